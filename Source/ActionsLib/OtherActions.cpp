@@ -559,3 +559,32 @@ void DoTopologyPlot(const ConfigParameters& config)
 
 template void DoTopologyPlot<float>(const ConfigParameters& config);
 template void DoTopologyPlot<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoConvertTextToBinary() - implements CNTK "convertTextToBinary" command
+// ===========================================================================
+
+// The command takes the configuration of a CNTKTextFormatDeserializer (file, input, chunkSizeInBytes, ...) plus
+// 'outputFile', and writes the data as a file for the CNTKBinaryReader, e.g.
+//   convert = [
+//       action = "convertTextToBinary"
+//       file = "train.ctf"
+//       outputFile = "train.bin"
+//       input = [ features = [ dim = 784 ; format = "dense" ] ; labels = [ dim = 10 ; format = "dense" ] ]
+//   ]
+// The conversion is done by the CNTKTextFormatReader plugin, see TextToBinaryConverter.
+template <typename ElemType>
+void DoConvertTextToBinary(const ConfigParameters& config)
+{
+    ConfigParameters converterConfig(config);
+    if (!converterConfig.ExistsCurrent(L"precision"))
+        converterConfig.Insert("precision", std::is_same<ElemType, double>::value ? "double" : "float");
+
+    typedef void (*ConvertTextToBinaryProc)(const ConfigParameters* config);
+    Plugin plugin;
+    auto convertProc = (ConvertTextToBinaryProc) plugin.Load(L"CNTKTextFormatReader", "ConvertTextToBinary");
+    convertProc(&converterConfig);
+}
+
+template void DoConvertTextToBinary<float>(const ConfigParameters& config);
+template void DoConvertTextToBinary<double>(const ConfigParameters& config);
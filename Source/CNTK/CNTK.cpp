@@ -339,6 +339,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoParameterSVD<ElemType>(commandParams);
                 }
+                else if (thisAction == "convertTextToBinary")
+                {
+                    DoConvertTextToBinary<ElemType>(commandParams);
+                }
                 else
                 {
                     RuntimeError("unknown action: %s  in command set: %s", thisAction.c_str(), command[i].c_str());
@@ -470,6 +474,10 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         Globals::ForceDeterministicAlgorithms();
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
+    if (config(L"quantizedGemm", false))
+        Globals::SetQuantizedGemm(true);
+    if (config(L"fastCpuConvolution", false))
+        Globals::SetFastCpuConvolution(true);
 
 #ifndef CPUONLY
     auto valpp = config.Find(L"deviceId");
@@ -635,6 +643,10 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
         Globals::ForceDeterministicAlgorithms();
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
+    if (config(L"quantizedGemm", false))
+        Globals::SetQuantizedGemm(true);
+    if (config(L"fastCpuConvolution", false))
+        Globals::SetFastCpuConvolution(true);
 
     // get the command param set they want
     wstring logpath = config(L"stderr", L"");
@@ -21,6 +21,10 @@
 #include <algorithm>
 #include <mutex>
 #include <future>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <condition_variable>
 #include <cstddef>
 
 #ifdef SWIG
@@ -551,6 +555,7 @@ namespace CNTK
         friend class BlockMomentumDistributedLearner;
         friend class Internal::VariableResolver;
         friend class Trainer;
+        friend class Serializer;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -835,6 +840,10 @@ namespace CNTK
         bool m_isReadOnly;
 
         std::shared_ptr<void> m_tensorView; // Microsoft::MSR::CNTK::TensorView<ElemType>*
+
+        // Owner of the external storage (e.g. a memory-mapped model file) that the data of this view and of all views
+        // aliasing it points into; null for views over storage that they allocated themselves or that the caller owns.
+        std::shared_ptr<void> m_externalStorage;
     };
 
     enum class MaskKind : char
@@ -2888,6 +2897,25 @@ namespace CNTK
         Invalid,
     };
 
+    ///
+    /// The file formats in which a Function graph can be saved
+    ///
+    enum class ModelFormat
+    {
+        ///
+        /// A single protobuf message
+        ///
+        CNTKv2,
+
+        ///
+        /// A protobuf message with the structure of the graph, followed by the raw values of all Parameters and Constants,
+        /// aligned so that Function::Load can map them into memory instead of reading them. When loaded on the CPU,
+        /// the values are used in place, and all processes that load the same file share the same physical memory
+        /// for them until they modify them.
+        ///
+        CNTKv2Mappable,
+    };
+
     ///
     /// Defines a signature of the deserialize callback for user defined functions,
     /// that needs to be provided to Function::Load to inflate user defined functions in the model.
@@ -3268,7 +3296,7 @@ namespace CNTK
         ///
         /// Save this Function graph into a model file.
         ///
-        CNTK_API void Save(const std::wstring& filepath);
+        CNTK_API void Save(const std::wstring& filepath, ModelFormat format = ModelFormat::CNTKv2);
 
         ///
         /// Restore the models parameters (in-place) from a model file
@@ -3310,6 +3338,10 @@ namespace CNTK
         /// function instance returned from the Dropout(), RandomSample(), RandomSampleInclusionFrequency() 
         /// method or a corresponding primitive function returned from FindByName()).
         ///
+        /// * 'quantizedGemm' with the corresponding bool value. Makes a Times function with constant weights
+        /// compute its product on the CPU in 16-bit integers (can only be invoked on a function instance
+        /// returned from the Times() method or a primitive times function returned from FindByName()).
+        ///
         CNTK_API void SetAttribute(const std::wstring& name, const DictionaryValue& value);
 
         ///
@@ -4585,6 +4617,8 @@ namespace CNTK
 
     ///
     /// Create an instance of the CNTK built-in RMSProp learner.
+    /// With needAveMultiplier, the average multiplier of a sparse gradient on the CPU (e.g. of an embedding) is
+    /// averaged over the columns that have a gradient only.
     ///
     CNTK_API LearnerPtr RMSPropLearner(const std::vector<Parameter>& parameters,
                                        const LearningRateSchedule& learningRateSchedule,
@@ -4853,6 +4887,106 @@ namespace CNTK
     ///
     CNTK_API EvaluatorPtr CreateEvaluator(const FunctionPtr& evaluationFunction, const std::vector<ProgressWriterPtr>& progressWriters = {});
 
+    ///
+    /// Histograms of the requests served by a BatchingEvaluator.
+    ///
+    struct BatchingEvaluatorStatistics
+    {
+        /// Entry n is the number of forward passes that evaluated n requests together.
+        std::vector<size_t> batchSizeHistogram;
+
+        /// Entry i is the number of requests that waited for [2^i, 2^(i+1)) microseconds (entry 0 also
+        /// counts shorter waits) between their submission and the start of their forward pass.
+        std::vector<size_t> queueDelayHistogram;
+
+        std::wstring AsString() const
+        {
+            std::wstringstream wss;
+            wss << L"BatchingEvaluatorStatistics(batch sizes:";
+            for (size_t n = 0; n < batchSizeHistogram.size(); ++n)
+                if (batchSizeHistogram[n] != 0)
+                    wss << L" " << n << L"=" << batchSizeHistogram[n];
+            wss << L"; queue delays:";
+            for (size_t i = 0; i < queueDelayHistogram.size(); ++i)
+                if (queueDelayHistogram[i] != 0)
+                    wss << L" <" << (1ull << (i + 1)) << L"us=" << queueDelayHistogram[i];
+            wss << L")";
+            return wss.str();
+        }
+    };
+
+    ///
+    /// Serves concurrent requests for evaluating a Function on a single sequence each, by batching them:
+    /// requests are collected until maxBatchSize of them are waiting or the oldest of them has waited for
+    /// maxDelay, and are then evaluated together in a single forward pass, on a dedicated thread.
+    /// This amortizes the per-call overhead of Function::Evaluate over the batch.
+    ///
+    class BatchingEvaluator
+    {
+    public:
+        ///
+        /// Queues the evaluation of the Function's outputs for the specified 'arguments', which must specify
+        /// a Value containing exactly one sequence for every argument of the Function. The Values are read
+        /// when the batch is formed, so they must not be changed until the returned future is ready.
+        /// The future yields a Value with the one output sequence for each output of the Function, or the
+        /// exception that was thrown by the forward pass.
+        ///
+        CNTK_API std::future<std::unordered_map<Variable, ValuePtr>> EvaluateAsync(const std::unordered_map<Variable, ValuePtr>& arguments);
+
+        ///
+        /// Same as EvaluateAsync() but blocks until the outputs are available.
+        ///
+        CNTK_API std::unordered_map<Variable, ValuePtr> Evaluate(const std::unordered_map<Variable, ValuePtr>& arguments);
+
+        ///
+        /// Returns the histograms of the batch sizes and queueing delays since the creation or the last ResetStatistics().
+        ///
+        CNTK_API BatchingEvaluatorStatistics Statistics() const;
+
+        CNTK_API void ResetStatistics();
+
+        ///
+        /// Function being evaluated.
+        ///
+        FunctionPtr EvaluationFunction() const { return m_function; }
+
+        ///
+        /// Evaluates the requests that are still queued, then stops the batching thread.
+        ///
+        CNTK_API virtual ~BatchingEvaluator();
+
+    private:
+        template <typename T1, typename ...CtorArgTypes>
+        friend std::shared_ptr<T1> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+        struct Request;
+
+        BatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, std::chrono::microseconds maxDelay, const DeviceDescriptor& device);
+
+        void BatchingLoop();
+        void EvaluateBatch(std::vector<std::shared_ptr<Request>>& batch);
+
+        const FunctionPtr m_function;
+        std::vector<Variable> m_arguments;
+        std::vector<Variable> m_outputs;
+        const size_t m_maxBatchSize;
+        const std::chrono::microseconds m_maxDelay;
+        const DeviceDescriptor m_device;
+
+        mutable std::mutex m_mutex; // guards all of the following
+        std::condition_variable m_requestAvailable;
+        std::deque<std::shared_ptr<Request>> m_requests;
+        bool m_stopping;
+        BatchingEvaluatorStatistics m_statistics;
+
+        std::thread m_thread;
+    };
+
+    ///
+    /// Construct a BatchingEvaluator for the specified Function.
+    ///
+    CNTK_API BatchingEvaluatorPtr CreateBatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, std::chrono::microseconds maxDelay, const DeviceDescriptor& device = DeviceDescriptor::UseDefaultDevice());
+
     ///
     /// Trainer is the top-level abstraction responsible for the orchestration of the training of a model
     /// using the specified learners and training data either explicitly supplied as Value objects or from
@@ -5291,6 +5425,13 @@ namespace CNTK
     /// 
     CNTK_API  Deserializer CTFDeserializer(const std::wstring& fileName, const std::vector<StreamConfiguration>& streams);
 
+    /// 
+    /// Convert a file in the CNTK text format into the CNTK binary format (as read by the CNTKBinaryReader), with
+    /// the streams as for a CTFDeserializer. Each chunk of 'chunkSizeInBytes' of the text becomes a chunk of the binary file.
+    /// 
+    CNTK_API void ConvertCTFToBinary(const std::wstring& ctfFileName, const std::wstring& binaryFileName, const std::vector<StreamConfiguration>& streams,
+                                     DataType dataType = DataType::Float, size_t chunkSizeInBytes = 32 * 1024 * 1024);
+
     /// 
     /// Create an HTKFeatureDeserializer with the specified options
     /// 
@@ -206,6 +206,9 @@ namespace CNTK
     class Evaluator;
     typedef std::shared_ptr<Evaluator> EvaluatorPtr;
 
+    class BatchingEvaluator;
+    typedef std::shared_ptr<BatchingEvaluator> BatchingEvaluatorPtr;
+
     class Trainer;
     typedef std::shared_ptr<Trainer> TrainerPtr;
 
@@ -274,6 +277,9 @@ namespace CNTK
         CNTK_API void ForceDeterministicAlgorithms();
         CNTK_API bool ShouldForceDeterministicAlgorithms();
 
+        CNTK_API void SetFastCpuConvolution(bool enable);
+        CNTK_API bool ShouldUseFastCpuConvolution();
+
         CNTK_API void EnableSynchronousGPUKernelExecution();
         CNTK_API bool IsSynchronousGPUKernelExecutionEnabled();
 
@@ -0,0 +1,185 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+
+namespace CNTK
+{
+    static const size_t NumQueueDelayBuckets = 32;
+
+    struct BatchingEvaluator::Request
+    {
+        std::vector<NDArrayViewPtr> m_sequences; // one for every argument of the Function, in the order of m_arguments
+        std::chrono::steady_clock::time_point m_submitTime;
+        std::promise<std::unordered_map<Variable, ValuePtr>> m_outputs;
+    };
+
+    BatchingEvaluatorPtr CreateBatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, std::chrono::microseconds maxDelay, const DeviceDescriptor& device)
+    {
+        return MakeSharedObject<BatchingEvaluator>(function, maxBatchSize, maxDelay, device);
+    }
+
+    BatchingEvaluator::BatchingEvaluator(const FunctionPtr& function, size_t maxBatchSize, std::chrono::microseconds maxDelay, const DeviceDescriptor& device)
+        : m_function(function),
+          m_maxBatchSize(maxBatchSize),
+          m_maxDelay(maxDelay),
+          m_device(device),
+          m_stopping(false)
+    {
+        if (!m_function)
+            InvalidArgument("BatchingEvaluator: The Function to evaluate is not allowed to be null.");
+        if (m_maxBatchSize == 0)
+            InvalidArgument("BatchingEvaluator: The maximum batch size must be positive.");
+
+        m_arguments = m_function->Arguments();
+        for (const auto& argument : m_arguments)
+        {
+            if (argument.DynamicAxes().empty())
+                InvalidArgument("BatchingEvaluator: Argument '%S' has no batch axis, so requests cannot be batched.", argument.AsString().c_str());
+        }
+        m_outputs = m_function->Outputs();
+
+        ResetStatistics();
+        m_thread = std::thread(&BatchingEvaluator::BatchingLoop, this);
+    }
+
+    BatchingEvaluator::~BatchingEvaluator()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_requestAvailable.notify_all();
+        m_thread.join();
+    }
+
+    std::future<std::unordered_map<Variable, ValuePtr>> BatchingEvaluator::EvaluateAsync(const std::unordered_map<Variable, ValuePtr>& arguments)
+    {
+        if (arguments.size() != m_arguments.size())
+            InvalidArgument("BatchingEvaluator::EvaluateAsync: %d Values were specified, but the Function has %d arguments.", (int)arguments.size(), (int)m_arguments.size());
+
+        auto request = std::make_shared<Request>();
+        for (const auto& argument : m_arguments)
+        {
+            auto iter = arguments.find(argument);
+            if ((iter == arguments.end()) || !iter->second)
+                InvalidArgument("BatchingEvaluator::EvaluateAsync: No Value was specified for argument '%S'.", argument.AsString().c_str());
+
+            // Throws for Values that do not contain entire sequences.
+            auto sequences = iter->second->UnpackVariableValue(argument, m_device);
+            if (sequences.size() != 1)
+                InvalidArgument("BatchingEvaluator::EvaluateAsync: The Value for argument '%S' contains %d sequences, but must contain exactly one.",
+                                argument.AsString().c_str(), (int)sequences.size());
+            request->m_sequences.push_back(sequences[0]);
+        }
+
+        auto outputs = request->m_outputs.get_future();
+        request->m_submitTime = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back(request);
+        }
+        m_requestAvailable.notify_one();
+        return outputs;
+    }
+
+    std::unordered_map<Variable, ValuePtr> BatchingEvaluator::Evaluate(const std::unordered_map<Variable, ValuePtr>& arguments)
+    {
+        return EvaluateAsync(arguments).get();
+    }
+
+    BatchingEvaluatorStatistics BatchingEvaluator::Statistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    void BatchingEvaluator::ResetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.batchSizeHistogram.assign(m_maxBatchSize + 1, 0);
+        m_statistics.queueDelayHistogram.assign(NumQueueDelayBuckets, 0);
+    }
+
+    void BatchingEvaluator::BatchingLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_requestAvailable.wait(lock, [this] { return m_stopping || !m_requests.empty(); });
+            if (m_requests.empty()) // stopping, and nothing left to do
+                return;
+
+            // Wait for more requests, until the batch is full or the oldest request is due.
+            auto deadline = m_requests.front()->m_submitTime + m_maxDelay;
+            m_requestAvailable.wait_until(lock, deadline, [this] { return m_stopping || (m_requests.size() >= m_maxBatchSize); });
+
+            size_t batchSize = std::min(m_requests.size(), m_maxBatchSize);
+            std::vector<std::shared_ptr<Request>> batch(m_requests.begin(), m_requests.begin() + batchSize);
+            m_requests.erase(m_requests.begin(), m_requests.begin() + batchSize);
+
+            auto now = std::chrono::steady_clock::now();
+            m_statistics.batchSizeHistogram[batchSize]++;
+            for (const auto& request : batch)
+            {
+                auto delay = std::chrono::duration_cast<std::chrono::microseconds>(now - request->m_submitTime).count();
+                size_t bucket = 0;
+                while ((delay >>= 1) > 0 && (bucket + 1 < NumQueueDelayBuckets))
+                    bucket++;
+                m_statistics.queueDelayHistogram[bucket]++;
+            }
+
+            lock.unlock();
+            EvaluateBatch(batch);
+            lock.lock();
+        }
+    }
+
+    void BatchingEvaluator::EvaluateBatch(std::vector<std::shared_ptr<Request>>& batch)
+    {
+        std::vector<std::unordered_map<Variable, ValuePtr>> results(batch.size());
+        try
+        {
+            // Every request becomes one sequence of the minibatch; Value::Create() sets up the mask for the
+            // sequences that are shorter than the longest one.
+            std::unordered_map<Variable, ValuePtr> arguments;
+            std::vector<bool> sequenceStartFlags(batch.size(), true);
+            for (size_t i = 0; i < m_arguments.size(); ++i)
+            {
+                std::vector<NDArrayViewPtr> sequences;
+                sequences.reserve(batch.size());
+                for (const auto& request : batch)
+                    sequences.push_back(request->m_sequences[i]);
+                arguments[m_arguments[i]] = Value::Create(m_arguments[i].Shape(), sequences, sequenceStartFlags, m_device, /*readOnly =*/ true, /*createNewCopy =*/ true);
+            }
+
+            std::unordered_map<Variable, ValuePtr> outputs;
+            for (const auto& output : m_outputs)
+                outputs[output] = nullptr;
+            m_function->Evaluate(arguments, outputs, m_device);
+
+            for (const auto& output : m_outputs)
+            {
+                auto sequences = outputs[output]->UnpackVariableValue(output, m_device);
+                if (sequences.size() != batch.size())
+                    LogicError("BatchingEvaluator: Output '%S' has %d sequences for a batch of %d requests.", output.AsString().c_str(), (int)sequences.size(), (int)batch.size());
+                for (size_t j = 0; j < batch.size(); ++j)
+                    results[j][output] = Value::Create(output.Shape(), { sequences[j] }, { true }, m_device, /*readOnly =*/ false, /*createNewCopy =*/ true);
+            }
+        }
+        catch (...)
+        {
+            auto exception = std::current_exception();
+            for (auto& request : batch)
+                request->m_outputs.set_exception(exception);
+            return;
+        }
+
+        for (size_t j = 0; j < batch.size(); ++j)
+            batch[j]->m_outputs.set_value(std::move(results[j]));
+    }
+}
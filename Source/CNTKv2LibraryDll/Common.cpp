@@ -474,6 +474,16 @@ namespace CNTK
             return Microsoft::MSR::CNTK::Globals::ShouldForceDeterministicAlgorithms();
         }
 
+        void SetFastCpuConvolution(bool enable)
+        {
+            Microsoft::MSR::CNTK::Globals::SetFastCpuConvolution(enable);
+        }
+
+        bool ShouldUseFastCpuConvolution()
+        {
+            return Microsoft::MSR::CNTK::Globals::ShouldUseFastCpuConvolution();
+        }
+
         void EnableSynchronousGPUKernelExecution()
         {
             SyncGuard::EnableSync();
@@ -882,7 +882,10 @@ namespace CNTK
                 {
                     size_t outputRank = functionConfig[PrimitiveFunction::AttributeNameOutputRank].Value<size_t>();
                     auto inferInputRankToMap = functionConfig[PrimitiveFunction::AttributeNameInferInputRankToMap].Value<int>();
-                    computationNodePtr = New<TimesNode<ElementType>>(network->GetDeviceId(), internalNodeName, outputRank, inferInputRankToMap);
+                    bool quantizedGemm = false;
+                    if (functionConfig.Contains(PrimitiveFunction::AttributeNameQuantizedGemm))
+                        quantizedGemm = functionConfig[PrimitiveFunction::AttributeNameQuantizedGemm].Value<bool>();
+                    computationNodePtr = New<TimesNode<ElementType>>(network->GetDeviceId(), internalNodeName, outputRank, inferInputRankToMap, quantizedGemm);
                     break;
                 }
                 case PrimitiveOpType::TransposeTimes:
@@ -1969,6 +1972,14 @@ namespace CNTK
                     assert(rngUserPtr != nullptr);
                     rngUserPtr->SetRngState(seed);
                 }
+                else if (attribute == PrimitiveFunction::AttributeNameQuantizedGemm)
+                {
+                    auto quantizedGemm = function->m_attributes[attribute].Value<bool>();
+                    if (node->Is<TimesNode<float>>())
+                        node->As<TimesNode<float>>()->SetQuantizedGemm(quantizedGemm);
+                    else
+                        node->As<TimesNode<double>>()->SetQuantizedGemm(quantizedGemm);
+                }
                 else 
                 {
                     // Should never happen.
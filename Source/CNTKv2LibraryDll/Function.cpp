@@ -9,6 +9,7 @@
 #include "CompositeFunction.h"
 #include "BlockFunction.h"
 #include "Utils.h"
+#include "Serialization.h"
 #include "UserFunctionFactory.h"
 #include "TrainingNodes.h"
 
@@ -448,9 +449,17 @@ namespace CNTK
         Forward(arguments, outputs, computeDevice, {});
     }
 
-    void Function::Save(const std::wstring& filepath)
+    void Function::Save(const std::wstring& filepath, ModelFormat format)
     {
         Dictionary model = Serialize();
+        if (format == ModelFormat::CNTKv2Mappable)
+        {
+            SaveMappableDictionary(model, filepath);
+            return;
+        }
+        else if (format != ModelFormat::CNTKv2)
+            InvalidArgument("Function::Save: Unsupported model format %d.", (int)format);
+
         auto stream = GetFstream(filepath, false);
         *stream << model;
         stream->flush();
@@ -459,7 +468,12 @@ namespace CNTK
     /*static*/ FunctionPtr Function::Load(const std::wstring& filepath, const DeviceDescriptor& computeDevice)
     {
         auto stream = GetFstream(filepath, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsMappableModel(*stream))
+        {
+            stream.reset();
+            return Function::Deserialize(LoadMappedDictionary(filepath), computeDevice);
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -487,6 +501,8 @@ namespace CNTK
 
         if (Internal::IsLegacyModel(buffer, length))
             InvalidArgument("Loading a legacy model from byte array is not supported.");
+        else if (IsMappableModel(buffer, length))
+            InvalidArgument("Loading a memory-mappable model from byte array is not supported; load it from the model file.");
         else
         {
             modelStreamBuffer buf(buffer, length);
@@ -506,7 +522,13 @@ namespace CNTK
     void Function::Restore(const std::wstring& filepath)
     {
         auto stream = GetFstream(filepath, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsMappableModel(*stream))
+        {
+            stream.reset();
+            RestoreFromCheckpoint(LoadMappedDictionary(filepath));
+            return;
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -993,6 +1015,10 @@ namespace CNTK
 
             primitiveFunctionPtr->SetRandomSeed(seed);
         }
+        else if (name == PrimitiveFunction::AttributeNameQuantizedGemm)
+        {
+            primitiveFunctionPtr->SetQuantizedGemm(value.Value<bool>());
+        }
         else 
         {
             LogicError("SetAttribute: '%S' is not supported (this attribute cannot be updated).", name.c_str());
@@ -108,6 +108,9 @@ namespace CNTK
             else
                 LogicError("Unsupported DataType %s", DataTypeName(v.second->GetDataType()));
         }
+
+        for (auto& history : m_sparseUpdateHistories)
+            history.second.Reset();
     }
 
     // Clipping gradients to prevent outliers,
@@ -221,6 +224,9 @@ namespace CNTK
             }
         }
 
+        for (const auto& parameter : parameters)
+            m_sparseUpdateHistories[parameter];
+
         if (m_additionalOptions.useMeanGradient && learningRateSchedule.Unit() == LearningRateSchedule::UnitType::Minibatch)
         {
             LogicError("useMeanGradient should not be used with per-minibatch learning rate setting");
@@ -334,6 +340,34 @@ namespace CNTK
 
     static const std::wstring s_learnerTypeValue = L"Learner";
 
+    // The last updates of the columns are stored as doubles, which hold them exactly.
+    static Dictionary SerializeSparseUpdateHistory(const SparseUpdateHistory& history)
+    {
+        Dictionary dict;
+        dict[numUpdatesKey] = history.m_numUpdates;
+        if (!history.m_lastUpdates.empty())
+        {
+            NDArrayView lastUpdates(DataType::Double, NDShape({ history.m_lastUpdates.size() }), DeviceDescriptor::CPUDevice());
+            std::copy(history.m_lastUpdates.begin(), history.m_lastUpdates.end(), lastUpdates.WritableDataBuffer<double>());
+            dict[lastUpdatesKey] = lastUpdates;
+        }
+        return dict;
+    }
+
+    static void DeserializeSparseUpdateHistory(const Dictionary& dict, SparseUpdateHistory& history)
+    {
+        history.Reset();
+        history.m_numUpdates = dict[numUpdatesKey].Value<size_t>();
+        if (dict.Contains(lastUpdatesKey))
+        {
+            const auto& lastUpdates = dict[lastUpdatesKey].Value<NDArrayView>();
+            if (lastUpdates.GetDataType() != DataType::Double)
+                LogicError("DataType of the sparse update history restored from checkpoint does not match the expected value.");
+            const double* data = lastUpdates.DataBuffer<double>();
+            history.m_lastUpdates.assign(data, data + lastUpdates.Shape().TotalSize());
+        }
+    }
+
     /*virtual*/ Dictionary LearnerBase::CreateCheckpoint() /*override*/
     {
         Dictionary checkpoint;
@@ -357,6 +391,13 @@ namespace CNTK
 
         checkpoint[smoothedGradientsKey] = serializedSmoothedGradients;
 
+        std::vector<DictionaryValue> serializedSparseUpdateHistories(Parameters().size());
+        i = 0;
+        for (const auto& parameter : Parameters())
+            serializedSparseUpdateHistories[i++] = SerializeSparseUpdateHistory(m_sparseUpdateHistories.at(parameter));
+
+        checkpoint[sparseUpdateHistoriesKey] = serializedSparseUpdateHistories;
+
         return checkpoint;
     }
 
@@ -426,6 +467,20 @@ namespace CNTK
 
             smoothedGradientValue->CopyFrom(checkpointedValue);
         }
+
+        // Older checkpoints have no sparse update histories, so that the skipped updates before them are lost.
+        for (auto& history : m_sparseUpdateHistories)
+            history.second.Reset();
+
+        if (checkpoint.Contains(sparseUpdateHistoriesKey))
+        {
+            const auto& values = checkpoint[sparseUpdateHistoriesKey].Value<vector<DictionaryValue>>();
+            if (values.size() != parameters.size())
+                LogicError("Checkpoint contains %d sparse update histories, but the learner has %d parameters.", (int)values.size(), (int)parameters.size());
+
+            for (size_t i = 0; i < parameters.size(); i++)
+                DeserializeSparseUpdateHistory(values[i].Value<Dictionary>(), m_sparseUpdateHistories.at(parameters[i]));
+        }
     }
 
     void LearnerBase::ReportTrainingParameterValue(const TrainingParameterSchedule<double>& schedule, const wstring& name) const
@@ -517,7 +572,7 @@ namespace CNTK
         const auto momentum = ElementType(MomentumValueForMB(trainingSampleCount));
 
         parameterMatrix->MomentumSGDUpdate(*gradientMatrix, *smoothedGradientMatrix,
-                                           learningRate, momentum, UseUnitGainMomentum());
+                                           learningRate, momentum, UseUnitGainMomentum(), SparseUpdateHistoryOf(parameter));
     }
 
     /*virtual*/ void LearnerNesterov::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, 
@@ -536,7 +591,7 @@ namespace CNTK
         const auto momentum = ElementType(MomentumValueForMB(trainingSampleCount));
 
         parameterMatrix->NesterovAcceleratedMomentumSGDUpdate(*gradientMatrix, *smoothedGradientMatrix,
-                                                              learningRate, momentum, UseUnitGainMomentum());
+                                                              learningRate, momentum, UseUnitGainMomentum(), SparseUpdateHistoryOf(parameter));
     }
 
     LearnerAdaGrad::LearnerAdaGrad(const std::vector<Parameter>& parameters,
@@ -684,7 +739,7 @@ namespace CNTK
         const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
 
         smoothedGradientMatrix->FSAdagradUpdate(*gradientMatrix, *parameterMatrix, m_targetAdagradAvDenom_x_sqrtAdagradSqrFrames, learningRate,
-                                                momentum, varMomentum, UseUnitGainMomentum());
+                                                momentum, varMomentum, UseUnitGainMomentum(), SparseUpdateHistoryOf(parameter));
     }
 
     LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
@@ -757,7 +812,8 @@ namespace CNTK
         const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
 
         smoothedGradientMatrix->AdamUpdate(*gradientMatrix, *parameterMatrix, m_smoothedCount, learningRate,
-                                           momentum, varMomentum, (ElementType)m_epsilon, UseUnitGainMomentum(), m_adamax);
+                                           momentum, varMomentum, (ElementType)m_epsilon, UseUnitGainMomentum(), m_adamax,
+                                           SparseUpdateHistoryOf(parameter));
     }
 
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
@@ -846,7 +902,8 @@ namespace CNTK
                                                                    ElementType(m_dec),
                                                                    ElementType(m_min),
                                                                    m_needAveMultiplier,
-                                                                   m_smoothedCount > 1);
+                                                                   m_smoothedCount > 1,
+                                                                   SparseUpdateHistoryOf(parameter));
 
         Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate / aveMultiplier), *gradientMatrix, *parameterMatrix);
     }
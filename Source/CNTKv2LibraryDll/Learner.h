@@ -7,6 +7,7 @@
 
 #include "stdafx.h"
 #include "CNTKLibrary.h"
+#include "CommonMatrix.h"
 #include <numeric>
 #include <functional>
 
@@ -68,6 +69,15 @@ namespace CNTK
 
         std::unordered_map<Parameter, NDArrayViewPtr> m_smoothedGradientValues;
 
+        // Tracks which columns of a parameter the updates from sparse gradients have skipped (see SparseUpdateHistory).
+        // Checkpointed, so that a restored learner still catches up with the updates skipped before the checkpoint.
+        mutable std::unordered_map<Parameter, Microsoft::MSR::CNTK::SparseUpdateHistory> m_sparseUpdateHistories;
+
+        Microsoft::MSR::CNTK::SparseUpdateHistory* SparseUpdateHistoryOf(const Parameter& parameter) const
+        {
+            return &m_sparseUpdateHistories.at(parameter);
+        }
+
         mutable size_t m_noiseInjectionSeed;
 
         // The following four static protected methods expose private methods of NDArrayView class
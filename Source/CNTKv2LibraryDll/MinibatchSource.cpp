@@ -408,6 +408,29 @@ namespace CNTK
         return ctf;
     }
 
+    void ConvertCTFToBinary(const std::wstring& ctfFileName, const std::wstring& binaryFileName, const std::vector<StreamConfiguration>& streams,
+                            DataType dataType, size_t chunkSizeInBytes)
+    {
+        if (dataType != DataType::Float && dataType != DataType::Double)
+            InvalidArgument("ConvertCTFToBinary: Unsupported data type '%s'.", DataTypeName(dataType));
+
+        Dictionary converterConfiguration = CTFDeserializer(ctfFileName, streams);
+        converterConfiguration.Add(L"outputFile", binaryFileName, L"precision", dataType == DataType::Double ? L"double" : L"float",
+                                   L"chunkSizeInBytes", chunkSizeInBytes);
+
+        ConfigParameters config;
+        std::wstringstream s;
+        for (const auto& keyValuePair : converterConfiguration)
+            AddConfigString(s, keyValuePair.first, keyValuePair.second, 0);
+
+        config.Parse(msra::strfun::utf8(s.str()));
+
+        typedef void(*ConvertTextToBinaryProc)(const ConfigParameters* config);
+        Plugin plugin;
+        ConvertTextToBinaryProc convertProc = (ConvertTextToBinaryProc)plugin.Load(L"CNTKTextFormatReader", "ConvertTextToBinary");
+        convertProc(&config);
+    }
+
     Deserializer HTKFeatureDeserializer(const std::vector<HTKFeatureConfiguration>& streams)
     {
         Deserializer htk;
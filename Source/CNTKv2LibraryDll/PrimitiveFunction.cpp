@@ -52,6 +52,7 @@ namespace CNTK
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameEndAxis = L"endAxis";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameOutputRank = L"outputRank";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameInferInputRankToMap = L"inferInputRankToMap";
+    /*static*/ const std::wstring PrimitiveFunction::AttributeNameQuantizedGemm = L"quantizedGemm";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameOffset = L"offset";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameStrides = L"strides";
     /*static*/ const std::wstring PrimitiveFunction::AttributeNameSharing = L"sharing";
@@ -1287,4 +1288,13 @@ namespace CNTK
         m_attributes[AttributeNameRngSeed] = seed;
         m_dirtyAttributes.insert(AttributeNameRngSeed);
     }
+
+    void PrimitiveFunction::SetQuantizedGemm(bool quantizedGemm)
+    {
+        if (OpType() != PrimitiveOpType::Times)
+            LogicError("Cannot set quantized GEMM on '%S' function.", OpName().c_str());
+
+        m_attributes[AttributeNameQuantizedGemm] = quantizedGemm;
+        m_dirtyAttributes.insert(AttributeNameQuantizedGemm);
+    }
 }
@@ -214,6 +214,7 @@ namespace CNTK
         static const std::wstring AttributeNameEndAxis;
         static const std::wstring AttributeNameOutputRank;
         static const std::wstring AttributeNameInferInputRankToMap;
+        static const std::wstring AttributeNameQuantizedGemm;
         static const std::wstring AttributeNameOffset;
         static const std::wstring AttributeNameStrides;
         static const std::wstring AttributeNameSharing;
@@ -751,6 +752,8 @@ namespace CNTK
 
         void SetRandomSeed(size_t seed);
 
+        void SetQuantizedGemm(bool quantizedGemm);
+
     private:
         PrimitiveOpType m_op;
         // Increasing s_serializationVersion every time we add more ops allows us to print 
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "Serialization.h"
+#include "MemoryMappedFile.h"
 #include <istream>
 #include <ostream>
 #include <string>
@@ -31,6 +33,16 @@ namespace CNTK
     static const uint32 MAGIC_NUMBER = 0x636e746bU;
     static const uint32 BLOCK_SIZE = 8 << 10; // 8Kb;
 
+    // Memory-mappable model files start with this magic number and the byte size of the message, which is followed by
+    // the NDArrayView values, each at a multiple of the alignment.
+    static const uint32 MAPPABLE_MAGIC_NUMBER = 0x636e746dU;
+    static const size_t MAPPED_DATA_ALIGNMENT = 64;
+
+    static size_t AlignToMappedData(size_t size)
+    {
+        return (size + MAPPED_DATA_ALIGNMENT - 1) / MAPPED_DATA_ALIGNMENT * MAPPED_DATA_ALIGNMENT;
+    }
+
     static void SetUTF8Locale()
     {
 #ifndef _MSC_VER
@@ -124,6 +136,9 @@ namespace CNTK
         friend class Dictionary;
         friend class DictionaryValue;
 
+        friend void SaveMappableDictionary(const Dictionary&, const std::wstring&);
+        friend Dictionary LoadMappedDictionary(const std::wstring&);
+
         Serializer(const Dictionary& dict);
         Serializer(const DictionaryValue& dict);
 
@@ -145,7 +160,7 @@ namespace CNTK
         std::ostream& Write(std::ostream& stream);
         void Write(const std::wstring& filename);
         void Write(io::ZeroCopyOutputStream& stream);
-
+        void WriteMappable(const std::wstring& filename);
 
         bool Read(std::istream& stream, Dictionary& dict);
         bool Read(std::istream& stream, DictionaryValue& value);
@@ -157,6 +172,7 @@ namespace CNTK
         bool Read(std::istream& stream, const std::function<bool(io::ZeroCopyInputStream& input)>& callback);
 
         bool ReadNDArrayViewData(io::ZeroCopyInputStream& input);
+        bool ReadMapped(const std::wstring& filename, Dictionary& dict);
 
         size_t GetTotalByteSize() 
         {
@@ -256,6 +272,31 @@ namespace CNTK
             }
         }
 
+        static void WriteRaw(const void* data, size_t size, io::ZeroCopyOutputStream& output)
+        {
+            auto bytes = reinterpret_cast<const char*>(data);
+            while (size > 0)
+            {
+                void* buffer;
+                int bufferSize;
+                if (!output.Next(&buffer, &bufferSize))
+                    RuntimeError("Failed to write the NDArrayView values.");
+                auto chunkSize = std::min(size, (size_t)bufferSize);
+                memcpy(buffer, bytes, chunkSize);
+                if (chunkSize < (size_t)bufferSize)
+                    output.BackUp(bufferSize - (int)chunkSize);
+                bytes += chunkSize;
+                size -= chunkSize;
+            }
+        }
+
+        static void WritePadding(io::ZeroCopyOutputStream& output)
+        {
+            static const char zeros[MAPPED_DATA_ALIGNMENT] = {};
+            auto position = (size_t)output.ByteCount();
+            WriteRaw(zeros, AlignToMappedData(position) - position, output);
+        }
+
         template <typename T>
         static bool ReadData(RenewableCodedStream& input, NDArrayView& dst)
         {
@@ -285,6 +326,10 @@ namespace CNTK
         Message* m_proto;
         std::vector<std::pair<NDArrayView*, proto::NDArrayView*>> m_arrayViews;
         size_t m_byteSize {0};
+
+        // memory-mapped (copy-on-write) model file being read, and the offset of the NDArrayView values in it
+        std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile> m_mappedFile;
+        size_t m_mappedDataOffset {0};
     };
 
 
@@ -430,6 +475,23 @@ namespace CNTK
         std::unique_ptr<NDShape> shape(CreateFromProto(src.shape()));
         auto dataType = FromProtoType(src.data_type());
         auto storageFormat = FromProtoType(src.storage_format());
+
+        if (src.values_case() == proto::NDArrayView::kRawDataOffset)
+        {
+            // The values follow the message in a memory-mappable model file; use them in place.
+            auto numBytes = shape->TotalSize() * DataTypeSize(dataType);
+            if (!m_mappedFile)
+                RuntimeError("NDArrayView values stored outside of the message can only be read from a memory-mappable model file.");
+            if ((storageFormat != StorageFormat::Dense) ||
+                (src.raw_data_offset() > m_mappedFile->Size() - m_mappedDataOffset) ||
+                (numBytes > m_mappedFile->Size() - m_mappedDataOffset - src.raw_data_offset()))
+                RuntimeError("The memory-mappable model file is corrupt: invalid location of NDArrayView values.");
+
+            NDArrayView* mappedView = new NDArrayView(dataType, *shape, m_mappedFile->WritableData() + m_mappedDataOffset + src.raw_data_offset(), numBytes, DeviceDescriptor::CPUDevice());
+            mappedView->m_externalStorage = m_mappedFile;
+            return mappedView;
+        }
+
         NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
 
         if (dataType == DataType::Float)
@@ -630,6 +692,51 @@ namespace CNTK
         }
     }
 
+    void Serializer::WriteMappable(const std::wstring& filename)
+    {
+        // Lay out the values of the NDArrayViews one after another, each aligned.
+        size_t dataSize = 0;
+        for (auto& pair : m_arrayViews)
+        {
+            const auto& src = *(pair.first);
+            if (src.GetStorageFormat() != StorageFormat::Dense)
+                InvalidArgument("Sparse NDArrayView values cannot be saved in a memory-mappable model file.");
+            pair.second->set_raw_data_offset(dataSize);
+            dataSize += AlignToMappedData(src.Shape().TotalSize() * DataTypeSize(src.GetDataType()));
+        }
+
+        auto messageSize = m_proto->ByteSizeLong();
+        if (messageSize >= static_cast<size_t>(INT_MAX))
+            RuntimeError("The model structure is too large (%zu bytes) for a memory-mappable model file.", messageSize);
+
+        auto stream = GetFstream(filename, false);
+        {
+            io::OstreamOutputStream output(stream.get());
+            {
+                io::CodedOutputStream codedOutput(&output);
+                codedOutput.WriteLittleEndian32(MAPPABLE_MAGIC_NUMBER);
+                codedOutput.WriteLittleEndian32((uint32)messageSize);
+                m_proto->SerializeToCodedStream(&codedOutput);
+            }
+            WritePadding(output);
+
+            // The values are mapped into memory as they are, so they are written in the native byte order
+            // (little-endian on all supported platforms).
+            for (auto& pair : m_arrayViews)
+            {
+                const auto& src = *(pair.first);
+                if (src.GetDataType() == DataType::Float)
+                    WriteRaw(src.DataBuffer<float>(), src.Shape().TotalSize() * sizeof(float), output);
+                else if (src.GetDataType() == DataType::Double)
+                    WriteRaw(src.DataBuffer<double>(), src.Shape().TotalSize() * sizeof(double), output);
+                WritePadding(output);
+            }
+        }
+        stream->flush();
+        if (stream->fail())
+            RuntimeError("Failed to write the model file '%S'.", filename.c_str());
+    }
+
     std::ostream& Serializer::Write(std::ostream& stream)
     {
         io::OstreamOutputStream output(&stream);
@@ -696,6 +803,30 @@ namespace CNTK
         });
     }
 
+    bool Serializer::ReadMapped(const std::wstring& filename, Dictionary& dict)
+    {
+        m_mappedFile = std::make_shared<Microsoft::MSR::CNTK::MemoryMappedFile>(filename, /*copyOnWrite=*/true);
+        auto data = reinterpret_cast<const uint8*>(m_mappedFile->Data());
+        auto size = m_mappedFile->Size();
+        if ((size < 2 * sizeof(uint32)) || !IsMappableModel(m_mappedFile->Data(), size))
+            return false;
+
+        uint32 messageSize;
+        io::CodedInputStream::ReadLittleEndian32FromArray(data + sizeof(uint32), &messageSize);
+        if (messageSize > size - 2 * sizeof(uint32))
+            return false;
+        m_mappedDataOffset = std::min(AlignToMappedData(2 * sizeof(uint32) + messageSize), size);
+
+        m_proto = Arena::CreateMessage<proto::Dictionary>(&m_arena);
+        io::CodedInputStream codedInput(data + 2 * sizeof(uint32), (int)messageSize);
+        codedInput.SetTotalBytesLimit(INT_MAX, INT_MAX);
+        if (!m_proto->ParseFromCodedStream(&codedInput) || !codedInput.ConsumedEntireMessage())
+            return false;
+
+        Copy(*dynamic_cast<proto::Dictionary*>(m_proto), dict);
+        return true;
+    }
+
     bool Serializer::Read(std::istream& stream, DictionaryValue& value)
     {
         m_proto = Arena::CreateMessage<proto::DictionaryValue>(&m_arena);
@@ -792,6 +923,40 @@ namespace CNTK
         return dictionary;
     }
 
+    bool IsMappableModel(std::istream& stream)
+    {
+        char buffer[sizeof(MAPPABLE_MAGIC_NUMBER)];
+        const auto position = stream.tellg();
+        stream.read(buffer, sizeof(buffer));
+        auto bytesRead = (size_t)stream.gcount();
+        stream.clear();
+        stream.seekg(position);
+        return IsMappableModel(buffer, bytesRead);
+    }
+
+    bool IsMappableModel(const char* buffer, size_t bufferSize)
+    {
+        if (bufferSize < sizeof(MAPPABLE_MAGIC_NUMBER))
+            return false;
+
+        uint32 prefix;
+        io::CodedInputStream::ReadLittleEndian32FromArray(reinterpret_cast<const uint8*>(buffer), &prefix);
+        return prefix == MAPPABLE_MAGIC_NUMBER;
+    }
+
+    void SaveMappableDictionary(const Dictionary& dictionary, const std::wstring& filename)
+    {
+        Serializer(dictionary).WriteMappable(filename);
+    }
+
+    Dictionary LoadMappedDictionary(const std::wstring& filename)
+    {
+        Dictionary dictionary;
+        if (!Serializer().ReadMapped(filename, dictionary))
+            RuntimeError("Failed to parse the memory-mappable model file (%ls).", filename.c_str());
+        return dictionary;
+    }
+
     /*static*/ DictionaryValue DictionaryValue::Load(const std::wstring& filename)
     {
         DictionaryValue dictionaryValue;
@@ -35,6 +35,9 @@ namespace CNTK
     const std::wstring learningRateScheduleKey = L"learnig_rate_schedule";
     const std::wstring smoothedGradientsKey = L"smoothed_gradients";
     const std::wstring noiseInjectionSeedKey = L"noise_injection_seed";
+    const std::wstring sparseUpdateHistoriesKey = L"sparse_update_histories";
+    const std::wstring numUpdatesKey = L"num_updates";
+    const std::wstring lastUpdatesKey = L"last_updates";
     const std::wstring smoothedCountKey = L"smoothed_count";
     const std::wstring stateKey = L"state";
     const std::wstring rngSeedKey = L"rng_seed";
@@ -106,4 +109,12 @@ namespace CNTK
 
         return version;
     }
+
+    // Memory-mappable model files (ModelFormat::CNTKv2Mappable): the Dictionary without the NDArrayView values, followed by
+    // the raw values of all NDArrayViews, each aligned. LoadMappedDictionary() maps the file into memory (copy-on-write),
+    // and the NDArrayViews in the returned Dictionary point into the mapping, which they keep alive.
+    bool IsMappableModel(std::istream& stream);
+    bool IsMappableModel(const char* buffer, size_t bufferSize);
+    void SaveMappableDictionary(const Dictionary& dictionary, const std::wstring& filename);
+    Dictionary LoadMappedDictionary(const std::wstring& filename);
 }
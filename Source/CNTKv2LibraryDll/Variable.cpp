@@ -511,9 +511,16 @@ namespace CNTK
         {
             auto& value = dict[valueKey].Value<NDArrayView>();
 
+            // Values mapped from a model file are used in place if they are on the right device, so that they are
+            // neither copied nor take up memory of their own until they are modified.
             // TODO: this copying here is redundant, value should be moved from the dictionary to the variable.
             // Also, the correct device should be used upfront when deserializing NDArrayView.
-            Variable var(shape, kind, dataType, value.DeepClone(device, kind == VariableKind::Constant), needsGradient, dynamicAxis, isSparse, name, uid);
+            NDArrayViewPtr varValue;
+            if (value.m_externalStorage && (value.Device() == device))
+                varValue = value.Alias(kind == VariableKind::Constant);
+            else
+                varValue = value.DeepClone(device, kind == VariableKind::Constant);
+            Variable var(shape, kind, dataType, varValue, needsGradient, dynamicAxis, isSparse, name, uid);
             if (var.IsParameter())
                 return Parameter(var);
             else
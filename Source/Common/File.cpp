@@ -87,6 +87,8 @@ void File::Init(const wchar_t* filename, int fileOptions)
 {
     m_filename = filename;
     m_options = fileOptions;
+    m_memoryBuffer = nullptr;
+    m_memorySize = 0;
     if (m_filename.empty())
         RuntimeError("File: filename is empty");
     const auto outputPipe = (m_filename.front() == '|');
@@ -96,6 +98,13 @@ void File::Init(const wchar_t* filename, int fileOptions)
     const auto writing = !!(fileOptions & fileOptionsWrite);
     if (!reading && !writing)
         RuntimeError("File: either fileOptionsRead or fileOptionsWrite must be specified");
+    if (fileOptions & fileOptionsMemory)
+    {
+        if (reading)
+            RuntimeError("File: fileOptionsMemory cannot be used with fileOptionsRead");
+        OpenMemory();
+        return;
+    }
     // convert fileOptions to fopen()'s mode string
     wstring options = reading ? L"r" : L"";
     if (writing)
@@ -149,6 +158,27 @@ void File::Init(const wchar_t* filename, int fileOptions)
                 });
 }
 
+// open an in-memory stream for a File opened with fileOptionsMemory
+// The filename is only used in messages; CopyMemoryTo() writes the content to its actual destination.
+void File::OpenMemory()
+{
+    m_pcloseNeeded = false;
+    m_seekable = true;
+#ifdef _WIN32
+    // There is no open_memstream() on Windows. Use a temporary file instead, which is deleted when closed ('D')
+    // and which the file system keeps in memory as long as it can ('T').
+    wchar_t* tempFileName = _wtempnam(nullptr, L"cntk");
+    if (!tempFileName)
+        RuntimeError("File: cannot create a temporary file name for '%S'", m_filename.c_str());
+    m_file = _wfopen(tempFileName, L"w+bTD");
+    free(tempFileName);
+#else
+    m_file = open_memstream(&m_memoryBuffer, &m_memorySize);
+#endif
+    if (!m_file)
+        RuntimeError("File: cannot open memory stream for '%S': %s", m_filename.c_str(), strerror(errno));
+}
+
 // determine the directory for a given pathname
 // (wstring only for now; feel free to make this a template if needed)
 /*static*/ wstring File::DirectoryPathOf(wstring path)
@@ -277,6 +307,7 @@ File::~File(void)
             RuntimeError("File: failed to close file at %S", m_filename.c_str());
         }
     }
+    free(m_memoryBuffer); // allocated by open_memstream(), if any
 }
 
 void File::Flush()
@@ -284,6 +315,30 @@ void File::Flush()
     fflushOrDie(m_file);
 }
 
+// write the content of a File opened with fileOptionsMemory to 'target'
+void File::CopyMemoryTo(FILE* target)
+{
+    if (!(m_options & fileOptionsMemory))
+        LogicError("File: CopyMemoryTo() requires a File opened with fileOptionsMemory");
+    fflushOrDie(m_file);
+#ifdef _WIN32
+    const uint64_t size = GetPosition();
+    SetPosition(0);
+    vector<char> buffer(WRITE_BUFFER_SIZE);
+    for (uint64_t copied = 0; copied < size;)
+    {
+        size_t n = (size_t) min((uint64_t) buffer.size(), size - copied);
+        freadOrDie(buffer.data(), 1, n, m_file);
+        fwriteOrDie(buffer.data(), 1, n, target);
+        copied += n;
+    }
+    SetPosition(size);
+#else
+    // After fflush(), the buffer of open_memstream() holds everything written so far.
+    fwriteOrDie(m_memoryBuffer, 1, m_memorySize, target);
+#endif
+}
+
 // read a line
 // End of line is denoted by one of these, i.e. we don't support the old Mac OS convention of CR
 //  - LF
@@ -16,6 +16,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     std::atomic<bool> Globals::m_enableShareNodeValueMatrices(true);
     std::atomic<bool> Globals::m_optimizeGradientAccumulation(true);
+    std::atomic<bool> Globals::m_quantizedGemm(false);
+    std::atomic<bool> Globals::m_fastCpuConvolution(false);
 
     // Note: this is a map that transfers the old reader and writer names to
     //       the new naming scheme
@@ -362,4 +362,18 @@ void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval);
 extern "C" EVAL_API void GetEvalExtendedF(IEvaluateModelExtended<float>** peval);
 extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval);
 
+//
+// The extended interface, evaluated by a pool of workers, each of which has its own copy of the network
+// that shares the model parameters with the others. Unlike above, ForwardPass() can be called from several
+// threads at once; each call blocks until one of the workers has evaluated it.
+// Init() accepts the following additional settings:
+//   numEvalWorkers - number of workers; 0 (default) for one per numCPUThreads logical processors
+//   pinEvalWorkers - pin every worker (and its BLAS threads) to its own numCPUThreads logical processors (default false)
+// ForwardPass() with resetRNN = false requires a single worker, since consecutive calls may go to different workers.
+//
+template <typename ElemType>
+void EVAL_API GetEvalExtendedPool(IEvaluateModelExtended<ElemType>** peval);
+extern "C" EVAL_API void GetEvalExtendedPoolF(IEvaluateModelExtended<float>** peval);
+extern "C" EVAL_API void GetEvalExtendedPoolD(IEvaluateModelExtended<double>** peval);
+
 } } }
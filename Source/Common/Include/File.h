@@ -34,6 +34,7 @@ enum FileOptions
     fileOptionsRead = 8,                                        // open in read mode
     fileOptionsWrite = 16,                                      // open in write mode
     fileOptionsSequential = 32,                                 // optimize for sequential reads (allocates big buffer)
+    fileOptionsMemory = 64,                                     // write to memory instead of the file; see File::CopyMemoryTo()
     fileOptionsReadWrite = fileOptionsRead | fileOptionsWrite,  // read/write mode
 };
 
@@ -99,7 +100,10 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    char* m_memoryBuffer; // fileOptionsMemory: the buffer of open_memstream() (Linux only)
+    size_t m_memorySize;
     void Init(const wchar_t* filename, int fileOptions);
+    void OpenMemory();
 
 public:
     File(const std::wstring& filename, int fileOptions);
@@ -109,6 +113,9 @@ public:
 
     void Flush();
 
+    // write everything written so far to a File opened with fileOptionsMemory to 'target'
+    void CopyMemoryTo(FILE* target);
+
     bool CanSeek() const { return m_seekable; }
     size_t Size();
     uint64_t GetPosition();
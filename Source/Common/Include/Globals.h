@@ -28,11 +28,22 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static void SetShareNodeValueMatrices(bool enable) { m_enableShareNodeValueMatrices = enable; }
         static bool ShouldEnableShareNodeValueMatrices() { return m_enableShareNodeValueMatrices; }
 
+        // Compute the products of Times nodes with constant weights on the CPU in 16-bit integers (see TimesNode)
+        static void SetQuantizedGemm(bool enable) { m_quantizedGemm = enable; }
+        static bool ShouldUseQuantizedGemm() { return m_quantizedGemm; }
+
+        // Let the CPU convolution nodes choose between the GEMM, direct and Winograd algorithms by timing them
+        // (see ConvolutionEngineKind); ignored when deterministic algorithms are forced
+        static void SetFastCpuConvolution(bool enable) { m_fastCpuConvolution = enable; }
+        static bool ShouldUseFastCpuConvolution() { return m_fastCpuConvolution; }
+
     private:
         static std::atomic<bool> m_forceDeterministicAlgorithms;
         // The global flag to enable matrices values in forward and backward prop
         static std::atomic<bool> m_enableShareNodeValueMatrices;
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
+        static std::atomic<bool> m_quantizedGemm;
+        static std::atomic<bool> m_fastCpuConvolution;
     };
 }}}
@@ -0,0 +1,149 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <memory>
+#include <string>
+#ifdef __WINDOWS__
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "windows.h"
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Mapping of a whole file into the address space.
+// Pages are loaded on first access and evicted by the OS as needed, so the file can be much larger than
+// the physical memory, and they are shared with all other processes that map the same file.
+// Used by the CNTKBinaryReader, whose chunks point directly into the mapping (they keep a shared_ptr to it),
+// and by the V2 library for memory-mappable model files, whose NDArrayViews do the same.
+//
+// A copy-on-write mapping can be written to through WritableData(); modified pages become private to the
+// process and the file is never changed.
+class MemoryMappedFile
+{
+public:
+    explicit MemoryMappedFile(const std::wstring& filename, bool copyOnWrite = false)
+        : m_filename(filename), m_data(nullptr), m_size(0), m_copyOnWrite(copyOnWrite)
+    {
+        // The view (mapping) keeps the file open, so the handles (descriptor) are closed right away,
+        // whether or not mapping succeeded.
+#ifdef __WINDOWS__
+        HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            RuntimeError("Error opening file '%ls' for memory mapping: error %u.", filename.c_str(), (unsigned int)GetLastError());
+        LARGE_INTEGER size;
+        HANDLE mapping = NULL;
+        if (GetFileSizeEx(file, &size))
+        {
+            m_size = (size_t)size.QuadPart;
+            mapping = CreateFileMappingW(file, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+        }
+        if (mapping != NULL)
+            m_data = (char*)MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+        auto error = GetLastError();
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        if (m_data == nullptr)
+            RuntimeError("Error memory mapping file '%ls': error %u.", filename.c_str(), (unsigned int)error);
+#else
+        std::string name = msra::strfun::utf8(filename);
+        int file = open(name.c_str(), O_RDONLY);
+        if (file < 0)
+            RuntimeError("Error opening file '%ls' for memory mapping: %s.", filename.c_str(), strerror(errno));
+        struct stat info;
+        int error = 0;
+        if (fstat(file, &info) == 0)
+        {
+            m_size = (size_t)info.st_size;
+            void* data = copyOnWrite ? mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0)
+                                     : mmap(nullptr, m_size, PROT_READ, MAP_SHARED, file, 0);
+            if (data != MAP_FAILED)
+                m_data = (char*)data;
+        }
+        if (m_data == nullptr)
+            error = errno;
+        close(file);
+        if (m_data == nullptr)
+            RuntimeError("Error memory mapping file '%ls': %s.", filename.c_str(), strerror(error));
+        m_pageSize = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    ~MemoryMappedFile()
+    {
+#ifdef __WINDOWS__
+        UnmapViewOfFile(m_data);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+
+    size_t Size() const { return m_size; }
+
+    // Returns a pointer to the whole file.
+    const char* Data() const { return m_data; }
+
+    // Returns a pointer to the bytes [offset, offset + size) of the file, or fails if they are beyond its end.
+    const char* Data(int64_t offset, size_t size) const
+    {
+        if (offset < 0 || (uint64_t)offset > m_size || size > m_size - (size_t)offset)
+            RuntimeError("Range [%" PRId64 ", %" PRIu64 ") is outside of the file '%ls' of %" PRIu64 " bytes.",
+                offset, (uint64_t)offset + size, m_filename.c_str(), (uint64_t)m_size);
+        return m_data + offset;
+    }
+
+    // Returns a writable pointer to the whole file; only for copy-on-write mappings.
+    char* WritableData() const
+    {
+        if (!m_copyOnWrite)
+            LogicError("The file '%ls' is mapped read-only.", m_filename.c_str());
+        return m_data;
+    }
+
+    // Hints the OS that the given range will be read soon, so it can start reading it in the background.
+    // This is only a hint; errors are ignored.
+    void WillNeed(int64_t offset, size_t size) const
+    {
+#ifdef __WINDOWS__
+        // PrefetchVirtualMemory() is not available on all Windows versions we support; rely on the OS read-ahead.
+        UNUSED(offset);
+        UNUSED(size);
+#else
+        // madvise() needs a page-aligned start address
+        size_t begin = (size_t)offset / m_pageSize * m_pageSize;
+        size_t end = min((size_t)offset + size, m_size);
+        if (begin < end)
+            madvise((void*)(m_data + begin), end - begin, MADV_WILLNEED);
+#endif
+    }
+
+private:
+    std::wstring m_filename;
+    char* m_data;
+    size_t m_size;
+    bool m_copyOnWrite;
+#ifndef __WINDOWS__
+    size_t m_pageSize;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+};
+
+typedef std::shared_ptr<MemoryMappedFile> MemoryMappedFilePtr;
+
+}}}
@@ -604,6 +604,10 @@ private:
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
     mutable Matrix<char> m_columnsValidityMask;
 
+    // Serializes the lazy creation of m_columnsValidityMask, since nodes that share this layout may be
+    // evaluated concurrently (cf. InterOpScheduler).
+    mutable std::mutex m_columnsValidityMaskMutex;
+
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
     // Meant to guard in lazy creation of m_columnsValidityMask.
@@ -905,6 +909,7 @@ inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
 {
     CheckIsValid();
     // lazily compute the validity mask
+    std::lock_guard<std::mutex> lock(m_columnsValidityMaskMutex);
     if (m_columnsValidityMask.IsEmpty())
     {
         assert(HasGaps()); // must only be called if there are gaps
@@ -258,8 +258,18 @@ public:
 //       empty stubs.
 // -----------------------------------------------------------------------
 
+// Defined in MPIWrapperShm.cpp. The shared-memory implementation is selected by setting CNTK_SHM_NUM_PROCESSES.
+int GetMPIWrapperShmNumProcesses();
+MPIWrapper* CreateMPIWrapperShm();
+
 extern "C" void GetMpiWrapper(MPIWrapper **mpi)
 {
+    if (GetMPIWrapperShmNumProcesses() > 0)
+    {
+        *mpi = CreateMPIWrapperShm();
+        return;
+    }
+
 #if HAS_MPI
     *mpi = new MPIWrapperMpi();
 #else
@@ -371,6 +381,10 @@ MPI_Datatype MPIWrapper::GetDataType(size_t *)
 //       and forward the call to the implementation instead of handling it globally here.
 int MPIWrapper::GetTotalNumberOfMPINodes()
 {
+    int numShmProcesses = GetMPIWrapperShmNumProcesses();
+    if (numShmProcesses > 0)
+        return numShmProcesses;
+
 #if !HAS_MPI
     return 0;
 #else
@@ -0,0 +1,878 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+// MPIWrapperShm.cpp -- MPIWrapper for several processes on a single host, on top of POSIX shared memory.
+//
+// The processes are started by the user (one per NUMA node, say) with the same environment, except for the rank:
+//
+//     CNTK_SHM_NUM_PROCESSES  number of processes (required, selects this implementation)
+//     CNTK_SHM_RANK           rank of this process, 0..CNTK_SHM_NUM_PROCESSES-1 (required)
+//     CNTK_SHM_NAME           name of the shared memory segment (required, must be unique among the jobs that
+//                             run at the same time, e.g. derived from the job id of the scheduler)
+//     CNTK_SHM_BUFFER_MB      size of the collective buffer of each process, in MB (optional, default 64)
+//     CNTK_SHM_TIMEOUT_SEC    how long to wait for all processes to start, in seconds (optional, default 300)
+//
+// Collectives go through one buffer per process. An AllReduce is a reduce-scatter followed by an all-gather:
+// every process copies its data into its buffer, reduces one slice of the data across all buffers, and then
+// collects the reduced slices of the others. Every slice is reduced by one process only, so all processes
+// end up with bit-identical results. Each buffer has two halves that are used alternately, which saves the
+// barrier that would otherwise be needed before a buffer can be overwritten. Larger data goes in chunks.
+//
+// Point-to-point messages go through one mailbox for every ordered pair of processes, and are progressed
+// whenever a process waits for one of its requests.
+//
+// Every process records its process id in the segment. A process that waits for the others checks whether they
+// are still running, so that the job fails instead of hanging when one of them crashes. The ids also tell a
+// segment that was left behind by a crashed job, which rank 0 replaces and the other ranks do not attach to,
+// from one that is in use by another job with the same name.
+//
+// Notes:
+//  - Collectives are blocking. The asynchronous variants complete before they return, and the request they
+//    return is already complete.
+//  - Only MPI_SUM is supported as reduction operation, and messages are matched in order, not by tag.
+//  - Calls must be serialized, like with MPI_THREAD_SERIALIZED.
+//
+
+#include "Include/Basics.h"
+#include "Include/MPIWrapper.h"
+
+#ifndef _WIN32
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if !HAS_MPI
+#define MPI_SUCCESS             0
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Returns the number of processes if the shared-memory implementation was requested through the
+// environment, and 0 otherwise.
+int GetMPIWrapperShmNumProcesses()
+{
+    const char* p = std::getenv("CNTK_SHM_NUM_PROCESSES");
+    return p ? std::stoi(std::string(p)) : 0;
+}
+
+#ifdef _WIN32
+
+MPIWrapper* CreateMPIWrapperShm()
+{
+    RuntimeError("MPIWrapperShm: Shared-memory communication (CNTK_SHM_NUM_PROCESSES) is not supported on Windows.");
+}
+
+#else
+
+static const uint32_t ShmReadyMagic = 0x43534d31; // set by rank 0 once the segment is initialized
+static const size_t ShmAlignment = 64;
+static const size_t ShmMailboxBytes = 1024 * 1024;
+static const int ShmSpinCount = 4000;
+static const std::chrono::milliseconds ShmPeerCheckInterval(100);
+
+static size_t AlignUp(size_t n)
+{
+    return (n + ShmAlignment - 1) / ShmAlignment * ShmAlignment;
+}
+
+static void FutexWait(std::atomic<uint32_t>* address, uint32_t value)
+{
+    // The timeout lets the caller check whether another process has aborted.
+    struct timespec timeout = { 0, 100 * 1000 * 1000 };
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+
+static void FutexWakeAll(std::atomic<uint32_t>* address)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Returns false if the process has exited, including if it is a zombie that its parent has not reaped yet.
+static bool IsProcessRunning(pid_t pid)
+{
+    if (kill(pid, 0) != 0 && errno == ESRCH)
+        return false;
+    // /proc/<pid>/stat is "<pid> (<command>) <state> ...", where the command may contain spaces and parentheses.
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(stat, line))
+        return true; // no procfs, so rely on kill()
+    size_t end = line.rfind(')');
+    char state = (end != std::string::npos && end + 2 < line.size()) ? line[end + 2] : 'R';
+    return state != 'Z' && state != 'X';
+}
+
+static size_t DataTypeSize(MPI_Datatype datatype)
+{
+    if (datatype == MPI_CHAR)
+        return 1;
+    if (datatype == MPI_INT || datatype == MPI_UNSIGNED || datatype == MPI_FLOAT)
+        return 4;
+    if (datatype == MPI_DOUBLE || datatype == MPI_LONG_LONG_INT)
+        return 8;
+    LogicError("MPIWrapperShm: Unsupported MPI_Datatype.");
+}
+
+// Requests are numbers that are stored in the MPI_Request, which is an int or a pointer depending on the
+// MPI implementation. 0 denotes a completed (null) request.
+static void SetRequestId(MPI_Request* request, int id)
+{
+    static_assert(sizeof(MPI_Request) >= sizeof(int), "MPI_Request is too small to hold a request id");
+    memset(request, 0, sizeof(MPI_Request));
+    memcpy(request, &id, sizeof(id));
+}
+
+static int GetRequestId(const MPI_Request* request)
+{
+    int id;
+    memcpy(&id, request, sizeof(id));
+    return id;
+}
+
+// Layout of the shared memory segment:
+//     ShmControl
+//     int32_t pids[numProcesses]                       -- process ids, 0 until the process has attached
+//     uint64_t counts[2][numProcesses]                 -- number of bytes contributed to the current gather
+//     char buffers[numProcesses][bufferBytes]          -- collective buffers, two halves each
+//     ShmMailbox mailboxes[numProcesses][numProcesses] -- mailboxes[src][dst], followed by the data
+struct ShmControl
+{
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> attached;
+    std::atomic<uint32_t> aborted;
+    std::atomic<uint32_t> barrierCount;
+    std::atomic<uint32_t> barrierGeneration;
+    uint32_t numProcesses;
+    uint64_t bufferBytes;
+};
+
+struct ShmMailbox
+{
+    std::atomic<uint32_t> full;
+    int32_t tag;
+    uint64_t messageBytes;
+    uint64_t chunkBytes;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "MPIWrapperShm requires lock-free atomics in shared memory");
+
+static size_t PidsOffset()
+{
+    return AlignUp(sizeof(ShmControl));
+}
+
+// Returns whether any process that is recorded in the existing segment of the given name is still running.
+static bool IsSegmentInUse(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    bool inUse = false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= PidsOffset())
+    {
+        void* segment = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (segment != MAP_FAILED)
+        {
+            const ShmControl* control = static_cast<const ShmControl*>(segment);
+            const std::atomic<int32_t>* pids = reinterpret_cast<const std::atomic<int32_t>*>(static_cast<char*>(segment) + PidsOffset());
+            size_t numProcesses = std::min((size_t)control->numProcesses, ((size_t)st.st_size - PidsOffset()) / sizeof(int32_t));
+            for (size_t rank = 0; rank < numProcesses && !inUse; rank++)
+            {
+                int32_t pid = pids[rank].load();
+                inUse = pid != 0 && IsProcessRunning(pid);
+            }
+            munmap(segment, st.st_size);
+        }
+    }
+    close(fd);
+    return inUse;
+}
+
+class MPIWrapperShm : public MPIWrapper
+{
+    struct PendingMessage
+    {
+        bool m_isSend;
+        int m_peer;
+        int m_tag;
+        char* m_data;
+        size_t m_capacity;      // size of the buffer
+        size_t m_messageBytes;  // size of the message, known for receives once the first chunk arrived
+        size_t m_doneBytes;
+        bool m_complete;
+    };
+
+    int m_rank;
+    int m_numProcesses;
+    std::string m_name;
+    size_t m_bufferBytes;
+    size_t m_segmentBytes;
+    char* m_segment;
+
+    ShmControl* m_control;
+    std::atomic<int32_t>* m_pids;
+    uint64_t* m_counts;
+    char* m_buffers;
+    char* m_mailboxes;
+
+    // which half of the collective buffers the next collective uses
+    mutable size_t m_bufferHalf;
+
+    // outstanding point-to-point messages, by request id, and queued per peer in posting order
+    mutable std::map<int, PendingMessage> m_messages;
+    mutable std::vector<std::deque<int>> m_sendQueues;
+    mutable std::vector<std::deque<int>> m_recvQueues;
+    mutable int m_nextRequestId;
+
+    // the time until which all processes must have attached, and when the other processes were last checked
+    std::chrono::steady_clock::time_point m_startupDeadline;
+    mutable std::chrono::steady_clock::time_point m_lastPeerCheck;
+
+public:
+    MPIWrapperShm();
+    ~MPIWrapperShm();
+
+    size_t NumNodesInUse() const override { return m_numProcesses; }
+    size_t CurrentNodeRank() const override { return m_rank; }
+    bool IsMainNode() const override { return m_rank == 0; }
+    std::wstring CurrentNodeName() const override;
+    bool IsIdle() const override { return false; }
+    bool UsingAllNodes() const override { return true; }
+    size_t MainNodeRank() const override { return 0; }
+    bool IsMultiHost() const override { return false; }
+    bool UseGpuGdr() override { return false; }
+
+    // -----------------------------------------------------------------------
+    // data-exchange functions (wrappers around MPI functions)
+    // -----------------------------------------------------------------------
+
+    int Finalize(void) override;
+    int Wait(MPI_Request* request, MPI_Status* status) override;
+    int Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* status) override;
+    int Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]) override;
+    int Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, /*MPI_Comm comm,*/ MPI_Request* request) override;
+    int Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Status* status) override;
+    int Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Request* request) override;
+    int Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, /*MPI_Comm comm,*/ MPI_Request* request) override;
+    int Abort(int errorcode) override;
+    int Error_string(int errorcode, char* string, int* resultlen) override;
+
+    // allreduce of a vector
+    void AllReduce(std::vector<size_t>& accumulator) const override { AllReduceSum(accumulator.data(), accumulator.data(), accumulator.size()); }
+    void AllReduce(std::vector<int>& accumulator) const override    { AllReduceSum(accumulator.data(), accumulator.data(), accumulator.size()); }
+    void AllReduce(std::vector<double>& accumulator) const override { AllReduceSum(accumulator.data(), accumulator.data(), accumulator.size()); }
+    void AllReduce(std::vector<float>& accumulator) const override  { AllReduceSum(accumulator.data(), accumulator.data(), accumulator.size()); }
+
+    // for raw pointer
+    void AllReduce(size_t* sendData, size_t numElements, MPI_Op op = MPI_SUM) const override { AllReduce(sendData, sendData, numElements, op); }
+    void AllReduce(int* sendData, size_t numElements, MPI_Op op = MPI_SUM) const override    { AllReduce(sendData, sendData, numElements, op); }
+    void AllReduce(double* sendData, size_t numElements, MPI_Op op = MPI_SUM) const override { AllReduce(sendData, sendData, numElements, op); }
+    void AllReduce(float* sendData, size_t numElements, MPI_Op op = MPI_SUM) const override  { AllReduce(sendData, sendData, numElements, op); }
+
+    void AllReduce(size_t* sendData, size_t* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const override { AllReduceImpl(sendData, receiveData, numElements, op); }
+    void AllReduce(int* sendData, int* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const override       { AllReduceImpl(sendData, receiveData, numElements, op); }
+    void AllReduce(double* sendData, double* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const override { AllReduceImpl(sendData, receiveData, numElements, op); }
+    void AllReduce(float* sendData, float* receiveData, size_t numElements, MPI_Op op = MPI_SUM) const override   { AllReduceImpl(sendData, receiveData, numElements, op); }
+
+    void AllReduceAsync(size_t* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override { AllReduceAsync(sendData, sendData, numElements, request, op); }
+    void AllReduceAsync(int* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override    { AllReduceAsync(sendData, sendData, numElements, request, op); }
+    void AllReduceAsync(double* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override { AllReduceAsync(sendData, sendData, numElements, request, op); }
+    void AllReduceAsync(float* sendData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override  { AllReduceAsync(sendData, sendData, numElements, request, op); }
+
+    void AllReduceAsync(size_t* sendData, size_t* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override { AllReduceImpl(sendData, receiveData, numElements, op); SetRequestId(request, 0); }
+    void AllReduceAsync(int* sendData, int* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override       { AllReduceImpl(sendData, receiveData, numElements, op); SetRequestId(request, 0); }
+    void AllReduceAsync(double* sendData, double* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override { AllReduceImpl(sendData, receiveData, numElements, op); SetRequestId(request, 0); }
+    void AllReduceAsync(float* sendData, float* receiveData, size_t numElements, MPI_Request* request, MPI_Op op = MPI_SUM) const override   { AllReduceImpl(sendData, receiveData, numElements, op); SetRequestId(request, 0); }
+
+    void Bcast(size_t* sendData, size_t numElements, size_t srcRank) override { BcastBytes(sendData, numElements * sizeof(*sendData), srcRank); }
+    void Bcast(double* sendData, size_t numElements, size_t srcRank) override { BcastBytes(sendData, numElements * sizeof(*sendData), srcRank); }
+    void Bcast(float* sendData, size_t numElements, size_t srcRank) override  { BcastBytes(sendData, numElements * sizeof(*sendData), srcRank); }
+    void Bcast(void* buffer, int count, MPI_Datatype datatype, int root) override { BcastBytes(buffer, count * DataTypeSize(datatype), root); }
+
+    void AllGatherAsync(const size_t* sendData, size_t numSendElements, size_t* receiveData, size_t numRecvElements, MPI_Request* request) const override { AllGather(sendData, numSendElements, receiveData, numRecvElements); SetRequestId(request, 0); }
+    void AllGatherAsync(const int* sendData, size_t numSendElements, int* receiveData, size_t numRecvElements, MPI_Request* request) const override       { AllGather(sendData, numSendElements, receiveData, numRecvElements); SetRequestId(request, 0); }
+    void AllGatherAsync(const float* sendData, size_t numSendElements, float* receiveData, size_t numRecvElements, MPI_Request* request) const override   { AllGather(sendData, numSendElements, receiveData, numRecvElements); SetRequestId(request, 0); }
+    void AllGatherAsync(const double* sendData, size_t numSendElements, double* receiveData, size_t numRecvElements, MPI_Request* request) const override { AllGather(sendData, numSendElements, receiveData, numRecvElements); SetRequestId(request, 0); }
+    void Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const override;
+
+    void AllGather(const size_t* sendData, size_t numSendElements, size_t* receiveData, size_t numRecvElements) const override { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, -1); }
+    void AllGather(const int* sendData, size_t numSendElements, int* receiveData, size_t numRecvElements) const override       { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, -1); }
+    void AllGather(const float* sendData, size_t numSendElements, float* receiveData, size_t numRecvElements) const override   { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, -1); }
+    void AllGather(const double* sendData, size_t numSendElements, double* receiveData, size_t numRecvElements) const override { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, -1); }
+
+    void Gather(const size_t* sendData, size_t numSendElements, size_t* receiveData, size_t numRecvElements, size_t rootRank) const override { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, (int)rootRank); }
+    void Gather(const int* sendData, size_t numSendElements, int* receiveData, size_t numRecvElements, size_t rootRank) const override       { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, (int)rootRank); }
+    void Gather(const float* sendData, size_t numSendElements, float* receiveData, size_t numRecvElements, size_t rootRank) const override   { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, (int)rootRank); }
+    void Gather(const double* sendData, size_t numSendElements, double* receiveData, size_t numRecvElements, size_t rootRank) const override { GatherImpl(sendData, numSendElements, receiveData, numRecvElements, nullptr, nullptr, (int)rootRank); }
+
+    void Gatherv(const size_t* sendData, size_t numSendElements, size_t* receiveData, int recvCounts[], int offsets[], size_t rootRank) const override { GatherImpl(sendData, numSendElements, receiveData, 0, recvCounts, offsets, (int)rootRank); }
+    void Gatherv(const char* sendData, size_t numSendElements, char* receiveData, int recvCounts[], int offsets[], size_t rootRank) const override       { GatherImpl(sendData, numSendElements, receiveData, 0, recvCounts, offsets, (int)rootRank); }
+    void Gatherv(const int* sendData, size_t numSendElements, int* receiveData, int recvCounts[], int offsets[], size_t rootRank) const override         { GatherImpl(sendData, numSendElements, receiveData, 0, recvCounts, offsets, (int)rootRank); }
+    void Gatherv(const float* sendData, size_t numSendElements, float* receiveData, int recvCounts[], int offsets[], size_t rootRank) const override     { GatherImpl(sendData, numSendElements, receiveData, 0, recvCounts, offsets, (int)rootRank); }
+    void Gatherv(const double* sendData, size_t numSendElements, double* receiveData, int recvCounts[], int offsets[], size_t rootRank) const override   { GatherImpl(sendData, numSendElements, receiveData, 0, recvCounts, offsets, (int)rootRank); }
+
+    // wait for all ranks to reach here
+    int WaitAll() override;
+    void WaitAny(MPI_Request* requests, int numRequests, int* index) override { Waitany(numRequests, requests, index, MPI_STATUS_IGNORE) || MpiFail("WaitAny: MPI_Waitany"); }
+    void Wait(MPI_Request* request) override { Wait(request, MPI_STATUS_IGNORE) || MpiFail("Wait: MPI_Wait"); }
+    int WaitAll(std::vector<MPI_Request>& requests) override { return Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE); }
+
+private:
+    char* Buffer(int rank, size_t half) const { return m_buffers + rank * m_bufferBytes + half * (m_bufferBytes / 2); }
+    ShmMailbox* Mailbox(int source, int dest) const { return reinterpret_cast<ShmMailbox*>(m_mailboxes + (source * m_numProcesses + dest) * AlignUp(sizeof(ShmMailbox) + ShmMailboxBytes)); }
+    static char* MailboxData(ShmMailbox* mailbox) { return reinterpret_cast<char*>(mailbox) + AlignUp(sizeof(ShmMailbox)); }
+    size_t NextBufferHalf() const { size_t half = m_bufferHalf; m_bufferHalf ^= 1; return half; }
+
+    void CheckPeers() const;
+    void Barrier(bool startup = false) const;
+    void CheckStartupDeadline(const char* what) const;
+
+    template <class ElemType>
+    void AllReduceImpl(const ElemType* sendData, ElemType* receiveData, size_t numElements, MPI_Op op) const;
+    template <class ElemType>
+    void AllReduceSum(const ElemType* sendData, ElemType* receiveData, size_t numElements) const;
+    void BcastBytes(void* data, size_t numBytes, size_t srcRank) const;
+    template <class ElemType>
+    void GatherImpl(const ElemType* sendData, size_t numSendElements, ElemType* receiveData, size_t numRecvElements, const int recvCounts[], const int offsets[], int rootRank) const;
+    void GatherBytes(const char* sendData, size_t sendBytes, char* receiveData, const std::vector<size_t>& receiveOffsets, bool receive) const;
+
+    int PostMessage(bool isSend, void* buf, int count, MPI_Datatype datatype, int peer, int tag, MPI_Request* request);
+    bool Progress();
+};
+
+MPIWrapperShm::MPIWrapperShm()
+    : m_segment(nullptr), m_bufferHalf(0), m_nextRequestId(1)
+{
+    static bool initialized = false;
+    if (initialized)
+    {
+        LogicError("MPIWrapperShm: this is a singleton class that can only be instantiated once per process");
+    }
+
+    initialized = true;
+
+    m_numProcesses = GetMPIWrapperShmNumProcesses();
+    const char* rank = std::getenv("CNTK_SHM_RANK");
+    if (!rank)
+        InvalidArgument("MPIWrapperShm: CNTK_SHM_RANK must be set along with CNTK_SHM_NUM_PROCESSES.");
+    m_rank = std::stoi(std::string(rank));
+    if (m_numProcesses < 1 || m_rank < 0 || m_rank >= m_numProcesses)
+        InvalidArgument("MPIWrapperShm: Invalid rank %d for %d processes.", m_rank, m_numProcesses);
+
+    // A name derived from something like the id of the parent process would be shared by all jobs that the same
+    // shell starts, so the name must be given.
+    const char* name = std::getenv("CNTK_SHM_NAME");
+    if (!name || !*name)
+        InvalidArgument("MPIWrapperShm: CNTK_SHM_NAME must be set along with CNTK_SHM_NUM_PROCESSES, to a name that is unique to the job.");
+    m_name = name;
+    if (m_name[0] != '/')
+        m_name = "/" + m_name;
+
+    const char* bufferMB = std::getenv("CNTK_SHM_BUFFER_MB");
+    m_bufferBytes = AlignUp((bufferMB ? std::stoul(std::string(bufferMB)) : 64) * 1024 * 1024);
+    if (m_bufferBytes == 0)
+        InvalidArgument("MPIWrapperShm: CNTK_SHM_BUFFER_MB must be positive.");
+
+    const char* timeoutSec = std::getenv("CNTK_SHM_TIMEOUT_SEC");
+    m_startupDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSec ? std::stoi(std::string(timeoutSec)) : 300);
+
+    size_t countsOffset = PidsOffset() + AlignUp(m_numProcesses * sizeof(int32_t));
+    size_t buffersOffset = countsOffset + AlignUp(2 * m_numProcesses * sizeof(uint64_t));
+    size_t mailboxesOffset = buffersOffset + m_numProcesses * m_bufferBytes;
+    m_segmentBytes = mailboxesOffset + m_numProcesses * m_numProcesses * AlignUp(sizeof(ShmMailbox) + ShmMailboxBytes);
+
+    fprintf(stderr, "MPIWrapperShm: initializing rank %d of %d, shared memory segment %s (%d MB)\n", m_rank, m_numProcesses, m_name.c_str(), (int)(m_segmentBytes >> 20));
+    fflush(stderr);
+
+    // Rank 0 creates and initializes the segment, the others wait for it to appear.
+    if (m_rank == 0)
+    {
+        int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 && errno == EEXIST)
+        {
+            if (IsSegmentInUse(m_name))
+                RuntimeError("MPIWrapperShm: Shared memory segment %s is in use by another job; CNTK_SHM_NAME must be unique per job.", m_name.c_str());
+            shm_unlink(m_name.c_str()); // left over from a crashed job
+            fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        }
+        if (fd < 0 || ftruncate(fd, m_segmentBytes) != 0)
+            RuntimeError("MPIWrapperShm: Failed to create shared memory segment %s: %s", m_name.c_str(), strerror(errno));
+
+        void* segment = mmap(nullptr, m_segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (segment == MAP_FAILED)
+            RuntimeError("MPIWrapperShm: Failed to map shared memory segment %s: %s", m_name.c_str(), strerror(errno));
+        m_segment = static_cast<char*>(segment);
+        m_control = reinterpret_cast<ShmControl*>(m_segment);
+        m_pids = reinterpret_cast<std::atomic<int32_t>*>(m_segment + PidsOffset());
+
+        // ftruncate() zeroed the segment, which leaves all counters and mailboxes empty.
+        m_control->numProcesses = m_numProcesses;
+        m_control->bufferBytes = m_bufferBytes;
+        m_pids[0].store(getpid());
+        m_control->ready.store(ShmReadyMagic, std::memory_order_release);
+    }
+    else
+    {
+        // A segment whose rank 0 is no longer running was left behind by a crashed job; rank 0 will replace it.
+        for (;;)
+        {
+            int fd = shm_open(m_name.c_str(), O_RDWR, 0600);
+            struct stat st;
+            if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size == m_segmentBytes)
+            {
+                void* segment = mmap(nullptr, m_segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (segment == MAP_FAILED)
+                    RuntimeError("MPIWrapperShm: Failed to map shared memory segment %s: %s", m_name.c_str(), strerror(errno));
+                m_control = static_cast<ShmControl*>(segment);
+                m_pids = reinterpret_cast<std::atomic<int32_t>*>(static_cast<char*>(segment) + PidsOffset());
+                if (m_control->ready.load(std::memory_order_acquire) == ShmReadyMagic && IsProcessRunning(m_pids[0].load()))
+                {
+                    m_segment = static_cast<char*>(segment);
+                    close(fd);
+                    break;
+                }
+                munmap(segment, m_segmentBytes);
+            }
+            if (fd >= 0)
+                close(fd);
+            CheckStartupDeadline("rank 0 to create the shared memory segment");
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (m_control->numProcesses != (uint32_t)m_numProcesses || m_control->bufferBytes != m_bufferBytes)
+            RuntimeError("MPIWrapperShm: Shared memory segment %s was set up for a different configuration.", m_name.c_str());
+        m_pids[m_rank].store(getpid());
+    }
+
+    m_counts = reinterpret_cast<uint64_t*>(m_segment + countsOffset);
+    m_buffers = m_segment + buffersOffset;
+    m_mailboxes = m_segment + mailboxesOffset;
+
+    // The last process to attach removes the name, so that nothing is left behind once the job ends.
+    if (m_control->attached.fetch_add(1) + 1 == (uint32_t)m_numProcesses)
+        shm_unlink(m_name.c_str());
+
+    m_sendQueues.resize(m_numProcesses);
+    m_recvQueues.resize(m_numProcesses);
+
+    try
+    {
+        Barrier(/*startup=*/true);
+    }
+    catch (const std::exception&)
+    {
+        // Not all processes have attached, so the name is still there.
+        shm_unlink(m_name.c_str());
+        munmap(m_segment, m_segmentBytes);
+        m_segment = nullptr;
+        throw;
+    }
+}
+
+MPIWrapperShm::~MPIWrapperShm()
+{
+    fprintf(stderr, "~MPIWrapperShm\n");
+    if (m_segment)
+        munmap(m_segment, m_segmentBytes);
+}
+
+std::wstring MPIWrapperShm::CurrentNodeName() const
+{
+    char name[256] = { 0 };
+    if (gethostname(name, sizeof(name) - 1) != 0)
+        return L"localhost";
+    return std::wstring(name, name + strlen(name));
+}
+
+// Fails if another process has aborted or exited. This is called while waiting for the other processes.
+void MPIWrapperShm::CheckPeers() const
+{
+    if (m_control->aborted.load(std::memory_order_relaxed))
+        RuntimeError("MPIWrapperShm: Another process has aborted.");
+
+    // This takes a system call per process, so it is not done on every call.
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPeerCheck < ShmPeerCheckInterval)
+        return;
+    m_lastPeerCheck = now;
+    for (int rank = 0; rank < m_numProcesses; rank++)
+    {
+        int32_t pid = m_pids[rank].load();
+        if (rank != m_rank && pid != 0 && !IsProcessRunning(pid))
+        {
+            // Let the others fail right away, too.
+            m_control->aborted.store(1);
+            FutexWakeAll(&m_control->barrierGeneration);
+            RuntimeError("MPIWrapperShm: Rank %d (process %d) has exited.", rank, (int)pid);
+        }
+    }
+}
+
+void MPIWrapperShm::CheckStartupDeadline(const char* what) const
+{
+    if (std::chrono::steady_clock::now() > m_startupDeadline)
+        RuntimeError("MPIWrapperShm: Timed out waiting for %s (shared memory segment %s, see CNTK_SHM_TIMEOUT_SEC).", what, m_name.c_str());
+}
+
+// Sense-reversing barrier: the last process to arrive bumps the generation that the others wait on.
+// The startup barrier waits for processes that have not attached yet, and may time out.
+void MPIWrapperShm::Barrier(bool startup) const
+{
+    uint32_t generation = m_control->barrierGeneration.load(std::memory_order_acquire);
+    if (m_control->barrierCount.fetch_add(1, std::memory_order_acq_rel) + 1 == (uint32_t)m_numProcesses)
+    {
+        m_control->barrierCount.store(0, std::memory_order_relaxed);
+        m_control->barrierGeneration.fetch_add(1, std::memory_order_release);
+        FutexWakeAll(&m_control->barrierGeneration);
+        return;
+    }
+
+    for (int spin = 0; m_control->barrierGeneration.load(std::memory_order_acquire) == generation; spin++)
+    {
+        if (spin < ShmSpinCount)
+            continue;
+        CheckPeers();
+        if (startup)
+            CheckStartupDeadline("all processes to start");
+        FutexWait(&m_control->barrierGeneration, generation);
+    }
+}
+
+int MPIWrapperShm::WaitAll()
+{
+    Barrier();
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Finalize(void)
+{
+    while (Progress()) // flush outstanding sends
+        CheckPeers();
+    Barrier();
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Abort(int errorcode)
+{
+    m_control->aborted.store(1);
+    FutexWakeAll(&m_control->barrierGeneration);
+    _exit(errorcode);
+}
+
+int MPIWrapperShm::Error_string(int errorcode, char* str, int* resultlen)
+{
+    if (!str || !resultlen)
+    {
+        return MPI_UNDEFINED;
+    }
+
+    *resultlen = sprintf(str, "Error-%d", errorcode);
+    return MPI_SUCCESS;
+}
+
+// -----------------------------------------------------------------------
+// collectives
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void MPIWrapperShm::AllReduceImpl(const ElemType* sendData, ElemType* receiveData, size_t numElements, MPI_Op op) const
+{
+    if (op != MPI_SUM)
+        LogicError("MPIWrapperShm: Only MPI_SUM is supported for AllReduce.");
+    if ((const void*)sendData == MPI_IN_PLACE)
+        sendData = receiveData;
+    AllReduceSum(sendData, receiveData, numElements);
+}
+
+template <class ElemType>
+void MPIWrapperShm::AllReduceSum(const ElemType* sendData, ElemType* receiveData, size_t numElements) const
+{
+    const size_t chunkElements = m_bufferBytes / 2 / sizeof(ElemType);
+    for (size_t chunkBegin = 0; chunkBegin < numElements; chunkBegin += chunkElements)
+    {
+        size_t chunkSize = std::min(chunkElements, numElements - chunkBegin);
+        size_t half = NextBufferHalf();
+        ElemType* myBuffer = reinterpret_cast<ElemType*>(Buffer(m_rank, half));
+        memcpy(myBuffer, sendData + chunkBegin, chunkSize * sizeof(ElemType));
+        Barrier();
+
+        // reduce-scatter: this process sums up its slice of the chunk from all buffers into its own buffer
+        auto sliceBegin = [&](int rank) { return chunkSize * rank / m_numProcesses; };
+        size_t begin = sliceBegin(m_rank);
+        size_t end = sliceBegin(m_rank + 1);
+        for (int rank = 0; rank < m_numProcesses; rank++)
+        {
+            if (rank == m_rank)
+                continue;
+            const ElemType* other = reinterpret_cast<const ElemType*>(Buffer(rank, half));
+            for (size_t i = begin; i < end; i++)
+                myBuffer[i] += other[i];
+        }
+        Barrier();
+
+        // all-gather: collect the reduced slices of all processes
+        for (int rank = 0; rank < m_numProcesses; rank++)
+        {
+            const ElemType* other = reinterpret_cast<const ElemType*>(Buffer(rank, half));
+            memcpy(receiveData + chunkBegin + sliceBegin(rank), other + sliceBegin(rank), (sliceBegin(rank + 1) - sliceBegin(rank)) * sizeof(ElemType));
+        }
+    }
+}
+
+int MPIWrapperShm::Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Request* request)
+{
+    if (datatype == MPI_FLOAT)
+        AllReduceImpl(static_cast<const float*>(sendbuf), static_cast<float*>(recvbuf), count, op);
+    else if (datatype == MPI_DOUBLE)
+        AllReduceImpl(static_cast<const double*>(sendbuf), static_cast<double*>(recvbuf), count, op);
+    else if (datatype == MPI_INT)
+        AllReduceImpl(static_cast<const int*>(sendbuf), static_cast<int*>(recvbuf), count, op);
+    else if (datatype == MPI_UNSIGNED)
+        AllReduceImpl(static_cast<const unsigned int*>(sendbuf), static_cast<unsigned int*>(recvbuf), count, op);
+    else if (datatype == MPI_LONG_LONG_INT)
+        AllReduceImpl(static_cast<const long long*>(sendbuf), static_cast<long long*>(recvbuf), count, op);
+    else
+        LogicError("MPIWrapperShm: Unsupported MPI_Datatype for Iallreduce.");
+    SetRequestId(request, 0);
+    return MPI_SUCCESS;
+}
+
+void MPIWrapperShm::BcastBytes(void* data, size_t numBytes, size_t srcRank) const
+{
+    const size_t chunkBytes = m_bufferBytes / 2;
+    for (size_t chunkBegin = 0; chunkBegin < numBytes; chunkBegin += chunkBytes)
+    {
+        size_t chunkSize = std::min(chunkBytes, numBytes - chunkBegin);
+        size_t half = NextBufferHalf();
+        if (m_rank == (int)srcRank)
+            memcpy(Buffer(m_rank, half), static_cast<char*>(data) + chunkBegin, chunkSize);
+        Barrier();
+        if (m_rank != (int)srcRank)
+            memcpy(static_cast<char*>(data) + chunkBegin, Buffer((int)srcRank, half), chunkSize);
+    }
+}
+
+// Gathers the data of all processes to the root, or to all processes for rootRank < 0. Without recvCounts,
+// every process receives numRecvElements elements. The numbers of elements that the processes actually send
+// are exchanged along with the data.
+template <class ElemType>
+void MPIWrapperShm::GatherImpl(const ElemType* sendData, size_t numSendElements, ElemType* receiveData, size_t numRecvElements,
+                               const int recvCounts[], const int offsets[], int rootRank) const
+{
+    bool receive = (rootRank < 0) || (rootRank == m_rank);
+    std::vector<size_t> receiveOffsets(m_numProcesses);
+    for (int rank = 0; rank < m_numProcesses; rank++)
+        receiveOffsets[rank] = (recvCounts ? offsets[rank] : rank * numRecvElements) * sizeof(ElemType);
+    GatherBytes(reinterpret_cast<const char*>(sendData), numSendElements * sizeof(ElemType), reinterpret_cast<char*>(receiveData), receiveOffsets, receive);
+}
+
+void MPIWrapperShm::Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount, MPI_Datatype recvtype) const
+{
+    std::vector<size_t> receiveOffsets(m_numProcesses);
+    for (int rank = 0; rank < m_numProcesses; rank++)
+        receiveOffsets[rank] = rank * recvcount * DataTypeSize(recvtype);
+    GatherBytes(static_cast<const char*>(sendbuf), sendcount * DataTypeSize(sendtype), static_cast<char*>(recvbuf), receiveOffsets, /*receive=*/true);
+}
+
+void MPIWrapperShm::GatherBytes(const char* sendData, size_t sendBytes, char* receiveData, const std::vector<size_t>& receiveOffsets, bool receive) const
+{
+    const size_t chunkBytes = m_bufferBytes / 2;
+    std::vector<size_t> bytes(m_numProcesses);
+    size_t numChunks = 1;
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        size_t half = NextBufferHalf();
+        size_t chunkBegin = chunk * chunkBytes;
+        if (chunk == 0)
+            m_counts[half * m_numProcesses + m_rank] = sendBytes;
+        if (chunkBegin < sendBytes)
+            memcpy(Buffer(m_rank, half), sendData + chunkBegin, std::min(chunkBytes, sendBytes - chunkBegin));
+        Barrier();
+
+        if (chunk == 0)
+        {
+            for (int rank = 0; rank < m_numProcesses; rank++)
+            {
+                bytes[rank] = m_counts[half * m_numProcesses + rank];
+                numChunks = std::max(numChunks, (bytes[rank] + chunkBytes - 1) / chunkBytes);
+            }
+        }
+        if (!receive)
+            continue;
+        for (int rank = 0; rank < m_numProcesses; rank++)
+        {
+            if (chunkBegin < bytes[rank])
+                memcpy(receiveData + receiveOffsets[rank] + chunkBegin, Buffer(rank, half), std::min(chunkBytes, bytes[rank] - chunkBegin));
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// point-to-point messages
+// -----------------------------------------------------------------------
+
+int MPIWrapperShm::PostMessage(bool isSend, void* buf, int count, MPI_Datatype datatype, int peer, int tag, MPI_Request* request)
+{
+    if (peer < 0 || peer >= m_numProcesses || peer == m_rank)
+        InvalidArgument("MPIWrapperShm: Invalid peer rank %d.", peer);
+
+    int id = m_nextRequestId++;
+    if (m_nextRequestId <= 0)
+        m_nextRequestId = 1;
+    size_t numBytes = count * DataTypeSize(datatype);
+    m_messages[id] = PendingMessage{ isSend, peer, tag, static_cast<char*>(buf), numBytes, isSend ? numBytes : 0, 0, false };
+    (isSend ? m_sendQueues : m_recvQueues)[peer].push_back(id);
+    SetRequestId(request, id);
+
+    Progress();
+    return MPI_SUCCESS;
+}
+
+int MPIWrapperShm::Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Request* request)
+{
+    // The data is only read.
+    return PostMessage(/*isSend=*/true, const_cast<void*>(buf), count, datatype, dest, tag, request);
+}
+
+int MPIWrapperShm::Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Request* request)
+{
+    return PostMessage(/*isSend=*/false, buf, count, datatype, source, tag, request);
+}
+
+int MPIWrapperShm::Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Status* status)
+{
+    MPI_Request request;
+    Irecv(buf, count, datatype, source, tag, &request);
+    return Wait(&request, status);
+}
+
+// Moves at most one chunk of the first outstanding message from and to every peer through the mailboxes.
+// Returns whether any messages are still outstanding.
+bool MPIWrapperShm::Progress()
+{
+    bool outstanding = false;
+    for (int peer = 0; peer < m_numProcesses; peer++)
+    {
+        if (!m_sendQueues[peer].empty())
+        {
+            PendingMessage& message = m_messages[m_sendQueues[peer].front()];
+            ShmMailbox* mailbox = Mailbox(m_rank, peer);
+            if (mailbox->full.load(std::memory_order_acquire) == 0)
+            {
+                size_t chunkBytes = std::min(ShmMailboxBytes, message.m_messageBytes - message.m_doneBytes);
+                mailbox->tag = message.m_tag;
+                mailbox->messageBytes = message.m_messageBytes;
+                mailbox->chunkBytes = chunkBytes;
+                memcpy(MailboxData(mailbox), message.m_data + message.m_doneBytes, chunkBytes);
+                mailbox->full.store(1, std::memory_order_release);
+                message.m_doneBytes += chunkBytes;
+                if (message.m_doneBytes == message.m_messageBytes)
+                {
+                    message.m_complete = true;
+                    m_sendQueues[peer].pop_front();
+                }
+            }
+            outstanding |= !m_sendQueues[peer].empty();
+        }
+
+        if (!m_recvQueues[peer].empty())
+        {
+            PendingMessage& message = m_messages[m_recvQueues[peer].front()];
+            ShmMailbox* mailbox = Mailbox(peer, m_rank);
+            if (mailbox->full.load(std::memory_order_acquire) != 0)
+            {
+                if (mailbox->tag != message.m_tag)
+                    LogicError("MPIWrapperShm: Received a message with tag %d from rank %d while expecting tag %d; messages must be received in the order they are sent.",
+                               (int)mailbox->tag, peer, message.m_tag);
+                if (mailbox->messageBytes > message.m_capacity)
+                    RuntimeError("MPIWrapperShm: Message of %d bytes from rank %d does not fit into the receive buffer of %d bytes.",
+                                 (int)mailbox->messageBytes, peer, (int)message.m_capacity);
+                memcpy(message.m_data + message.m_doneBytes, MailboxData(mailbox), mailbox->chunkBytes);
+                message.m_messageBytes = mailbox->messageBytes;
+                message.m_doneBytes += mailbox->chunkBytes;
+                mailbox->full.store(0, std::memory_order_release);
+                if (message.m_doneBytes == message.m_messageBytes)
+                {
+                    message.m_complete = true;
+                    m_recvQueues[peer].pop_front();
+                }
+            }
+            outstanding |= !m_recvQueues[peer].empty();
+        }
+    }
+    return outstanding;
+}
+
+int MPIWrapperShm::Wait(MPI_Request* request, MPI_Status* /*status*/)
+{
+    int index;
+    return Waitany(1, request, &index, MPI_STATUS_IGNORE);
+}
+
+int MPIWrapperShm::Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* /*status*/)
+{
+    for (int spin = 0;; spin++)
+    {
+        bool anyActive = false;
+        for (int i = 0; i < count; i++)
+        {
+            int id = GetRequestId(&array_of_requests[i]);
+            if (id == 0)
+                continue;
+            anyActive = true;
+            auto iter = m_messages.find(id);
+            if (iter == m_messages.end())
+                LogicError("MPIWrapperShm: Unknown request.");
+            if (iter->second.m_complete)
+            {
+                m_messages.erase(iter);
+                SetRequestId(&array_of_requests[i], 0);
+                *index = i;
+                return MPI_SUCCESS;
+            }
+        }
+        if (!anyActive)
+        {
+            *index = MPI_UNDEFINED;
+            return MPI_SUCCESS;
+        }
+
+        Progress();
+        if (spin >= ShmSpinCount)
+        {
+            CheckPeers();
+            std::this_thread::yield();
+        }
+    }
+}
+
+int MPIWrapperShm::Waitall(int count, MPI_Request array_of_requests[], MPI_Status* /*array_of_statuses*/)
+{
+    for (int i = 0; i < count; i++)
+        Wait(&array_of_requests[i], MPI_STATUS_IGNORE);
+    return MPI_SUCCESS;
+}
+
+MPIWrapper* CreateMPIWrapperShm()
+{
+    return new MPIWrapperShm();
+}
+
+#endif
+
+}}}
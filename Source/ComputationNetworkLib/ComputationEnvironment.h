@@ -10,6 +10,9 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class NodeProfiler;
+class InterOpScheduler;
+
 // ===========================================================================
 // ComputationEnvironment -- global network properties of interest to nodes
 // ===========================================================================
@@ -56,6 +59,17 @@ struct ComputationEnvironment
 
     bool IsV2Library() const { return isV2Library; }
 
+    // if set, ForwardProp() and Backprop() record the time spent in every node
+    std::shared_ptr<NodeProfiler> nodeProfiler;
+
+    // if set, ForwardProp() and Backprop() run independent nodes concurrently on its threads (CPU only)
+    std::shared_ptr<InterOpScheduler> interOpScheduler;
+
+    // if set, LookupTable nodes with sparse inputs compute a sparse (block-column) gradient of the embedding on the
+    // CPU, which only has the columns of the words in the minibatch. Only for trainers that apply the gradients
+    // as they are, i.e. do not sum them across workers or replicas.
+    bool sparseEmbeddingGradients = false;
+
     // more properties should be added here as needed
 };
 typedef std::shared_ptr<ComputationEnvironment> ComputationEnvironmentPtr;
@@ -102,12 +102,23 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     renameOrDie(tmpFileName, fileName);
 }
 
-// TODO: how does the file distinguish float vs double nodes?
+void ComputationNetwork::Save(File& fstream) const
+{
+    VerifyIsCompiled("Save");
+    SaveToFileImpl(fstream);
+}
+
 void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
 {
     File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
     // Buffer writes in memory then flush to filesystem, which reduces number of small writes
     fstream.Setvbuf();
+    SaveToFileImpl(fstream);
+}
+
+// TODO: how does the file distinguish float vs double nodes?
+void ComputationNetwork::SaveToFileImpl(File& fstream) const
+{
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
     // model version
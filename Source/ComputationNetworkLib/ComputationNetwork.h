@@ -119,10 +119,13 @@ public:
 
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
+    // write the model to an open File, e.g. one opened with fileOptionsMemory to snapshot the model
+    void Save(File& fstream) const;
 
 private:
 
     void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveToFileImpl(File& fstream) const;
     
     static size_t GetModelVersion(File& fstream);
 
@@ -141,6 +144,18 @@ public:
     // main entry point for backprop
     void Backprop(const ComputationNodeBasePtr rootNode);
 
+    // Sets a function that Backprop() calls for every LearnableParameter as soon as its gradient is final, in the
+    // order in which the backward pass finishes them, e.g. to start aggregating gradients while the rest of the
+    // backward pass runs. It is always called on the thread that called Backprop(). Pass nullptr to remove it.
+    void SetGradientReadyCallback(const std::function<void(const ComputationNodeBasePtr&)>& callback)
+    {
+        m_gradientReadyCallback = callback;
+    }
+
+    // Runs independent nodes in ForwardProp() and Backprop() concurrently on 'numThreads' threads (see InterOpScheduler).
+    // Pass 0 or 1 to go back to evaluating one node at a time. Only supported on the CPU.
+    void SetInterOpParallelism(size_t numThreads);
+
     template <class NODESET> // version that takes multiple nodes
     void TravserseInSortedGlobalEvalOrder(const NODESET& nodes, const std::function<void(const ComputationNodeBasePtr&)>& action)
     {
@@ -174,9 +189,11 @@ public:
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
     {
-        TravserseInSortedGlobalEvalOrder(nodes, [](const ComputationNodeBasePtr& node) {
-            PARTraversalFlowControlNode::ForwardProp(node, FrameRange(nullptr));
+        std::vector<ComputationNodeBasePtr> evalOrder;
+        TravserseInSortedGlobalEvalOrder(nodes, [&evalOrder](const ComputationNodeBasePtr& node) {
+            evalOrder.push_back(node);
         });
+        PARTraversalFlowControlNode::ForwardProp(evalOrder, FrameRange(nullptr));
     }
 
     template <class NODESET> // version that takes multiple nodes
@@ -263,6 +280,8 @@ public:
 
 private:
     void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
+    void PrintMemoryPlanStats() const;
+    void ReplanMatrixSharingIfNeeded();
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
@@ -460,6 +479,7 @@ public:
 
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
+    ComputationNetworkPtr CloneSharingParameters() const;
     void CopyInputs(const std::wstring fromName, std::wstring toName);
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
@@ -967,6 +987,12 @@ public:
     }
     bool GetIsV2Library() const { return m_environment->isV2Library; }
 
+    void SetSparseEmbeddingGradients(bool enable)
+    {
+        m_environment->sparseEmbeddingGradients = enable;
+    }
+    bool GetSparseEmbeddingGradients() const { return m_environment->sparseEmbeddingGradients; }
+
     void SetTraceLevel(int traceLevel)
     {
         m_environment->traceLevel = traceLevel;
@@ -1182,6 +1208,9 @@ protected:
         }
 
         static void ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr);
+        // same for a list of nodes in evaluation order, concurrently if the environment has an InterOpScheduler
+        static void ForwardProp(const std::vector<ComputationNodeBasePtr>& nodes, const FrameRange& fr);
+        static void Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr);
         static void PostForwardAndBackProp(const ComputationNodeBasePtr& node);
 
         virtual void BeginForwardProp() override {}
@@ -1198,6 +1227,8 @@ protected:
         virtual void EndBackprop() override {}
 
         virtual void Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) override;
+        // same, calling gradientReady for every LearnableParameter once all nodes that feed into its gradient are done
+        void Backprop(const FrameRange& fr, const std::function<void(const ComputationNodeBasePtr&)>& gradientReady);
         virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool);
         virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool);
         virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool);
@@ -1274,6 +1305,9 @@ private:
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
     std::map<const ComputationNodeBasePtr, ComputationNodeBasePtr> m_nestedNetworks;        // [out node] network rewritten as recursive traveral, potentially optimized; execution plan
 
+    // called by Backprop() for every LearnableParameter whose gradient is final (see SetGradientReadyCallback())
+    std::function<void(const ComputationNodeBasePtr&)> m_gradientReadyCallback;
+
     // cached quick-access list for inputs and parameters
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_inputValues;         // [out node] -> all input nodes feeding into out node
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_learnableParameters; // [out node] -> all parameter nodes feeding into out node
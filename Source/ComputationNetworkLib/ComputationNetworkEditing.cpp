@@ -97,6 +97,53 @@ void ComputationNetwork::CopySubTree(const ComputationNetwork& fromNet,
     }
 }
 
+// create a copy of the entire network whose LearnableParameters share their values with this network
+// Everything else, including the activations, the MBLayouts and the matrix pool, belongs to the copy, so that
+// the copy and this network can be evaluated concurrently, as long as neither of them updates the parameters.
+ComputationNetworkPtr ComputationNetwork::CloneSharingParameters() const
+{
+    auto net = make_shared<ComputationNetwork>(GetDeviceId());
+    net->SetTraceLevel(TraceLevel());
+    net->SetTrackGapNans(GetTrackGapNaNs());
+    net->SetIsV2Library(GetIsV2Library());
+    net->SetSparseEmbeddingGradients(GetSparseEmbeddingGradients());
+
+    // nodes first (this also copies the tags), then the links between them, like Read()
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        int flags = CopyNodeFlags::copyNodeValue;
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+            flags |= CopyNodeFlags::copyNodeValueShared;
+        net->AddNodeToNet(node->Duplicate(node->NodeName(), (CopyNodeFlags) flags));
+    }
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (node->GetNumInputs() == 0)
+            continue;
+        vector<ComputationNodeBasePtr> inputs;
+        for (const auto& input : node->GetInputs())
+            inputs.push_back(net->GetNodeFromName(input->NodeName()));
+        net->GetNodeFromName(iter.first)->AttachInputs(inputs);
+    }
+
+    const vector<pair<wstring, const vector<ComputationNodeBasePtr>*>> nodeGroups =
+    {
+        { L"feature",    &m_featureNodes    },
+        { L"label",      &m_labelNodes      },
+        { L"criterion",  &m_criterionNodes  },
+        { L"evaluation", &m_evaluationNodes },
+        { L"output",     &m_outputNodes     },
+    };
+    for (const auto& group : nodeGroups)
+        for (const auto& node : *group.second)
+            net->AddToNodeGroup(group.first, net->GetNodeFromName(node->NodeName()));
+
+    net->CompileNetwork();
+    return net;
+}
+
 // you can only copy inputs from nodes in the same network
 void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring toName)
 {
@@ -11,6 +11,8 @@
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
+#include "NodeProfiler.h"
+#include "InterOpScheduler.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -40,6 +42,9 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
 
+    // the minibatch size is only known now; size the memory-sharing plan for it
+    ReplanMatrixSharingIfNeeded();
+
     // traverse all nodes in the pre-determined evaluation order
     GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
 }
@@ -85,7 +90,10 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    if (m_gradientReadyCallback)
+        static_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode))->Backprop(FrameRange(nullptr), m_gradientReadyCallback);
+    else
+        GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -103,6 +111,19 @@ ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNod
     return m_nestedNetworks[rootNode];
 }
 
+void ComputationNetwork::SetInterOpParallelism(size_t numThreads)
+{
+    m_environment->interOpScheduler = nullptr; // (joins the threads of the previous one first)
+    if (numThreads <= 1)
+        return;
+    if (GetDeviceId() != CPUDEVICE)
+    {
+        fprintf(stderr, "SetInterOpParallelism: WARNING: Nodes are only evaluated concurrently on the CPU, ignored.\n");
+        return;
+    }
+    m_environment->interOpScheduler = make_shared<InterOpScheduler>(numThreads);
+}
+
 // -----------------------------------------------------------------------
 // PARTraversalFlowControlNode methods -- implements PAR traversal
 //
@@ -140,14 +161,50 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         }
     }
 }
+
+// the environment of 'node', or nullptr if it has none
+// Recurrent loops are not part of the network, so they take it from the nodes they contain.
+static const ComputationEnvironment* GetEnvironment(const ComputationNodeBasePtr& node)
+{
+    if (node->HasEnvironmentPtr())
+        return &node->Environment();
+    auto flowControlNode = dynamic_pointer_cast<FlowControlNode>(node);
+    if (flowControlNode && !flowControlNode->m_nestedNodes.empty() && flowControlNode->m_nestedNodes[0]->HasEnvironmentPtr())
+        return &flowControlNode->m_nestedNodes[0]->Environment();
+    return nullptr;
+}
+
+// the NodeProfiler to record the evaluation of 'node' with, if any
+// Only training is profiled, so that e.g. the cross-validation after each epoch does not count as forward propagation.
+static NodeProfiler* GetNodeProfiler(const ComputationNodeBasePtr& node)
+{
+    auto environment = GetEnvironment(node);
+    return environment && environment->IsTraining() ? environment->nodeProfiler.get() : nullptr;
+}
+
+// the InterOpScheduler to evaluate 'nodes' with, if any; a single node is evaluated directly
+static InterOpScheduler* GetInterOpScheduler(const std::vector<ComputationNodeBasePtr>& nodes)
+{
+    if (nodes.size() < 2)
+        return nullptr;
+    auto environment = GetEnvironment(nodes.front());
+    return environment ? environment->interOpScheduler.get() : nullptr;
+}
+
 /*static*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr)
 {
     if (node->IsOutOfDateWrtInputs())
     {
+        auto* profiler = GetNodeProfiler(node);
+        auto start = profiler ? NodeProfiler::Clock::now() : NodeProfiler::Clock::time_point();
+
         node->BeginForwardProp();
         node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
         node->EndForwardProp();
 
+        if (profiler)
+            profiler->Record(node, /*backward=*/false, start);
+
         node->BumpEvalTimeStamp();
 
         // Extreme Tracing, part 1/4
@@ -157,10 +214,21 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 }
 
 
+/*static*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const std::vector<ComputationNodeBasePtr>& nodes, const FrameRange& fr)
+{
+    auto* scheduler = GetInterOpScheduler(nodes);
+    if (scheduler)
+        scheduler->Run(nodes, /*backward=*/false, [&fr](const ComputationNodeBasePtr& node) { ForwardProp(node, fr); });
+    else
+    {
+        for (auto& node : nodes)
+            ForwardProp(node, fr);
+    }
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
-    for (auto& node : m_nestedNodes)
-        ForwardProp(node, fr);
+    ForwardProp(m_nestedNodes, fr);
 }
 
 /*static*/ void ComputationNetwork::PARTraversalFlowControlNode::PostForwardAndBackProp(const ComputationNodeBasePtr& node)
@@ -177,18 +245,50 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
-    // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    Backprop(fr, nullptr);
+}
+
+/*static*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    auto* profiler = GetNodeProfiler(node);
+    auto start = profiler ? NodeProfiler::Clock::now() : NodeProfiler::Clock::time_point();
+
+    node->BeginBackprop();
+    node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+    node->EndBackprop();
+
+    if (profiler)
+        profiler->Record(node, /*backward=*/true, start);
+
+    // Extreme Tracing, part 2/4
+    if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
+        DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, const std::function<void(const ComputationNodeBasePtr&)>& gradientReady)
+{
+    // All consumers of a parameter come before it in backprop order, so they have all been processed once it is done.
+    // (Parameters are never part of a loop.)
+    auto onNodeDone = [&gradientReady](const ComputationNodeBasePtr& node)
     {
-        auto& node = *pnode;
+        if (node->OperationName() == OperationNameOf(LearnableParameter) && node->IsParameterUpdateRequired())
+            gradientReady(node);
+    };
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+    auto* scheduler = GetInterOpScheduler(m_nestedNodes);
+    if (scheduler)
+    {
+        scheduler->Run(m_nestedNodes, /*backward=*/true, [&fr](const ComputationNodeBasePtr& node) { Backprop(node, fr); },
+                       gradientReady ? InterOpScheduler::NodeFunction(onNodeDone) : nullptr);
+        return;
+    }
 
-        // Extreme Tracing, part 2/4
-        if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
-            DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+    // process nodes in pre-determined order
+    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    {
+        Backprop(*pnode, fr);
+        if (gradientReady)
+            onNodeDone(*pnode);
     }
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
@@ -1024,6 +1124,7 @@ void ComputationNetwork::PrintMemorySharingStructure(const vector<ComputationNod
         }
     }
     fprintf(stderr, "\n");
+    PrintMemoryPlanStats();
 }
 
 
@@ -1173,9 +1274,8 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     m_matrixPool.OptimizedMemoryAllocation(); 
     m_areMatricesAllocated = true;
 
-    // TO DO: At the time of AllocateAllMatrices we don't know the minibatch size. In theory one may allocate memory again once we start to receive
-    // data from the reader (and the minibatch size is known). For some problems, minibatch size can change constantly, and there needs to be a 
-    // tradeoff in deciding how frequent to run optimized memory allocation. For now, we do it only once at the very beginning for speed concerns. 
+    // At this point we don't know the minibatch size, so minibatch-dependent requests are planned by their per-column size only.
+    // ForwardProp() redoes the plan via ReplanMatrixSharingIfNeeded() whenever a minibatch is larger than any seen before.
 
     // TO DO: when some matrices are sparse, the memory size request may be wrong. One may need to call OptimizedMemoryAllocation later again 
     // if the requests of sparse allocation and release are re-processed correctly. Future work. 
@@ -1185,6 +1285,39 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         PrintMemorySharingStructure(GetAllNodes());
 }
 
+// Redo the memory-sharing plan if the current minibatch is larger than the one the plan was made for.
+// Since the plan only ever grows, this happens a few times early in training and then no more.
+void ComputationNetwork::ReplanMatrixSharingIfNeeded()
+{
+    if (!AreMatricesAllocated() || !m_matrixPool.NeedsReplanning())
+        return;
+
+    m_matrixPool.OptimizedMemoryAllocation();
+
+    // pooled matrices may have been replaced by new, empty ones, so cached values of non-leaf nodes are gone; force their recomputation
+    for (const auto& node : GetAllNodes())
+    {
+        if (!node->IsLeaf() && node->IsValueSharable())
+            node->SetEvalTimeStampOutdatedWrtAll();
+    }
+
+    if (TraceLevel() > 0)
+        PrintMemoryPlanStats();
+}
+
+// print peak memory and fragmentation of the memory-sharing plan to log
+void ComputationNetwork::PrintMemoryPlanStats() const
+{
+    const double MB = 1024.0 * 1024.0;
+    for (const auto& item : m_matrixPool.GetPlanStats())
+    {
+        const MemoryPlanStats& stats = item.second;
+        fprintf(stderr, "Memory sharing plan for device %d: %d requests in %d matrices, %.1f MB allocated (%.1f MB without sharing), peak %.1f MB live, %.1f MB as a single arena, fragmentation %.1f%%.\n",
+                (int) item.first, (int) stats.numRequests, (int) stats.numBuffers, stats.allocatedBytes / MB, stats.requestedBytes / MB,
+                stats.peakLiveBytes / MB, stats.arenaBytes / MB, 100.0 * stats.Fragmentation());
+    }
+}
+
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap)
 {
     for (int i = 0; i < n->GetNumInputs(); i++)
@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <mutex>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -69,7 +70,8 @@ enum CopyNodeFlags // flags to be passed to the CopyTo() function
     copyNodeValue          = 1, // copy everything except for the input links
     copyNodeInputLinks     = 2, // copy over input links
     copyNodeAll            = 3, // copy everything
-    copyNodeAcrossNetworks = 4  // allow a cross network child copy
+    copyNodeAcrossNetworks = 4, // allow a cross network child copy
+    copyNodeValueShared    = 8  // together with copyNodeValue: let the copy share the value matrix instead of copying it
 };
 
 #pragma region base computation class
@@ -464,6 +466,22 @@ public:
         return GetSampleMatrixNumCols() < other->GetSampleMatrixNumCols();
     }
 
+    // rough number of floating-point operations of ForwardProp() over the current minibatch, for profiling
+    // By default, one operation per element of the largest of the output and the inputs, which fits element-wise
+    // operations and reductions. Nodes that do more work per element, such as matrix products, override this.
+    virtual double GetForwardFLOPsEstimate() const
+    {
+        if (m_inputs.empty())
+            return 0; // leaves, e.g. inputs and parameters, are not computed
+        double numElements = (double) GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+        for (const auto& input : m_inputs)
+        {
+            if (input)
+                numElements = std::max(numElements, (double) input->GetSampleMatrixNumRows() * input->GetSampleMatrixNumCols());
+        }
+        return numElements;
+    }
+
     // interpretation as a Matrix reference
 private:
     void CheckTensorIsMatrix() const
@@ -691,6 +709,13 @@ public:
 
     virtual std::set<std::pair<const MatrixBase*, std::wstring>> GetMatrixInfo() const = 0; // to be defined by <ElemType> version
 
+    // the matrices of this node's output(s): the values and, if allocated, the gradients
+    virtual void GetOutputMatrices(std::vector<const MatrixBase*>& values, std::vector<const MatrixBase*>& gradients) const = 0;
+
+    // matrices that ForwardProp() (or Backprop() if 'backward') reads and writes, for running nodes concurrently
+    // Matrices are identified by address, which also captures that the MatrixPool lets several nodes share one.
+    virtual void GetMatrixAccesses(bool backward, std::vector<const MatrixBase*>& reads, std::vector<const MatrixBase*>& writes) const = 0;
+
     // -----------------------------------------------------------------------
     // validation
     // -----------------------------------------------------------------------
@@ -1264,7 +1289,9 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = DownCast(nodeP);
-            if (m_value)
+            if (m_value && (flags & CopyNodeFlags::copyNodeValueShared))
+                node->m_value = m_value;
+            else if (m_value)
             {
                 node->CreateValueMatrixIfNull();
                 node->m_value->SetValue(*m_value);
@@ -1789,6 +1816,57 @@ public:
         return matrixInfo;
     }
 
+    virtual void GetOutputMatrices(std::vector<const MatrixBase*>& values, std::vector<const MatrixBase*>& gradients) const override
+    {
+        if (m_value)
+            values.push_back(m_value.get());
+        if (m_gradient)
+            gradients.push_back(m_gradient.get());
+        auto multiOutputNode = dynamic_cast<const MultiOutputNode<ElemType>*>(this);
+        if (multiOutputNode)
+        {
+            for (size_t i = 1; i < multiOutputNode->m_numOutputs; ++i)
+            {
+                if (multiOutputNode->m_outputsValue[i])
+                    values.push_back(multiOutputNode->m_outputsValue[i].get());
+                if (multiOutputNode->m_outputsGradient[i])
+                    gradients.push_back(multiOutputNode->m_outputsGradient[i].get());
+            }
+        }
+    }
+
+    // ForwardProp() writes the values and reads the inputs' values. Backprop() reads the values and the inputs' values,
+    // and writes the gradients of the inputs, as well as its own (e.g. masking in BeginBackprop()). Internal matrices
+    // from the MatrixPool count as written by both, as it is not known which of them they use.
+    virtual void GetMatrixAccesses(bool backward, std::vector<const MatrixBase*>& reads, std::vector<const MatrixBase*>& writes) const override
+    {
+        std::vector<const MatrixBase*> values, gradients;
+        GetOutputMatrices(values, gradients);
+        if (!backward)
+            writes.insert(writes.end(), values.begin(), values.end());
+        else
+        {
+            reads.insert(reads.end(), values.begin(), values.end());
+            writes.insert(writes.end(), gradients.begin(), gradients.end());
+        }
+        for (auto pMatrixPtr : m_pooledMatrixPtrs)
+        {
+            const MatrixBase* matrix = pMatrixPtr->get();
+            if (matrix && std::find(values.begin(), values.end(), matrix) == values.end() && std::find(gradients.begin(), gradients.end(), matrix) == gradients.end())
+                writes.push_back(matrix);
+        }
+        for (const auto& input : m_inputs)
+        {
+            if (!input)
+                continue;
+            std::vector<const MatrixBase*> inputValues, inputGradients;
+            input->GetOutputMatrices(inputValues, inputGradients);
+            reads.insert(reads.end(), inputValues.begin(), inputValues.end());
+            if (backward && input->NeedsGradient())
+                writes.insert(writes.end(), inputGradients.begin(), inputGradients.end());
+        }
+    }
+
     // request matrices needed to do node function value evaluation
     // for memory pool utilization optimizaiton, the requested pointer is not immediately useable until the entire network has gone through all requests 
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
@@ -1898,15 +1976,29 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
+    // copy one of this node's matrices to another node in CopyTo(); matrices from the matrix pool only exist once
+    // the network's matrices have been allocated, before that there is nothing to copy
+    void CopyMatrixIfAllocated(const shared_ptr<Matrix<ElemType>>& from, shared_ptr<Matrix<ElemType>>& to) const
+    {
+        if (!from)
+            return;
+        if (!to)
+            to = make_shared<Matrix<ElemType>>(from->GetDeviceId());
+        to->SetValue(*from);
+    }
+
     // matrixSize is per sample size, if unknown or hard to estimate, set matrixSize = 0
-    // if the matrix's size will scale with minibatch size, set mbScale = true 
+    // if the matrix's size will scale with minibatch size, set mbScale = true; the pool then sizes it by the node's MBLayout once that is known,
+    // or by pMBLayout if given (for matrices that scale with the minibatch of an input rather than that of this node)
     // if workspace flag is true, the memory request will be treated specially. We assume workspace memory will share their own pointers 
     // this is currently a workaround for workspace memory for convolutions
-    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, size_t matrixSize=0, bool mbScale=false, bool isWorkSpace=false)
+    void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool, size_t matrixSize=0, bool mbScale=false, bool isWorkSpace=false, const MBLayoutPtr& pMBLayout=nullptr)
     {
         if (matrixPtr == nullptr)
         {
-            matrixPool.RequestAllocate<ElemType>(m_deviceId, &matrixPtr, matrixSize, mbScale, isWorkSpace);
+            matrixPool.RequestAllocate<ElemType>(m_deviceId, &matrixPtr, matrixSize, mbScale, isWorkSpace, mbScale ? (pMBLayout ? pMBLayout : m_pMBLayout) : nullptr);
+            if (std::find(m_pooledMatrixPtrs.begin(), m_pooledMatrixPtrs.end(), &matrixPtr) == m_pooledMatrixPtrs.end())
+                m_pooledMatrixPtrs.push_back(&matrixPtr);
         }
     }
 
@@ -2077,6 +2169,8 @@ public:
     // When using the TensorView interface, one could instead just use a 1x1 matrix with a view that broadcasts its columns (stride 0).
     static const Matrix<ElemType>& ConstOnes(const size_t rows, const size_t cols, const DEVICEID_TYPE deviceId)
     {
+        static std::mutex constOnesMutex; // nodes may be evaluated concurrently (cf. InterOpScheduler)
+        std::lock_guard<std::mutex> lock(constOnesMutex);
         if (s_constOnes.find(rows) == s_constOnes.end() ||
             s_constOnes[rows].find(cols) == s_constOnes[rows].end()) // not found
         {
@@ -2102,6 +2196,9 @@ protected:
     static std::map<size_t, std::map<size_t, shared_ptr<Matrix<ElemType>>>> s_constOnes;
 
     MatrixType m_preferredGradientMatrixType = UNDETERMINED;
+
+private:
+    std::vector<shared_ptr<Matrix<ElemType>>*> m_pooledMatrixPtrs; // every member this node requested from the MatrixPool, for GetMatrixAccesses()
 };
 
 // convenience wrapper for ComputationNode::New()
@@ -2228,6 +2325,21 @@ public:
     virtual std::string FormatOperationPrototype(const std::string& extraArgs) const override { return ""; }
     virtual void DumpNodeInfo(const bool /*printValues*/, const bool /*printMetadata*/, File& fstream) const override {}
     virtual std::set<std::pair<const MatrixBase*, std::wstring>> GetMatrixInfo() const override { NOT_IMPLEMENTED; }
+    virtual void GetOutputMatrices(std::vector<const MatrixBase*>& values, std::vector<const MatrixBase*>& gradients) const override { NOT_IMPLEMENTED; }
+
+    virtual void GetMatrixAccesses(bool backward, std::vector<const MatrixBase*>& reads, std::vector<const MatrixBase*>& writes) const override
+    {
+        for (const auto& node : m_nestedNodes)
+            node->GetMatrixAccesses(backward, reads, writes);
+    }
+
+    virtual double GetForwardFLOPsEstimate() const override
+    {
+        double flops = 0;
+        for (const auto& node : m_nestedNodes)
+            flops += node->GetForwardFLOPsEstimate();
+        return flops;
+    }
 
 protected: public:                                     // needed in ComputationNetwork::FindInRecurrentLoops(), which really should be part of SEQTraversalFlowControlNode
     std::vector<ComputationNodeBasePtr> m_nestedNodes; // nodes tucked away in this node, in evaluation order
@@ -2288,6 +2400,7 @@ protected:
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;                                                                                    \
     using Base::BackpropTo;                                                                                                                              \
     using Base::ConstOnes;                                                                                                                               \
+    using Base::CopyMatrixIfAllocated;                                                                                                                   \
     using Base::CopyTo;                                                                                                                                  \
     using Base::CreateMatrixIfNull;                                                                                                                      \
     using Base::CreateUniqId;                                                                                                                            \
@@ -332,6 +332,15 @@ public:
     // TODO: the check for NeedsDynamicValidation() is a temporary resolution and needs to be properly handled when we look at support for free dimension convolution inputs. 
     virtual bool ImplementsGradientOverwriteOptimization() const override { return Base::NeedsDynamicValidation() ? false : m_convEng->ImplementsGradientOverwriteOptimization(); }
 
+    // Every output element (input element if transposed) is a dot product with one of the m_mapCount kernels.
+    virtual double GetForwardFLOPsEstimate() const override
+    {
+        double kernelSize = (double) InputRef(0).GetSampleMatrixNumRows() * InputRef(0).GetSampleMatrixNumCols() / std::max((size_t) 1, m_mapCount.GetNumElements());
+        double numElements = m_transpose ? (double) InputRef(1).GetSampleMatrixNumRows() * InputRef(1).GetSampleMatrixNumCols()
+                                         : (double) GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+        return 2 * kernelSize * numElements;
+    }
+
 public:
     void Save(File& fstream) const override
     {
@@ -563,7 +572,8 @@ public:
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad);
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
-                                                                ConvolutionEngineKind::All, NodeName(), Globals::ShouldForceDeterministicAlgorithms());
+                                                                Globals::ShouldUseFastCpuConvolution() ? ConvolutionEngineKind::AllWithFastCpu : ConvolutionEngineKind::All,
+                                                                NodeName(), Globals::ShouldForceDeterministicAlgorithms());
             }
 
             if (Input(0)->GetSampleLayout().GetNumElements() != m_kernelShape.GetNumElements() * m_convEng->Geometry()->KernelCount())
@@ -262,8 +262,8 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<DiagTimesNode<ElemType>>(nodeP);
-            node->m_innerproduct->SetValue(*m_innerproduct);
-            node->m_rightGradient->SetValue(*m_rightGradient);
+            CopyMatrixIfAllocated(m_innerproduct, node->m_innerproduct);
+            CopyMatrixIfAllocated(m_rightGradient, node->m_rightGradient);
         }
     }
     // request matrices that are needed for gradient computation
@@ -99,9 +99,9 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<ClassificationErrorNode<ElemType>>(nodeP);
-            node->m_maxIndexes0->SetValue(*m_maxIndexes0);
-            node->m_maxIndexes1->SetValue(*m_maxIndexes1);
-            node->m_maxValues->SetValue(*m_maxValues);
+            CopyMatrixIfAllocated(m_maxIndexes0, node->m_maxIndexes0);
+            CopyMatrixIfAllocated(m_maxIndexes1, node->m_maxIndexes1);
+            CopyMatrixIfAllocated(m_maxValues, node->m_maxValues);
         }
     }
     // request matrices needed to do node function value evaluation
@@ -326,10 +326,10 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<NDCG1EvalNode<ElemType>>(nodeP);
-            node->m_urlGain0->SetValue(*m_urlGain0);
-            node->m_urlGain1->SetValue(*m_urlGain1);
-            node->m_urlDiscount0->SetValue(*m_urlDiscount0);
-            node->m_urlDiscount1->SetValue(*m_urlDiscount1);
+            CopyMatrixIfAllocated(m_urlGain0, node->m_urlGain0);
+            CopyMatrixIfAllocated(m_urlGain1, node->m_urlGain1);
+            CopyMatrixIfAllocated(m_urlDiscount0, node->m_urlDiscount0);
+            CopyMatrixIfAllocated(m_urlDiscount1, node->m_urlDiscount1);
 
             node->m_queryUrls = m_queryUrls;
             node->m_urlSorter = m_urlSorter;
@@ -584,6 +584,28 @@ public:
             Matrix<ElemType> sliceInput1Value = InputRef(1).MaskedValueFor(t);
             Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(t);
 
+            // If the trainer allows it (see ComputationEnvironment::sparseEmbeddingGradients), the gradient of the
+            // embedding is sparse if the input is, as in TimesNode, so that only the columns of the words in the
+            // minibatch are computed and updated.
+            bool sparseGradient = sliceInput1Value.GetMatrixType() == SPARSE && InputRef(0).Value().GetDeviceId() == CPUDEVICE &&
+                                  Base::HasEnvironmentPtr() && Base::Environment().sparseEmbeddingGradients;
+            if (sparseGradient &&
+                InputRef(0).GetPreferredGradientMatrixType() == UNDETERMINED &&
+                InputRef(0).Gradient().GetMatrixType() == DENSE)
+            {
+                // allocate a new matrix instead of switching the type in place, which may affect nodes that share this one
+                auto& gradient = InputRef(0).Gradient();
+                InputRef(0).GradientPtrRef() = std::make_shared<Matrix<ElemType>>(gradient.GetNumRows(), gradient.GetNumCols(), gradient.GetPreferredDeviceId(),
+                                                                                  SPARSE, MatrixFormat::matrixFormatSparseBlockCol);
+                InputRef(0).SetPreferredGradientMatrixType(SPARSE);
+            }
+            else if (!sparseGradient && InputRef(0).GetPreferredGradientMatrixType() != DENSE)
+            {
+                if (InputRef(0).GetPreferredGradientMatrixType() == SPARSE)
+                    InputRef(0).Gradient().SwitchToMatrixType(DENSE, matrixFormatDense, true);
+                InputRef(0).SetPreferredGradientMatrixType(DENSE);
+            }
+
             BackpropToLeft(sliceInput1Value, InputRef(0).GradientAsMatrix(), sliceOutputGrad);
         }
         else if (inputIndex == 1) // right derivative (input)
@@ -0,0 +1,373 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "InterOpScheduler.h"
+#include "CPUMatrix.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+InterOpScheduler::InterOpScheduler(size_t numThreads)
+    : m_graph(nullptr), m_run(nullptr), m_notifyDone(false), m_numRemaining(0), m_numQueued(0), m_failed(false),
+      m_stopping(false), m_generation(0), m_numBusyWorkers(0)
+{
+    if (numThreads < 1)
+        InvalidArgument("InterOpScheduler: At least one thread is needed.");
+
+    m_previousNumMathThreads = CPUMatrix<float>::GetMaxNumThreads();
+    m_numMathThreadsPerWorker = max(1, m_previousNumMathThreads / (int) numThreads);
+
+    // all workers must exist before the first one can look into the others' queues
+    for (size_t i = 0; i < numThreads; i++)
+        m_workers.push_back(make_unique<Worker>());
+    for (size_t i = 0; i < numThreads; i++)
+        m_workers[i]->thread = thread(&InterOpScheduler::WorkerLoop, this, i);
+}
+
+InterOpScheduler::~InterOpScheduler()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker : m_workers)
+        worker->thread.join();
+    // The BLAS thread count is global, so the workers changed it for everyone.
+    CPUMatrix<float>::SetNumThreads(m_previousNumMathThreads);
+}
+
+// Makes the dependencies of the nodes in 'graph', given what each of them reads and writes.
+/*static*/ void InterOpScheduler::MakeGraph(bool backward, const vector<vector<const MatrixBase*>>& reads, const vector<vector<const MatrixBase*>>& writes, Graph& graph)
+{
+    size_t numTasks = graph.nodes.size();
+    vector<pair<size_t, size_t>> edges;
+    auto addEdge = [&edges](size_t from, size_t to)
+    {
+        if (from == to)
+            return;
+        if (from > to) // would deadlock
+            LogicError("InterOpScheduler: Node order is inconsistent with the dependencies.");
+        edges.push_back(make_pair(from, to));
+    };
+
+    // The nodes that produce the inputs. The nodes of a loop are represented by the loop.
+    unordered_map<const ComputationNodeBase*, size_t> taskOfNode;
+    for (size_t t = 0; t < numTasks; t++)
+    {
+        taskOfNode[graph.nodes[t].get()] = t;
+        auto flowControlNode = dynamic_pointer_cast<FlowControlNode>(graph.nodes[t]);
+        if (flowControlNode)
+        {
+            for (const auto& nestedNode : flowControlNode->m_nestedNodes)
+                taskOfNode[nestedNode.get()] = t;
+        }
+    }
+    for (size_t t = 0; t < numTasks; t++)
+    {
+        auto flowControlNode = dynamic_pointer_cast<FlowControlNode>(graph.nodes[t]);
+        const auto& nodes = flowControlNode ? flowControlNode->m_nestedNodes : vector<ComputationNodeBasePtr>(1, graph.nodes[t]);
+        for (const auto& node : nodes)
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                auto iter = taskOfNode.find(input.get());
+                if (iter == taskOfNode.end())
+                    continue; // not evaluated by this traversal
+                if (backward)
+                    addEdge(t, iter->second);
+                else
+                    addEdge(iter->second, t);
+            }
+        }
+    }
+
+    // Accesses to the same matrix keep their sequential order, except for reads between the same two writes.
+    struct MatrixState
+    {
+        size_t lastWriter = SIZE_MAX;
+        vector<size_t> readersSinceLastWrite;
+    };
+    unordered_map<const MatrixBase*, MatrixState> matrixStates;
+    for (size_t t = 0; t < numTasks; t++)
+    {
+        for (auto matrix : reads[t])
+        {
+            auto& state = matrixStates[matrix];
+            if (state.lastWriter != SIZE_MAX)
+                addEdge(state.lastWriter, t);
+            state.readersSinceLastWrite.push_back(t);
+        }
+        for (auto matrix : writes[t])
+        {
+            auto& state = matrixStates[matrix];
+            if (state.lastWriter != SIZE_MAX)
+                addEdge(state.lastWriter, t);
+            for (auto reader : state.readersSinceLastWrite)
+                addEdge(reader, t);
+            state.lastWriter = t;
+            state.readersSinceLastWrite.clear();
+        }
+    }
+
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+    graph.successors.assign(numTasks, vector<size_t>());
+    graph.numPredecessors.assign(numTasks, 0);
+    for (const auto& edge : edges)
+    {
+        graph.successors[edge.first].push_back(edge.second);
+        graph.numPredecessors[edge.second]++;
+    }
+}
+
+// The graph of a traversal is kept, and only redone if the matrices of its nodes have changed, e.g. because the
+// memory-sharing plan was redone for a larger minibatch.
+const InterOpScheduler::Graph& InterOpScheduler::GetGraph(const vector<ComputationNodeBasePtr>& nodes, bool backward)
+{
+    vector<ComputationNodeBasePtr> orderedNodes(nodes);
+    if (backward)
+        reverse(orderedNodes.begin(), orderedNodes.end());
+
+    vector<vector<const MatrixBase*>> reads(orderedNodes.size());
+    vector<vector<const MatrixBase*>> writes(orderedNodes.size());
+    vector<const MatrixBase*> accesses;
+    for (size_t t = 0; t < orderedNodes.size(); t++)
+    {
+        orderedNodes[t]->GetMatrixAccesses(backward, reads[t], writes[t]);
+        accesses.insert(accesses.end(), reads[t].begin(), reads[t].end());
+        accesses.push_back(nullptr);
+        accesses.insert(accesses.end(), writes[t].begin(), writes[t].end());
+        accesses.push_back(nullptr);
+    }
+
+    vector<ComputationNodeBase*> key;
+    for (const auto& node : nodes)
+        key.push_back(node.get());
+    auto& graph = m_graphs[make_pair(key, backward)];
+    if (graph.nodes.empty() || graph.accesses != accesses)
+    {
+        graph.nodes = orderedNodes;
+        graph.accesses = accesses;
+        MakeGraph(backward, reads, writes, graph);
+    }
+    return graph;
+}
+
+void InterOpScheduler::Run(const vector<ComputationNodeBasePtr>& nodes, bool backward, const NodeFunction& run, const NodeFunction& done)
+{
+    if (nodes.empty())
+        return;
+
+    // A node that evaluates nodes itself must do so on its own thread, since the others may all be waiting for it.
+    for (const auto& worker : m_workers)
+    {
+        if (worker->thread.get_id() == this_thread::get_id())
+        {
+            for (size_t i = 0; i < nodes.size(); i++)
+            {
+                const auto& node = nodes[backward ? nodes.size() - 1 - i : i];
+                run(node);
+                if (done)
+                    done(node);
+            }
+            return;
+        }
+    }
+
+    const Graph& graph = GetGraph(nodes, backward);
+    size_t numTasks = graph.nodes.size();
+
+    // The workers are idle, so nothing needs to be locked until they are started.
+    m_graph = &graph;
+    m_run = &run;
+    m_notifyDone = (done != nullptr);
+    m_numPending.reset(new atomic<size_t>[numTasks]);
+    for (size_t t = 0; t < numTasks; t++)
+        m_numPending[t] = graph.numPredecessors[t];
+    m_numRemaining = numTasks;
+    m_failed = false;
+    for (auto& worker : m_workers)
+        worker->tasks.clear(); // left over from a failed Run()
+    size_t numReady = 0;
+    for (size_t t = 0; t < numTasks; t++)
+    {
+        if (graph.numPredecessors[t] == 0)
+            m_workers[numReady++ % m_workers.size()]->tasks.push_back(t);
+    }
+    m_numQueued = numReady;
+
+    unique_lock<mutex> lock(m_mutex);
+    m_error = nullptr;
+    m_doneTasks.clear();
+    m_numBusyWorkers = m_workers.size();
+    m_generation++;
+    m_workAvailable.notify_all();
+
+    // pass the nodes to 'done' as they complete, until all workers have finished
+    vector<size_t> doneTasks;
+    for (;;)
+    {
+        m_callerWakeUp.wait(lock, [this] { return !m_doneTasks.empty() || m_numBusyWorkers == 0; });
+        bool finished = (m_numBusyWorkers == 0);
+        doneTasks.swap(m_doneTasks);
+        if (!m_error)
+        {
+            lock.unlock();
+            exception_ptr error;
+            try
+            {
+                for (auto t : doneTasks)
+                    done(graph.nodes[t]);
+            }
+            catch (...)
+            {
+                error = current_exception();
+            }
+            lock.lock();
+            if (error && !m_error)
+            {
+                m_error = error;
+                m_failed = true;
+                m_workAvailable.notify_all();
+            }
+        }
+        doneTasks.clear();
+        if (finished)
+            break;
+    }
+
+    m_graph = nullptr;
+    m_run = nullptr;
+    if (m_error)
+        rethrow_exception(m_error);
+}
+
+void InterOpScheduler::Push(size_t workerIndex, size_t task)
+{
+    auto& worker = *m_workers[workerIndex];
+    {
+        lock_guard<mutex> lock(worker.mutex);
+        worker.tasks.push_back(task);
+        m_numQueued++;
+    }
+    // a worker that has just found nothing to do either sees the new task, or is already waiting for it
+    {
+        lock_guard<mutex> lock(m_mutex);
+    }
+    m_workAvailable.notify_one();
+}
+
+bool InterOpScheduler::Pop(size_t workerIndex, size_t& task)
+{
+    // the most recent task of our own, whose inputs are most likely still in the cache
+    {
+        auto& worker = *m_workers[workerIndex];
+        lock_guard<mutex> lock(worker.mutex);
+        if (!worker.tasks.empty())
+        {
+            task = worker.tasks.back();
+            worker.tasks.pop_back();
+            m_numQueued--;
+            return true;
+        }
+    }
+    // otherwise the oldest task of someone else
+    for (size_t k = 1; k < m_workers.size(); k++)
+    {
+        auto& worker = *m_workers[(workerIndex + k) % m_workers.size()];
+        lock_guard<mutex> lock(worker.mutex);
+        if (!worker.tasks.empty())
+        {
+            task = worker.tasks.front();
+            worker.tasks.pop_front();
+            m_numQueued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void InterOpScheduler::WorkerLoop(size_t workerIndex)
+{
+    // the OpenMP thread count is per thread
+    CPUMatrix<float>::SetNumThreads(m_numMathThreadsPerWorker);
+
+    size_t generation = 0;
+    unique_lock<mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_workAvailable.wait(lock, [this, generation] { return m_stopping || m_generation != generation; });
+        if (m_stopping)
+            return;
+        generation = m_generation;
+
+        lock.unlock();
+        RunTasks(workerIndex);
+        lock.lock();
+
+        if (--m_numBusyWorkers == 0)
+            m_callerWakeUp.notify_all();
+    }
+}
+
+// runs tasks until all are done, or one has failed
+void InterOpScheduler::RunTasks(size_t workerIndex)
+{
+    for (;;)
+    {
+        size_t task;
+        if (!Pop(workerIndex, task))
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this] { return m_numQueued > 0 || m_numRemaining == 0 || m_failed; });
+            if (m_numRemaining == 0 || m_failed)
+                return;
+            continue;
+        }
+        if (m_failed)
+            return;
+
+        try
+        {
+            (*m_run)(m_graph->nodes[task]);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (!m_error)
+                m_error = current_exception();
+            m_failed = true;
+            m_workAvailable.notify_all();
+            return;
+        }
+
+        for (auto successor : m_graph->successors[task])
+        {
+            if (--m_numPending[successor] == 0)
+                Push(workerIndex, successor);
+        }
+        if (m_notifyDone)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_doneTasks.push_back(task);
+            m_callerWakeUp.notify_one();
+        }
+        if (--m_numRemaining == 0)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_workAvailable.notify_all();
+        }
+    }
+}
+
+}}}
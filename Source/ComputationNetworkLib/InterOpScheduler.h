@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// InterOpScheduler.h -- running independent nodes of a network concurrently
+//
+
+#pragma once
+
+#include "ComputationNode.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Runs the nodes of a PAR traversal (in evaluation order, with recurrent loops as SEQTraversalFlowControlNodes) on a
+// pool of threads, each node as soon as all nodes it depends on are done, e.g. the towers of a multi-tower network
+// or the two directions of a bidirectional recurrence at the same time.
+//
+// A node depends on the nodes that produce its inputs, and, for every matrix it reads or writes (cf.
+// GetMatrixAccesses()), on every node that accesses that matrix before it in the sequential order, unless both only
+// read it. Since the MatrixPool lets nodes share a matrix only if their sequential lifetimes do not overlap, this
+// keeps the sharing plan correct, at the price of ordering nodes that merely happen to share a matrix.
+// Backprop is scheduled the same way over the reverse order; as every node that contributes to a gradient writes it,
+// these contributions are still added up one at a time, in the sequential order.
+//
+// Every thread takes the nodes that become ready after one of its nodes is done, and takes from the other threads'
+// queues when it runs out (work stealing). Each thread gets an equal share of the math library's threads.
+//
+// CPU only, as the GPU executes the kernels of all nodes in a single stream anyway.
+class InterOpScheduler
+{
+public:
+    typedef std::function<void(const ComputationNodeBasePtr&)> NodeFunction;
+
+    InterOpScheduler(size_t numThreads);
+    ~InterOpScheduler();
+
+    size_t GetNumThreads() const { return m_workers.size(); }
+
+    // Calls 'run' for every node of 'nodes', in dependency order, concurrently where possible; if 'backward', in the
+    // order of backprop. If given, 'done' is called for every node after 'run', on the calling thread. Returns once all
+    // nodes are done. If 'run' throws, no more nodes are started, and the first error is rethrown. When called from one
+    // of the scheduler's own threads (a node that evaluates nodes itself), the nodes are run one at a time.
+    void Run(const std::vector<ComputationNodeBasePtr>& nodes, bool backward, const NodeFunction& run, const NodeFunction& done = nullptr);
+
+private:
+    // dependencies between the nodes of one traversal, indexed by their position in the order of execution
+    struct Graph
+    {
+        std::vector<ComputationNodeBasePtr> nodes;       // in the order of execution
+        std::vector<const MatrixBase*> accesses;         // the matrices accessed by all nodes when the graph was made; if these change, the graph is redone
+        std::vector<std::vector<size_t>> successors;
+        std::vector<size_t> numPredecessors;
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex mutex;         // protects 'tasks'
+        std::deque<size_t> tasks; // own tasks are taken from the back, stolen ones from the front
+    };
+
+    static void MakeGraph(bool backward, const std::vector<std::vector<const MatrixBase*>>& reads, const std::vector<std::vector<const MatrixBase*>>& writes, Graph& graph);
+    const Graph& GetGraph(const std::vector<ComputationNodeBasePtr>& nodes, bool backward);
+
+    void Push(size_t workerIndex, size_t task);
+    bool Pop(size_t workerIndex, size_t& task);
+    void WorkerLoop(size_t workerIndex);
+    void RunTasks(size_t workerIndex);
+
+    std::map<std::pair<std::vector<ComputationNodeBase*>, bool>, Graph> m_graphs; // [nodes, backward] -> graph
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    int m_numMathThreadsPerWorker;
+    int m_previousNumMathThreads;
+
+    // state of the current Run()
+    const Graph* m_graph;
+    const NodeFunction* m_run;
+    bool m_notifyDone;
+    std::unique_ptr<std::atomic<size_t>[]> m_numPending; // [task] number of predecessors that are not done yet
+    std::atomic<size_t> m_numRemaining;                  // tasks not done yet
+    std::atomic<size_t> m_numQueued;                     // tasks in the workers' queues
+    std::atomic<bool> m_failed;
+
+    std::mutex m_mutex; // protects everything below
+    std::condition_variable m_workAvailable; // for the workers: a new Run(), a queued task, or the end of the Run()
+    std::condition_variable m_callerWakeUp;  // for the caller: a task is done, or all workers have finished
+    bool m_stopping;
+    size_t m_generation;     // number of Run() calls so far
+    size_t m_numBusyWorkers; // workers that have not finished the current Run() yet
+    std::vector<size_t> m_doneTasks; // to be passed to 'done' by the caller
+    std::exception_ptr m_error;
+};
+
+}}}
@@ -341,6 +341,16 @@ public:
     {
     }
 
+    // A product of an [M x K] and a [K x N] matrix takes 2 M K N operations. Since |A| |B| |C| = (M K N)^2, this also
+    // holds for the transposed and the tensor variants.
+    virtual double GetForwardFLOPsEstimate() const override
+    {
+        double numElements0 = (double) InputRef(0).GetSampleMatrixNumRows() * InputRef(0).GetSampleMatrixNumCols();
+        double numElements1 = (double) InputRef(1).GetSampleMatrixNumRows() * InputRef(1).GetSampleMatrixNumCols();
+        double numElements = (double) GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+        return 2 * sqrt(numElements0 * numElements1 * numElements);
+    }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
@@ -427,10 +437,12 @@ private:
 
         for (int i = 0; i < NumInputs; i++)
         {
-            RequestMatrixFromPool(m_tempScatterIndices[i], matrixPool, InputRef(i).GetMBLayout()->GetNumCols(), true);
+            // both scale with the minibatch of the input, not with that of this node, which has the sequence axis reduced
+            const auto& inputMBLayout = InputRef(i).GetMBLayout();
+            RequestMatrixFromPool(m_tempScatterIndices[i], matrixPool, 1, true, false, inputMBLayout);
             const auto& packedData = InputRef(i).Value();
             if (packedData.GetMatrixType() == DENSE)
-                RequestMatrixFromPool(m_tempUnpackedValue[i], matrixPool, InputRef(i).GetSampleLayout().GetNumElements(), true);
+                RequestMatrixFromPool(m_tempUnpackedValue[i], matrixPool, InputRef(i).GetSampleLayout().GetNumElements(), true, false, inputMBLayout);
             else
                 m_tempUnpackedValue[i] = std::make_shared<Matrix<ElemType>>(packedData.GetNumRows(), packedData.GetNumCols(), packedData.GetDeviceId(), packedData.GetMatrixType(), packedData.GetFormat());
         }
@@ -977,6 +989,10 @@ private:
 // 'outputRank' defaults to 1, which is used in the above example.
 // Example for outputRank = 2:
 //  [I x J x K] * [K x L x M x *] = [I x J x L x M x *]
+// With 'quantizedGemm' (or the global 'quantizedGemm' option), dense products with constant weights on the
+// CPU are computed in 16-bit integers by the block multiplier (see QuantizedTimesNode). The weights are
+// quantized once, and again when their eval time stamp changes; this only applies while the network is
+// inferring, and a training pass drops the quantized weights.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -987,15 +1003,65 @@ class TimesNode : public TimesNodeBase<ElemType, false>
     static const std::wstring TypeName() { return L"Times"; }
 
 public:
-    TimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1, int inferInputRankToMap = Base::NoInferredInputRank)
-        : Base(deviceId, name, outputRank, inferInputRankToMap)
+    TimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1, int inferInputRankToMap = Base::NoInferredInputRank, bool quantizedGemm = false)
+        : Base(deviceId, name, outputRank, inferInputRankToMap), m_quantizedGemm(quantizedGemm)
     {
     }
     TimesNode(const ScriptableObjects::IConfigRecordPtr configp)
-        : TimesNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"outputRank"), configp->Get(L"inferInputRankToMap"))
+        : TimesNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"outputRank"), configp->Get(L"inferInputRankToMap"), configp->Get(L"quantizedGemm"))
     {
         AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
     }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<TimesNode<ElemType>>(nodeP);
+            node->m_quantizedGemm = m_quantizedGemm;
+        }
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        if (UseQuantizedGemm())
+        {
+            if (!this->m_pQuantizedMultiplier)
+            {
+                // the inner dimension of the product spans the dimensions of the weights after the first outputRank ones
+                const auto& shape0 = InputRef(0).GetSampleLayout();
+                size_t innerDim = 1;
+                for (size_t i = this->OutputRank(); i < shape0.GetRank(); i++)
+                    innerDim *= shape0[i];
+                size_t bitShift = BlockQuantizedMultiplier<ElemType>::SafeBitShift(innerDim);
+                shared_ptr<SymmetricQuantizer<ElemType, short>> pQA(new SymmetricQuantizer<ElemType, short>(bitShift));
+                shared_ptr<SymmetricQuantizer<ElemType, short>> pQB(new SymmetricQuantizer<ElemType, short>(bitShift));
+                this->m_pQuantizedMultiplier = make_shared<BlockQuantizedMultiplier<ElemType>>(pQA, pQB);
+            }
+            // The weights are quantized again whenever they are written, e.g. by V2 Parameter::SetValue().
+            static_pointer_cast<BlockQuantizedMultiplier<ElemType>>(this->m_pQuantizedMultiplier)->SetVersionOfA(InputRef(0).GetEvalTimeStamp());
+        }
+        else
+            this->m_pQuantizedMultiplier = nullptr;
+
+        Base::ForwardProp(fr);
+    }
+
+    // This is not saved with the model; it is an option of how the model is evaluated.
+    void SetQuantizedGemm(bool quantizedGemm) { m_quantizedGemm = quantizedGemm; }
+    bool QuantizedGemm() const { return m_quantizedGemm; }
+
+private:
+    bool UseQuantizedGemm() const
+    {
+        return (m_quantizedGemm || Globals::ShouldUseQuantizedGemm()) &&
+               m_deviceId == CPUDEVICE &&
+               Environment().IsInferring() &&
+               dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(0)) != nullptr;
+    }
+
+    bool m_quantizedGemm;
 };
 
 template class TimesNode<float>;
@@ -1434,9 +1500,9 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CosDistanceNode<ElemType>>(nodeP);
-            node->m_invNorm0->SetValue(*m_invNorm0);
-            node->m_invNorm1->SetValue(*m_invNorm1);
-            node->m_temp->SetValue(*m_temp);
+            CopyMatrixIfAllocated(m_invNorm0, node->m_invNorm0);
+            CopyMatrixIfAllocated(m_invNorm1, node->m_invNorm1);
+            CopyMatrixIfAllocated(m_temp, node->m_temp);
         }
     }
 
@@ -1749,12 +1815,12 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CosDistanceWithNegativeSamplesNode<ElemType>>(nodeP);
-            node->m_invNorm0->SetValue(*m_invNorm0);
-            node->m_invNorm1->SetValue(*m_invNorm1);
-            node->m_invNormSquare->SetValue(*m_invNormSquare);
-            node->m_leftTerm->SetValue(*m_leftTerm);
-            node->m_rightTerm->SetValue(*m_rightTerm);
-            node->m_temp->SetValue(*m_temp);
+            CopyMatrixIfAllocated(m_invNorm0, node->m_invNorm0);
+            CopyMatrixIfAllocated(m_invNorm1, node->m_invNorm1);
+            CopyMatrixIfAllocated(m_invNormSquare, node->m_invNormSquare);
+            CopyMatrixIfAllocated(m_leftTerm, node->m_leftTerm);
+            CopyMatrixIfAllocated(m_rightTerm, node->m_rightTerm);
+            CopyMatrixIfAllocated(m_temp, node->m_temp);
         }
     }
     // request matrices needed to do node function value evaluation
@@ -11,10 +11,13 @@
 #include <set>
 #include <utility>
 #include <algorithm>
+#include <map>
+#include <tuple>
 #include <stdlib.h>
 
 #include "Basics.h"
 #include "Matrix.h"
+#include "Sequences.h"
 #include "ComputationNode.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -30,12 +33,20 @@ struct MemRequestInfo
     int allocStep;                              // at what step counter memory allocation is requested 
     int releaseStep;                            // at what step counter memory release is requested  
     int memoryId;                               // integer indexing the memory buffer ID 
-    MemRequestInfo(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace, int allocStep)
-        :deviceId(deviceId), pMatrixPtr(pMatrixPtr), matrixSize(matrixSize), mbScale(mbScale), isWorkSpace(isWorkSpace), allocStep(allocStep), releaseStep(INT_MAX), memoryId(-1)
+    MBLayoutPtr pMBLayout;                      // layout whose number of columns determines the actual size of an mbScale request (may be null)
+    size_t plannedNumCols;                      // largest number of minibatch columns seen so far for pMBLayout; the plan is made for this size
+    MemRequestInfo(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace, int allocStep, const MBLayoutPtr& pMBLayout)
+        :deviceId(deviceId), pMatrixPtr(pMatrixPtr), matrixSize(matrixSize), mbScale(mbScale), isWorkSpace(isWorkSpace), allocStep(allocStep), releaseStep(INT_MAX), memoryId(-1), pMBLayout(pMBLayout), plannedNumCols(0)
     {
     }
     void SetReleaseStep(int step) { releaseStep = step; }
     void SetMemoryId(int id) { memoryId = id;  }
+    // number of minibatch columns of the current minibatch, or 0 if it is not known (yet)
+    size_t CurrentNumCols() const { return (mbScale && pMBLayout) ? pMBLayout->GetNumCols() : 0; }
+    // size in elements the plan assumes for this request
+    size_t PlannedSize() const { return (mbScale && plannedNumCols > 0) ? matrixSize * plannedNumCols : matrixSize; }
+    // a request that is never released (e.g. the gradient of a parameter) must keep its matrix across re-planning
+    bool IsPersistent() const { return releaseStep == INT_MAX; }
 };
 
 template <class ElemType>
@@ -43,7 +54,7 @@ struct greater_than_mem_req_size
 {
     inline bool operator() (const MemRequestInfo<ElemType>& info1, const MemRequestInfo<ElemType>& info2)
     {
-        return (info1.matrixSize > info2.matrixSize);
+        return (info1.PlannedSize() > info2.PlannedSize());
     }
 };
 
@@ -58,6 +69,20 @@ struct MemAllocInfo
     }
 };
 
+// statistics of the memory-sharing plan for one device, in bytes
+struct MemoryPlanStats
+{
+    size_t numRequests = 0;
+    size_t numBuffers = 0;     // number of distinct matrices after sharing
+    size_t requestedBytes = 0; // memory needed without any sharing
+    size_t allocatedBytes = 0; // memory needed by the shared matrices (each as large as its largest user)
+    size_t peakLiveBytes = 0;  // largest amount of memory that is live at any one step; no sharing scheme can do better
+    size_t arenaBytes = 0;     // size of a single buffer into which all requests are packed at fixed offsets
+
+    // fraction of the allocated memory that is not needed at the peak
+    double Fragmentation() const { return allocatedBytes == 0 ? 0.0 : 1.0 - (double) peakLiveBytes / allocatedBytes; }
+};
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
@@ -68,6 +93,9 @@ class MatrixPool
     set<DEVICEID_TYPE> m_deviceIDSet; 
     int m_stepCounter; 
 
+    // lifetime [allocStep, releaseStep] and size in bytes of one request
+    typedef tuple<int, int, size_t> MemInterval;
+
     template <class ElemType>
     vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec(); 
 
@@ -94,13 +122,14 @@ public:
     // memories will have their own pool. This is a design proven to be useful for the workspace memory in convolution. 
     // matrixSize is an estimate of the required memory to be allocated. Note we don't allocate any memory at the time of request. Instead, a 
     // global memory allocation optimziation is run to improve memory efficiency 
-    // mbScale is another flag indicating if the size of the memory will scale w.r.t. the minibatch size. Unfortunately, at the time of memory
-    // request and pointer assignment, we don't known the minibatch size. Thus our memory sharing algorithm is sub-optimal. 
+    // mbScale is another flag indicating if the size of the memory will scale w.r.t. the minibatch size. At the time of memory request and
+    // pointer assignment, we don't know the minibatch size yet. For mbScale requests, matrixSize is therefore the per-column size, and
+    // pMBLayout is remembered so that the plan can be redone once the actual minibatch dimensions are known (see NeedsReplanning()).
     template <class ElemType>
-    void RequestAllocate(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace)
+    void RequestAllocate(DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>*pMatrixPtr, size_t matrixSize, bool mbScale, bool isWorkSpace, const MBLayoutPtr& pMBLayout = nullptr)
     {
         vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>(); 
-        MemRequestInfo<ElemType> memInfo(deviceId, pMatrixPtr, matrixSize, mbScale, isWorkSpace, m_stepCounter);
+        MemRequestInfo<ElemType> memInfo(deviceId, pMatrixPtr, matrixSize, mbScale, isWorkSpace, m_stepCounter, pMBLayout);
         memInfoVec.push_back(memInfo); 
         m_deviceIDSet.insert(deviceId); 
         m_stepCounter++; 
@@ -117,8 +146,119 @@ public:
         return; 
     }
 
+    // The plan is made for the largest minibatch seen so far. Returns true if the current minibatch has more columns
+    // than that for any request, in which case OptimizedMemoryAllocation() should be run again before the next ForwardProp.
+    bool NeedsReplanning() const
+    {
+        return NeedsReplanningFunc(m_memRequestInfoFloatVec) || NeedsReplanningFunc(m_memRequestInfoDoubleVec);
+    }
+
+    // statistics of the current plan, per device
+    map<DEVICEID_TYPE, MemoryPlanStats> GetPlanStats() const
+    {
+        map<DEVICEID_TYPE, MemoryPlanStats> statsMap;
+        for (auto devId : m_deviceIDSet)
+        {
+            MemoryPlanStats& stats = statsMap[devId];
+            vector<MemInterval> intervals;
+            CollectPlanStats(m_memRequestInfoFloatVec, devId, stats, intervals);
+            CollectPlanStats(m_memRequestInfoDoubleVec, devId, stats, intervals);
+            stats.peakLiveBytes = ComputePeakLiveBytes(intervals);
+            stats.arenaBytes = ComputeArenaBytes(intervals);
+        }
+        return statsMap;
+    }
+
 private: 
-    bool CheckOverlap(pair<int, int>occ, vector<pair<int, int>>&occVec)
+    template <class ElemType>
+    static bool NeedsReplanningFunc(const vector<MemRequestInfo<ElemType>>& memInfoVec)
+    {
+        for (const auto& memInfo : memInfoVec)
+        {
+            if (memInfo.CurrentNumCols() > memInfo.plannedNumCols)
+                return true;
+        }
+        return false;
+    }
+
+    template <class ElemType>
+    static void CollectPlanStats(const vector<MemRequestInfo<ElemType>>& memInfoVec, DEVICEID_TYPE devId, MemoryPlanStats& stats, vector<MemInterval>& intervals)
+    {
+        // memory ids are only unique per workspace flag
+        map<pair<bool, int>, size_t> bufferBytes;
+        for (const auto& memInfo : memInfoVec)
+        {
+            if (memInfo.deviceId != devId || memInfo.memoryId < 0)
+                continue;
+            size_t bytes = memInfo.PlannedSize() * sizeof(ElemType);
+            stats.numRequests++;
+            stats.requestedBytes += bytes;
+            size_t& buffer = bufferBytes[make_pair(memInfo.isWorkSpace, memInfo.memoryId)];
+            buffer = max(buffer, bytes);
+            intervals.push_back(MemInterval(memInfo.allocStep, memInfo.releaseStep, bytes));
+        }
+        stats.numBuffers += bufferBytes.size();
+        for (const auto& buffer : bufferBytes)
+            stats.allocatedBytes += buffer.second;
+    }
+
+    static size_t ComputePeakLiveBytes(const vector<MemInterval>& intervals)
+    {
+        // a request occupies its memory from allocStep through releaseStep inclusively (cf. CheckOverlap())
+        vector<pair<int, long long>> events;
+        for (const auto& interval : intervals)
+        {
+            events.push_back(make_pair(get<0>(interval), (long long) get<2>(interval)));
+            if (get<1>(interval) != INT_MAX)
+                events.push_back(make_pair(get<1>(interval) + 1, -(long long) get<2>(interval)));
+        }
+        sort(events.begin(), events.end()); // at equal steps, releases (negative) come before allocations
+        long long live = 0;
+        long long peak = 0;
+        for (const auto& event : events)
+        {
+            live += event.second;
+            peak = max(peak, live);
+        }
+        return (size_t) peak;
+    }
+
+    // Packs all requests into one buffer (largest first, each at the lowest offset that does not collide with a request
+    // of overlapping lifetime). Unlike matrix-level sharing, this lets a large buffer be reused by several smaller ones at once.
+    // Pooled matrices must remain individually resizable, so this is not used for the actual allocation, but it tells how
+    // close the matrix-level sharing comes to what is achievable.
+    size_t ComputeArenaBytes(vector<MemInterval> intervals) const
+    {
+        sort(intervals.begin(), intervals.end(), [](const MemInterval& a, const MemInterval& b)
+        {
+            return get<2>(a) > get<2>(b);
+        });
+        vector<pair<size_t, size_t>> placedRanges(intervals.size()); // [offset, offset + size) of each placed request
+        size_t arenaBytes = 0;
+        for (size_t i = 0; i < intervals.size(); i++)
+        {
+            vector<pair<size_t, size_t>> conflicts;
+            vector<pair<int, int>> occ(1, make_pair(get<0>(intervals[i]), get<1>(intervals[i])));
+            for (size_t j = 0; j < i; j++)
+            {
+                if (CheckOverlap(make_pair(get<0>(intervals[j]), get<1>(intervals[j])), occ))
+                    conflicts.push_back(placedRanges[j]);
+            }
+            sort(conflicts.begin(), conflicts.end());
+            size_t offset = 0;
+            for (const auto& range : conflicts)
+            {
+                if (range.first >= offset + get<2>(intervals[i]))
+                    break; // fits into the gap before this range
+                offset = max(offset, range.second);
+            }
+            placedRanges[i] = make_pair(offset, offset + get<2>(intervals[i]));
+            arenaBytes = max(arenaBytes, placedRanges[i].second);
+        }
+        return arenaBytes;
+    }
+
+    bool CheckOverlap(pair<int, int>occ, const vector<pair<int, int>>&occVec) const
     {
         bool bRet = false;
         for (auto& o : occVec)
@@ -148,13 +288,17 @@ private:
         for (auto iter = memInfoVec.begin(); iter != memInfoVec.end(); )
         {
             if ((*(iter->pMatrixPtr))->GetMatrixType() == SPARSE)
-                memInfoVec.erase(iter);
+                iter = memInfoVec.erase(iter);
             else
                 iter++; 
         }
 
-        // sort the memory request from largest size to smallest 
-        std::sort(memInfoVec.begin(), memInfoVec.end(), greater_than_mem_req_size<ElemType>());
+        // size the minibatch-dependent requests for the largest minibatch seen so far
+        for (auto& memInfo : memInfoVec)
+            memInfo.plannedNumCols = max(memInfo.plannedNumCols, memInfo.CurrentNumCols());
+
+        // sort the memory request from largest size to smallest (stable, so that re-planning with unchanged sizes gives the same plan)
+        std::stable_sort(memInfoVec.begin(), memInfoVec.end(), greater_than_mem_req_size<ElemType>());
 
         std::vector<bool> workspaceFlagVec = {true, false};
         for (auto& devId : m_deviceIDSet)
@@ -183,7 +327,7 @@ private:
                             // no current memory can be assigned, need to create a new one 
                             vector<pair<int, int>> occ;
                             occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                            MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                            MemAllocInfo ma(memoryCounter, memInfo.PlannedSize(), occ);
                             // insert in the front of the vector to maintain sorted order 
                             memAllocInfoVec.insert(memAllocInfoVec.begin(), ma);
                             memInfo.SetMemoryId(memoryCounter);
@@ -199,7 +343,7 @@ private:
                     {
                         vector<pair<int, int>> occ;
                         occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                        MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                        MemAllocInfo ma(memoryCounter, memInfo.PlannedSize(), occ);
                         memAllocInfoVec.push_back(ma);
                         memInfo.SetMemoryId(memoryCounter);
                         memoryCounter++;
@@ -226,7 +370,7 @@ private:
                         {
                             vector<pair<int, int>> occ;
                             occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                            MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                            MemAllocInfo ma(memoryCounter, memInfo.PlannedSize(), occ);
                             memAllocInfoVec.push_back(ma);  // add as the last one 
                             memInfo.SetMemoryId(memoryCounter);
                             memoryCounter++;
@@ -241,7 +385,7 @@ private:
                     {
                         vector<pair<int, int>> occ;
                         occ.push_back(make_pair(memInfo.allocStep, memInfo.releaseStep));
-                        MemAllocInfo ma(memoryCounter, memInfo.matrixSize, occ);
+                        MemAllocInfo ma(memoryCounter, memInfo.PlannedSize(), occ);
                         memAllocInfoVec.push_back(ma);
                         memInfo.SetMemoryId(memoryCounter);
                         memoryCounter++;
@@ -251,7 +395,17 @@ private:
                 // now assign the actual pointers 
                 for (int i = 0; i < memoryCounter; i++)
                 {
-                    auto matrixPtr = make_shared<Matrix<ElemType>>(devId);
+                    // If the buffer has a persistent user, keep that user's current matrix, so that re-planning does not swap out
+                    // e.g. a parameter gradient from under the code that holds on to it. Two persistent requests always overlap,
+                    // so there is at most one per buffer.
+                    shared_ptr<Matrix<ElemType>> matrixPtr;
+                    for (auto& memInfo : memInfoVec)
+                    {
+                        if (memInfo.deviceId == devId && memInfo.isWorkSpace == wsFlag && memInfo.memoryId == i && memInfo.IsPersistent())
+                            matrixPtr = *memInfo.pMatrixPtr;
+                    }
+                    if (!matrixPtr)
+                        matrixPtr = make_shared<Matrix<ElemType>>(devId);
                     if (!matrixPtr) // this can't really happen, because we haven't started allocating memory yet
                         LogicError("MatrixPool: failed to get a valid matrix.");
                     for (auto& memInfo : memInfoVec)
@@ -0,0 +1,258 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "NodeProfiler.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static double NumElements(const ComputationNodeBasePtr& node)
+{
+    return (double) node->GetSampleMatrixNumRows() * node->GetSampleMatrixNumCols();
+}
+
+static size_t ElementSize(const ComputationNodeBasePtr& node)
+{
+    if (dynamic_pointer_cast<ComputationNode<float>>(node))
+        return sizeof(float);
+    if (dynamic_pointer_cast<ComputationNode<double>>(node))
+        return sizeof(double);
+    return 0;
+}
+
+// Estimates the floating-point operations of ForwardProp() (or Backprop()) of a node, and the bytes of the matrices
+// it reads and writes, with all matrices taken as dense. For Backprop(), every input that needs a gradient is
+// assumed to cost as much as the forward computation, reading the output gradient and the input value and updating
+// the input gradient.
+static void EstimateWork(const ComputationNodeBasePtr& node, bool backward, double& flops, double& bytes)
+{
+    flops = 0;
+    bytes = 0;
+    auto flowControlNode = dynamic_pointer_cast<FlowControlNode>(node);
+    if (flowControlNode)
+    {
+        for (const auto& nestedNode : flowControlNode->m_nestedNodes)
+        {
+            double nestedFLOPs, nestedBytes;
+            EstimateWork(nestedNode, backward, nestedFLOPs, nestedBytes);
+            flops += nestedFLOPs;
+            bytes += nestedBytes;
+        }
+        return;
+    }
+
+    double forwardFLOPs = node->GetForwardFLOPsEstimate();
+    double numElements = NumElements(node);
+    if (!backward)
+    {
+        flops = forwardFLOPs;
+        bytes = numElements;
+        for (const auto& input : node->GetInputs())
+            bytes += NumElements(input);
+    }
+    else
+    {
+        for (const auto& input : node->GetInputs())
+        {
+            if (!input->NeedsGradient())
+                continue;
+            flops += forwardFLOPs;
+            bytes += numElements + 2 * NumElements(input);
+        }
+    }
+    bytes *= ElementSize(node);
+}
+
+static string JsonString(const wstring& s)
+{
+    string result = "\"";
+    for (char c : string(msra::strfun::utf8(s)))
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char) c < 0x20)
+            result += msra::strfun::strprintf("\\u%04x", (int) c);
+        else
+            result += c;
+    }
+    return result + "\"";
+}
+
+NodeProfiler::NodeProfiler(size_t maxTraceEvents)
+    : m_enabled(true), m_maxTraceEvents(maxTraceEvents)
+{
+    Reset();
+}
+
+void NodeProfiler::Reset()
+{
+    m_origin = Clock::now();
+    m_nodes.clear();
+    m_nodeIndex.clear();
+    m_traceEvents.clear();
+    m_numDroppedTraceEvents = 0;
+    m_threadIndex.clear();
+}
+
+void NodeProfiler::Record(const ComputationNodeBasePtr& node, bool backward, Clock::time_point start)
+{
+    auto end = Clock::now();
+    if (!m_enabled)
+        return;
+
+    lock_guard<mutex> lock(m_mutex);
+    auto iter = m_nodeIndex.find(node->NodeName());
+    size_t index;
+    if (iter != m_nodeIndex.end())
+        index = iter->second;
+    else
+    {
+        index = m_nodes.size();
+        m_nodes.push_back(NodeInfo());
+        m_nodes.back().nodeName = node->NodeName();
+        m_nodes.back().operationName = node->OperationName();
+        m_nodeIndex[node->NodeName()] = index;
+    }
+
+    auto& info = m_nodes[index];
+    double seconds = chrono::duration<double>(end - start).count();
+    double flops, bytes;
+    EstimateWork(node, backward, flops, bytes);
+    if (backward)
+    {
+        info.statistics.backwardCount++;
+        info.statistics.backwardSeconds += seconds;
+    }
+    else
+    {
+        info.statistics.forwardCount++;
+        info.statistics.forwardSeconds += seconds;
+        if (!dynamic_pointer_cast<FlowControlNode>(node))
+        {
+            info.numRows = node->GetSampleMatrixNumRows();
+            info.numCols = node->GetSampleMatrixNumCols();
+            info.maxNumElements = max(info.maxNumElements, info.numRows * info.numCols);
+        }
+    }
+    info.statistics.flops += flops;
+    info.statistics.bytes += bytes;
+
+    if (m_traceEvents.size() < m_maxTraceEvents)
+    {
+        TraceEvent event;
+        event.nodeIndex = index;
+        event.backward = backward;
+        event.startMicroseconds = chrono::duration<double, micro>(start - m_origin).count();
+        event.durationMicroseconds = seconds * 1e6;
+        event.flops = flops;
+        auto threadIter = m_threadIndex.find(this_thread::get_id());
+        if (threadIter == m_threadIndex.end())
+            threadIter = m_threadIndex.insert(make_pair(this_thread::get_id(), m_threadIndex.size())).first;
+        event.threadIndex = threadIter->second;
+        m_traceEvents.push_back(event);
+    }
+    else
+        m_numDroppedTraceEvents++;
+}
+
+void NodeProfiler::Statistics::Add(const Statistics& other)
+{
+    forwardCount += other.forwardCount;
+    backwardCount += other.backwardCount;
+    forwardSeconds += other.forwardSeconds;
+    backwardSeconds += other.backwardSeconds;
+    flops += other.flops;
+    bytes += other.bytes;
+}
+
+void NodeProfiler::WriteTableRow(FILE* f, const wstring& name, const wstring& operationName, const Statistics& statistics, double totalSeconds, const string& dims) const
+{
+    double seconds = statistics.TotalSeconds();
+    fprintf(f, "%10.2f %6.2f%% %10.2f %10.2f %8d %8d %10.3f %8.2f %10.1f  %-24s %-28ls %ls\n",
+            seconds * 1e3, totalSeconds > 0 ? 100 * seconds / totalSeconds : 0.0,
+            statistics.forwardSeconds * 1e3, statistics.backwardSeconds * 1e3,
+            (int) statistics.forwardCount, (int) statistics.backwardCount,
+            statistics.flops * 1e-9, seconds > 0 ? statistics.flops * 1e-9 / seconds : 0.0,
+            statistics.bytes / (1024 * 1024),
+            dims.c_str(), operationName.c_str(), name.c_str());
+}
+
+void NodeProfiler::WriteTable(FILE* f) const
+{
+    Statistics total;
+    for (const auto& info : m_nodes)
+        total.Add(info.statistics);
+    double totalSeconds = total.TotalSeconds();
+
+    fprintf(f, "\nNode profile: %.3f s in %d nodes, %.3f s forward, %.3f s backward.\n",
+            totalSeconds, (int) m_nodes.size(), total.forwardSeconds, total.backwardSeconds);
+    const char* header = "  total ms   total     fwd ms     bwd ms     #fwd     #bwd     GFLOP  GFLOP/s    MB touched";
+
+    // per node, by total time
+    vector<size_t> order(m_nodes.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [this](size_t a, size_t b) { return m_nodes[a].statistics.TotalSeconds() > m_nodes[b].statistics.TotalSeconds(); });
+    fprintf(f, "\n%s  %-24s %-28s %s\n", header, "output (max elements)", "operation", "node");
+    for (size_t i : order)
+    {
+        const auto& info = m_nodes[i];
+        string dims = info.maxNumElements > 0 ? msra::strfun::strprintf("%d x %d (%d)", (int) info.numRows, (int) info.numCols, (int) info.maxNumElements) : string("-");
+        WriteTableRow(f, info.nodeName, info.operationName, info.statistics, totalSeconds, dims);
+    }
+
+    // per operation, by total time
+    map<wstring, pair<Statistics, size_t>> operations;
+    for (const auto& info : m_nodes)
+    {
+        auto& operation = operations[info.operationName];
+        operation.first.Add(info.statistics);
+        operation.second++;
+    }
+    vector<pair<wstring, pair<Statistics, size_t>>> sortedOperations(operations.begin(), operations.end());
+    sort(sortedOperations.begin(), sortedOperations.end(), [](const pair<wstring, pair<Statistics, size_t>>& a, const pair<wstring, pair<Statistics, size_t>>& b)
+    {
+        return a.second.first.TotalSeconds() > b.second.first.TotalSeconds();
+    });
+    fprintf(f, "\n%s  %-24s %-28s\n", header, "nodes", "operation");
+    for (const auto& operation : sortedOperations)
+        WriteTableRow(f, L"", operation.first, operation.second.first, totalSeconds, msra::strfun::strprintf("%d", (int) operation.second.second));
+
+    if (m_numDroppedTraceEvents > 0)
+        fprintf(f, "\n%d node evaluations did not fit into the trace.\n", (int) m_numDroppedTraceEvents);
+    fprintf(f, "\n");
+}
+
+void NodeProfiler::WriteChromeTrace(const wstring& fileName) const
+{
+    FILE* f = fopenOrDie(fileName, L"w");
+    fprintfOrDie(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    vector<string> names(m_nodes.size());
+    vector<string> operationNames(m_nodes.size());
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        names[i] = JsonString(m_nodes[i].nodeName);
+        operationNames[i] = JsonString(m_nodes[i].operationName);
+    }
+    for (size_t i = 0; i < m_traceEvents.size(); i++)
+    {
+        const auto& event = m_traceEvents[i];
+        fprintfOrDie(f, "{\"name\":%s,\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"operation\":%s,\"flops\":%.0f}}%s\n",
+                     names[event.nodeIndex].c_str(), event.backward ? "backward" : "forward", (int) event.threadIndex, event.startMicroseconds, event.durationMicroseconds,
+                     operationNames[event.nodeIndex].c_str(), event.flops, i + 1 < m_traceEvents.size() ? "," : "");
+    }
+    fprintfOrDie(f, "]}\n");
+    fflushOrDie(f);
+    fcloseOrDie(f);
+}
+
+}}}
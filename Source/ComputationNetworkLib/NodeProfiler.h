@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NodeProfiler.h -- per-node timing of forward and backward propagation
+//
+
+#pragma once
+
+#include "ComputationNode.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Measures the time that ComputationNetwork spends in every node during ForwardProp() and Backprop(), and
+// estimates the floating-point operations and the bytes of the matrices touched by each of them. The numbers are
+// accumulated over all minibatches, and can be printed as a table per node and per operation, or written as a
+// trace in the Chrome trace event format (chrome://tracing) that shows every single node evaluation.
+//
+// A recurrent loop is measured as a whole, under the name of its SEQTraversalFlowControlNode ("Loop_...").
+// On the GPU, the times are only meaningful if kernels are executed synchronously (SyncGuard::EnableSync()).
+//
+// To use it, set it as the nodeProfiler of the network's ComputationEnvironment. Only evaluations in the training mode
+// (NetworkOperationMode::training) are recorded; precomputation and validation passes are not. Nodes that are evaluated
+// concurrently (cf. InterOpScheduler) appear on separate threads of the trace.
+class NodeProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // At most 'maxTraceEvents' evaluations are kept for the trace; the statistics are always complete.
+    NodeProfiler(size_t maxTraceEvents = 1000000);
+
+    void Enable(bool enable) { m_enabled = enable; }
+    bool IsEnabled() const { return m_enabled; }
+
+    // Records that 'node' ran ForwardProp() (or Backprop() if 'backward') from 'start' until now.
+    void Record(const ComputationNodeBasePtr& node, bool backward, Clock::time_point start);
+
+    // Discards everything recorded so far.
+    void Reset();
+
+    // Prints the statistics per node, sorted by total time, followed by the statistics per operation.
+    void WriteTable(FILE* f) const;
+
+    // Writes the recorded evaluations as a JSON trace in the Chrome trace event format.
+    void WriteChromeTrace(const std::wstring& fileName) const;
+
+private:
+    struct Statistics
+    {
+        size_t forwardCount = 0;
+        size_t backwardCount = 0;
+        double forwardSeconds = 0;
+        double backwardSeconds = 0;
+        double flops = 0;
+        double bytes = 0;
+        double TotalSeconds() const { return forwardSeconds + backwardSeconds; }
+        void Add(const Statistics& other);
+    };
+
+    struct NodeInfo
+    {
+        std::wstring nodeName;
+        std::wstring operationName;
+        Statistics statistics;
+        size_t numRows = 0; // of the value at the last evaluation
+        size_t numCols = 0;
+        size_t maxNumElements = 0;
+    };
+
+    struct TraceEvent
+    {
+        size_t nodeIndex;
+        bool backward;
+        double startMicroseconds; // since the construction of the profiler
+        double durationMicroseconds;
+        double flops;
+        size_t threadIndex;
+    };
+
+    void WriteTableRow(FILE* f, const std::wstring& name, const std::wstring& operationName, const Statistics& statistics, double totalSeconds, const std::string& dims) const;
+
+    bool m_enabled;
+    Clock::time_point m_origin;
+    std::vector<NodeInfo> m_nodes;
+    std::unordered_map<std::wstring, size_t> m_nodeIndex; // node name -> index into m_nodes
+    std::vector<TraceEvent> m_traceEvents;
+    size_t m_maxTraceEvents;
+    size_t m_numDroppedTraceEvents;
+    std::unordered_map<std::thread::id, size_t> m_threadIndex; // thread -> tid in the trace
+
+    std::mutex m_mutex; // Record() may be called by several threads at once
+};
+
+}}}
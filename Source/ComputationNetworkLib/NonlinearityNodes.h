@@ -227,7 +227,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<SoftmaxNodeBase<ElemType>>(nodeP);
-            node->m_gradientTemp->SetValue(*m_gradientTemp);
+            CopyMatrixIfAllocated(m_gradientTemp, node->m_gradientTemp);
         }
     }
 
@@ -299,7 +299,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<SoftmaxNode<ElemType>>(nodeP);
-            node->m_diff->SetValue(*m_diff);
+            CopyMatrixIfAllocated(m_diff, node->m_diff);
         }
     }
     // request matrices that are needed for gradient computation
@@ -366,7 +366,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LogSoftmaxNode<ElemType>>(nodeP);
-            node->m_softmax->SetValue(*m_softmax);
+            CopyMatrixIfAllocated(m_softmax, node->m_softmax);
         }
     }
     // request matrices that are needed for gradient computation
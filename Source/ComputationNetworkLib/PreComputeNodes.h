@@ -348,9 +348,9 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<InvStdDevNode<ElemType>>(nodeP);
-            node->m_mean->SetValue(*m_mean);
-            node->m_var ->SetValue(*m_var);
-            node->m_temp->SetValue(*m_temp);
+            CopyMatrixIfAllocated(m_mean, node->m_mean);
+            CopyMatrixIfAllocated(m_var, node->m_var);
+            CopyMatrixIfAllocated(m_temp, node->m_temp);
         }
     }
 
@@ -594,9 +594,9 @@ public:
         {
             auto node = dynamic_pointer_cast<SequenceWithSoftmaxNode<ElemType>>(nodeP);
 
-            node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-            node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
-            node->m_gammaFromLattice->SetValue(*m_gammaFromLattice);
+            CopyMatrixIfAllocated(m_logSoftmaxOfRight, node->m_logSoftmaxOfRight);
+            CopyMatrixIfAllocated(m_softmaxOfRight, node->m_softmaxOfRight);
+            CopyMatrixIfAllocated(m_gammaFromLattice, node->m_gammaFromLattice);
             node->m_fsSmoothingWeight = m_fsSmoothingWeight;
             node->m_frameDropThreshold = m_frameDropThreshold;
             node->m_doReferenceAlignment = m_doReferenceAlignment;
@@ -902,11 +902,11 @@ public:
         {
             auto node = dynamic_pointer_cast<ForwardBackwardNode<ElemType>>(nodeP);
 
-            node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-            node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
-            node->m_CTCposterior->SetValue(*m_CTCposterior);
-            node->m_maxIndexes->SetValue(*m_maxIndexes);
-            node->m_maxValues->SetValue(*m_maxValues);
+            CopyMatrixIfAllocated(m_logSoftmaxOfRight, node->m_logSoftmaxOfRight);
+            CopyMatrixIfAllocated(m_softmaxOfRight, node->m_softmaxOfRight);
+            CopyMatrixIfAllocated(m_CTCposterior, node->m_CTCposterior);
+            CopyMatrixIfAllocated(m_maxIndexes, node->m_maxIndexes);
+            CopyMatrixIfAllocated(m_maxValues, node->m_maxValues);
             node->m_delayConstraint = m_delayConstraint;
         }
     }
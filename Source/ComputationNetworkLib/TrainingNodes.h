@@ -86,7 +86,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<SquareErrorNode<ElemType>>(nodeP);
-            node->m_leftMinusRight->SetValue(*m_leftMinusRight);
+            CopyMatrixIfAllocated(m_leftMinusRight, node->m_leftMinusRight);
         }
     }
 
@@ -212,8 +212,8 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
-            node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-            node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
+            CopyMatrixIfAllocated(m_logSoftmaxOfRight, node->m_logSoftmaxOfRight);
+            CopyMatrixIfAllocated(m_softmaxOfRight, node->m_softmaxOfRight);
         }
     }
 
@@ -333,10 +333,10 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyNode<ElemType>>(nodeP);
-            node->m_logOfRight->SetValue(*m_logOfRight);
+            CopyMatrixIfAllocated(m_logOfRight, node->m_logOfRight);
             if (m_leftDivRight != nullptr)
             {
-                node->m_leftDivRight->SetValue(*m_leftDivRight);
+                CopyMatrixIfAllocated(m_leftDivRight, node->m_leftDivRight);
             }
         }
     }
@@ -437,7 +437,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<MatrixL1RegNode<ElemType>>(nodeP);
-            node->m_gradientOfL1Norm->SetValue(*m_gradientOfL1Norm);
+            CopyMatrixIfAllocated(m_gradientOfL1Norm, node->m_gradientOfL1Norm);
         }
     }
 
@@ -749,13 +749,13 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LambdaRankNode<ElemType>>(nodeP);
-            node->m_pairwiseDifferences->SetValue(*m_pairwiseDifferences);
-            node->m_lambdas->SetValue(*m_lambdas);
-            node->m_weightUpdate->SetValue(*m_weightUpdate);
-            node->m_urlGain0->SetValue(*m_urlGain0);
-            node->m_urlGain1->SetValue(*m_urlGain1);
-            node->m_urlDiscount0->SetValue(*m_urlDiscount0);
-            node->m_urlDiscount1->SetValue(*m_urlDiscount1);
+            CopyMatrixIfAllocated(m_pairwiseDifferences, node->m_pairwiseDifferences);
+            CopyMatrixIfAllocated(m_lambdas, node->m_lambdas);
+            CopyMatrixIfAllocated(m_weightUpdate, node->m_weightUpdate);
+            CopyMatrixIfAllocated(m_urlGain0, node->m_urlGain0);
+            CopyMatrixIfAllocated(m_urlGain1, node->m_urlGain1);
+            CopyMatrixIfAllocated(m_urlDiscount0, node->m_urlDiscount0);
+            CopyMatrixIfAllocated(m_urlDiscount1, node->m_urlDiscount1);
 
             node->m_queryUrls = m_queryUrls;
             node->m_urlSorter = m_urlSorter;
@@ -2177,10 +2177,10 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<LogisticNode<ElemType>>(nodeP);
-            node->m_classZeroLabels->SetValue(*m_classZeroLabels);
-            node->m_result->SetValue(*m_result);
-            node->m_temp->SetValue(*m_temp);
-            node->m_sumOfWeights->SetValue(*m_sumOfWeights);
+            CopyMatrixIfAllocated(m_classZeroLabels, node->m_classZeroLabels);
+            CopyMatrixIfAllocated(m_result, node->m_result);
+            CopyMatrixIfAllocated(m_temp, node->m_temp);
+            CopyMatrixIfAllocated(m_sumOfWeights, node->m_sumOfWeights);
         }
     }
 
@@ -29,6 +29,12 @@
 #include "latticearchive.h"
 #include <limits>
 #include "RecurrentNodes.h"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -41,6 +47,8 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
 
     Globals::SetShareNodeValueMatrices(m_config(L"shareNodeValueMatrices", true));
+    Globals::SetQuantizedGemm(m_config(L"quantizedGemm", false));
+    Globals::SetFastCpuConvolution(m_config(L"fastCpuConvolution", false));
 }
 
 
@@ -459,4 +467,193 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
 
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
+
+// ----------------------------------------------------------------------------
+// Extended interface, evaluated by a pool of worker threads
+// ----------------------------------------------------------------------------
+
+// Restricts the calling thread, and the OpenMP threads it creates later, to the logical processors
+// [firstCore, firstCore + numCores). This is a hint only; failures are ignored.
+static void PinCurrentThread(size_t firstCore, size_t numCores)
+{
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (size_t i = 0; i < numCores; i++)
+        mask |= (DWORD_PTR)1 << ((firstCore + i) % (8 * sizeof(DWORD_PTR)));
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (size_t i = 0; i < numCores; i++)
+        CPU_SET((firstCore + i) % CPU_SETSIZE, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::Init(const std::string& config)
+{
+    CNTKEvalBase<ElemType>::Init(config);
+
+    int numCPUThreads = this->m_config("numCPUThreads", "1");
+    m_numCPUThreads = std::max(1, CPUMatrix<ElemType>::SetNumThreads(numCPUThreads));
+    m_numWorkers = this->m_config("numEvalWorkers", "0");
+    if (m_numWorkers == 0)
+        m_numWorkers = std::max<size_t>(1, std::thread::hardware_concurrency() / m_numCPUThreads);
+    m_pinWorkers = this->m_config(L"pinEvalWorkers", false);
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::CreateNetwork(const std::string& networkDescription)
+{
+    CNTKEvalBase<ElemType>::CreateNetwork(networkDescription);
+    m_workers.clear();
+    m_workers.emplace_back(new CNTKEvalExtended<ElemType>(this->m_net));
+}
+
+template <typename ElemType>
+VariableSchema CNTKEvalExtendedPool<ElemType>::GetOutputSchema() const
+{
+    if (m_workers.empty())
+        RuntimeError("GetOutputSchema() called before CreateNetwork()");
+    return m_workers[0]->GetOutputSchema();
+}
+
+template <typename ElemType>
+VariableSchema CNTKEvalExtendedPool<ElemType>::GetInputSchema() const
+{
+    if (m_workers.empty())
+        RuntimeError("GetInputSchema() called before CreateNetwork()");
+    return m_workers[0]->GetInputSchema();
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
+{
+    if (m_workers.empty())
+        RuntimeError("StartForwardEvaluation() called before CreateNetwork()");
+    if (!m_threads.empty())
+        RuntimeError("StartForwardEvaluation() can only be called once.");
+
+    // The copies must be made before the loaded network allocates its activations, which they do not need.
+    for (size_t i = 1; i < m_numWorkers; i++)
+        m_workers.emplace_back(new CNTKEvalExtended<ElemType>(this->m_net->CloneSharingParameters()));
+    for (auto& worker : m_workers)
+        worker->StartForwardEvaluation(outputNodeNames);
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+        m_threads.emplace_back(&CNTKEvalExtendedPool<ElemType>::WorkerLoop, this, i);
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::WorkerLoop(size_t workerIndex)
+{
+    if (m_pinWorkers)
+        PinCurrentThread(workerIndex * m_numCPUThreads, m_numCPUThreads);
+    // the OpenMP thread count is per thread
+    CPUMatrix<ElemType>::SetNumThreads(m_numCPUThreads);
+
+    auto& eval = *m_workers[workerIndex];
+    for (;;)
+    {
+        Request* request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_requestAvailable.wait(lock, [this] { return m_stopping || !m_requests.empty(); });
+            if (m_requests.empty()) // stopping, and nothing left to do
+                return;
+            request = m_requests.front();
+            m_requests.pop_front();
+        }
+
+        try
+        {
+            request->m_work(eval);
+            request->m_done.set_value();
+        }
+        catch (...)
+        {
+            request->m_done.set_exception(std::current_exception());
+        }
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::Submit(const Work& work, bool resetRNN)
+{
+    if (m_threads.empty())
+        RuntimeError("ForwardPass() called before StartForwardEvaluation()");
+    if (!resetRNN && m_workers.size() > 1)
+        InvalidArgument("ForwardPass() without resetting the recurrent state requires a single worker (numEvalWorkers=1).");
+
+    Request request;
+    request.m_work = work;
+    auto done = request.m_done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.push_back(&request);
+    }
+    m_requestAvailable.notify_one();
+    done.get(); // rethrows what the worker caught
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs)
+{
+    ForwardPass(inputs, outputs, true);
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs, bool resetRNN)
+{
+    Submit([&](CNTKEvalExtended<ElemType>& eval) { eval.ForwardPass(inputs, outputs, resetRNN); }, resetRNN);
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs)
+{
+    ForwardPass(inputs, outputs, true);
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs, bool resetRNN)
+{
+    Submit([&](CNTKEvalExtended<ElemType>& eval) { eval.ForwardPass(inputs, outputs, resetRNN); }, resetRNN);
+}
+
+template <typename ElemType>
+void CNTKEvalExtendedPool<ElemType>::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_requestAvailable.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+
+    // the workers hold on to their networks, including m_net
+    m_workers.clear();
+    CNTKEvalBase<ElemType>::Destroy();
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalExtendedPool(IEvaluateModelExtended<ElemType>** peval)
+{
+    *peval = new CNTKEvalExtendedPool<ElemType>();
+}
+
+extern "C" EVAL_API void GetEvalExtendedPoolF(IEvaluateModelExtended<float>** peval)
+{
+    GetEvalExtendedPool(peval);
+}
+extern "C" EVAL_API void GetEvalExtendedPoolD(IEvaluateModelExtended<double>** peval)
+{
+    GetEvalExtendedPool(peval);
+}
+
+template class CNTKEvalExtendedPool<double>;
+template class CNTKEvalExtendedPool<float>;
 } } }
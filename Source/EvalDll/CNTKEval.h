@@ -13,6 +13,12 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "Eval.h"
 #include "EvalReader.h"
@@ -93,6 +99,12 @@ public:
     CNTKEvalExtended() : CNTKEvalBase<ElemType>(), 
         m_started(false){}
 
+    // evaluator for a network that has been created elsewhere, e.g. for a worker of CNTKEvalExtendedPool
+    CNTKEvalExtended(ComputationNetworkPtr net) : CNTKEvalExtended()
+    {
+        this->m_net = net;
+    }
+
     virtual VariableSchema GetOutputSchema() const override;
 
     virtual void StartForwardEvaluation(const std::vector<wstring>& outputs) override;
@@ -132,4 +144,63 @@ private:
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
 
 };
+
+// ------------------------------------------------------------------------
+// Extended interface, evaluated by a pool of worker threads
+// Each worker owns a CNTKEvalExtended on its own copy of the network, which shares the LearnableParameters
+// with the loaded network but has its own activations. ForwardPass() may be called from any number of threads;
+// a call is queued and returns once one of the workers has evaluated it.
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKEvalExtendedPool : public CNTKEvalBase<ElemType>, public IEvaluateModelExtended<ElemType>
+{
+public:
+    CNTKEvalExtendedPool() : CNTKEvalBase<ElemType>(),
+        m_numWorkers(1), m_numCPUThreads(1), m_pinWorkers(false), m_stopping(false) {}
+
+    virtual VariableSchema GetOutputSchema() const override;
+
+    virtual void StartForwardEvaluation(const std::vector<wstring>& outputs) override;
+
+    virtual VariableSchema GetInputSchema() const override;
+
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& output) override;
+
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& output, bool resetRNN) override;
+
+    virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) override;
+
+    virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
+
+    virtual void Destroy() override;
+
+    virtual void CreateNetwork(const std::string& networkDescription) override;
+
+    virtual void Init(const std::string& config) override;
+
+private:
+    typedef std::function<void(CNTKEvalExtended<ElemType>&)> Work;
+
+    struct Request
+    {
+        Work m_work;
+        std::promise<void> m_done;
+    };
+
+    void Submit(const Work& work, bool resetRNN);
+    void WorkerLoop(size_t workerIndex);
+
+    size_t m_numWorkers;
+    int m_numCPUThreads; // BLAS threads of each worker
+    bool m_pinWorkers;
+
+    // m_workers[0] evaluates the loaded network itself
+    std::vector<std::unique_ptr<CNTKEvalExtended<ElemType>>> m_workers;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex; // guards the following two
+    std::deque<Request*> m_requests;
+    bool m_stopping;
+    std::condition_variable m_requestAvailable;
+};
 } } }
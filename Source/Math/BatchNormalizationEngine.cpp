@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "BatchNormalizationEngine.h"
 #include "CuDnnFactories.h"
+#include "CPUBatchNormalization.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -127,6 +128,15 @@ std::unique_ptr<BatchNormEngine<ElemType>> BatchNormEngine<ElemType>::Create(DEV
     // Use CNTK as default batch norm engine.
     if (HasFlag(enabledEngines, BatchNormEngineKind::Cntk))
     {
+        // On the CPU, use the native implementation, which, unlike the generic CPUMatrix one, also supports training.
+        if (deviceId < 0)
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "Using CNTK CPU batch normalization engine.\n");
+
+            return std::make_unique<CpuBatchNormEngine<ElemType>>(deviceId, inOutT, spatial, imageLayout);
+        }
+
         if (GetMathLibTraceLevel() > 0)
             fprintf(stderr, "Using CNTK batch normalization engine.\n");
 
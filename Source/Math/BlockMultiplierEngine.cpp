@@ -0,0 +1,43 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BlockMultiplierEngine.cpp -- the SSE block multiplier, and runtime selection of the block handler
+//
+
+#include "stdafx.h"
+#include "BlockMultiplierEngineImpl.h"
+#include <omp.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+std::unique_ptr<BlockMultiplierEngine> BlockMultiplierEngine::Create(int numThreads)
+{
+    if (GetSupportedCPUInstructionSet() >= CPUInstructionSet::AVX2)
+    {
+        auto engine = Create(CPUInstructionSet::AVX2, numThreads);
+        if (engine)
+            return engine;
+    }
+    return Create(CPUInstructionSet::Generic, numThreads);
+}
+
+std::unique_ptr<BlockMultiplierEngine> BlockMultiplierEngine::Create(CPUInstructionSet instructionSet, int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = omp_get_max_threads();
+
+    switch (instructionSet)
+    {
+    case CPUInstructionSet::Generic:
+        return std::unique_ptr<BlockMultiplierEngine>(new BlockMultiplierEngineImpl<BlockHandlerSSE>(CPUInstructionSet::Generic, numThreads));
+    case CPUInstructionSet::AVX2:
+        if (GetSupportedCPUInstructionSet() < CPUInstructionSet::AVX2)
+            return nullptr;
+        return std::unique_ptr<BlockMultiplierEngine>(CreateBlockMultiplierEngineAVX2(numThreads));
+    default:
+        return nullptr;
+    }
+}
+
+}}}
@@ -0,0 +1,39 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "CPUTensorKernels.h"
+#include <cstdint>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Product of 16-bit integer matrices by the BlockMultiplier, with the block handler (SSE, or AVX2 in
+// builds with SUPPORT_AVX2) chosen at runtime. The right-hand side is rewritten in block order once by PrepareB() and can then be
+// multiplied with any number of left-hand sides, so this is meant for products with constant weights.
+// All matrices are row-major, and the products are accumulated in 32-bit integers.
+class MATH_API BlockMultiplierEngine
+{
+public:
+    virtual ~BlockMultiplierEngine() {}
+
+    // Rewrites B (k x n) in block order for the following products. The engine keeps its own copy.
+    virtual void PrepareB(const int16_t* B, int k, int n) = 0;
+
+    // C (m x n) = A (m x k) * B, where B is the matrix passed to the last PrepareB(). C is overwritten.
+    virtual void Multiply(const int16_t* A, int m, int32_t* C) = 0;
+
+    virtual CPUInstructionSet GetInstructionSet() const = 0;
+
+    // Creates an engine for the best instruction set that the CPU supports: AVX2, or SSE otherwise.
+    // numThreads = 0 uses as many threads as the other OpenMP loops.
+    static std::unique_ptr<BlockMultiplierEngine> Create(int numThreads = 0);
+
+    // Creates an engine for the given instruction set, where CPUInstructionSet::Generic stands for SSE,
+    // or returns nullptr if the CPU or this build does not support it.
+    static std::unique_ptr<BlockMultiplierEngine> Create(CPUInstructionSet instructionSet, int numThreads = 0);
+};
+
+}}}
@@ -0,0 +1,31 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BlockMultiplierEngineAVX2.cpp -- the AVX2 block multiplier
+//
+// BlockMultiplier<BlockHandlerAVX> instantiates inline and STL code (std::vector, std::function, ...) that the
+// linker may merge with the copies of other translation units. So unlike the TensorOp kernels, this cannot be
+// compiled for AVX2 on its own, and is only available in builds where all code is compiled for AVX2
+// (SUPPORT_AVX2, see Makefile). BlockMultiplierEngine.cpp still checks that the CPU supports AVX2.
+//
+
+#include "stdafx.h"
+#include "BlockMultiplierEngineImpl.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef SUPPORT_AVX2
+
+BlockMultiplierEngine* CreateBlockMultiplierEngineAVX2(int numThreads)
+{
+    return new BlockMultiplierEngineImpl<BlockHandlerAVX>(CPUInstructionSet::AVX2, numThreads);
+}
+
+#else
+
+BlockMultiplierEngine* CreateBlockMultiplierEngineAVX2(int) { return nullptr; }
+
+#endif
+
+}}}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BlockMultiplierEngineImpl.h -- BlockMultiplierEngine on top of BlockMultiplier<BlockHandlerT>
+//
+// This is included by BlockMultiplierEngine.cpp (SSE) and BlockMultiplierEngineAVX2.cpp (AVX2) only, each
+// of which instantiates it for its block handler.
+//
+
+#pragma once
+
+#include "BlockMultiplierEngine.h"
+#include "BlockMultiplier.h"
+#include <assert.h>
+#include <string.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class BlockHandlerT>
+class BlockMultiplierEngineImpl : public BlockMultiplierEngine
+{
+    typedef BlockMultiplier<BlockHandlerT> Multiplier;
+
+public:
+    BlockMultiplierEngineImpl(CPUInstructionSet instructionSet, int numThreads)
+        : m_multiplier(numThreads), m_instructionSet(instructionSet), m_preparedB(nullptr), m_k(0), m_n(0)
+    {
+    }
+
+    ~BlockMultiplierEngineImpl()
+    {
+        if (m_preparedB != nullptr)
+            Multiplier::FreeMatrix(m_preparedB);
+    }
+
+    void PrepareB(const int16_t* B, int k, int n) override
+    {
+        if (m_preparedB != nullptr)
+            Multiplier::FreeMatrix(m_preparedB);
+        // PrepareB() only reads B.
+        m_preparedB = m_multiplier.PrepareB(const_cast<int16_t*>(B), k, n);
+        m_k = k;
+        m_n = n;
+    }
+
+    void Multiply(const int16_t* A, int m, int32_t* C) override
+    {
+        assert(m_preparedB != nullptr);
+        // MultiplyMatrices() accumulates into C, and only reads A.
+        memset(C, 0, sizeof(int32_t) * m * m_n);
+        m_multiplier.MultiplyMatrices(const_cast<int16_t*>(A), m, m_k, m_preparedB, m_n, C);
+    }
+
+    CPUInstructionSet GetInstructionSet() const override { return m_instructionSet; }
+
+private:
+    Multiplier m_multiplier;
+    CPUInstructionSet m_instructionSet;
+    int16_t* m_preparedB;
+    int m_k;
+    int m_n;
+};
+
+// Defined in BlockMultiplierEngineAVX2.cpp. Returns nullptr if this build has no AVX2 code. The caller
+// must have checked that the CPU supports AVX2.
+BlockMultiplierEngine* CreateBlockMultiplierEngineAVX2(int numThreads);
+
+}}}
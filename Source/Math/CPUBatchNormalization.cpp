@@ -0,0 +1,388 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CPUBatchNormalization.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// number of rows that form one unit of work in the non-spatial case
+static const size_t c_rowBlockSize = 256;
+
+// The reductions below keep several partial sums in ElemType, which the compiler can vectorize without
+// having to reorder floating point operations itself, and return their total in double.
+static const size_t c_numPartialSums = 8;
+
+// sum of x[i], i < n
+template <class ElemType>
+static double Sum(const ElemType* x, size_t n)
+{
+    ElemType partial[c_numPartialSums] = {};
+    size_t i = 0;
+    for (; i + c_numPartialSums <= n; i += c_numPartialSums)
+        for (size_t k = 0; k < c_numPartialSums; k++)
+            partial[k] += x[i + k];
+    double sum = 0;
+    for (; i < n; i++)
+        sum += x[i];
+    for (size_t k = 0; k < c_numPartialSums; k++)
+        sum += partial[k];
+    return sum;
+}
+
+// sum of (x[i] - mean)^2, i < n
+template <class ElemType>
+static double SumOfSquaredDeviations(const ElemType* x, size_t n, ElemType mean)
+{
+    ElemType partial[c_numPartialSums] = {};
+    size_t i = 0;
+    for (; i + c_numPartialSums <= n; i += c_numPartialSums)
+        for (size_t k = 0; k < c_numPartialSums; k++)
+        {
+            ElemType d = x[i + k] - mean;
+            partial[k] += d * d;
+        }
+    double sum = 0;
+    for (; i < n; i++)
+    {
+        double d = x[i] - mean;
+        sum += d * d;
+    }
+    for (size_t k = 0; k < c_numPartialSums; k++)
+        sum += partial[k];
+    return sum;
+}
+
+// sum of dy[i] * (x[i] - mean), i < n
+template <class ElemType>
+static double SumOfProductsWithDeviations(const ElemType* dy, const ElemType* x, size_t n, ElemType mean)
+{
+    ElemType partial[c_numPartialSums] = {};
+    size_t i = 0;
+    for (; i + c_numPartialSums <= n; i += c_numPartialSums)
+        for (size_t k = 0; k < c_numPartialSums; k++)
+            partial[k] += dy[i + k] * (x[i + k] - mean);
+    double sum = 0;
+    for (; i < n; i++)
+        sum += (double)dy[i] * (x[i] - mean);
+    for (size_t k = 0; k < c_numPartialSums; k++)
+        sum += partial[k];
+    return sum;
+}
+
+// y[i] = a * (x[i] - center) + b, i < n
+template <class ElemType>
+static void Normalize(const ElemType* x, ElemType* y, size_t n, ElemType center, ElemType a, ElemType b)
+{
+    for (size_t i = 0; i < n; i++)
+        y[i] = a * (x[i] - center) + b;
+}
+
+// y[i] = a[i] * (x[i] - center[i]) + b[i], i < n
+template <class ElemType>
+static void Normalize(const ElemType* x, ElemType* y, size_t n, const ElemType* center, const ElemType* a, const ElemType* b)
+{
+    for (size_t i = 0; i < n; i++)
+        y[i] = a[i] * (x[i] - center[i]) + b[i];
+}
+
+// dx[i] += a * (dy[i] - b * (x[i] - mean) - c), i < n
+template <class ElemType>
+static void AddGradient(const ElemType* dy, const ElemType* x, ElemType* dx, size_t n, ElemType mean, ElemType a, ElemType b, ElemType c)
+{
+    for (size_t i = 0; i < n; i++)
+        dx[i] += a * (dy[i] - b * (x[i] - mean) - c);
+}
+
+// dx[i] += a[i] * (dy[i] - b[i] * (x[i] - mean[i]) - c[i]), i < n
+template <class ElemType>
+static void AddGradient(const ElemType* dy, const ElemType* x, ElemType* dx, size_t n, const ElemType* mean, const ElemType* a, const ElemType* b, const ElemType* c)
+{
+    for (size_t i = 0; i < n; i++)
+        dx[i] += a[i] * (dy[i] - b[i] * (x[i] - mean[i]) - c[i]);
+}
+
+// Updates the running statistics of a channel from its minibatch statistics, and determines the mean and
+// inverse standard deviation to normalize with, the same way as the CNTK GPU engine does.
+template <class ElemType>
+static void UpdateStatistics(double mean, double sumOfSquaredDeviations, size_t count, double expAvgFactor, double blendFactor, double epsilon,
+                             ElemType& runMean, ElemType& runVariance, ElemType& savedMean, ElemType& savedInvStdDev)
+{
+    double unbiasedVariance = count > 1 ? sumOfSquaredDeviations / (count - 1) : 0;
+    if (expAvgFactor == 1) // (the running statistics may not be initialized yet)
+    {
+        runMean = (ElemType)mean;
+        runVariance = (ElemType)unbiasedVariance;
+    }
+    else if (expAvgFactor != 0)
+    {
+        runMean = (ElemType)(expAvgFactor * mean + (1 - expAvgFactor) * runMean);
+        runVariance = (ElemType)(expAvgFactor * unbiasedVariance + (1 - expAvgFactor) * runVariance);
+    }
+
+    double invStdDev = 1 / sqrt(sumOfSquaredDeviations / count + epsilon);
+    if (blendFactor != 0)
+    {
+        mean = blendFactor * runMean + (1 - blendFactor) * mean;
+        invStdDev = blendFactor / sqrt(runVariance + epsilon) + (1 - blendFactor) * invStdDev;
+    }
+    savedMean = (ElemType)mean;
+    savedInvStdDev = (ElemType)invStdDev;
+}
+
+template <class ElemType>
+void CpuBatchNormEngine<ElemType>::EnsureCompatible()
+{
+    if (m_spatial && m_imageLayout == ImageLayoutKind::HWC)
+        InvalidArgument("CNTK batch normalization supports only cudnn(CHW) layout.");
+    if (m_deviceId >= 0)
+        InvalidArgument("The CPU batch normalization engine cannot be used on GPU %d.", (int)m_deviceId);
+}
+
+template <class ElemType>
+void CpuBatchNormEngine<ElemType>::ForwardCore(const Mat& in, const Mat& scale, const Mat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
+                                               Mat& out, double epsilon, Mat& savedMean, Mat& savedInvStdDev)
+{
+    size_t vectorSize = in.GetNumRows();
+    size_t numChannels = scale.GetNumRows();
+    size_t spatialSize = vectorSize / numChannels;
+    size_t batchSize = in.GetNumCols();
+    size_t count = batchSize * spatialSize;
+
+    // Without updates of the running statistics and without contribution of the minibatch statistics,
+    // the data is only read once, to normalize it.
+    bool useRunningStatistics = inferenceOnly || (expAvgFactor == 0 && blendFactor == 1);
+    if (inferenceOnly)
+    {
+        savedMean.Resize(0, 0); // only doing inference: these two are not produced
+        savedInvStdDev.Resize(0, 0);
+    }
+    else
+    {
+        savedMean.Resize(numChannels, 1);
+        savedInvStdDev.Resize(numChannels, 1);
+    }
+
+    const ElemType* x = in.Data();
+    ElemType* y = out.Data();
+    const ElemType* pScale = scale.Data();
+    const ElemType* pBias = bias.Data();
+    ElemType* pRunMean = runMean.Data();
+    ElemType* pRunVariance = runVariance.Data();
+    ElemType* pSavedMean = inferenceOnly ? nullptr : savedMean.Data();
+    ElemType* pSavedInvStdDev = inferenceOnly ? nullptr : savedInvStdDev.Data();
+
+    // Determines center, multiplier and offset for channel c, such that y = multiplier * (x - center) + offset
+    // is scale * (x - mean) * invStdDev + bias. In inference mode, the mean is folded into the offset, so that
+    // the center is 0. In training mode, it is kept separate for accuracy: for channels with a small variance,
+    // the folded offset would cancel out most of multiplier * x.
+    auto getCoefficients = [&](size_t c, double mean, double sumOfSquaredDeviations, ElemType& center, ElemType& multiplier, ElemType& offset)
+    {
+        ElemType invStdDev;
+        if (useRunningStatistics)
+        {
+            mean = pRunMean[c];
+            invStdDev = (ElemType)(1 / sqrt(pRunVariance[c] + epsilon));
+            if (!inferenceOnly)
+            {
+                pSavedMean[c] = (ElemType)mean;
+                pSavedInvStdDev[c] = invStdDev;
+            }
+        }
+        else
+        {
+            UpdateStatistics(mean, sumOfSquaredDeviations, count, expAvgFactor, blendFactor, epsilon, pRunMean[c], pRunVariance[c], pSavedMean[c], pSavedInvStdDev[c]);
+            mean = pSavedMean[c];
+            invStdDev = pSavedInvStdDev[c];
+        }
+        multiplier = pScale[c] * invStdDev;
+        if (inferenceOnly)
+        {
+            center = 0;
+            offset = (ElemType)(pBias[c] - mean * multiplier);
+        }
+        else
+        {
+            center = (ElemType)mean;
+            offset = pBias[c];
+        }
+    };
+
+    if (spatialSize > 1)
+    {
+#pragma omp parallel for
+        for (long c = 0; c < (long)numChannels; c++)
+        {
+            const ElemType* xChannel = x + c * spatialSize;
+            ElemType* yChannel = y + c * spatialSize;
+
+            double mean = 0;
+            double sumOfSquaredDeviations = 0;
+            if (!useRunningStatistics)
+            {
+                // Two passes for the variance, which is much more accurate than E[x^2] - E[x]^2 in float.
+                double sum = 0;
+                for (size_t j = 0; j < batchSize; j++)
+                    sum += Sum(xChannel + j * vectorSize, spatialSize);
+                mean = sum / count;
+                for (size_t j = 0; j < batchSize; j++)
+                    sumOfSquaredDeviations += SumOfSquaredDeviations(xChannel + j * vectorSize, spatialSize, (ElemType)mean);
+            }
+
+            ElemType center, multiplier, offset;
+            getCoefficients(c, mean, sumOfSquaredDeviations, center, multiplier, offset);
+            for (size_t j = 0; j < batchSize; j++)
+                Normalize(xChannel + j * vectorSize, yChannel + j * vectorSize, spatialSize, center, multiplier, offset);
+        }
+    }
+    else
+    {
+        long numBlocks = (long)((numChannels + c_rowBlockSize - 1) / c_rowBlockSize);
+#pragma omp parallel for
+        for (long block = 0; block < numBlocks; block++)
+        {
+            size_t first = block * c_rowBlockSize;
+            size_t rows = std::min(c_rowBlockSize, numChannels - first);
+            const ElemType* xBlock = x + first;
+            ElemType* yBlock = y + first;
+
+            ElemType mean[c_rowBlockSize];
+            double sum[c_rowBlockSize], sumOfSquaredDeviations[c_rowBlockSize];
+            std::fill(sum, sum + rows, 0.0);
+            std::fill(sumOfSquaredDeviations, sumOfSquaredDeviations + rows, 0.0);
+            if (!useRunningStatistics)
+            {
+                for (size_t j = 0; j < batchSize; j++)
+                {
+                    const ElemType* xColumn = xBlock + j * vectorSize;
+                    for (size_t r = 0; r < rows; r++)
+                        sum[r] += xColumn[r];
+                }
+                for (size_t r = 0; r < rows; r++)
+                    mean[r] = (ElemType)(sum[r] / count);
+                for (size_t j = 0; j < batchSize; j++)
+                {
+                    const ElemType* xColumn = xBlock + j * vectorSize;
+                    for (size_t r = 0; r < rows; r++)
+                    {
+                        double d = xColumn[r] - mean[r];
+                        sumOfSquaredDeviations[r] += d * d;
+                    }
+                }
+            }
+
+            ElemType center[c_rowBlockSize], multiplier[c_rowBlockSize], offset[c_rowBlockSize];
+            for (size_t r = 0; r < rows; r++)
+                getCoefficients(first + r, sum[r] / count, sumOfSquaredDeviations[r], center[r], multiplier[r], offset[r]);
+            for (size_t j = 0; j < batchSize; j++)
+                Normalize(xBlock + j * vectorSize, yBlock + j * vectorSize, rows, center, multiplier, offset);
+        }
+    }
+}
+
+// The gradient is computed like in the CNTK GPU engine (see kBackpropagateBatchNormGradients):
+//   dBias  = sum(dy)
+//   dScale = sum(dy * xHat), with xHat = (x - mean) * invStdDev
+//   dx    += scale * invStdDev * (dy - mbStatsWeight * (xHat * dScale + dBias) / m)
+// The latter is rewritten as dx += a * (dy - b * (x - mean) - c), with constants a, b and c per channel.
+template <class ElemType>
+void CpuBatchNormEngine<ElemType>::BackwardCore(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& savedMean, const Mat& savedInvStdDev,
+                                                Mat& scaleGrad, Mat& biasGrad)
+{
+    size_t vectorSize = in.GetNumRows();
+    size_t numChannels = scale.GetNumRows();
+    size_t spatialSize = vectorSize / numChannels;
+    size_t batchSize = in.GetNumCols();
+    size_t count = batchSize * spatialSize;
+    double mbStatsWeight = 1 - blendFactor; // weight for contribution from actual MB stats (0 if none, e.g. locked BN node)
+
+    const ElemType* x = in.Data();
+    const ElemType* dy = srcGrad.Data();
+    ElemType* dx = grad.Data();
+    const ElemType* pScale = scale.Data();
+    const ElemType* pMean = savedMean.Data();
+    const ElemType* pInvStdDev = savedInvStdDev.Data();
+    ElemType* pScaleGrad = scaleGrad.Data();
+    ElemType* pBiasGrad = biasGrad.Data();
+
+    // Stores the scale and bias gradients of channel c, and determines the constants of its data gradient.
+    auto getGradientConstants = [&](size_t c, double sumOfProductsWithDeviations, double sum, ElemType& a, ElemType& b, ElemType& cc)
+    {
+        double invStdDev = pInvStdDev[c];
+        double dScale = sumOfProductsWithDeviations * invStdDev;
+        double dBias = sum;
+        pScaleGrad[c] = (ElemType)dScale;
+        pBiasGrad[c] = (ElemType)dBias;
+
+        a = (ElemType)(pScale[c] * invStdDev);
+        b = (ElemType)(mbStatsWeight * dScale * invStdDev / count);
+        cc = (ElemType)(mbStatsWeight * dBias / count);
+    };
+
+    if (spatialSize > 1)
+    {
+#pragma omp parallel for
+        for (long c = 0; c < (long)numChannels; c++)
+        {
+            size_t channelOffset = c * spatialSize;
+            double sum = 0, sumOfProductsWithDeviations = 0;
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                size_t offset = channelOffset + j * vectorSize;
+                sum += Sum(dy + offset, spatialSize);
+                sumOfProductsWithDeviations += SumOfProductsWithDeviations(dy + offset, x + offset, spatialSize, pMean[c]);
+            }
+
+            ElemType a, b, cc;
+            getGradientConstants(c, sumOfProductsWithDeviations, sum, a, b, cc);
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                size_t offset = channelOffset + j * vectorSize;
+                AddGradient(dy + offset, x + offset, dx + offset, spatialSize, pMean[c], a, b, cc);
+            }
+        }
+    }
+    else
+    {
+        long numBlocks = (long)((numChannels + c_rowBlockSize - 1) / c_rowBlockSize);
+#pragma omp parallel for
+        for (long block = 0; block < numBlocks; block++)
+        {
+            size_t first = block * c_rowBlockSize;
+            size_t rows = std::min(c_rowBlockSize, numChannels - first);
+
+            double sum[c_rowBlockSize], sumOfProductsWithDeviations[c_rowBlockSize];
+            std::fill(sum, sum + rows, 0.0);
+            std::fill(sumOfProductsWithDeviations, sumOfProductsWithDeviations + rows, 0.0);
+            const ElemType* mean = pMean + first;
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                size_t offset = first + j * vectorSize;
+                for (size_t r = 0; r < rows; r++)
+                {
+                    sum[r] += dy[offset + r];
+                    sumOfProductsWithDeviations[r] += (double)dy[offset + r] * (x[offset + r] - mean[r]);
+                }
+            }
+
+            ElemType a[c_rowBlockSize], b[c_rowBlockSize], cc[c_rowBlockSize];
+            for (size_t r = 0; r < rows; r++)
+                getGradientConstants(first + r, sumOfProductsWithDeviations[r], sum[r], a[r], b[r], cc[r]);
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                size_t offset = first + j * vectorSize;
+                AddGradient(dy + offset, x + offset, dx + offset, rows, mean, a, b, cc);
+            }
+        }
+    }
+}
+
+template class CpuBatchNormEngine<float>;
+template class CpuBatchNormEngine<double>;
+
+}}}
@@ -0,0 +1,54 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "BatchNormalizationEngine.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// CpuBatchNormEngine is the CPU counterpart of the CNTK (GPU) batch normalization engine, and
+// computes the same results, for training as well as inference.
+//
+// Scale, bias and the statistics are folded into one multiplier and one offset per channel
+// before the data is touched, so that normalization is a single multiply-add pass over the
+// data. In inference mode this is the only pass. (In training mode, the mean is subtracted
+// separately, for accuracy.)
+//
+// In the spatial (CHW) case, a channel is a contiguous block of spatialSize elements in every
+// column; the channels are processed in parallel, and the reductions run over these blocks.
+// In the non-spatial case, every row is a channel; blocks of rows are processed in parallel, and
+// the reductions run over the columns, vectorized across the rows of a block. Either way, the
+// statistics of a channel and its normalization are computed by the same thread, while its data
+// is still in the cache.
+template <class ElemType>
+class CpuBatchNormEngine : public BatchNormEngine<ElemType>
+{
+public:
+    using Base = BatchNormEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    CpuBatchNormEngine(DEVICEID_TYPE deviceId, const TensorShape& inOutT,
+                       bool spatial, ImageLayoutKind imageLayout)
+                       : Base(deviceId, inOutT, spatial, imageLayout)
+    {
+    }
+
+protected:
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_inOutT;
+    using Base::m_spatial;
+
+    void EnsureCompatible() override;
+
+    void ForwardCore(const Mat& in, const Mat& scale, const Mat& bias, bool inferenceOnly, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runVariance,
+                     Mat& out, double epsilon, Mat& savedMean, Mat& savedInvStdDev) override;
+
+    void BackwardCore(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& savedMean, const Mat& savedInvStdDev,
+                      Mat& scaleGrad, Mat& biasGrad) override;
+};
+
+}}}
@@ -0,0 +1,411 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CPUConvolution.h"
+#include <algorithm>
+#include <omp.h>
+
+#ifdef USE_MKL
+#include <mkl.h>
+#else
+#include <cblas.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool CpuConvolutionDims::TryGet(const ConvolveGeometry& geometry, CpuConvolutionDims& dims)
+{
+    const auto& inputShape = geometry.InputShape();
+    const auto& outputShape = geometry.OutputShape();
+    const auto& kernelShape = geometry.KernelShape();
+    if (inputShape.GetRank() != 3 || outputShape.GetRank() != 3 || kernelShape.GetRank() != 3)
+        return false;
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (!geometry.GetSharing(i))
+            return false;
+    }
+    // The kernel must span all input channels, and produce one output per map in the channel dimension.
+    size_t mapCount = geometry.GetMapCount(2);
+    if (geometry.GetMapCount(0) != 1 || geometry.GetMapCount(1) != 1 ||
+        kernelShape[2] != inputShape[2] || outputShape[2] != mapCount || geometry.GetLowerPad(2) != 0)
+        return false;
+
+    dims.m_inW = inputShape[0];
+    dims.m_inH = inputShape[1];
+    dims.m_inC = inputShape[2];
+    dims.m_outW = outputShape[0];
+    dims.m_outH = outputShape[1];
+    dims.m_outC = mapCount;
+    dims.m_kernelW = kernelShape[0];
+    dims.m_kernelH = kernelShape[1];
+    dims.m_strideW = geometry.GetStride(0);
+    dims.m_strideH = geometry.GetStride(1);
+    dims.m_padW = geometry.GetLowerPad(0);
+    dims.m_padH = geometry.GetLowerPad(1);
+    return true;
+}
+
+static void Gemm(size_t m, size_t n, size_t k, const float* a, const float* b, float* c)
+{
+    cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, (int) m, (int) n, (int) k,
+                1.0f, const_cast<float*>(a), (int) m, const_cast<float*>(b), (int) k, 0.0f, c, (int) m);
+}
+
+static void Gemm(size_t m, size_t n, size_t k, const double* a, const double* b, double* c)
+{
+    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, (int) m, (int) n, (int) k,
+                1.0, const_cast<double*>(a), (int) m, const_cast<double*>(b), (int) k, 0.0, c, (int) m);
+}
+
+//------------------------------------------------------------------
+// Direct convolution.
+//------------------------------------------------------------------
+
+// Channels per block of the repacked input, maps per block of the repacked weights, and number of
+// adjacent outputs (along W) that are computed together.
+static const size_t c_channelBlock = 8;
+static const size_t c_mapBlock = 8;
+static const size_t c_outputTile = 4;
+
+// Vectorizes the loop that follows (over the maps of a block), rather than the ones around it, so that
+// the accumulators stay in registers. (OpenMP SIMD directives are not supported by Visual C++.)
+#ifdef _MSC_VER
+#define VECTORIZE_LOOP
+#else
+#define VECTORIZE_LOOP _Pragma("omp simd")
+#endif
+
+// Size of the zero-padded, repacked input of one sample, which covers the input cells of all outputs,
+// including the ones of the last (partial) output tile in every row.
+static void GetDirectInputSize(const CpuConvolutionDims& dims, size_t& height, size_t& width)
+{
+    size_t tiledOutW = (dims.m_outW + c_outputTile - 1) / c_outputTile * c_outputTile;
+    height = (dims.m_outH - 1) * dims.m_strideH + dims.m_kernelH;
+    width = (tiledOutW - 1) * dims.m_strideW + dims.m_kernelW;
+}
+
+template <class ElemType>
+size_t CpuConvolution<ElemType>::DirectWorkspaceSize(const CpuConvolutionDims& dims, size_t batchSize)
+{
+    size_t channelBlocks = (dims.m_inC + c_channelBlock - 1) / c_channelBlock;
+    size_t mapBlocks = (dims.m_outC + c_mapBlock - 1) / c_mapBlock;
+    size_t height, width;
+    GetDirectInputSize(dims, height, width);
+    return mapBlocks * channelBlocks * dims.m_kernelH * dims.m_kernelW * c_channelBlock * c_mapBlock +
+           batchSize * channelBlocks * height * width * c_channelBlock;
+}
+
+template <class ElemType>
+void CpuConvolution<ElemType>::Direct(const CpuConvolutionDims& dims, const ElemType* in, const ElemType* kernel, ElemType* out, size_t batchSize, ElemType* workspace)
+{
+    const size_t C = dims.m_inC, K = dims.m_outC, kH = dims.m_kernelH, kW = dims.m_kernelW;
+    const size_t channelBlocks = (C + c_channelBlock - 1) / c_channelBlock;
+    const size_t mapBlocks = (K + c_mapBlock - 1) / c_mapBlock;
+    size_t height, width;
+    GetDirectInputSize(dims, height, width);
+
+    // Weights: [mapBlocks][channelBlocks][kH][kW][c_channelBlock][c_mapBlock], zero-padded.
+    ElemType* weights = workspace;
+    const size_t weightsSize = mapBlocks * channelBlocks * kH * kW * c_channelBlock * c_mapBlock;
+#pragma omp parallel for
+    for (long long kb = 0; kb < (long long) mapBlocks; kb++)
+    {
+        ElemType* dst = weights + kb * channelBlocks * kH * kW * c_channelBlock * c_mapBlock;
+        std::fill(dst, dst + channelBlocks * kH * kW * c_channelBlock * c_mapBlock, (ElemType) 0);
+        for (size_t k = kb * c_mapBlock; k < std::min(K, (size_t) (kb + 1) * c_mapBlock); k++)
+        {
+            for (size_t c = 0; c < C; c++)
+            {
+                for (size_t y = 0; y < kH; y++)
+                {
+                    for (size_t x = 0; x < kW; x++)
+                    {
+                        dst[((((c / c_channelBlock) * kH + y) * kW + x) * c_channelBlock + c % c_channelBlock) * c_mapBlock + k % c_mapBlock] =
+                            kernel[((k * C + c) * kH + y) * kW + x];
+                    }
+                }
+            }
+        }
+    }
+
+    // Input: [batchSize][channelBlocks][height][width][c_channelBlock], zero-padded.
+    ElemType* input = weights + weightsSize;
+    const size_t inSize = dims.m_inW * dims.m_inH * C;
+    const size_t blockSize = height * width * c_channelBlock;
+#pragma omp parallel for
+    for (long long i = 0; i < (long long) (batchSize * channelBlocks); i++)
+    {
+        size_t n = i / channelBlocks, cb = i % channelBlocks;
+        ElemType* dst = input + i * blockSize;
+        std::fill(dst, dst + blockSize, (ElemType) 0);
+        for (size_t c = cb * c_channelBlock; c < std::min(C, (cb + 1) * c_channelBlock); c++)
+        {
+            const ElemType* src = in + n * inSize + c * dims.m_inW * dims.m_inH;
+            for (size_t y = 0; y < height; y++)
+            {
+                int inY = (int) y - dims.m_padH;
+                if (inY < 0 || inY >= (int) dims.m_inH)
+                    continue;
+                for (size_t x = 0; x < width; x++)
+                {
+                    int inX = (int) x - dims.m_padW;
+                    if (inX >= 0 && inX < (int) dims.m_inW)
+                        dst[(y * width + x) * c_channelBlock + c % c_channelBlock] = src[inY * dims.m_inW + inX];
+                }
+            }
+        }
+    }
+
+    // Every task computes one output row of a block of maps.
+    const size_t outSize = dims.m_outW * dims.m_outH * K;
+#pragma omp parallel for
+    for (long long i = 0; i < (long long) (batchSize * mapBlocks * dims.m_outH); i++)
+    {
+        size_t oy = i % dims.m_outH;
+        size_t kb = (i / dims.m_outH) % mapBlocks;
+        size_t n = i / (dims.m_outH * mapBlocks);
+        size_t maps = std::min(c_mapBlock, K - kb * c_mapBlock);
+        for (size_t ox = 0; ox < dims.m_outW; ox += c_outputTile)
+        {
+            ElemType acc[c_outputTile][c_mapBlock] = {};
+            for (size_t cb = 0; cb < channelBlocks; cb++)
+            {
+                for (size_t ky = 0; ky < kH; ky++)
+                {
+                    const ElemType* row = input + ((n * channelBlocks + cb) * height + oy * dims.m_strideH + ky) * width * c_channelBlock;
+                    const ElemType* w = weights + ((kb * channelBlocks + cb) * kH + ky) * kW * c_channelBlock * c_mapBlock;
+                    for (size_t kx = 0; kx < kW; kx++, w += c_channelBlock * c_mapBlock)
+                    {
+                        const ElemType* x = row + (ox * dims.m_strideW + kx) * c_channelBlock;
+                        for (size_t c = 0; c < c_channelBlock; c++)
+                        {
+                            for (size_t t = 0; t < c_outputTile; t++)
+                            {
+                                ElemType v = x[t * dims.m_strideW * c_channelBlock + c];
+                                VECTORIZE_LOOP
+                                for (size_t k = 0; k < c_mapBlock; k++)
+                                    acc[t][k] += v * w[c * c_mapBlock + k];
+                            }
+                        }
+                    }
+                }
+            }
+
+            size_t outputs = std::min(c_outputTile, dims.m_outW - ox);
+            ElemType* dst = out + n * outSize + ((kb * c_mapBlock) * dims.m_outH + oy) * dims.m_outW + ox;
+            for (size_t k = 0; k < maps; k++)
+            {
+                for (size_t t = 0; t < outputs; t++)
+                    dst[k * dims.m_outH * dims.m_outW + t] = acc[t][k];
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------
+// Winograd convolution.
+//------------------------------------------------------------------
+
+// Transformation matrices of F(2 x 2, 3 x 3) and F(4 x 4, 3 x 3), row-major: the input transform B^T
+// (a x a, where a = m + 2), the kernel transform G (a x 3) and the output transform A^T (m x a).
+static const double c_winogradBT2[4 * 4] = {
+    1,  0, -1,  0,
+    0,  1,  1,  0,
+    0, -1,  1,  0,
+    0,  1,  0, -1 };
+static const double c_winogradG2[4 * 3] = {
+    1,    0,   0,
+    0.5,  0.5, 0.5,
+    0.5, -0.5, 0.5,
+    0,    0,   1 };
+static const double c_winogradAT2[2 * 4] = {
+    1, 1,  1,  0,
+    0, 1, -1, -1 };
+
+static const double c_winogradBT4[6 * 6] = {
+    4,  0, -5,  0, 1, 0,
+    0, -4, -4,  1, 1, 0,
+    0,  4, -4, -1, 1, 0,
+    0, -2, -1,  2, 1, 0,
+    0,  2, -1, -2, 1, 0,
+    0,  4,  0, -5, 0, 1 };
+static const double c_winogradG4[6 * 3] = {
+    1.0 / 4,   0,          0,
+   -1.0 / 6,  -1.0 / 6,   -1.0 / 6,
+   -1.0 / 6,   1.0 / 6,   -1.0 / 6,
+    1.0 / 24,  1.0 / 12,   1.0 / 6,
+    1.0 / 24, -1.0 / 12,   1.0 / 6,
+    0,         0,          1 };
+static const double c_winogradAT4[4 * 6] = {
+    1, 1,  1, 1,  1, 0,
+    0, 1, -1, 2, -2, 0,
+    0, 1,  1, 4,  4, 0,
+    0, 1, -1, 8, -8, 1 };
+
+// Upper bound of the number of elements of the transformed input and output tiles that are processed at once.
+static const size_t c_winogradChunkElements = 4 * 1024 * 1024;
+
+static void CheckWinograd(const CpuConvolutionDims& dims, size_t tileSize)
+{
+    if (!dims.IsWinogradCompatible())
+        InvalidArgument("Winograd convolution supports only 3 x 3 kernels with stride 1.");
+    if (tileSize != 2 && tileSize != 4)
+        InvalidArgument("Winograd convolution supports only output tiles of 2 x 2 or 4 x 4.");
+}
+
+// Number of tiles that are transformed and multiplied at once.
+static size_t GetWinogradChunkTiles(const CpuConvolutionDims& dims, size_t tileSize, size_t tiles)
+{
+    size_t cells = (tileSize + 2) * (tileSize + 2);
+    size_t chunkTiles = c_winogradChunkElements / (cells * (dims.m_inC + dims.m_outC));
+    return std::max<size_t>(1, std::min(tiles, std::max<size_t>(chunkTiles, 16)));
+}
+
+static size_t GetWinogradTiles(const CpuConvolutionDims& dims, size_t tileSize, size_t batchSize)
+{
+    return batchSize * ((dims.m_outH + tileSize - 1) / tileSize) * ((dims.m_outW + tileSize - 1) / tileSize);
+}
+
+template <class ElemType>
+size_t CpuConvolution<ElemType>::WinogradWorkspaceSize(const CpuConvolutionDims& dims, size_t tileSize, size_t batchSize)
+{
+    CheckWinograd(dims, tileSize);
+    size_t cells = (tileSize + 2) * (tileSize + 2);
+    size_t chunkTiles = GetWinogradChunkTiles(dims, tileSize, GetWinogradTiles(dims, tileSize, batchSize));
+    return cells * dims.m_outC * dims.m_inC + cells * (dims.m_inC + dims.m_outC) * chunkTiles;
+}
+
+template <class ElemType>
+void CpuConvolution<ElemType>::Winograd(const CpuConvolutionDims& dims, size_t tileSize, const ElemType* in, const ElemType* kernel, ElemType* out, size_t batchSize, ElemType* workspace)
+{
+    CheckWinograd(dims, tileSize);
+
+    const size_t m = tileSize, a = tileSize + 2, cells = a * a;
+    const size_t C = dims.m_inC, K = dims.m_outC;
+    ElemType BT[6 * 6], G[6 * 3], AT[4 * 6];
+    std::copy(m == 2 ? c_winogradBT2 : c_winogradBT4, (m == 2 ? c_winogradBT2 : c_winogradBT4) + a * a, BT);
+    std::copy(m == 2 ? c_winogradG2 : c_winogradG4, (m == 2 ? c_winogradG2 : c_winogradG4) + a * 3, G);
+    std::copy(m == 2 ? c_winogradAT2 : c_winogradAT4, (m == 2 ? c_winogradAT2 : c_winogradAT4) + m * a, AT);
+
+    const size_t tilesW = (dims.m_outW + m - 1) / m, tilesH = (dims.m_outH + m - 1) / m;
+    const size_t tiles = batchSize * tilesH * tilesW;
+    const size_t chunkTiles = GetWinogradChunkTiles(dims, m, tiles);
+
+    // Transformed weights U = G g G^T: for every tile cell a K x C matrix (column-major).
+    ElemType* U = workspace;
+#pragma omp parallel for
+    for (long long i = 0; i < (long long) (K * C); i++)
+    {
+        size_t k = i / C, c = i % C;
+        const ElemType* g = kernel + (k * C + c) * 9;
+        ElemType t[6 * 3];
+        for (size_t r = 0; r < a; r++)
+        {
+            for (size_t x = 0; x < 3; x++)
+                t[r * 3 + x] = G[r * 3] * g[x] + G[r * 3 + 1] * g[3 + x] + G[r * 3 + 2] * g[6 + x];
+        }
+        for (size_t r = 0; r < a; r++)
+        {
+            for (size_t s = 0; s < a; s++)
+                U[(r * a + s) * K * C + c * K + k] = t[r * 3] * G[s * 3] + t[r * 3 + 1] * G[s * 3 + 1] + t[r * 3 + 2] * G[s * 3 + 2];
+        }
+    }
+
+    // Transformed input V = B^T d B and products M = U V: for every tile cell a C x tiles and a K x tiles matrix.
+    ElemType* V = U + cells * K * C;
+    ElemType* M = V + cells * C * chunkTiles;
+    const size_t inSize = dims.m_inW * dims.m_inH * C;
+    const size_t outSize = dims.m_outW * dims.m_outH * K;
+    for (size_t first = 0; first < tiles; first += chunkTiles)
+    {
+        const size_t count = std::min(chunkTiles, tiles - first);
+
+#pragma omp parallel for
+        for (long long p = 0; p < (long long) count; p++)
+        {
+            size_t tile = first + p;
+            size_t tx = tile % tilesW, ty = (tile / tilesW) % tilesH, n = tile / (tilesW * tilesH);
+            int x0 = (int) (tx * m) - dims.m_padW, y0 = (int) (ty * m) - dims.m_padH;
+            ElemType d[6 * 6], t[6 * 6];
+            for (size_t c = 0; c < C; c++)
+            {
+                const ElemType* src = in + n * inSize + c * dims.m_inW * dims.m_inH;
+                for (size_t y = 0; y < a; y++)
+                {
+                    int inY = y0 + (int) y;
+                    for (size_t x = 0; x < a; x++)
+                    {
+                        int inX = x0 + (int) x;
+                        d[y * a + x] = (inY >= 0 && inY < (int) dims.m_inH && inX >= 0 && inX < (int) dims.m_inW) ? src[inY * dims.m_inW + inX] : 0;
+                    }
+                }
+                for (size_t r = 0; r < a; r++)
+                {
+                    for (size_t x = 0; x < a; x++)
+                    {
+                        ElemType sum = 0;
+                        for (size_t y = 0; y < a; y++)
+                            sum += BT[r * a + y] * d[y * a + x];
+                        t[r * a + x] = sum;
+                    }
+                }
+                for (size_t r = 0; r < a; r++)
+                {
+                    for (size_t s = 0; s < a; s++)
+                    {
+                        ElemType sum = 0;
+                        for (size_t x = 0; x < a; x++)
+                            sum += t[r * a + x] * BT[s * a + x];
+                        V[((r * a + s) * count + p) * C + c] = sum;
+                    }
+                }
+            }
+        }
+
+        for (size_t cell = 0; cell < cells; cell++)
+            Gemm(K, count, C, U + cell * K * C, V + cell * C * count, M + cell * K * count);
+
+#pragma omp parallel for
+        for (long long p = 0; p < (long long) count; p++)
+        {
+            size_t tile = first + p;
+            size_t tx = tile % tilesW, ty = (tile / tilesW) % tilesH, n = tile / (tilesW * tilesH);
+            size_t outputsW = std::min(m, dims.m_outW - tx * m), outputsH = std::min(m, dims.m_outH - ty * m);
+            ElemType t[4 * 6];
+            for (size_t k = 0; k < K; k++)
+            {
+                // Y = A^T M A
+                for (size_t r = 0; r < m; r++)
+                {
+                    for (size_t s = 0; s < a; s++)
+                    {
+                        ElemType sum = 0;
+                        for (size_t y = 0; y < a; y++)
+                            sum += AT[r * a + y] * M[((y * a + s) * count + p) * K + k];
+                        t[r * a + s] = sum;
+                    }
+                }
+                ElemType* dst = out + n * outSize + (k * dims.m_outH + ty * m) * dims.m_outW + tx * m;
+                for (size_t r = 0; r < outputsH; r++)
+                {
+                    for (size_t s = 0; s < outputsW; s++)
+                    {
+                        ElemType sum = 0;
+                        for (size_t x = 0; x < a; x++)
+                            sum += t[r * a + x] * AT[s * a + x];
+                        dst[r * dims.m_outW + s] = sum;
+                    }
+                }
+            }
+        }
+    }
+}
+
+template class CpuConvolution<float>;
+template class CpuConvolution<double>;
+
+}}}
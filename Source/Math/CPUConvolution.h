@@ -0,0 +1,56 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "CommonMatrix.h"
+#include "ConvolveGeometry.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Dimensions of a 2D convolution with full sharing, where the kernel spans all input channels,
+// on data with CHW layout (W is the fastest changing dimension). The output has K maps.
+struct CpuConvolutionDims
+{
+    size_t m_inW, m_inH, m_inC;
+    size_t m_outW, m_outH, m_outC;
+    size_t m_kernelW, m_kernelH;
+    size_t m_strideW, m_strideH;
+    int m_padW, m_padH; // number of (zero) cells before the first input cell; the first input cell of output (x, y) is (x * strideW - padW, y * strideH - padH)
+
+    // Returns false if the geometry is not such a convolution.
+    static bool TryGet(const ConvolveGeometry& geometry, CpuConvolutionDims& dims);
+
+    bool IsWinogradCompatible() const
+    {
+        return m_kernelW == 3 && m_kernelH == 3 && m_strideW == 1 && m_strideH == 1;
+    }
+};
+
+// Forward convolution algorithms for the CPU that, unlike the unrolling + GEMM technique, do not
+// materialize the unrolled input (which is kernelW * kernelH times the size of the input).
+// The input (and output) columns are samples in CHW layout, and the kernel has the same layout as in
+// the other engines: element (x, y, c) of map k is at ((k * C + c) * kernelH + y) * kernelW + x.
+// The workspace must hold at least the number of elements returned by the respective *WorkspaceSize.
+template <class ElemType>
+class MATH_API CpuConvolution
+{
+public:
+    // Blocked direct convolution. The input is repacked into blocks of channels (NCHWc layout),
+    // padded with zeros, and the weights into blocks of channels and maps, so that the inner loops
+    // accumulate a few adjacent outputs of a block of maps in registers, vectorized over the maps.
+    static size_t DirectWorkspaceSize(const CpuConvolutionDims& dims, size_t batchSize);
+    static void Direct(const CpuConvolutionDims& dims, const ElemType* in, const ElemType* kernel, ElemType* out, size_t batchSize, ElemType* workspace);
+
+    // Winograd minimal filtering F(m x m, 3 x 3), m = 2 or 4, for 3 x 3 kernels with stride 1
+    // (see Lavin and Gray, "Fast Algorithms for Convolutional Neural Networks"). The input is split
+    // into overlapping tiles of (m + 2) x (m + 2) cells, which are transformed, multiplied with the
+    // transformed weights in one GEMM per tile cell, and transformed back into m x m outputs.
+    // This needs 2.25 (m = 2) or 4 (m = 4) times fewer multiplications than the direct convolution,
+    // but F(4 x 4, 3 x 3) is less accurate.
+    static size_t WinogradWorkspaceSize(const CpuConvolutionDims& dims, size_t tileSize, size_t batchSize);
+    static void Winograd(const CpuConvolutionDims& dims, size_t tileSize, const ElemType* in, const ElemType* kernel, ElemType* out, size_t batchSize, ElemType* workspace);
+};
+
+}}}
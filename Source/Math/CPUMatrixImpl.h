@@ -11,6 +11,8 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPURNN.h"
+#include "CPUTensorKernels.h"
 #include "TensorOps.h"
 #include <assert.h>
 #include <stdexcept>
@@ -4836,6 +4838,35 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+#pragma region RNN Functions
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    // numLayers, hiddenSize are input parameters
+    if (!m_rnnExecutor)
+        m_rnnExecutor = std::make_shared<CPURNNExecutor<ElemType>>(xDim, yDim, rnnAttributes);
+    m_rnnExecutor->ForwardCore(paramW, inputX, *this, numSequencesForFrame, rnnAttributes, reserve, workspace);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardData(const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& paramW, CPUMatrix<ElemType>& outputDX, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    if (!m_rnnExecutor)
+        LogicError("RNNBackwardData called, but RNNWrapper object is not yet initialized");
+    m_rnnExecutor->BackwardDataCore(*this, outputDY, paramW, outputDX, rnnAttributes, reserve, workspace);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardWeights(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    if (!m_rnnExecutor)
+        LogicError("RNNBackwardWeights called, but RNNWrapper object is not yet initialized");
+    m_rnnExecutor->BackwardWeightsCore(inputX, outputY, dw, rnnAttributes, reserve, workspace);
+}
+
+#pragma endregion RNN Functions
+
 
 #pragma region Static BLAS Functions
 
@@ -7055,6 +7086,199 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     }
 }
 
+// -----------------------------------------------------------------------
+// fast paths that use the explicitly vectorized kernels of CPUTensorKernels.h
+// -----------------------------------------------------------------------
+
+static const size_t c_tensorKernelGrain = 4096;                   // elements per OpenMP work item
+static const size_t c_minElementsForParallelTensorKernel = 16384; // below this, OpenMP costs more than it gains
+
+// elementwise operation without reduction, where all operands have unit stride in the innermost dimension:
+// calls kernel(n, pointers) on each contiguous innermost run (split into chunks of c_tensorKernelGrain)
+template <class ElemType, size_t N, typename KERNEL>
+static bool TensorOpWithContiguousKernel(array<ElemType*, N> pointers, const array<size_t, N>& offsets,
+                                         const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                         const SmallVector<size_t>& reducingOpDims, const KERNEL& kernel)
+{
+    if (!reducingOpDims.empty() || regularOpDims.empty())
+        return false;
+    for (size_t i = 0; i < N; i++)
+    {
+        if (regularStrides[i][0] != 1)
+            return false;
+        pointers[i] += offsets[i];
+    }
+
+    size_t innerDim = regularOpDims[0];
+    size_t numOuter = 1;
+    for (size_t k = 1; k < regularOpDims.size(); k++)
+        numOuter *= regularOpDims[k];
+    size_t numChunks = (innerDim + c_tensorKernelGrain - 1) / c_tensorKernelGrain;
+
+#pragma omp parallel for if (numOuter * innerDim >= c_minElementsForParallelTensorKernel)
+    for (long long job = 0; job < (long long) (numOuter * numChunks); job++)
+    {
+        size_t outer = (size_t) job / numChunks;
+        size_t begin = ((size_t) job % numChunks) * c_tensorKernelGrain;
+        array<ElemType*, N> p = pointers;
+        for (size_t k = 1; k < regularOpDims.size(); k++)
+        {
+            ptrdiff_t index = (ptrdiff_t) (outer % regularOpDims[k]);
+            outer /= regularOpDims[k];
+            for (size_t i = 0; i < N; i++)
+                p[i] += index * regularStrides[i][k];
+        }
+        for (size_t i = 0; i < N; i++)
+            p[i] += begin;
+        kernel(min(c_tensorKernelGrain, innerDim - begin), p);
+    }
+    return true;
+}
+
+// reduction (sum or max) of a tensor without elementwise op, along a single flattened reducing dimension that is either
+//  - innermost (unit stride in the input), e.g. the column sums of a matrix, or the sum of all elements; or
+//  - outermost (the output is contiguous), e.g. the row sums of a matrix, as in a bias gradient
+template <class ElemType>
+static bool TensorReductionWithKernel(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const CPUTensorKernelTable<ElemType>& kernels, ElementWiseOperator reductionOp,
+                                      const array<size_t, 2>& offsets,
+                                      const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                                      const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    if (reducingOpDims.size() != 1 || reducingOpDims[0] == 0)
+        return false;
+    auto reduce = reductionOp == ElementWiseOperator::opSum ? kernels.reduceSum : reductionOp == ElementWiseOperator::opMax ? kernels.reduceMax : nullptr;
+    auto reduceColumns = reductionOp == ElementWiseOperator::opSum ? kernels.reduceColumnsSum : reductionOp == ElementWiseOperator::opMax ? kernels.reduceColumnsMax : nullptr;
+    if (!reduce || !reduceColumns)
+        return false;
+    const ElemType* pa = pointers[0] + offsets[0];
+    ElemType* pc = pointers[1] + offsets[1];
+    size_t reducingDim = reducingOpDims[0];
+
+    if (reducingStrides[0][0] == 1) // innermost
+    {
+        size_t numOutputs = 1;
+        for (size_t k = 0; k < regularOpDims.size(); k++)
+            numOutputs *= regularOpDims[k];
+        auto finish = [beta, alpha](double aggregate, ElemType* c)
+        {
+            ElemType val = (ElemType) aggregate * alpha;
+            if (beta != 0)
+                val += beta * *c;
+            *c = val;
+        };
+        if (numOutputs == 1) // e.g. sum of all elements: reduce chunks in parallel, then combine them in a fixed order
+        {
+            size_t numChunks = (reducingDim + c_tensorKernelGrain - 1) / c_tensorKernelGrain;
+            vector<double> partial(numChunks);
+#pragma omp parallel for if (reducingDim >= c_minElementsForParallelTensorKernel)
+            for (long long chunk = 0; chunk < (long long) numChunks; chunk++)
+            {
+                size_t begin = (size_t) chunk * c_tensorKernelGrain;
+                partial[chunk] = reduce(min(c_tensorKernelGrain, reducingDim - begin), pa + begin);
+            }
+            double aggregate = partial[0];
+            for (size_t chunk = 1; chunk < numChunks; chunk++)
+                aggregate = reductionOp == ElementWiseOperator::opSum ? aggregate + partial[chunk] : max(aggregate, partial[chunk]);
+            finish(aggregate, pc);
+            return true;
+        }
+#pragma omp parallel for if (numOutputs * reducingDim >= c_minElementsForParallelTensorKernel)
+        for (long long output = 0; output < (long long) numOutputs; output++)
+        {
+            const ElemType* a = pa;
+            ElemType* c = pc;
+            size_t remaining = (size_t) output;
+            for (size_t k = 0; k < regularOpDims.size(); k++)
+            {
+                ptrdiff_t index = (ptrdiff_t) (remaining % regularOpDims[k]);
+                remaining /= regularOpDims[k];
+                a += index * regularStrides[0][k];
+                c += index * regularStrides[1][k];
+            }
+            finish(reduce(reducingDim, a), c);
+        }
+        return true;
+    }
+    else if (regularOpDims.size() == 1 && regularStrides[0][0] == 1 && regularStrides[1][0] == 1 && reducingStrides[0][0] > 0) // outermost
+    {
+        size_t rows = regularOpDims[0];
+        size_t numChunks = (rows + c_tensorKernelGrain - 1) / c_tensorKernelGrain;
+#pragma omp parallel for if (rows * reducingDim >= c_minElementsForParallelTensorKernel)
+        for (long long chunk = 0; chunk < (long long) numChunks; chunk++)
+        {
+            size_t begin = (size_t) chunk * c_tensorKernelGrain;
+            reduceColumns(min(c_tensorKernelGrain, rows - begin), reducingDim, pa + begin, (size_t) reducingStrides[0][0], pc + begin, alpha, beta);
+        }
+        return true;
+    }
+    return false;
+}
+
+// unary TensorOp through the vectorized kernels; returns false if they do not handle this case
+template <class ElemType>
+static bool TensorOpWithKernels(ElemType beta, const array<ElemType*, 2>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                const array<size_t, 2>& offsets,
+                                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
+                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
+{
+    const CPUTensorKernelTable<ElemType>* kernels = GetCPUTensorKernels<ElemType>();
+    if (!kernels)
+        return false;
+
+    if (!reducingOpDims.empty())
+        return op == ElementWiseOperator::opCopy &&
+               TensorReductionWithKernel(beta, pointers, alpha, *kernels, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    typename CPUTensorKernelTable<ElemType>::UnaryKernel kernel;
+    switch (op)
+    {
+    case ElementWiseOperator::opCopy:            kernel = kernels->copy;            break;
+    case ElementWiseOperator::opSigmoid:         kernel = kernels->sigmoid;         break;
+    case ElementWiseOperator::opTanh:            kernel = kernels->tanh;            break;
+    case ElementWiseOperator::opExp:             kernel = kernels->exp;             break;
+    case ElementWiseOperator::opLog:             kernel = kernels->log;             break;
+    case ElementWiseOperator::opLinearRectifier: kernel = kernels->linearRectifier; break;
+    default:                                     kernel = nullptr;
+    }
+    if (!kernel)
+        return false;
+    return TensorOpWithContiguousKernel(pointers, offsets, regularOpDims, regularStrides, reducingOpDims, [=](size_t n, const array<ElemType*, 2>& p)
+    {
+        kernel(n, p[0], p[1], alpha, beta);
+    });
+}
+
+// binary TensorOp through the vectorized kernels; returns false if they do not handle this case
+template <class ElemType>
+static bool TensorOpWithKernels(ElemType beta, const array<ElemType*, 3>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                const array<size_t, 3>& offsets,
+                                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
+                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
+{
+    const CPUTensorKernelTable<ElemType>* kernels = GetCPUTensorKernels<ElemType>();
+    if (!kernels || !reducingOpDims.empty())
+        return false;
+
+    typename CPUTensorKernelTable<ElemType>::BinaryKernel kernel;
+    switch (op)
+    {
+    case ElementWiseOperator::opSum:                                                       kernel = kernels->sum;                                                       break;
+    case ElementWiseOperator::opDifference:                                                kernel = kernels->difference;                                                break;
+    case ElementWiseOperator::opElementwiseProduct:                                        kernel = kernels->elementwiseProduct;                                        break;
+    case ElementWiseOperator::opElementwiseProductWithSigmoidDerivativeFromOutput:         kernel = kernels->elementwiseProductWithSigmoidDerivativeFromOutput;         break;
+    case ElementWiseOperator::opElementwiseProductWithTanhDerivativeFromOutput:            kernel = kernels->elementwiseProductWithTanhDerivativeFromOutput;            break;
+    case ElementWiseOperator::opElementwiseProductWithLinearRectifierDerivativeFromOutput: kernel = kernels->elementwiseProductWithLinearRectifierDerivativeFromOutput; break;
+    case ElementWiseOperator::opElementwiseProductWithLogDerivativeFromOutput:             kernel = kernels->elementwiseProductWithLogDerivativeFromOutput;             break;
+    default:                                                                               kernel = nullptr;
+    }
+    if (!kernel)
+        return false;
+    return TensorOpWithContiguousKernel(pointers, offsets, regularOpDims, regularStrides, reducingOpDims, [=](size_t n, const array<ElemType*, 3>& p)
+    {
+        kernel(n, p[0], p[1], p[2], alpha, beta);
+    });
+}
+
 // -----------------------------------------------------------------------
 // entry points from Matrix.cpp; also map op to a lambda
 // -----------------------------------------------------------------------
@@ -7084,6 +7308,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (TensorOpWithKernels(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -7112,6 +7338,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (TensorOpWithKernels(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -0,0 +1,570 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CPURNN.h"
+#include "TensorOps.h"
+#include <algorithm>
+#include <omp.h>
+
+#ifdef USE_MKL
+#include <mkl.h>
+#else
+#include <cblas.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// thin column-major wrappers over BLAS, so that the kernels below can address sub-blocks
+// (e.g. the forward or backward half of a bidirectional output) by pointer and leading dimension
+static void Gemm(bool transA, bool transB, size_t m, size_t n, size_t k, float alpha, const float* a, size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc)
+{
+    cblas_sgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans,
+                (int) m, (int) n, (int) k, alpha, const_cast<float*>(a), (int) lda, const_cast<float*>(b), (int) ldb, beta, c, (int) ldc);
+}
+
+static void Gemm(bool transA, bool transB, size_t m, size_t n, size_t k, double alpha, const double* a, size_t lda, const double* b, size_t ldb, double beta, double* c, size_t ldc)
+{
+    cblas_dgemm(CblasColMajor, transA ? CblasTrans : CblasNoTrans, transB ? CblasTrans : CblasNoTrans,
+                (int) m, (int) n, (int) k, alpha, const_cast<double*>(a), (int) lda, const_cast<double*>(b), (int) ldb, beta, c, (int) ldc);
+}
+
+static void Gemv(size_t m, size_t n, float alpha, const float* a, size_t lda, const float* x, float beta, float* y)
+{
+    cblas_sgemv(CblasColMajor, CblasNoTrans, (int) m, (int) n, alpha, const_cast<float*>(a), (int) lda, const_cast<float*>(x), 1, beta, y, 1);
+}
+
+static void Gemv(size_t m, size_t n, double alpha, const double* a, size_t lda, const double* x, double beta, double* y)
+{
+    cblas_dgemv(CblasColMajor, CblasNoTrans, (int) m, (int) n, alpha, const_cast<double*>(a), (int) lda, const_cast<double*>(x), 1, beta, y, 1);
+}
+
+// below this many elements per time step, the fused gate pass is not worth distributing over threads
+static const size_t c_minElementsForParallelGates = 4096;
+
+template <class ElemType>
+CPURNNExecutor<ElemType>::CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes)
+    : m_xDim(xDim), m_yDim(yDim),
+      m_rnnAttributes(rnnAttributes),
+      m_seqLength(0), m_numFrames(0), m_maxSequences(0),
+      m_reserveSize(0), m_workspacePerDirection(0), m_workspaceSize(0),
+      m_BackwardDataCalledYet(false)
+{
+    if      (m_rnnAttributes.m_recurrentOp == wstring(L"lstm"))    m_cellType = CellType::LSTM;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"gru"))     m_cellType = CellType::GRU;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"rnnReLU")) m_cellType = CellType::RNNReLU;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"rnnTanh")) m_cellType = CellType::RNNTanh;
+    else InvalidArgument("Unknown cell type '%ls'. Supported values are 'lstm', 'gru', 'rnnReLU', 'rnnTanh'.", m_rnnAttributes.m_recurrentOp.c_str());
+
+    if (m_yDim != NumDirections() * m_rnnAttributes.m_hiddenSize)
+        InvalidArgument("CPURNNExecutor: Output leading dimension must be twice hidden size for bidirectional networks");
+
+    // parameter layout does not depend on the minibatch, so it is computed once
+    const size_t numLayers = m_rnnAttributes.m_numLayers;
+    const size_t hidden = m_rnnAttributes.m_hiddenSize;
+    const size_t gateDim = NumGates() * hidden;
+    m_paramOffsets.resize(numLayers * NumDirections());
+    size_t offset = 0;
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        for (size_t dir = 0; dir < NumDirections(); dir++)
+        {
+            auto& p = m_paramOffsets[Index(layer, dir)];
+            p.m_W = offset; offset += LayerInputDim(layer) * gateDim;
+            p.m_R = offset; offset += hidden * gateDim;
+        }
+    }
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        for (size_t dir = 0; dir < NumDirections(); dir++)
+        {
+            auto& p = m_paramOffsets[Index(layer, dir)];
+            p.m_bW = offset; offset += gateDim;
+            p.m_bR = offset; offset += gateDim;
+        }
+    }
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::NumGates() const
+{
+    switch (m_cellType)
+    {
+    case CellType::LSTM: return 4;
+    case CellType::GRU:  return 3;
+    default:             return 1;
+    }
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::NumRecurrent(size_t dir, size_t t) const
+{
+    if (!HasPrevStep(dir, t))
+        return 0;
+    // sequences are sorted by decreasing length, hence the shorter of the two steps determines the count
+    return min(m_numSequencesForFrame[t], m_numSequencesForFrame[PrevStep(dir, t)]);
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ComputeLayout(size_t numFrames)
+{
+    const size_t numLayers = m_rnnAttributes.m_numLayers;
+    const size_t hidden = m_rnnAttributes.m_hiddenSize;
+    const size_t gateDim = NumGates() * hidden;
+
+    m_numFrames = numFrames;
+    m_seqLength = m_numSequencesForFrame.size();
+    m_frameOffsets.resize(m_seqLength);
+    m_maxSequences = 0;
+    size_t offset = 0;
+    for (size_t t = 0; t < m_seqLength; t++)
+    {
+        if (t > 0 && m_numSequencesForFrame[t] > m_numSequencesForFrame[t - 1])
+            InvalidArgument("CPURNNExecutor: sequences must be sorted by decreasing length");
+        m_frameOffsets[t] = offset;
+        offset += m_numSequencesForFrame[t];
+        m_maxSequences = max(m_maxSequences, m_numSequencesForFrame[t]);
+    }
+    if (offset != numFrames)
+        InvalidArgument("CPURNNExecutor: numSequencesForFrame describes %d frames, but the input has %d", (int) offset, (int) numFrames);
+
+    // reserve: per layer/direction state, followed by the outputs of all but the top layer
+    m_reserveOffsets.resize(numLayers * NumDirections());
+    offset = 0;
+    for (auto& r : m_reserveOffsets)
+    {
+        r.m_gates  = offset; offset += gateDim * numFrames;
+        r.m_cell   = offset; offset += hidden * numFrames;
+        r.m_dGates = offset; offset += gateDim * numFrames;
+        if (m_cellType == CellType::GRU)
+        {
+            r.m_dGatesRec = offset;
+            offset += gateDim * numFrames;
+        }
+        else
+            r.m_dGatesRec = r.m_dGates;
+    }
+    m_layerOutputOffsets.resize(numLayers);
+    for (size_t layer = 0; layer + 1 < numLayers; layer++)
+    {
+        m_layerOutputOffsets[layer] = offset;
+        offset += m_yDim * numFrames;
+    }
+    m_reserveSize = offset;
+
+    // workspace: per direction, the recurrent projection of one step and the gradients flowing
+    // into the previous step (two buffers for h, one for the LSTM cell); shared by all directions,
+    // the gradient w.r.t. a layer's input (two buffers) and a vector of ones for the bias gradients
+    m_workspacePerDirection = (gateDim + 3 * hidden) * m_maxSequences;
+    m_workspaceSize = NumDirections() * m_workspacePerDirection + 2 * m_yDim * numFrames + numFrames;
+}
+
+template <class ElemType>
+ElemType* CPURNNExecutor<ElemType>::LayerOutput(size_t layer, ElemType* reserve, ElemType* outputY) const
+{
+    return layer + 1 == m_rnnAttributes.m_numLayers ? outputY : reserve + m_layerOutputOffsets[layer];
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardDirection(size_t layer, size_t dir, const ElemType* x, size_t ldx, ElemType* y, const ElemType* w, ElemType* reserve, ElemType* workspace)
+{
+    const size_t hidden = m_rnnAttributes.m_hiddenSize;
+    const size_t gateDim = NumGates() * hidden;
+    const size_t inputDim = LayerInputDim(layer);
+    const auto& p = m_paramOffsets[Index(layer, dir)];
+    const auto& r = m_reserveOffsets[Index(layer, dir)];
+    const ElemType* R = w + p.m_R;
+    const ElemType* bW = w + p.m_bW;
+    const ElemType* bR = w + p.m_bR;
+    ElemType* gates = reserve + r.m_gates;
+    ElemType* cell = reserve + r.m_cell;
+    ElemType* rec = workspace;
+    ElemType* yDir = y + dir * hidden;
+    const size_t ldy = m_yDim;
+    const CellType cellType = m_cellType;
+
+    // input projection of all time steps at once
+    Gemm(true, false, gateDim, m_numFrames, inputDim, (ElemType) 1, w + p.m_W, inputDim, x, ldx, (ElemType) 0, gates, gateDim);
+
+    for (size_t s = 0; s < m_seqLength; s++)
+    {
+        const size_t t = dir == 0 ? s : m_seqLength - 1 - s;
+        const size_t n = m_numSequencesForFrame[t];
+        const size_t nr = NumRecurrent(dir, t);
+        const size_t cur = m_frameOffsets[t];
+        const size_t prev = nr > 0 ? m_frameOffsets[PrevStep(dir, t)] : 0;
+
+        // recurrent projection for the sequences that have a predecessor
+        if (nr > 0)
+            Gemm(true, false, gateDim, nr, hidden, (ElemType) 1, R, hidden, yDir + prev * ldy, ldy, (ElemType) 0, rec, gateDim);
+
+        // fused gate nonlinearities and state update, one sequence per iteration
+#pragma omp parallel for if (n * gateDim >= c_minElementsForParallelGates)
+        for (long jj = 0; jj < (long) n; jj++)
+        {
+            const size_t j = (size_t) jj;
+            const bool hasPrev = j < nr;
+            ElemType* a = gates + (cur + j) * gateDim;
+            const ElemType* rj = rec + j * gateDim;
+            ElemType* h = yDir + (cur + j) * ldy;
+            const ElemType* hPrev = yDir + (prev + j) * ldy;
+            switch (cellType)
+            {
+            case CellType::LSTM:
+            {
+                ElemType* c = cell + (cur + j) * hidden;
+                const ElemType* cPrev = cell + (prev + j) * hidden;
+                for (size_t k = 0; k < hidden; k++)
+                {
+                    ElemType ai = a[k]              + bW[k]              + bR[k];
+                    ElemType af = a[k + hidden]     + bW[k + hidden]     + bR[k + hidden];
+                    ElemType ag = a[k + 2 * hidden] + bW[k + 2 * hidden] + bR[k + 2 * hidden];
+                    ElemType ao = a[k + 3 * hidden] + bW[k + 3 * hidden] + bR[k + 3 * hidden];
+                    if (hasPrev)
+                    {
+                        ai += rj[k];
+                        af += rj[k + hidden];
+                        ag += rj[k + 2 * hidden];
+                        ao += rj[k + 3 * hidden];
+                    }
+                    const ElemType i = Sigmoid(ai);
+                    const ElemType f = Sigmoid(af);
+                    const ElemType g = tanh_(ag);
+                    const ElemType o = Sigmoid(ao);
+                    const ElemType ct = i * g + (hasPrev ? f * cPrev[k] : 0);
+                    a[k] = i;
+                    a[k + hidden] = f;
+                    a[k + 2 * hidden] = g;
+                    a[k + 3 * hidden] = o;
+                    c[k] = ct;
+                    h[k] = o * tanh_(ct);
+                }
+                break;
+            }
+            case CellType::GRU:
+            {
+                ElemType* u = cell + (cur + j) * hidden;
+                for (size_t k = 0; k < hidden; k++)
+                {
+                    ElemType ar = a[k]          + bW[k]          + bR[k];
+                    ElemType az = a[k + hidden] + bW[k + hidden] + bR[k + hidden];
+                    ElemType uk = bR[k + 2 * hidden];
+                    if (hasPrev)
+                    {
+                        ar += rj[k];
+                        az += rj[k + hidden];
+                        uk += rj[k + 2 * hidden];
+                    }
+                    const ElemType rr = Sigmoid(ar);
+                    const ElemType z = Sigmoid(az);
+                    const ElemType hc = tanh_(a[k + 2 * hidden] + bW[k + 2 * hidden] + rr * uk);
+                    a[k] = rr;
+                    a[k + hidden] = z;
+                    a[k + 2 * hidden] = hc;
+                    u[k] = uk;
+                    h[k] = (1 - z) * hc + (hasPrev ? z * hPrev[k] : 0);
+                }
+                break;
+            }
+            case CellType::RNNReLU:
+            case CellType::RNNTanh:
+            {
+                for (size_t k = 0; k < hidden; k++)
+                {
+                    ElemType ak = a[k] + bW[k] + bR[k] + (hasPrev ? rj[k] : 0);
+                    ak = cellType == CellType::RNNReLU ? max(ak, (ElemType) 0) : tanh_(ak);
+                    a[k] = ak;
+                    h[k] = ak;
+                }
+                break;
+            }
+            }
+        }
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardDirection(size_t layer, size_t dir, const ElemType* y, const ElemType* dy, const ElemType* w, ElemType* reserve, ElemType* workspace)
+{
+    const size_t hidden = m_rnnAttributes.m_hiddenSize;
+    const size_t gateDim = NumGates() * hidden;
+    const auto& p = m_paramOffsets[Index(layer, dir)];
+    const auto& r = m_reserveOffsets[Index(layer, dir)];
+    const ElemType* R = w + p.m_R;
+    const ElemType* gates = reserve + r.m_gates;
+    const ElemType* cell = reserve + r.m_cell;
+    ElemType* dGates = reserve + r.m_dGates;
+    ElemType* dGatesRec = reserve + r.m_dGatesRec;
+    const ElemType* yDir = y + dir * hidden;
+    const ElemType* dyDir = dy + dir * hidden;
+    const size_t ldy = m_yDim;
+    const CellType cellType = m_cellType;
+
+    // gradients flowing from one step into its predecessor
+    ElemType* dhRec  = workspace + gateDim * m_maxSequences;
+    ElemType* dhNext = dhRec + hidden * m_maxSequences;
+    ElemType* dcRec  = dhNext + hidden * m_maxSequences;
+
+    // walk the steps in the reverse of the forward processing order
+    size_t numIncoming = 0;
+    for (size_t s = 0; s < m_seqLength; s++)
+    {
+        const size_t t = dir == 0 ? m_seqLength - 1 - s : s;
+        const size_t n = m_numSequencesForFrame[t];
+        const size_t nr = NumRecurrent(dir, t);
+        const size_t cur = m_frameOffsets[t];
+        const size_t prev = nr > 0 ? m_frameOffsets[PrevStep(dir, t)] : 0;
+
+#pragma omp parallel for if (n * gateDim >= c_minElementsForParallelGates)
+        for (long jj = 0; jj < (long) n; jj++)
+        {
+            const size_t j = (size_t) jj;
+            const bool hasPrev = j < nr;
+            const bool hasIncoming = j < numIncoming;
+            const ElemType* a = gates + (cur + j) * gateDim;
+            const ElemType* dh = dyDir + (cur + j) * ldy;
+            const ElemType* dhr = dhRec + j * hidden;
+            ElemType* da = dGates + (cur + j) * gateDim;
+            switch (cellType)
+            {
+            case CellType::LSTM:
+            {
+                const ElemType* c = cell + (cur + j) * hidden;
+                const ElemType* cPrev = cell + (prev + j) * hidden;
+                ElemType* dc = dcRec + j * hidden;
+                for (size_t k = 0; k < hidden; k++)
+                {
+                    const ElemType i = a[k];
+                    const ElemType f = a[k + hidden];
+                    const ElemType g = a[k + 2 * hidden];
+                    const ElemType o = a[k + 3 * hidden];
+                    const ElemType tc = tanh_(c[k]);
+                    const ElemType dhk = dh[k] + (hasIncoming ? dhr[k] : 0);
+                    const ElemType dck = dhk * o * (1 - tc * tc) + (hasIncoming ? dc[k] : 0);
+                    da[k]              = dck * g * i * (1 - i);
+                    da[k + hidden]     = hasPrev ? dck * cPrev[k] * f * (1 - f) : 0;
+                    da[k + 2 * hidden] = dck * i * (1 - g * g);
+                    da[k + 3 * hidden] = dhk * tc * o * (1 - o);
+                    if (hasPrev)
+                        dc[k] = dck * f;
+                }
+                break;
+            }
+            case CellType::GRU:
+            {
+                const ElemType* u = cell + (cur + j) * hidden;
+                const ElemType* hPrev = yDir + (prev + j) * ldy;
+                ElemType* daRec = dGatesRec + (cur + j) * gateDim;
+                ElemType* dhp = dhNext + j * hidden;
+                for (size_t k = 0; k < hidden; k++)
+                {
+                    const ElemType rr = a[k];
+                    const ElemType z = a[k + hidden];
+                    const ElemType hc = a[k + 2 * hidden];
+                    const ElemType hp = hasPrev ? hPrev[k] : 0;
+                    const ElemType dhk = dh[k] + (hasIncoming ? dhr[k] : 0);
+                    const ElemType dhc = dhk * (1 - z) * (1 - hc * hc);
+                    const ElemType dr = dhc * u[k] * rr * (1 - rr);
+                    const ElemType dz = dhk * (hp - hc) * z * (1 - z);
+                    da[k] = dr;
+                    da[k + hidden] = dz;
+                    da[k + 2 * hidden] = dhc;
+                    daRec[k] = dr;
+                    daRec[k + hidden] = dz;
+                    daRec[k + 2 * hidden] = dhc * rr;
+                    if (hasPrev)
+                        dhp[k] = dhk * z; // direct path of h_{t-1} into h_t; the recurrent GEMM adds to this
+                }
+                break;
+            }
+            case CellType::RNNReLU:
+            case CellType::RNNTanh:
+            {
+                for (size_t k = 0; k < hidden; k++)
+                {
+                    const ElemType hk = a[k];
+                    const ElemType dhk = dh[k] + (hasIncoming ? dhr[k] : 0);
+                    da[k] = cellType == CellType::RNNReLU ? (hk > 0 ? dhk : 0) : dhk * (1 - hk * hk);
+                }
+                break;
+            }
+            }
+        }
+
+        // gradient w.r.t. the hidden state of the predecessor step
+        if (nr > 0)
+            Gemm(false, false, hidden, nr, gateDim, (ElemType) 1, R, hidden, dGatesRec + cur * gateDim, gateDim,
+                 cellType == CellType::GRU ? (ElemType) 1 : (ElemType) 0, dhNext, hidden);
+        swap(dhRec, dhNext);
+        numIncoming = nr;
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardCore(
+    const CPUMatrix<ElemType>& weightsW,
+    const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY,
+    const vector<size_t>& numSequencesForFrame,
+    const RnnAttributes& rnnAttributes,
+    CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    // test that the RNN shape is correct
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+    if (inputX.GetNumRows() != m_xDim)
+        InvalidArgument("CPURNNExecutor: input has %d rows, but %d were expected", (int) inputX.GetNumRows(), (int) m_xDim);
+
+    const auto& lastParams = m_paramOffsets.back();
+    const size_t numParameters = lastParams.m_bR + NumGates() * m_rnnAttributes.m_hiddenSize;
+    if (numParameters != weightsW.GetNumElements())
+        InvalidArgument("RNN needs %ld parameters, but %ld were allocated", numParameters, weightsW.GetNumElements());
+
+    m_numSequencesForFrame = numSequencesForFrame;
+    ComputeLayout(inputX.GetNumCols());
+
+    reserve.Resize(m_reserveSize, 1);
+    workspace.Resize(m_workspaceSize, 1);
+    outputY.RequireSize(m_yDim, m_numFrames);
+
+    ElemType* r = reserve.Data();
+    ElemType* ws = workspace.Data();
+    const ElemType* w = weightsW.Data();
+    const long numDirections = (long) NumDirections();
+    for (size_t layer = 0; layer < m_rnnAttributes.m_numLayers; layer++)
+    {
+        const ElemType* x = layer == 0 ? inputX.Data() : LayerOutput(layer - 1, r, outputY.Data());
+        const size_t ldx = layer == 0 ? m_xDim : m_yDim;
+        ElemType* y = LayerOutput(layer, r, outputY.Data());
+
+        // the two directions of a bidirectional layer are independent
+#pragma omp parallel for num_threads(numDirections) if (numDirections > 1)
+        for (long dir = 0; dir < numDirections; dir++)
+            ForwardDirection(layer, (size_t) dir, x, ldx, y, w, r, ws + dir * m_workspacePerDirection);
+    }
+    m_BackwardDataCalledYet = false;
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardDataCore(
+    const CPUMatrix<ElemType>& outputY, const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& weightsW, CPUMatrix<ElemType>& dx,
+    const RnnAttributes& rnnAttributes,
+    CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    // test that the RNN shape is correct
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+    if (reserve.GetNumElements() < m_reserveSize || workspace.GetNumElements() < m_workspaceSize)
+        LogicError("RNNBackwardData: reserve or workspace was modified after RNNForward");
+
+    if (m_BackwardDataCalledYet)
+        return;
+
+    dx.RequireSize(m_xDim, m_numFrames);
+
+    ElemType* r = reserve.Data();
+    ElemType* ws = workspace.Data();
+    const ElemType* w = weightsW.Data();
+    const size_t gateDim = NumGates() * m_rnnAttributes.m_hiddenSize;
+    const long numDirections = (long) NumDirections();
+
+    // gradients w.r.t. the intermediate layer outputs ping-pong between two workspace buffers
+    ElemType* layerGrad[2] = { ws + numDirections * m_workspacePerDirection, ws + numDirections * m_workspacePerDirection + m_yDim * m_numFrames };
+    const ElemType* dy = outputDY.Data();
+    for (size_t layer = m_rnnAttributes.m_numLayers; layer-- > 0;)
+    {
+        const ElemType* y = LayerOutput(layer, r, const_cast<ElemType*>(outputY.Data()));
+
+#pragma omp parallel for num_threads(numDirections) if (numDirections > 1)
+        for (long dir = 0; dir < numDirections; dir++)
+            BackwardDirection(layer, (size_t) dir, y, dy, w, r, ws + dir * m_workspacePerDirection);
+
+        // gradient w.r.t. the layer input, summed over the directions
+        const size_t inputDim = LayerInputDim(layer);
+        ElemType* dIn = layer == 0 ? dx.Data() : layerGrad[layer % 2];
+        for (size_t dir = 0; dir < (size_t) numDirections; dir++)
+            Gemm(false, false, inputDim, m_numFrames, gateDim, (ElemType) 1, w + m_paramOffsets[Index(layer, dir)].m_W, inputDim,
+                 r + m_reserveOffsets[Index(layer, dir)].m_dGates, gateDim, dir == 0 ? (ElemType) 0 : (ElemType) 1, dIn, inputDim);
+        dy = dIn;
+    }
+    m_BackwardDataCalledYet = true;
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardWeightsCore(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw,
+    const RnnAttributes& rnnAttributes,
+    CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    // test that the RNN shape is correct
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+    if (!m_BackwardDataCalledYet)
+        LogicError("RNNBackwardWeights: RNNBackwardData must be called first");
+    if (dw.GetNumElements() != m_paramOffsets.back().m_bR + NumGates() * m_rnnAttributes.m_hiddenSize)
+        InvalidArgument("RNNBackwardWeights: gradient has %ld elements, which does not match the parameters", dw.GetNumElements());
+
+    ElemType* r = reserve.Data();
+    ElemType* ws = workspace.Data();
+    ElemType* dW = dw.Data();
+    const size_t hidden = m_rnnAttributes.m_hiddenSize;
+    const size_t gateDim = NumGates() * hidden;
+    const long numDirections = (long) NumDirections();
+
+    // the layer gradient buffers are no longer needed; reuse them for the shifted hidden states
+    ElemType* shared = ws + numDirections * m_workspacePerDirection;
+    ElemType* ones = shared + 2 * m_yDim * m_numFrames;
+    fill(ones, ones + m_numFrames, (ElemType) 1);
+
+    for (size_t layer = 0; layer < m_rnnAttributes.m_numLayers; layer++)
+    {
+        const ElemType* x = layer == 0 ? inputX.Data() : LayerOutput(layer - 1, r, const_cast<ElemType*>(outputY.Data()));
+        const size_t ldx = layer == 0 ? m_xDim : m_yDim;
+        const size_t inputDim = LayerInputDim(layer);
+        const ElemType* y = LayerOutput(layer, r, const_cast<ElemType*>(outputY.Data()));
+
+#pragma omp parallel for num_threads(numDirections) if (numDirections > 1)
+        for (long dirl = 0; dirl < numDirections; dirl++)
+        {
+            const size_t dir = (size_t) dirl;
+            const auto& p = m_paramOffsets[Index(layer, dir)];
+            const auto& ro = m_reserveOffsets[Index(layer, dir)];
+            const ElemType* dGates = r + ro.m_dGates;
+            const ElemType* dGatesRec = r + ro.m_dGatesRec;
+
+            // input weights: dW += X dGates^T, over all frames at once
+            Gemm(false, true, inputDim, gateDim, m_numFrames, (ElemType) 1, x, ldx, dGates, gateDim, (ElemType) 1, dW + p.m_W, inputDim);
+
+            // recurrent weights: gather the predecessor hidden state of every frame (zero if none), then dR += Hprev dGatesRec^T
+            ElemType* hPrev = shared + dir * hidden * m_numFrames;
+            for (size_t t = 0; t < m_seqLength; t++)
+            {
+                const size_t n = m_numSequencesForFrame[t];
+                const size_t nr = NumRecurrent(dir, t);
+                const size_t cur = m_frameOffsets[t];
+                const size_t prev = nr > 0 ? m_frameOffsets[PrevStep(dir, t)] : 0;
+                for (size_t j = 0; j < n; j++)
+                {
+                    ElemType* dst = hPrev + (cur + j) * hidden;
+                    if (j < nr)
+                    {
+                        const ElemType* src = y + dir * hidden + (prev + j) * m_yDim;
+                        copy(src, src + hidden, dst);
+                    }
+                    else
+                        fill(dst, dst + hidden, (ElemType) 0);
+                }
+            }
+            Gemm(false, true, hidden, gateDim, m_numFrames, (ElemType) 1, hPrev, hidden, dGatesRec, gateDim, (ElemType) 1, dW + p.m_R, hidden);
+
+            // biases: column sums of the gate gradients
+            Gemv(gateDim, m_numFrames, (ElemType) 1, dGates, gateDim, ones, (ElemType) 1, dW + p.m_bW);
+            Gemv(gateDim, m_numFrames, (ElemType) 1, dGatesRec, gateDim, ones, (ElemType) 1, dW + p.m_bR);
+        }
+    }
+}
+
+template class CPURNNExecutor<float>;
+template class CPURNNExecutor<double>;
+
+}}}
@@ -0,0 +1,108 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "Matrix.h"
+#include "CPUMatrix.h"
+#include "RNNCommon.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// CPURNNExecutor is the CPU counterpart of CuDnnRNNExecutor. It consumes the same packed
+// parameter layout and the same "dense CuDNN packing" of the sequences, so that a model
+// that uses OptimizedRNNStack can be trained and evaluated without a GPU.
+//
+// Parameter layout (identical to cuDNN with CUDNN_LINEAR_INPUT):
+//   for each layer, for each direction: W [inputDim x numGates*hidden], R [hidden x numGates*hidden]
+//   then, for each layer, for each direction: bW [numGates*hidden], bR [numGates*hidden]
+// Gate order is i, f, c, o for LSTM and r, z, h for GRU, as in cuDNN.
+//
+// Data layout: column k of the input/output is one frame; frames are sorted by time step,
+// and inside a time step by sequence, with sequences sorted by decreasing length. Therefore
+// sequence j is present at time step t iff j < numSequencesForFrame[t].
+//
+// The input projections of all time steps are computed with a single GEMM per layer and
+// direction; the recurrent projection is one GEMM per time step, followed by a fused pass
+// that applies all gate nonlinearities. Directions run concurrently, and each fused pass is
+// parallelized across sequences.
+template <class ElemType>
+class CPURNNExecutor
+{
+public:
+    CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes);
+
+    void ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+    void BackwardDataCore(const CPUMatrix<ElemType>& outputY, const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& weightsW, CPUMatrix<ElemType>& dx, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+    void BackwardWeightsCore(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+
+private:
+    enum class CellType
+    {
+        LSTM,
+        GRU,
+        RNNReLU,
+        RNNTanh
+    };
+
+    // offsets (in elements) of the pieces of one layer/direction inside the parameter vector
+    struct ParameterOffsets
+    {
+        size_t m_W;
+        size_t m_R;
+        size_t m_bW;
+        size_t m_bR;
+    };
+
+    // offsets (in elements) of the per-layer/direction state kept in the 'reserve' matrix between calls
+    struct ReserveOffsets
+    {
+        size_t m_gates;      // [numGates*hidden x numFrames] gate activations (after the nonlinearity)
+        size_t m_cell;       // [hidden x numFrames] LSTM cell state, or GRU recurrent candidate term R_h h + bR_h
+        size_t m_dGates;     // [numGates*hidden x numFrames] gradient w.r.t. the gate pre-activations (input side)
+        size_t m_dGatesRec;  // [numGates*hidden x numFrames] same, recurrent side (differs from m_dGates only for GRU)
+    };
+
+    size_t NumDirections() const { return m_rnnAttributes.m_bidirectional ? 2 : 1; }
+    size_t NumGates() const;
+    size_t LayerInputDim(size_t layer) const { return layer == 0 ? m_xDim : m_yDim; }
+    size_t Index(size_t layer, size_t dir) const { return layer * NumDirections() + dir; }
+
+    void ComputeLayout(size_t numFrames);
+
+    // the previous step of a sequence at time step t, in processing order of the direction
+    bool HasPrevStep(size_t dir, size_t t) const { return dir == 0 ? t > 0 : t + 1 < m_seqLength; }
+    size_t PrevStep(size_t dir, size_t t) const { return dir == 0 ? t - 1 : t + 1; }
+    // number of sequences at time step t that have a predecessor in processing order
+    size_t NumRecurrent(size_t dir, size_t t) const;
+
+    void ForwardDirection(size_t layer, size_t dir, const ElemType* x, size_t ldx, ElemType* y, const ElemType* w, ElemType* reserve, ElemType* workspace);
+    void BackwardDirection(size_t layer, size_t dir, const ElemType* y, const ElemType* dy, const ElemType* w, ElemType* reserve, ElemType* workspace);
+
+    // output of layer 'layer' ([yDim x numFrames]); the top layer writes straight to outputY
+    ElemType* LayerOutput(size_t layer, ElemType* reserve, ElemType* outputY) const;
+
+private:
+    size_t m_xDim, m_yDim;
+    RnnAttributes m_rnnAttributes;
+    CellType m_cellType;
+
+    vector<size_t> m_numSequencesForFrame;
+    vector<size_t> m_frameOffsets; // first column of each time step
+    size_t m_seqLength;
+    size_t m_numFrames;
+    size_t m_maxSequences;
+
+    vector<ParameterOffsets> m_paramOffsets;
+    vector<ReserveOffsets> m_reserveOffsets;
+    vector<size_t> m_layerOutputOffsets;
+    size_t m_reserveSize;
+    size_t m_workspacePerDirection;
+    size_t m_workspaceSize;
+
+    bool m_BackwardDataCalledYet;
+};
+
+}}}
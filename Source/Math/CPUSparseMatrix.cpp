@@ -17,6 +17,11 @@
 #include <random>
 #include <chrono>
 #include <iostream>
+#include <unordered_map>
+#include <limits>
+#if !defined(__aarch64__)
+#include <xmmintrin.h> // for _mm_prefetch
+#endif
 #ifdef LEAKDETECT
 #include <vld.h>
 #endif
@@ -870,6 +875,241 @@ void CPUSparseMatrix<ElemType>::Reset()
     SetBlockIdShift(0);
 }
 
+// -----------------------------------------------------------------------
+// kernel of the products of a sparse and a dense matrix
+// -----------------------------------------------------------------------
+
+// Approximate per-core L2 cache size, used to size the panels of the dense matrices that a thread works on at a time.
+static const size_t s_sparseDenseL2CacheBytes = 256 * 1024;
+// Minimum length of a panel, so that the vectorized loops along a panel stay long enough.
+static const size_t s_sparseDenseMinPanelLength = 64;
+// Number of multiply-adds below which the product runs on a single thread.
+static const size_t s_sparseDenseMinParallelWork = 16 * 1024;
+
+// y += alpha * x for vectors of n elements with the given strides
+static void SparseDenseAxpy(size_t n, float alpha, const float* x, size_t incx, float* y, size_t incy)
+{
+    cblas_saxpy((int) n, alpha, x, (int) incx, y, (int) incy);
+}
+
+static void SparseDenseAxpy(size_t n, double alpha, const double* x, size_t incx, double* y, size_t incy)
+{
+    cblas_daxpy((int) n, alpha, x, (int) incx, y, (int) incy);
+}
+
+// The nonzeros of a CSC matrix grouped by column, as they are stored, or otherwise (e.g. by row), which requires a
+// reordered copy of the index. Group g holds the nonzeros [m_starts[g], m_starts[g + 1]); m_indices holds their row
+// index when grouped by column, and their column index otherwise.
+template <class ElemType>
+class SparseNonzeroGroups
+{
+public:
+    SparseNonzeroGroups(const CPUSparseMatrix<ElemType>& csc, bool byColumn)
+    {
+        const CPUSPARSE_INDEX_TYPE* colStarts = csc.SecondaryIndexLocation();
+        const CPUSPARSE_INDEX_TYPE* rows = csc.MajorIndexLocation() - colStarts[0];
+        if (byColumn)
+        {
+            m_numGroups = csc.GetNumCols();
+            m_starts = colStarts;
+            m_indices = rows;
+            m_values = csc.Buffer();
+            return;
+        }
+
+        GroupBy(csc, csc.GetNumRows(), [rows](CPUSPARSE_INDEX_TYPE p) { return (size_t) rows[p]; });
+    }
+
+    // Groups the nonzeros by groupOfNonzero[p], where p counts the nonzeros of csc from 0.
+    // Unlike grouping by row, this takes no time or memory for the rows without nonzeros.
+    SparseNonzeroGroups(const CPUSparseMatrix<ElemType>& csc, size_t numGroups, const std::vector<size_t>& groupOfNonzero)
+    {
+        CPUSPARSE_INDEX_TYPE firstNonzero = csc.SecondaryIndexLocation()[0];
+        GroupBy(csc, numGroups, [firstNonzero, &groupOfNonzero](CPUSPARSE_INDEX_TYPE p) { return groupOfNonzero[p - firstNonzero]; });
+    }
+
+    size_t NumGroups() const { return m_numGroups; }
+    size_t NzCount() const { return m_starts[m_numGroups] - m_starts[0]; }
+
+    // Splits the groups into at most numParts consecutive ranges with about the same number of nonzeros.
+    // Returns the boundaries of the ranges.
+    std::vector<size_t> PartitionByNonzeros(size_t numParts) const
+    {
+        std::vector<size_t> boundaries(1, 0);
+        for (size_t part = 1; part < numParts; part++)
+        {
+            auto target = (CPUSPARSE_INDEX_TYPE)(m_starts[0] + NzCount() * part / numParts);
+            size_t boundary = std::lower_bound(m_starts + boundaries.back(), m_starts + m_numGroups, target) - m_starts;
+            if (boundary > boundaries.back())
+                boundaries.push_back(boundary);
+        }
+        if (m_numGroups > boundaries.back())
+            boundaries.push_back(m_numGroups);
+        return boundaries;
+    }
+
+    const CPUSPARSE_INDEX_TYPE* m_starts;
+    const CPUSPARSE_INDEX_TYPE* m_indices;
+    const ElemType* m_values;
+
+private:
+    // counting sort of the nonzeros by groupOf(index of the nonzero in csc); within a group, they stay ordered by column
+    template <class GroupOf>
+    void GroupBy(const CPUSparseMatrix<ElemType>& csc, size_t numGroups, const GroupOf& groupOf)
+    {
+        const CPUSPARSE_INDEX_TYPE* colStarts = csc.SecondaryIndexLocation();
+        m_numGroups = numGroups;
+        m_groupedStarts.assign(m_numGroups + 1, 0);
+        for (CPUSPARSE_INDEX_TYPE p = colStarts[0]; p < colStarts[csc.GetNumCols()]; p++)
+            m_groupedStarts[groupOf(p) + 1]++;
+        for (size_t group = 0; group < m_numGroups; group++)
+            m_groupedStarts[group + 1] += m_groupedStarts[group];
+
+        size_t nnz = m_groupedStarts[m_numGroups];
+        m_groupedIndices.resize(nnz);
+        m_groupedValues.resize(nnz);
+        std::vector<CPUSPARSE_INDEX_TYPE> next(m_groupedStarts.begin(), m_groupedStarts.end() - 1);
+        for (size_t col = 0; col < csc.GetNumCols(); col++)
+        {
+            for (CPUSPARSE_INDEX_TYPE p = colStarts[col]; p < colStarts[col + 1]; p++)
+            {
+                CPUSPARSE_INDEX_TYPE q = next[groupOf(p)]++;
+                m_groupedIndices[q] = (CPUSPARSE_INDEX_TYPE) col;
+                m_groupedValues[q] = csc.Buffer()[p];
+            }
+        }
+        m_starts = m_groupedStarts.data();
+        m_indices = m_groupedIndices.data();
+        m_values = m_groupedValues.data();
+    }
+
+    size_t m_numGroups;
+    std::vector<CPUSPARSE_INDEX_TYPE> m_groupedStarts;
+    std::vector<CPUSPARSE_INDEX_TYPE> m_groupedIndices;
+    std::vector<ElemType> m_groupedValues;
+};
+
+// Prefetches the cache line at p for reading.
+static inline void PrefetchForRead(const void* p)
+{
+#if defined(__aarch64__)
+    __builtin_prefetch(p);
+#else
+    _mm_prefetch((const char*) p, _MM_HINT_T0);
+#endif
+}
+
+// Whether a CSC matrix has at most one nonzero in each column, like a minibatch of one-hot vectors, in which
+// e.g. the gaps of sequences are empty.
+template <class ElemType>
+static bool HasAtMostOneNonzeroPerColumn(const CPUSparseMatrix<ElemType>& csc)
+{
+    const CPUSPARSE_INDEX_TYPE* colStarts = csc.SecondaryIndexLocation();
+    for (size_t col = 0; col < csc.GetNumCols(); col++)
+    {
+        if (colStarts[col + 1] - colStarts[col] > 1)
+            return false;
+    }
+    return true;
+}
+
+// c = alpha * dense * oneHot + beta * c, where oneHot has at most one nonzero in each column. This is the lookup of an
+// embedding: each column of c is a scaled copy of the column of 'dense' that the nonzero selects (or beta * c for an
+// empty column), so c is written once, without the initialization and the accumulation of the general product.
+template <class ElemType>
+static void GatherColumns(ElemType alpha, const CPUMatrix<ElemType>& dense, const CPUSparseMatrix<ElemType>& oneHot, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    const CPUSPARSE_INDEX_TYPE* colStarts = oneHot.SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* rows = oneHot.MajorIndexLocation() - colStarts[0];
+    const ElemType* values = oneHot.Buffer();
+    const ElemType* denseData = dense.Data();
+    ElemType* cData = c.Data();
+    const size_t m = dense.GetNumRows();
+    const long n = (long) oneHot.GetNumCols();
+    const size_t elementsPerCacheLine = 64 / sizeof(ElemType);
+
+#pragma omp parallel for if (n * m >= s_sparseDenseMinParallelWork)
+    for (long col = 0; col < n; col++)
+    {
+        // the columns of an embedding are read in random order, so fetch the next one while copying this one
+        if (col + 1 < n && colStarts[col + 2] > colStarts[col + 1])
+        {
+            const ElemType* next = denseData + rows[colStarts[col + 1]] * m;
+            for (size_t i = 0; i < m; i += elementsPerCacheLine)
+                PrefetchForRead(next + i);
+        }
+
+        ElemType* to = cData + col * m;
+        if (colStarts[col + 1] == colStarts[col]) // no nonzero
+        {
+            if (beta == 0)
+                memset(to, 0, sizeof(ElemType) * m);
+            else if (beta != 1)
+            {
+                for (size_t i = 0; i < m; i++)
+                    to[i] *= beta;
+            }
+            continue;
+        }
+
+        const ElemType* from = denseData + rows[colStarts[col]] * m;
+        ElemType scale = alpha * values[colStarts[col]];
+        if (beta == 0) // don't even read the memory if beta is 0
+        {
+            for (size_t i = 0; i < m; i++)
+                to[i] = scale * from[i];
+        }
+        else
+        {
+            for (size_t i = 0; i < m; i++)
+                to[i] = scale * from[i] + beta * to[i];
+        }
+    }
+}
+
+// For every nonzero of group g with index i and value v, adds alpha * v * (line i of 'dense') to line targetLines[g]
+// (line g if targetLines is null) of 'c'. A line of a matrix is a vector of 'length' elements; the strides give the
+// distance between the elements of a line and between the lines.
+// Only one thread writes to a line of c at a time: the groups are split into ranges with the same number of nonzeros,
+// one per thread, and the lines into panels such that the parts of the lines a thread works on fit into the L2 cache.
+// The panels of the ranges are processed in parallel.
+template <class ElemType>
+static void SparseDenseAccumulate(ElemType alpha, const SparseNonzeroGroups<ElemType>& groups, const size_t* targetLines, size_t length,
+                                  const ElemType* dense, size_t denseStride, size_t denseLineStride,
+                                  ElemType* c, size_t cStride, size_t cLineStride)
+{
+    size_t nnz = groups.NzCount();
+    if (nnz == 0 || length == 0)
+        return;
+
+    std::vector<size_t> ranges = groups.PartitionByNonzeros(omp_get_max_threads());
+    size_t numRanges = ranges.size() - 1;
+
+    // a range touches at most this many lines of the dense matrix and of c
+    size_t linesPerRange = std::min(nnz, nnz / numRanges + groups.NumGroups() / numRanges + 2);
+    size_t panelLength = std::max(s_sparseDenseMinPanelLength, s_sparseDenseL2CacheBytes / (sizeof(ElemType) * linesPerRange));
+    panelLength = std::min(panelLength, length);
+    size_t numPanels = (length + panelLength - 1) / panelLength;
+
+#pragma omp parallel for schedule(dynamic) if (nnz * length >= s_sparseDenseMinParallelWork)
+    for (long task = 0; task < (long) (numRanges * numPanels); task++)
+    {
+        size_t range = task % numRanges;
+        size_t panelBegin = (task / numRanges) * panelLength;
+        size_t panelEnd = std::min(panelBegin + panelLength, length);
+        for (size_t group = ranges[range]; group < ranges[range + 1]; group++)
+        {
+            size_t line = targetLines ? targetLines[group] : group;
+            ElemType* cLine = c + line * cLineStride + panelBegin * cStride;
+            for (CPUSPARSE_INDEX_TYPE p = groups.m_starts[group]; p < groups.m_starts[group + 1]; p++)
+            {
+                const ElemType* denseLine = dense + groups.m_indices[p] * denseLineStride + panelBegin * denseStride;
+                SparseDenseAxpy(panelEnd - panelBegin, alpha * groups.m_values[p], denseLine, denseStride, cLine, cStride);
+            }
+        }
+    }
+}
+
 // Implements product of one sparse and one dense matrix updating a third dense matrix. Input matrices are optionally transposed.
 // NOTE: The only for using a class template instead of a function template was that I couldn't make the function template compile.
 template <class ElemType, bool denseTimesSparse /* false means SparseTimesDense */, bool transposeA, bool transposeB>
@@ -903,6 +1143,13 @@ public:
         else
             c.VerifySize(m, n); // Can't resize if beta != 0
 
+        // Fast path for the lookup of an embedding with one-hot vectors.
+        if (denseTimesSparse && !transposeA && !transposeB && !dense.IsEmpty() && sparse.GetFormat() == matrixFormatSparseCSC && HasAtMostOneNonzeroPerColumn(sparse))
+        {
+            GatherColumns(alpha, dense, sparse, beta, c);
+            return;
+        }
+
         if (beta == 0)
             memset(c.Data(), 0, sizeof(ElemType)* c.GetNumElements());
         else if (beta != 1)
@@ -929,50 +1176,21 @@ public:
         // * Initialized the output matrix c
 
         // Now do the actual multiplication.
-        ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
-        int* rowIndexBuffer = sparse.MajorIndexLocation();                          // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
-        size_t iNonzero = 0;                                                           // Number of nonzero elements handled so far for curent slice view.
-        int numPreviosNonzero = sparse.SecondaryIndexLocation()[0];                 // Total number of nonzero values handled in previous slices.
-
-        // Loop over columns of the sparse matrix
-        for (size_t colSparse = 0; colSparse < sparse.GetNumCols(); colSparse++)
-        {
-            size_t numNonzeroInSparseCol = sparse.SecondaryIndexLocation()[colSparse + 1] - numPreviosNonzero;
-            // Loop over the nonzero rows of the current column of the sparse matrix
-            for (; iNonzero < numNonzeroInSparseCol; iNonzero++)
-            {
-                size_t rowSparse = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType sparseVal = valueBuffer[iNonzero];
-
-                // Determine the index of the 'outer' dimension of the sparse matrix and the common inner index.
-                size_t outerIndexSparse;
-                size_t innerIndex;
-                // Below if-statements are evaluated at compile time.
-                if      ( denseTimesSparse && !transposeB) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-                else if ( denseTimesSparse &&  transposeB) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse && !transposeA) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse &&  transposeA) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-
-                // Loop over the outer index of the dense matrix
-                for (size_t outerIndexDense = 0; outerIndexDense < outerDimensionDense; outerIndexDense++)
-                {
-                    // Determine the row index of the dense input matrix.
-                    // Below if-statements are evaluated at compile time.
-                    ElemType denseVal;
-                    if      ( denseTimesSparse && !transposeA) denseVal = dense(outerIndexDense,      innerIndex);
-                    else if ( denseTimesSparse &&  transposeA) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse && !transposeB) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse &&  transposeB) denseVal = dense(outerIndexDense,      innerIndex);
-                    
-
-                    // Update matrix c.
-                    if (denseTimesSparse)
-                        c(outerIndexDense, outerIndexSparse) += alpha * denseVal * sparseVal;
-                    else /*Sparse times dense */
-                        c(outerIndexSparse, outerIndexDense) += alpha * denseVal * sparseVal;
-                }
-            }
-        }
+        // Each nonzero of the sparse matrix adds a line of the dense matrix along its outer dimension, scaled by alpha
+        // and the value of the nonzero, to a line of c. The line of c is given by the outer index of the nonzero in the
+        // sparse matrix, so the nonzeros are grouped by it, and the line of the dense matrix by the inner index.
+        // Below conditions are evaluated at compile time.
+        const bool groupByColumn = denseTimesSparse ? !transposeB : transposeA;
+        SparseNonzeroGroups<ElemType> groups(sparse, groupByColumn);
+
+        // Strides of the dense matrix and c along the outer dimension of the dense matrix and between their lines.
+        const bool denseLinesAreColumns = denseTimesSparse ? !transposeA : transposeB;
+        size_t denseStride = denseLinesAreColumns ? 1 : dense.GetNumRows();
+        size_t denseLineStride = denseLinesAreColumns ? dense.GetNumRows() : 1;
+        size_t cStride = denseTimesSparse ? 1 : c.GetNumRows();
+        size_t cLineStride = denseTimesSparse ? c.GetNumRows() : 1;
+
+        SparseDenseAccumulate(alpha, groups, nullptr, outerDimensionDense, dense.Data(), denseStride, denseLineStride, c.Data(), cStride, cLineStride);
     }
 };
 
@@ -1036,11 +1254,11 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         InvalidArgument("CPUSparseMatrix::MultiplyAndAdd: The inner dimensions of a (= %lu) and b (= %lu) don't match.", k, l);
     }
 
-    if (!transposeA && !transposeB)
+    if (!transposeB)
     {
         NOT_IMPLEMENTED;
     }
-    else if (!transposeA && transposeB)
+    else
     {
         if (rhs.GetFormat() != matrixFormatSparseCSC)
             NOT_IMPLEMENTED;
@@ -1054,22 +1272,27 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
             c.RequireSizeAndAllocate(m, n, 0, true); // allocate for blockIds
         }
 
-        map<size_t, size_t> col2BlockId;
+        // The block of each nonzero of rhs. This takes time and memory for the nonzeros only, not for all
+        // rows of rhs, which matters for the gradient of an embedding with a large vocabulary.
+        unordered_map<size_t, size_t> col2BlockId;
         for (size_t blockId = 0; blockId < blockSizePrev; blockId++)
         {
             col2BlockId[c.GetBlockIds()[blockId]] = blockId;
         }
 
         size_t blockSizeCurr = blockSizePrev;
+        std::vector<size_t> blockOfNonzero(rhs.NzCount());
         for (size_t rhsNz = 0; rhsNz < rhs.NzCount(); rhsNz++)
         {
             size_t resultCol = rhs.MajorIndexLocation()[rhsNz];
-            if (col2BlockId.find(resultCol) == col2BlockId.end())
+            auto block = col2BlockId.find(resultCol);
+            if (block == col2BlockId.end())
             {
-                col2BlockId[resultCol] = blockSizeCurr;
+                block = col2BlockId.emplace(resultCol, blockSizeCurr).first;
                 c.GetBlockIds()[blockSizeCurr] = resultCol;
                 blockSizeCurr ++;
             }
+            blockOfNonzero[rhsNz] = block->second;
         }
 
         if (blockSizeCurr > blockSizePrev)
@@ -1079,32 +1302,15 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
             memset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev));
         }
 
-        for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
-        {
-            size_t start = rhs.SecondaryIndexLocation()[rhsCol];
-            size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1];
-
-            for (size_t p = start; p < end; p++)
-            {
-                size_t rhsRow = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
+        // Each nonzero rhs(row, col) adds alpha * rhs(row, col) * op(lhs)[:, col] to the block of column 'row' of c.
+        // The nonzeros are grouped by block, so that each block is summed up by one thread at a time, including
+        // the nonzeros of the same row (e.g. the same word in several samples), instead of adding up per-thread
+        // partial results.
+        SparseNonzeroGroups<ElemType> groups(rhs, blockSizeCurr, blockOfNonzero);
 
-                ElemType* results = c.Buffer() + col2BlockId[rhsRow] * m;
-                #pragma omp parallel for
-                for (int lhsRow = 0; lhsRow < (int)m; lhsRow++)
-                {
-                    results[lhsRow] += alpha * lhs((size_t)lhsRow, rhsCol) * val;
-                }
-            }
-        }
-    }
-    else if (transposeA && !transposeB)
-    {
-        NOT_IMPLEMENTED;
-    }
-    else
-    {
-        NOT_IMPLEMENTED;
+        size_t lhsStride = transposeA ? lhs.GetNumRows() : 1;
+        size_t lhsLineStride = transposeA ? 1 : lhs.GetNumRows();
+        SparseDenseAccumulate(alpha, groups, nullptr, m, lhs.Data(), lhsStride, lhsLineStride, c.Buffer(), 1, m);
     }
 }
 
@@ -1438,6 +1644,344 @@ void CPUSparseMatrix<ElemType>::AdaDelta(CPUMatrix<ElemType>& c, CPUMatrix<ElemT
     }
 }
 
+// Returns for every block the number of updates that have skipped its column since it was last touched, and records
+// that this update touches it. Without a history, nothing is caught up with.
+template <class ElemType>
+std::vector<size_t> CPUSparseMatrix<ElemType>::StartSparseUpdate(SparseUpdateHistory* history) const
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        LogicError("Unsupported sparse format.");
+
+    std::vector<size_t> numSkippedUpdates(GetBlockSize(), 0);
+    if (history == nullptr)
+        return numSkippedUpdates;
+
+    if (history->m_lastUpdates.size() != GetNumCols())
+        history->m_lastUpdates.assign(GetNumCols(), history->m_numUpdates);
+    history->m_numUpdates++;
+    for (size_t j = 0; j < GetBlockSize(); j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        numSkippedUpdates[j] = history->m_numUpdates - 1 - history->m_lastUpdates[col];
+        history->m_lastUpdates[col] = history->m_numUpdates;
+    }
+    return numSkippedUpdates;
+}
+
+// factor + factor^2 + ... + factor^k
+template <class ElemType>
+static ElemType GeometricSum(ElemType factor, size_t k)
+{
+    if (factor == 1)
+        return (ElemType) k;
+    return factor * (1 - pow(factor, (ElemType) k)) / (1 - factor);
+}
+
+// Momentum SGD on the columns that have a gradient. Unlike in the dense update, the smoothed gradients
+// do not include the learning rate (cf. Matrix::MomentumSGDUpdate()):
+// 1) sg_t = momentum * sg_{t-1} + unitGainFactor * g_t
+// 2) w_t = w_{t-1} - learnRatePerSample * sg_t                                      (momentum)
+//    w_t = w_{t-1} - learnRatePerSample * (momentum * sg_t + unitGainFactor * g_t) (Nesterov)
+// An update without a gradient decays sg by momentum and still moves w, so k of them add up to
+//   w -= learnRatePerSample * (momentum + ... + momentum^k) * sg    (one more factor momentum for Nesterov)
+//   sg *= momentum^k
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MomentumSGDUpdate(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum,
+                                                  bool unitGainMomentum, bool nesterov, SparseUpdateHistory* history)
+{
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+
+    if (c.IsEmpty())
+    {
+        c.RequireSize(GetNumRows(), GetNumCols());
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != GetNumCols())
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    std::vector<size_t> numSkippedUpdates = StartSparseUpdate(history);
+
+    size_t len = GetNumRows();
+    ElemType* grad = Data();
+    ElemType* smoothMom = c.Data();
+    ElemType* val = functionValues.Data();
+
+#pragma omp parallel for
+    for (int j = 0; j < (int) GetBlockSize(); j++)
+    {
+        size_t k = numSkippedUpdates[j];
+        ElemType catchUpDecay = pow(momentum, (ElemType) k);
+        ElemType catchUpStep = learnRatePerSample * GeometricSum(momentum, k) * (nesterov ? momentum : 1);
+        size_t start = (GetBlockIds()[j] - GetBlockIdShift()) * len;
+        for (size_t i = 0; i < len; i++)
+        {
+            ElemType g = grad[j * len + i];
+            ElemType& sg = smoothMom[start + i];
+            if (k > 0)
+            {
+                val[start + i] -= catchUpStep * sg;
+                sg *= catchUpDecay;
+            }
+            sg = momentum * sg + unitGainFactor * g;
+            val[start + i] -= learnRatePerSample * (nesterov ? momentum * sg + unitGainFactor * g : sg);
+        }
+    }
+}
+
+// FSAdaGrad on the columns that have a gradient, the same as CPUMatrix::FSAdagrad(). k updates without
+// a gradient decay the squared gradients by adaWeight^k and the momentum by momentum^k, and move w by
+// learnRatePerSample * (momentum + ... + momentum^k) * the momentum.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum,
+                                          ElemType adaWeight, ElemType adaMul, bool unitGainMomentum, SparseUpdateHistory* history)
+{
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    size_t numColsNeeded = 2 * GetNumCols();
+
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    std::vector<size_t> numSkippedUpdates = StartSparseUpdate(history);
+
+    size_t n = GetNumElements();
+    size_t len = GetNumRows();
+    ElemType* grad = Data();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+
+#pragma omp parallel for
+    for (int j = 0; j < (int) GetBlockSize(); j++)
+    {
+        size_t k = numSkippedUpdates[j];
+        ElemType adaDecay = pow(adaWeight, (ElemType) k);
+        ElemType momDecay = pow(momentum, (ElemType) k);
+        ElemType catchUpStep = learnRatePerSample * GeometricSum(momentum, k);
+        size_t start = (GetBlockIds()[j] - GetBlockIdShift()) * len;
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t denseIndex = start + i;
+            if (k > 0)
+            {
+                smoothAda[denseIndex] *= adaDecay;
+                if (momentum > 0.0f)
+                {
+                    val[denseIndex] -= catchUpStep * smoothMom[denseIndex];
+                    smoothMom[denseIndex] *= momDecay;
+                }
+            }
+
+            ElemType g = grad[j * len + i];
+            ElemType adaSqr = adaWeight * smoothAda[denseIndex] + (1.0f - adaWeight) * g * g;
+            smoothAda[denseIndex] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType w = adaMul * ((ElemType) 1.0 / sqrt(adaSqr));
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[denseIndex] + unitGainFactor * g;
+                smoothMom[denseIndex] = g;
+            }
+
+            val[denseIndex] -= g * learnRatePerSample;
+        }
+    }
+}
+
+// bias correction of Adam after 'smoothedCount' updates, as in Matrix::AdamUpdate()
+static double AdamBiasCorrection(double momentum, double adaWeight, double smoothedCount, bool adamax)
+{
+    smoothedCount = std::max(smoothedCount, 1.0);
+    return adamax ? 1. / (1 - pow(momentum, smoothedCount)) : sqrt(1 - pow(adaWeight, smoothedCount)) / (1 - pow(momentum, smoothedCount));
+}
+
+// Adam on the columns that have a gradient, the same as CPUMatrix::Adam(). The updates without a gradient are
+// replayed one by one when the column is touched again, as the bias correction changes with every update,
+// until the rest of the momentum of the column is below the precision of the weights.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, double momentum, double adaWeight,
+                                     double smoothedCount, ElemType epsilon, bool unitGainMomentum, bool adamax, SparseUpdateHistory* history)
+{
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    size_t numColsNeeded = 2 * GetNumCols();
+
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    std::vector<size_t> numSkippedUpdates = StartSparseUpdate(history);
+
+    size_t n = GetNumElements();
+    size_t len = GetNumRows();
+    ElemType* grad = Data();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+    const auto mom = (ElemType) momentum;
+    const auto ada = (ElemType) adaWeight;
+    const auto adaMul = (ElemType) AdamBiasCorrection(momentum, adaWeight, smoothedCount, adamax);
+    // mom^s below which the remaining momentum, mom^s / (1 - mom) of the step, is lost in the rounding of the weights
+    const auto momentumPrecision = (ElemType)(std::numeric_limits<ElemType>::epsilon() / 2 * (1 - momentum));
+
+#pragma omp parallel for
+    for (int j = 0; j < (int) GetBlockSize(); j++)
+    {
+        size_t k = numSkippedUpdates[j];
+        size_t start = (GetBlockIds()[j] - GetBlockIdShift()) * len;
+        // the skipped updates only move the weights through the momentum, which decays by 'mom' in each of them,
+        // so once mom^s is below the precision of the step, the rest of them changes the weights by less than
+        // a rounding error and only the decay of the squared gradients is left. This bounds the replay to
+        // log(eps (1 - mom)) / log(mom) passes over the column, e.g. 180 in float at momentum 0.9, 2,100 at 0.99.
+        ElemType momPower = 1; // mom^s
+        for (size_t s = 0; s < k; s++)
+        {
+            if (momPower < momentumPrecision)
+            {
+                const auto adaDecay = (ElemType) pow(ada, (ElemType)(k - s));
+                for (size_t i = 0; i < len; i++)
+                {
+                    smoothAda[start + i] *= adaDecay;
+                    smoothMom[start + i] = 0;
+                }
+                break;
+            }
+
+            const auto skippedMul = (ElemType) AdamBiasCorrection(momentum, adaWeight, smoothedCount - k + s, adamax);
+            for (size_t i = 0; i < len; i++)
+            {
+                size_t denseIndex = start + i;
+                smoothAda[denseIndex] *= ada;
+                ElemType w = skippedMul * (ElemType)(1.0 / ((adamax ? smoothAda[denseIndex] : sqrt(smoothAda[denseIndex])) + epsilon));
+                smoothMom[denseIndex] *= mom;
+                val[denseIndex] -= smoothMom[denseIndex] * w * learnRatePerSample;
+            }
+            momPower *= mom;
+        }
+
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t denseIndex = start + i;
+            ElemType g = grad[j * len + i];
+            ElemType a;
+            if (!adamax)
+            {
+                ElemType adaSqr = ada * smoothAda[denseIndex] + (1.0f - ada) * g * g;
+                smoothAda[denseIndex] = adaSqr;
+                a = sqrt(adaSqr);
+            }
+            else
+                a = smoothAda[denseIndex] = std::max(ada * smoothAda[denseIndex], abs(g));
+
+            ElemType w = adaMul * (ElemType)(1.0 / (a + epsilon));
+            g = mom * smoothMom[denseIndex] + unitGainFactor * g;
+            smoothMom[denseIndex] = g;
+            val[denseIndex] -= g * w * learnRatePerSample;
+        }
+    }
+}
+
+// RmsProp on the columns that have a gradient, the same as CPUMatrix::RmsProp() (which modifies the gradient
+// in place). k updates without a gradient decay the accumulated variances by RMS_GAMMA^k and the step sizes
+// by RMS_WGT_DEC^k (down to RMS_WGT_MIN), and reset the signs.
+// The returned average multiplier is the average over the touched columns only, unlike the dense one.
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                            const bool needAveMultiplier, const bool initialized, SparseUpdateHistory* history)
+{
+    const ElemType floor = 1e-6f;
+
+    size_t n = GetNumElements();
+    size_t len = GetNumRows();
+    ElemType* curr_grad = Data();
+
+    bool initialize = c.IsEmpty() || c.GetNumCols() < GetNumCols() * 3 || !initialized;
+    if (initialize)
+    {
+        c.RequireSize(GetNumRows(), GetNumCols() * 3);
+        c.SetValue(0.0);
+
+        // initialize starting step size; the moving average of gradient-squared is initialized below
+        ElemType* steps = c.Data() + 2 * n;
+        for (size_t i = 0; i < n; i++)
+            steps[i] = ElemType(0.02);
+
+        if (history)
+            history->Reset();
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != GetNumCols() * 3)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    std::vector<size_t> numSkippedUpdates = StartSparseUpdate(history);
+
+    ElemType* avars = c.Data();         // accumulated variances for RMS scaling
+    ElemType* signs = c.Data() + n;     // sign of previous gradient
+    ElemType* steps = c.Data() + 2 * n; // current step size
+
+    ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+    ElemType aveMultiplier = 0;
+
+#pragma omp parallel for reduction(+ : aveMultiplier)
+    for (int j = 0; j < (int) GetBlockSize(); j++)
+    {
+        size_t k = numSkippedUpdates[j];
+        ElemType avarsDecay = pow(RMS_GAMMA, (ElemType) k);
+        ElemType stepsDecay = pow(RMS_WGT_DEC, (ElemType) k);
+        size_t start = (GetBlockIds()[j] - GetBlockIdShift()) * len;
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t denseIndex = start + i;
+            ElemType& g = curr_grad[j * len + i];
+            if (initialize)
+                avars[denseIndex] = g * g;
+            if (k > 0)
+            {
+                avars[denseIndex] *= avarsDecay;
+                steps[denseIndex] = std::max(steps[denseIndex] * stepsDecay, RMS_WGT_MIN);
+                signs[denseIndex] = 0;
+            }
+
+            avars[denseIndex] = RMS_GAMMA * avars[denseIndex] + ONE_MINUS_GAMMA * (g * g);
+            const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+
+            if (signs[denseIndex] * grad_sign > 0)
+                steps[denseIndex] = std::min(steps[denseIndex] * RMS_WGT_INC, RMS_WGT_MAX);
+            else
+                steps[denseIndex] = std::max(steps[denseIndex] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+            ElemType a = steps[denseIndex] / sqrt(avars[denseIndex] + floor);
+            g *= a;
+            signs[denseIndex] = (ElemType) grad_sign;
+
+            if (needAveMultiplier)
+                aveMultiplier += a;
+        }
+    }
+
+    size_t nz = NzCount();
+    if (needAveMultiplier && nz > 0)
+        return aveMultiplier / nz;
+    else
+        return 1;
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
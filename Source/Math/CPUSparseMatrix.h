@@ -233,6 +233,20 @@ public:
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
     void AdaDelta(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learningRate, ElemType rho, ElemType epsilon);
 
+    // Updates of the columns of 'functionValues' and of the optimizer state 'c' that have a gradient in this block-column
+    // gradient, catching up with the updates in between if given a 'history' (see SparseUpdateHistory).
+    void MomentumSGDUpdate(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum,
+                           bool unitGainMomentum, bool nesterov, SparseUpdateHistory* history);
+    void FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum,
+                   ElemType adaWeight, ElemType adaMul, bool unitGainMomentum, SparseUpdateHistory* history);
+    void Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, double momentum, double adaWeight,
+              double smoothedCount, ElemType epsilon, bool unitGainMomentum, bool adamax, SparseUpdateHistory* history);
+    ElemType RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                     const bool needAveMultiplier, const bool initialized, SparseUpdateHistory* history);
+
+private:
+    std::vector<size_t> StartSparseUpdate(SparseUpdateHistory* history) const;
+
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
     CPUSparseMatrix<ElemType>& InplaceTruncateBottom(const ElemType threshold);
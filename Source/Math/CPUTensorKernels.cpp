@@ -0,0 +1,128 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernels.cpp -- runtime selection of the explicitly vectorized TensorOp kernels
+//
+
+#include "stdafx.h"
+#include "CPUTensorKernels.h"
+#include "CommonMatrix.h"
+#include <atomic>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// instruction set supported by the CPU and the operating system, regardless of what this build provides
+static CPUInstructionSet DetectCPUInstructionSet()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return CPUInstructionSet::Generic;
+    __cpuid(info, 1);
+    bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+    bool hasAVX = (info[2] & (1 << 28)) != 0;
+    bool hasFMA = (info[2] & (1 << 12)) != 0;
+    if (!hasOSXSave || !hasAVX)
+        return CPUInstructionSet::Generic;
+    unsigned long long xcr0 = _xgetbv(0);
+    bool osSavesYmm = (xcr0 & 0x06) == 0x06;
+    bool osSavesZmm = (xcr0 & 0xe6) == 0xe6;
+    __cpuidex(info, 7, 0);
+    bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+    bool hasAVX512F = (info[1] & (1 << 16)) != 0;
+    if (hasAVX512F && osSavesZmm)
+        return CPUInstructionSet::AVX512;
+    if (hasAVX2 && hasFMA && osSavesYmm)
+        return CPUInstructionSet::AVX2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return CPUInstructionSet::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CPUInstructionSet::AVX2;
+#endif
+#endif
+    return CPUInstructionSet::Generic;
+}
+
+// kernel tables of all instruction sets, filled in once
+template <class ElemType>
+struct CPUTensorKernelTables
+{
+    CPUTensorKernelTable<ElemType> m_avx2;
+    CPUTensorKernelTable<ElemType> m_avx512;
+    bool m_hasAVX2;
+    bool m_hasAVX512;
+
+    CPUTensorKernelTables()
+        : m_avx2(), m_avx512() // value-initialization sets all kernels to null
+    {
+        if (c_tensorKernelEpsInLog != EPS_IN_LOG || c_tensorKernelLogOfEpsInLog != LOG_OF_EPS_IN_LOG)
+            LogicError("CPUTensorKernels: The opLog clipping constants do not match CommonMatrix.h.");
+        m_hasAVX2 = GetCPUTensorKernelsAVX2(m_avx2);
+        m_hasAVX512 = GetCPUTensorKernelsAVX512(m_avx512);
+    }
+
+    static const CPUTensorKernelTables& Get()
+    {
+        static CPUTensorKernelTables tables;
+        return tables;
+    }
+};
+
+CPUInstructionSet GetSupportedCPUInstructionSet()
+{
+    static const CPUInstructionSet supported = []()
+    {
+        // cap what the CPU can do by what this build provides
+        CPUInstructionSet detected = DetectCPUInstructionSet();
+        const auto& tables = CPUTensorKernelTables<float>::Get();
+        if (detected == CPUInstructionSet::AVX512 && !tables.m_hasAVX512)
+            detected = CPUInstructionSet::AVX2;
+        if (detected == CPUInstructionSet::AVX2 && !tables.m_hasAVX2)
+            detected = CPUInstructionSet::Generic;
+        return detected;
+    }();
+    return supported;
+}
+
+static std::atomic<int> s_tensorKernelInstructionSet(-1); // -1: not set, use the supported one
+
+CPUInstructionSet GetCPUTensorKernelInstructionSet()
+{
+    int instructionSet = s_tensorKernelInstructionSet;
+    return instructionSet < 0 ? GetSupportedCPUInstructionSet() : (CPUInstructionSet) instructionSet;
+}
+
+void SetCPUTensorKernelInstructionSet(CPUInstructionSet instructionSet)
+{
+    if ((int) instructionSet > (int) GetSupportedCPUInstructionSet())
+        instructionSet = GetSupportedCPUInstructionSet();
+    s_tensorKernelInstructionSet = (int) instructionSet;
+}
+
+template <class ElemType>
+const CPUTensorKernelTable<ElemType>* GetCPUTensorKernels()
+{
+    const auto& tables = CPUTensorKernelTables<ElemType>::Get();
+    switch (GetCPUTensorKernelInstructionSet())
+    {
+    case CPUInstructionSet::AVX512:
+        return &tables.m_avx512;
+    case CPUInstructionSet::AVX2:
+        return &tables.m_avx2;
+    default:
+        return nullptr;
+    }
+}
+
+template const CPUTensorKernelTable<float>* GetCPUTensorKernels<float>();
+template const CPUTensorKernelTable<double>* GetCPUTensorKernels<double>();
+
+}}}
@@ -0,0 +1,100 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernels.h -- explicitly vectorized inner loops for CPUMatrix::TensorOp()
+//
+// The generic TensorOp implementation in CPUMatrixImpl.h evaluates a lambda per element and leaves vectorization
+// to the compiler, which does not manage to vectorize through the lambda. This provides hand-vectorized kernels
+// for the most frequent elementwise operations and reductions. The kernels for each instruction set live in
+// their own translation unit that is compiled for that instruction set (CPUTensorKernelsAVX2.cpp,
+// CPUTensorKernelsAVX512.cpp), and the best one supported by the CPU is selected at runtime.
+//
+// The kernels compute c = beta * c + alpha * f(...) like the generic code, where c is not read if beta == 0.
+// Elementwise arithmetic gives the same results as the generic code. Reductions are identical up to floating-point
+// reassociation, since the vectorized sums accumulate in a different order. Transcendental functions (exp, log,
+// tanh, sigmoid) are only vectorized for float and are accurate to a few ulps; lanes that fall outside the
+// range the approximations cover (e.g. overflow, NaN) are computed with the scalar functions.
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+enum class CPUInstructionSet
+{
+    Generic, // no explicitly vectorized kernels; use the generic TensorOp code
+    AVX2,    // AVX2 + FMA
+    AVX512   // AVX-512F
+};
+
+// the clipping of opLog (must match EPS_IN_LOG and LOG_OF_EPS_IN_LOG in CommonMatrix.h; verified in CPUTensorKernels.cpp)
+static const float c_tensorKernelEpsInLog = 1e-37f;
+static const float c_tensorKernelLogOfEpsInLog = -85.1f;
+
+// Table of kernels for one instruction set. Entries are null for operations that are not vectorized for this ElemType.
+template <class ElemType>
+struct CPUTensorKernelTable
+{
+    // c[i] = beta * c[i] + alpha * f(a[i]), i < n
+    typedef void (*UnaryKernel)(size_t n, const ElemType* a, ElemType* c, ElemType alpha, ElemType beta);
+    // c[i] = beta * c[i] + alpha * f(a[i], b[i]), i < n
+    typedef void (*BinaryKernel)(size_t n, const ElemType* a, const ElemType* b, ElemType* c, ElemType alpha, ElemType beta);
+    // reduction of a[i], i < n, into a single value (sums are accumulated in double, like the generic code does)
+    typedef double (*ReduceKernel)(size_t n, const ElemType* a);
+    // c[i] = beta * c[i] + alpha * reduction over j < cols of a[i + j * lda], i < rows
+    typedef void (*ReduceColumnsKernel)(size_t rows, size_t cols, const ElemType* a, size_t lda, ElemType* c, ElemType alpha, ElemType beta);
+
+    UnaryKernel copy;
+    UnaryKernel sigmoid;
+    UnaryKernel tanh;
+    UnaryKernel exp;
+    UnaryKernel log;
+    UnaryKernel linearRectifier;
+
+    BinaryKernel sum;
+    BinaryKernel difference;
+    BinaryKernel elementwiseProduct;
+    BinaryKernel elementwiseProductWithSigmoidDerivativeFromOutput;
+    BinaryKernel elementwiseProductWithTanhDerivativeFromOutput;
+    BinaryKernel elementwiseProductWithLinearRectifierDerivativeFromOutput;
+    BinaryKernel elementwiseProductWithLogDerivativeFromOutput;
+
+    ReduceKernel reduceSum;
+    ReduceKernel reduceMax;
+    ReduceColumnsKernel reduceColumnsSum;
+    ReduceColumnsKernel reduceColumnsMax;
+};
+
+// instruction set supported by this CPU (and by this build)
+MATH_API CPUInstructionSet GetSupportedCPUInstructionSet();
+
+// The instruction set whose kernels TensorOp uses. Defaults to the supported one. Setting it to a lower one
+// (e.g. Generic) is meant for testing and benchmarking; a higher one than supported is capped.
+MATH_API CPUInstructionSet GetCPUTensorKernelInstructionSet();
+MATH_API void SetCPUTensorKernelInstructionSet(CPUInstructionSet instructionSet);
+
+// the kernels for the current instruction set, or nullptr if it is Generic
+template <class ElemType>
+const CPUTensorKernelTable<ElemType>* GetCPUTensorKernels();
+
+// Implemented in the instruction-set specific translation units. These fill in the kernels they provide,
+// and return false if the instruction set is not available in this build (e.g. not an x64 target).
+bool GetCPUTensorKernelsAVX2(CPUTensorKernelTable<float>& kernels);
+bool GetCPUTensorKernelsAVX2(CPUTensorKernelTable<double>& kernels);
+bool GetCPUTensorKernelsAVX512(CPUTensorKernelTable<float>& kernels);
+bool GetCPUTensorKernelsAVX512(CPUTensorKernelTable<double>& kernels);
+
+}}}
@@ -0,0 +1,169 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsAVX2.cpp -- TensorOp kernels for AVX2 + FMA
+//
+// This file is compiled with AVX2 and FMA code generation enabled (see Makefile and Math.vcxproj). Its functions
+// must only be called after checking that the CPU supports AVX2, which CPUTensorKernels.cpp does. It deliberately
+// does not include stdafx.h; see CPUTensorKernelsImpl.h for why.
+//
+
+#include "CPUTensorKernelsImpl.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+struct AVX2Float
+{
+    typedef float Elem;
+    typedef __m256 V;
+    typedef __m256 Mask;
+    struct DAcc { __m256d lo, hi; };
+    static const size_t width = 8;
+
+    static V Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V Set1(float x) { return _mm256_set1_ps(x); }
+    static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V Fma(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+
+    static Mask Greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Mask GreaterEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static Mask Less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask LessEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Mask IsNumber(V a) { return _mm256_cmp_ps(a, a, _CMP_ORD_Q); }
+    static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Mask Or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+    static bool AllSet(Mask m) { return _mm256_movemask_ps(m) == 0xff; }
+    static V Select(Mask m, V t, V f) { return _mm256_blendv_ps(f, t, m); }
+
+    static V Abs(V a) { return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))); }
+    static V CopySign(V magnitude, V sign)
+    {
+        __m256 signBit = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+        return _mm256_or_ps(_mm256_andnot_ps(signBit, magnitude), _mm256_and_ps(signBit, sign));
+    }
+    static V Round(V a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static V ScaleByPow2(V p, V n)
+    {
+        __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+    }
+    static void Frexp(V x, V& mantissa, V& exponent) // x positive and normal
+    {
+        __m256i bits = _mm256_castps_si256(x);
+        exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+        mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000)));
+    }
+
+    static void ZeroAcc(DAcc& acc) { acc.lo = acc.hi = _mm256_setzero_pd(); }
+    static void AccumulateDouble(DAcc& acc, V v)
+    {
+        acc.lo = _mm256_add_pd(acc.lo, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+        acc.hi = _mm256_add_pd(acc.hi, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+    }
+    static V AccToVector(const DAcc& acc) { return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(acc.lo)), _mm256_cvtpd_ps(acc.hi), 1); }
+    static double HorizontalSum(const DAcc& acc)
+    {
+        double buffer[4];
+        _mm256_storeu_pd(buffer, _mm256_add_pd(acc.lo, acc.hi));
+        return (buffer[0] + buffer[1]) + (buffer[2] + buffer[3]);
+    }
+    static float HorizontalMax(V v)
+    {
+        float buffer[width];
+        _mm256_storeu_ps(buffer, v);
+        float result = buffer[0];
+        for (size_t i = 1; i < width; i++)
+            result = buffer[i] > result ? buffer[i] : result;
+        return result;
+    }
+};
+
+struct AVX2Double
+{
+    typedef double Elem;
+    typedef __m256d V;
+    typedef __m256d Mask;
+    typedef __m256d DAcc;
+    static const size_t width = 4;
+
+    static V Load(const double* p) { return _mm256_loadu_pd(p); }
+    static void Store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    static V Set1(double x) { return _mm256_set1_pd(x); }
+    static V Add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V Div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V Max(V a, V b) { return _mm256_max_pd(a, b); }
+    static V Min(V a, V b) { return _mm256_min_pd(a, b); }
+    static V Fma(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+
+    static Mask Greater(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static Mask GreaterEqual(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static Mask Less(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static Mask LessEqual(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static Mask IsNumber(V a) { return _mm256_cmp_pd(a, a, _CMP_ORD_Q); }
+    static Mask And(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+    static Mask Or(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+    static bool AllSet(Mask m) { return _mm256_movemask_pd(m) == 0xf; }
+    static V Select(Mask m, V t, V f) { return _mm256_blendv_pd(f, t, m); }
+
+    static void ZeroAcc(DAcc& acc) { acc = _mm256_setzero_pd(); }
+    static void AccumulateDouble(DAcc& acc, V v) { acc = _mm256_add_pd(acc, v); }
+    static V AccToVector(const DAcc& acc) { return acc; }
+    static double HorizontalSum(const DAcc& acc)
+    {
+        double buffer[4];
+        _mm256_storeu_pd(buffer, acc);
+        return (buffer[0] + buffer[1]) + (buffer[2] + buffer[3]);
+    }
+    static double HorizontalMax(V v)
+    {
+        double buffer[width];
+        _mm256_storeu_pd(buffer, v);
+        double result = buffer[0];
+        for (size_t i = 1; i < width; i++)
+            result = buffer[i] > result ? buffer[i] : result;
+        return result;
+    }
+};
+
+} // anonymous namespace
+
+bool GetCPUTensorKernelsAVX2(CPUTensorKernelTable<float>& kernels)
+{
+    FillArithmeticKernels<AVX2Float>(kernels);
+    FillTranscendentalKernels<AVX2Float>(kernels);
+    return true;
+}
+
+bool GetCPUTensorKernelsAVX2(CPUTensorKernelTable<double>& kernels)
+{
+    FillArithmeticKernels<AVX2Double>(kernels);
+    return true;
+}
+
+}}}
+
+#else // not an x64 target
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool GetCPUTensorKernelsAVX2(CPUTensorKernelTable<float>&) { return false; }
+bool GetCPUTensorKernelsAVX2(CPUTensorKernelTable<double>&) { return false; }
+
+}}}
+
+#endif
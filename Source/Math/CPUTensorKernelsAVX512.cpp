@@ -0,0 +1,174 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsAVX512.cpp -- TensorOp kernels for AVX-512F
+//
+// This file is compiled with AVX-512 code generation enabled (see Makefile and Math.vcxproj). Its functions
+// must only be called after checking that the CPU supports AVX-512F, which CPUTensorKernels.cpp does. It
+// deliberately does not include stdafx.h; see CPUTensorKernelsImpl.h for why.
+//
+
+#include "CPUTensorKernelsImpl.h"
+
+// AVX-512 intrinsics need Visual Studio 2017 or later
+#if (defined(_M_X64) || defined(__x86_64__)) && (!defined(_MSC_VER) || _MSC_VER >= 1910)
+
+#include <immintrin.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+struct AVX512Float
+{
+    typedef float Elem;
+    typedef __m512 V;
+    typedef __mmask16 Mask;
+    struct DAcc { __m512d lo, hi; };
+    static const size_t width = 16;
+
+    static V Load(const float* p) { return _mm512_loadu_ps(p); }
+    static void Store(float* p, V v) { _mm512_storeu_ps(p, v); }
+    static V Set1(float x) { return _mm512_set1_ps(x); }
+    static V Add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V Div(V a, V b) { return _mm512_div_ps(a, b); }
+    static V Max(V a, V b) { return _mm512_max_ps(a, b); }
+    static V Min(V a, V b) { return _mm512_min_ps(a, b); }
+    static V Fma(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+
+    static Mask Greater(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static Mask GreaterEqual(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static Mask Less(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static Mask LessEqual(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static Mask IsNumber(V a) { return _mm512_cmp_ps_mask(a, a, _CMP_ORD_Q); }
+    static Mask And(Mask a, Mask b) { return (Mask) (a & b); }
+    static Mask Or(Mask a, Mask b) { return (Mask) (a | b); }
+    static bool AllSet(Mask m) { return m == 0xffff; }
+    static V Select(Mask m, V t, V f) { return _mm512_mask_blend_ps(m, f, t); }
+
+    static V Abs(V a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+    static V CopySign(V magnitude, V sign)
+    {
+        __m512i magnitudeBits = _mm512_and_si512(_mm512_castps_si512(magnitude), _mm512_set1_epi32(0x7fffffff));
+        __m512i signBits = _mm512_and_si512(_mm512_castps_si512(sign), _mm512_set1_epi32(0x80000000));
+        return _mm512_castsi512_ps(_mm512_or_si512(magnitudeBits, signBits));
+    }
+    static V Round(V a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static V ScaleByPow2(V p, V n) { return _mm512_scalef_ps(p, n); }
+    static void Frexp(V x, V& mantissa, V& exponent) // x positive and normal
+    {
+        __m512i bits = _mm512_castps_si512(x);
+        exponent = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(126)));
+        mantissa = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)), _mm512_set1_epi32(0x3f000000)));
+    }
+
+    static void ZeroAcc(DAcc& acc) { acc.lo = acc.hi = _mm512_setzero_pd(); }
+    static void AccumulateDouble(DAcc& acc, V v)
+    {
+        __m256 lo = _mm512_castps512_ps256(v);
+        __m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+        acc.lo = _mm512_add_pd(acc.lo, _mm512_cvtps_pd(lo));
+        acc.hi = _mm512_add_pd(acc.hi, _mm512_cvtps_pd(hi));
+    }
+    static V AccToVector(const DAcc& acc)
+    {
+        __m256d lo = _mm256_castps_pd(_mm512_cvtpd_ps(acc.lo));
+        __m256d hi = _mm256_castps_pd(_mm512_cvtpd_ps(acc.hi));
+        return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(lo), hi, 1));
+    }
+    static double HorizontalSum(const DAcc& acc)
+    {
+        double buffer[8];
+        _mm512_storeu_pd(buffer, _mm512_add_pd(acc.lo, acc.hi));
+        return ((buffer[0] + buffer[1]) + (buffer[2] + buffer[3])) + ((buffer[4] + buffer[5]) + (buffer[6] + buffer[7]));
+    }
+    static float HorizontalMax(V v)
+    {
+        float buffer[width];
+        _mm512_storeu_ps(buffer, v);
+        float result = buffer[0];
+        for (size_t i = 1; i < width; i++)
+            result = buffer[i] > result ? buffer[i] : result;
+        return result;
+    }
+};
+
+struct AVX512Double
+{
+    typedef double Elem;
+    typedef __m512d V;
+    typedef __mmask8 Mask;
+    typedef __m512d DAcc;
+    static const size_t width = 8;
+
+    static V Load(const double* p) { return _mm512_loadu_pd(p); }
+    static void Store(double* p, V v) { _mm512_storeu_pd(p, v); }
+    static V Set1(double x) { return _mm512_set1_pd(x); }
+    static V Add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V Sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V Mul(V a, V b) { return _mm512_mul_pd(a, b); }
+    static V Div(V a, V b) { return _mm512_div_pd(a, b); }
+    static V Max(V a, V b) { return _mm512_max_pd(a, b); }
+    static V Min(V a, V b) { return _mm512_min_pd(a, b); }
+    static V Fma(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+
+    static Mask Greater(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static Mask GreaterEqual(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+    static Mask Less(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static Mask LessEqual(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+    static Mask IsNumber(V a) { return _mm512_cmp_pd_mask(a, a, _CMP_ORD_Q); }
+    static Mask And(Mask a, Mask b) { return (Mask) (a & b); }
+    static Mask Or(Mask a, Mask b) { return (Mask) (a | b); }
+    static bool AllSet(Mask m) { return m == 0xff; }
+    static V Select(Mask m, V t, V f) { return _mm512_mask_blend_pd(m, f, t); }
+
+    static void ZeroAcc(DAcc& acc) { acc = _mm512_setzero_pd(); }
+    static void AccumulateDouble(DAcc& acc, V v) { acc = _mm512_add_pd(acc, v); }
+    static V AccToVector(const DAcc& acc) { return acc; }
+    static double HorizontalSum(const DAcc& acc)
+    {
+        double buffer[8];
+        _mm512_storeu_pd(buffer, acc);
+        return ((buffer[0] + buffer[1]) + (buffer[2] + buffer[3])) + ((buffer[4] + buffer[5]) + (buffer[6] + buffer[7]));
+    }
+    static double HorizontalMax(V v)
+    {
+        double buffer[width];
+        _mm512_storeu_pd(buffer, v);
+        double result = buffer[0];
+        for (size_t i = 1; i < width; i++)
+            result = buffer[i] > result ? buffer[i] : result;
+        return result;
+    }
+};
+
+} // anonymous namespace
+
+bool GetCPUTensorKernelsAVX512(CPUTensorKernelTable<float>& kernels)
+{
+    FillArithmeticKernels<AVX512Float>(kernels);
+    FillTranscendentalKernels<AVX512Float>(kernels);
+    return true;
+}
+
+bool GetCPUTensorKernelsAVX512(CPUTensorKernelTable<double>& kernels)
+{
+    FillArithmeticKernels<AVX512Double>(kernels);
+    return true;
+}
+
+}}}
+
+#else // no AVX-512 support in this build
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool GetCPUTensorKernelsAVX512(CPUTensorKernelTable<float>&) { return false; }
+bool GetCPUTensorKernelsAVX512(CPUTensorKernelTable<double>&) { return false; }
+
+}}}
+
+#endif
@@ -0,0 +1,457 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUTensorKernelsImpl.h -- the vectorized TensorOp kernels, written once against a vector-traits class
+//
+// This is included by the instruction-set specific translation units only (CPUTensorKernelsAVX2.cpp,
+// CPUTensorKernelsAVX512.cpp), each of which defines the traits for its vector types and is compiled for its
+// instruction set. Everything here has internal linkage, so that no code compiled for one instruction set can
+// be merged by the linker into code that runs on a CPU without it. For the same reason, these translation units
+// must not instantiate inline functions or templates shared with the rest of the code base (e.g. from the STL).
+//
+// A traits class VT provides:
+//   typedef Elem, V (vector), Mask, DAcc (accumulator of doubles for one V); static const size_t width
+//   Load, Store, Set1, Add, Sub, Mul, Div, Max, Min, Fma (a * b + c),
+//   Greater, GreaterEqual, Less, LessEqual, IsNumber (comparisons giving a Mask), And, Or, AllSet, Select (mask ? t : f),
+//   ZeroAcc, AccumulateDouble, AccToVector, HorizontalSum, HorizontalMax
+// and, for float only, Abs, CopySign, Round, ScaleByPow2 (p * 2^n) and Frexp (x = m * 2^e with m in [0.5, 1)).
+//
+
+#pragma once
+
+#include "CPUTensorKernels.h"
+#include <math.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+// -----------------------------------------------------------------------
+// scalar versions; these must match the definitions in TensorOps.h
+// -----------------------------------------------------------------------
+
+inline float ScalarExp(float x) { return expf(x); }
+inline double ScalarExp(double x) { return exp(x); }
+inline float ScalarTanh(float x) { return tanhf(x); }
+inline double ScalarTanh(double x) { return tanh(x); }
+inline float ScalarLog(float x) { return x < c_tensorKernelEpsInLog ? c_tensorKernelLogOfEpsInLog : logf(x); }
+inline double ScalarLog(double x) { return x < c_tensorKernelEpsInLog ? c_tensorKernelLogOfEpsInLog : log(x); }
+template <class ElemType> inline ElemType ScalarSigmoid(ElemType x) { return 1 / (ScalarExp(-x) + 1); }
+
+// -----------------------------------------------------------------------
+// vectorized functions of float
+// Polynomial approximations are those of the Cephes library (expf, logf, tanhf).
+// Each returns false if some lane is outside the range the approximation handles.
+// -----------------------------------------------------------------------
+
+// exp(x) for x in [-87, 88], where neither the result nor 2^n overflows or becomes denormal
+template <class VT>
+inline typename VT::V ExpCore(typename VT::V x)
+{
+    typedef typename VT::V V;
+    V n = VT::Round(VT::Mul(x, VT::Set1(1.44269504088896341f)));
+    V r = VT::Fma(n, VT::Set1(-0.693359375f), x);
+    r = VT::Fma(n, VT::Set1(2.12194440e-4f), r);
+    V p = VT::Set1(1.9875691500e-4f);
+    p = VT::Fma(p, r, VT::Set1(1.3981999507e-3f));
+    p = VT::Fma(p, r, VT::Set1(8.3334519073e-3f));
+    p = VT::Fma(p, r, VT::Set1(4.1665795894e-2f));
+    p = VT::Fma(p, r, VT::Set1(1.6666665459e-1f));
+    p = VT::Fma(p, r, VT::Set1(5.0000001201e-1f));
+    p = VT::Fma(p, VT::Mul(r, r), VT::Add(r, VT::Set1(1.0f)));
+    return VT::ScaleByPow2(p, n);
+}
+
+template <class VT>
+inline bool Exp(typename VT::V x, typename VT::V& result)
+{
+    if (!VT::AllSet(VT::And(VT::GreaterEqual(x, VT::Set1(-87.0f)), VT::LessEqual(x, VT::Set1(88.0f))))) // also catches NaN
+        return false;
+    result = ExpCore<VT>(x);
+    return true;
+}
+
+template <class VT>
+inline bool Sigmoid(typename VT::V x, typename VT::V& result)
+{
+    typename VT::V e;
+    if (!Exp<VT>(VT::Sub(VT::Set1(0.0f), x), e))
+        return false;
+    result = VT::Div(VT::Set1(1.0f), VT::Add(e, VT::Set1(1.0f)));
+    return true;
+}
+
+template <class VT>
+inline bool Tanh(typename VT::V x, typename VT::V& result)
+{
+    typedef typename VT::V V;
+    if (!VT::AllSet(VT::IsNumber(x)))
+        return false;
+    V ax = VT::Abs(x);
+    // |x| < 0.625: odd polynomial
+    V z = VT::Mul(x, x);
+    V p = VT::Set1(-5.70498872745e-3f);
+    p = VT::Fma(p, z, VT::Set1(2.06390887954e-2f));
+    p = VT::Fma(p, z, VT::Set1(-5.37397155531e-2f));
+    p = VT::Fma(p, z, VT::Set1(1.33314422036e-1f));
+    p = VT::Fma(p, z, VT::Set1(-3.33332819422e-1f));
+    V small = VT::Fma(VT::Mul(p, z), x, x);
+    // otherwise 1 - 2 / (exp(2|x|) + 1); beyond |x| = 9 this is 1 in float precision
+    V e = ExpCore<VT>(VT::Min(VT::Add(ax, ax), VT::Set1(18.0f)));
+    V large = VT::CopySign(VT::Sub(VT::Set1(1.0f), VT::Div(VT::Set1(2.0f), VT::Add(e, VT::Set1(1.0f)))), x);
+    result = VT::Select(VT::Less(ax, VT::Set1(0.625f)), small, large);
+    return true;
+}
+
+// log with the clipping of opLog
+template <class VT>
+inline bool Log(typename VT::V x, typename VT::V& result)
+{
+    typedef typename VT::V V;
+    typedef typename VT::Mask Mask;
+    Mask clipped = VT::Less(x, VT::Set1(c_tensorKernelEpsInLog));
+    if (!VT::AllSet(VT::Or(clipped, VT::LessEqual(x, VT::Set1(3.402823466e+38f))))) // NaN or +inf
+        return false;
+    V m, e;
+    VT::Frexp(VT::Max(x, VT::Set1(c_tensorKernelEpsInLog)), m, e);
+    Mask belowSqrtHalf = VT::Less(m, VT::Set1(0.707106781186547524f));
+    e = VT::Select(belowSqrtHalf, VT::Sub(e, VT::Set1(1.0f)), e);
+    m = VT::Sub(VT::Select(belowSqrtHalf, VT::Add(m, m), m), VT::Set1(1.0f));
+    V z = VT::Mul(m, m);
+    V y = VT::Set1(7.0376836292e-2f);
+    y = VT::Fma(y, m, VT::Set1(-1.1514610310e-1f));
+    y = VT::Fma(y, m, VT::Set1(1.1676998740e-1f));
+    y = VT::Fma(y, m, VT::Set1(-1.2420140846e-1f));
+    y = VT::Fma(y, m, VT::Set1(1.4249322787e-1f));
+    y = VT::Fma(y, m, VT::Set1(-1.6668057665e-1f));
+    y = VT::Fma(y, m, VT::Set1(2.0000714765e-1f));
+    y = VT::Fma(y, m, VT::Set1(-2.4999993993e-1f));
+    y = VT::Fma(y, m, VT::Set1(3.3333331174e-1f));
+    y = VT::Mul(VT::Mul(y, m), z);
+    y = VT::Fma(e, VT::Set1(-2.12194440e-4f), y);
+    y = VT::Fma(z, VT::Set1(-0.5f), y);
+    V l = VT::Fma(e, VT::Set1(0.693359375f), VT::Add(m, y));
+    result = VT::Select(clipped, VT::Set1(c_tensorKernelLogOfEpsInLog), l);
+    return true;
+}
+
+// -----------------------------------------------------------------------
+// operations: a vector and a scalar version of each
+// -----------------------------------------------------------------------
+
+template <class VT>
+struct CopyOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V& r) { r = a; return true; }
+    static Elem Scalar(Elem a) { return a; }
+};
+
+template <class VT>
+struct LinearRectifierOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V& r) { r = VT::Select(VT::Greater(a, VT::Set1(0)), a, VT::Set1(0)); return true; }
+    static Elem Scalar(Elem a) { return a > 0 ? a : 0; }
+};
+
+template <class VT>
+struct SigmoidOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V& r) { return Sigmoid<VT>(a, r); }
+    static Elem Scalar(Elem a) { return ScalarSigmoid(a); }
+};
+
+template <class VT>
+struct TanhOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V& r) { return Tanh<VT>(a, r); }
+    static Elem Scalar(Elem a) { return ScalarTanh(a); }
+};
+
+template <class VT>
+struct ExpOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V& r) { return Exp<VT>(a, r); }
+    static Elem Scalar(Elem a) { return ScalarExp(a); }
+};
+
+template <class VT>
+struct LogOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V& r) { return Log<VT>(a, r); }
+    static Elem Scalar(Elem a) { return ScalarLog(a); }
+};
+
+template <class VT>
+struct SumOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V b, V& r) { r = VT::Add(a, b); return true; }
+    static Elem Scalar(Elem a, Elem b) { return a + b; }
+};
+
+template <class VT>
+struct DifferenceOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V b, V& r) { r = VT::Sub(a, b); return true; }
+    static Elem Scalar(Elem a, Elem b) { return a - b; }
+};
+
+template <class VT>
+struct ElementwiseProductOp
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V b, V& r) { r = VT::Mul(a, b); return true; }
+    static Elem Scalar(Elem a, Elem b) { return a * b; }
+};
+
+template <class VT>
+struct SigmoidDerivativeFromOutputOp // a * (b * (1 - b))
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V b, V& r) { r = VT::Mul(a, VT::Mul(b, VT::Sub(VT::Set1(1), b))); return true; }
+    static Elem Scalar(Elem a, Elem b) { return a * (b * (1 - b)); }
+};
+
+template <class VT>
+struct TanhDerivativeFromOutputOp // a * (1 - b * b)
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V b, V& r) { r = VT::Mul(a, VT::Sub(VT::Set1(1), VT::Mul(b, b))); return true; }
+    static Elem Scalar(Elem a, Elem b) { return a * (1 - b * b); }
+};
+
+template <class VT>
+struct LinearRectifierDerivativeFromOutputOp // b > 0 ? a : 0
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V b, V& r) { r = VT::Select(VT::Greater(b, VT::Set1(0)), a, VT::Set1(0)); return true; }
+    static Elem Scalar(Elem a, Elem b) { return b > 0 ? a : 0; }
+};
+
+template <class VT>
+struct LogDerivativeFromOutputOp // a * exp(-b)
+{
+    typedef typename VT::V V;
+    typedef typename VT::Elem Elem;
+    static bool Vector(V a, V b, V& r)
+    {
+        V e;
+        if (!Exp<VT>(VT::Sub(VT::Set1(0), b), e))
+            return false;
+        r = VT::Mul(a, e);
+        return true;
+    }
+    static Elem Scalar(Elem a, Elem b) { return a * ScalarExp(-b); }
+};
+
+// -----------------------------------------------------------------------
+// loops
+// -----------------------------------------------------------------------
+
+// c = beta * c + alpha * val, in the same order of operations as the generic code
+template <class VT>
+inline typename VT::V Combine(typename VT::V val, const typename VT::Elem* c, typename VT::Elem alpha, typename VT::Elem beta)
+{
+    if (alpha != 1)
+        val = VT::Mul(val, VT::Set1(alpha));
+    if (beta != 0)
+        val = VT::Add(val, VT::Mul(VT::Set1(beta), VT::Load(c)));
+    return val;
+}
+
+template <class ElemType>
+inline ElemType CombineScalar(ElemType val, const ElemType* c, ElemType alpha, ElemType beta)
+{
+    val *= alpha;
+    if (beta != 0)
+        val += beta * *c;
+    return val;
+}
+
+template <class VT, class OP>
+void UnaryKernel(size_t n, const typename VT::Elem* a, typename VT::Elem* c, typename VT::Elem alpha, typename VT::Elem beta)
+{
+    typedef typename VT::Elem Elem;
+    typedef typename VT::V V;
+    const size_t width = VT::width;
+    size_t i = 0;
+    for (; i + width <= n; i += width)
+    {
+        V r;
+        if (!OP::Vector(VT::Load(a + i), r))
+        {
+            Elem buffer[VT::width];
+            for (size_t j = 0; j < width; j++)
+                buffer[j] = OP::Scalar(a[i + j]);
+            r = VT::Load(buffer);
+        }
+        VT::Store(c + i, Combine<VT>(r, c + i, alpha, beta));
+    }
+    for (; i < n; i++)
+        c[i] = CombineScalar(OP::Scalar(a[i]), c + i, alpha, beta);
+}
+
+template <class VT, class OP>
+void BinaryKernel(size_t n, const typename VT::Elem* a, const typename VT::Elem* b, typename VT::Elem* c, typename VT::Elem alpha, typename VT::Elem beta)
+{
+    typedef typename VT::Elem Elem;
+    typedef typename VT::V V;
+    const size_t width = VT::width;
+    size_t i = 0;
+    for (; i + width <= n; i += width)
+    {
+        V r;
+        if (!OP::Vector(VT::Load(a + i), VT::Load(b + i), r))
+        {
+            Elem buffer[VT::width];
+            for (size_t j = 0; j < width; j++)
+                buffer[j] = OP::Scalar(a[i + j], b[i + j]);
+            r = VT::Load(buffer);
+        }
+        VT::Store(c + i, Combine<VT>(r, c + i, alpha, beta));
+    }
+    for (; i < n; i++)
+        c[i] = CombineScalar(OP::Scalar(a[i], b[i]), c + i, alpha, beta);
+}
+
+template <class VT>
+double ReduceSumKernel(size_t n, const typename VT::Elem* a)
+{
+    const size_t width = VT::width;
+    typename VT::DAcc acc0, acc1; // two accumulators to hide the latency of the additions
+    VT::ZeroAcc(acc0);
+    VT::ZeroAcc(acc1);
+    size_t i = 0;
+    for (; i + 2 * width <= n; i += 2 * width)
+    {
+        VT::AccumulateDouble(acc0, VT::Load(a + i));
+        VT::AccumulateDouble(acc1, VT::Load(a + i + width));
+    }
+    for (; i + width <= n; i += width)
+        VT::AccumulateDouble(acc0, VT::Load(a + i));
+    double sum = VT::HorizontalSum(acc0) + VT::HorizontalSum(acc1);
+    for (; i < n; i++)
+        sum += a[i];
+    return sum;
+}
+
+template <class VT>
+double ReduceMaxKernel(size_t n, const typename VT::Elem* a)
+{
+    typedef typename VT::Elem Elem;
+    const size_t width = VT::width;
+    size_t i = 0;
+    Elem result = a[0];
+    if (n >= width)
+    {
+        typename VT::V acc = VT::Load(a);
+        for (i = width; i + width <= n; i += width)
+            acc = VT::Max(acc, VT::Load(a + i));
+        result = VT::HorizontalMax(acc);
+    }
+    for (; i < n; i++)
+        result = a[i] > result ? a[i] : result;
+    return result;
+}
+
+template <class VT>
+void ReduceColumnsSumKernel(size_t rows, size_t cols, const typename VT::Elem* a, size_t lda, typename VT::Elem* c, typename VT::Elem alpha, typename VT::Elem beta)
+{
+    typedef typename VT::Elem Elem;
+    const size_t width = VT::width;
+    size_t i = 0;
+    for (; i + width <= rows; i += width)
+    {
+        typename VT::DAcc acc;
+        VT::ZeroAcc(acc);
+        for (size_t j = 0; j < cols; j++)
+            VT::AccumulateDouble(acc, VT::Load(a + i + j * lda));
+        VT::Store(c + i, Combine<VT>(VT::AccToVector(acc), c + i, alpha, beta));
+    }
+    for (; i < rows; i++)
+    {
+        double sum = 0;
+        for (size_t j = 0; j < cols; j++)
+            sum += a[i + j * lda];
+        c[i] = CombineScalar((Elem) sum, c + i, alpha, beta);
+    }
+}
+
+template <class VT>
+void ReduceColumnsMaxKernel(size_t rows, size_t cols, const typename VT::Elem* a, size_t lda, typename VT::Elem* c, typename VT::Elem alpha, typename VT::Elem beta)
+{
+    typedef typename VT::Elem Elem;
+    const size_t width = VT::width;
+    size_t i = 0;
+    for (; i + width <= rows; i += width)
+    {
+        typename VT::V acc = VT::Load(a + i);
+        for (size_t j = 1; j < cols; j++)
+            acc = VT::Max(acc, VT::Load(a + i + j * lda));
+        VT::Store(c + i, Combine<VT>(acc, c + i, alpha, beta));
+    }
+    for (; i < rows; i++)
+    {
+        Elem result = a[i];
+        for (size_t j = 1; j < cols; j++)
+            result = a[i + j * lda] > result ? a[i + j * lda] : result;
+        c[i] = CombineScalar(result, c + i, alpha, beta);
+    }
+}
+
+// -----------------------------------------------------------------------
+// filling the tables
+// -----------------------------------------------------------------------
+
+// kernels that only need basic arithmetic; for float and double
+template <class VT>
+void FillArithmeticKernels(CPUTensorKernelTable<typename VT::Elem>& kernels)
+{
+    kernels.copy = &UnaryKernel<VT, CopyOp<VT>>;
+    kernels.linearRectifier = &UnaryKernel<VT, LinearRectifierOp<VT>>;
+    kernels.sum = &BinaryKernel<VT, SumOp<VT>>;
+    kernels.difference = &BinaryKernel<VT, DifferenceOp<VT>>;
+    kernels.elementwiseProduct = &BinaryKernel<VT, ElementwiseProductOp<VT>>;
+    kernels.elementwiseProductWithSigmoidDerivativeFromOutput = &BinaryKernel<VT, SigmoidDerivativeFromOutputOp<VT>>;
+    kernels.elementwiseProductWithTanhDerivativeFromOutput = &BinaryKernel<VT, TanhDerivativeFromOutputOp<VT>>;
+    kernels.elementwiseProductWithLinearRectifierDerivativeFromOutput = &BinaryKernel<VT, LinearRectifierDerivativeFromOutputOp<VT>>;
+    kernels.reduceSum = &ReduceSumKernel<VT>;
+    kernels.reduceMax = &ReduceMaxKernel<VT>;
+    kernels.reduceColumnsSum = &ReduceColumnsSumKernel<VT>;
+    kernels.reduceColumnsMax = &ReduceColumnsMaxKernel<VT>;
+}
+
+// kernels that use the polynomial approximations; float only
+template <class VT>
+void FillTranscendentalKernels(CPUTensorKernelTable<float>& kernels)
+{
+    kernels.sigmoid = &UnaryKernel<VT, SigmoidOp<VT>>;
+    kernels.tanh = &UnaryKernel<VT, TanhOp<VT>>;
+    kernels.exp = &UnaryKernel<VT, ExpOp<VT>>;
+    kernels.log = &UnaryKernel<VT, LogOp<VT>>;
+    kernels.elementwiseProductWithLogDerivativeFromOutput = &BinaryKernel<VT, LogDerivativeFromOutputOp<VT>>;
+}
+
+} // anonymous namespace
+
+}}}
@@ -221,6 +221,32 @@ enum MatrixFlags
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
 };
 
+// -----------------------------------------------------------------------
+// SparseUpdateHistory -- bookkeeping for lazy updates from sparse gradients
+// -----------------------------------------------------------------------
+
+// Updates of a parameter from a gradient in matrixFormatSparseBlockCol (e.g. of an embedding) on the CPU only
+// touch the columns that have a gradient, in the parameter as well as in the optimizer state. To still get the
+// result of the dense update, the decay that the updates in between would have applied to the state of a column
+// (and, through momentum, to its value) is applied when the column is touched again, assuming that these updates
+// used the same hyper-parameters as the current one. The history records when each column was last brought up to date.
+//
+// Limitations:
+//  - Columns that are not touched lag behind until they are.
+//  - The average multiplier that RmsProp returns with needAveMultiplier is averaged over the touched columns only,
+//    while the dense update averages over all of them, so the two only match without it.
+struct SparseUpdateHistory
+{
+    size_t m_numUpdates = 0;           // number of updates so far
+    std::vector<size_t> m_lastUpdates; // [column] m_numUpdates after the last update that touched the column
+
+    void Reset()
+    {
+        m_numUpdates = 0;
+        m_lastUpdates.clear();
+    }
+};
+
 // -----------------------------------------------------------------------
 // BaseMatrixStorage -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
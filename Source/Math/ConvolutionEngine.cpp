@@ -6,6 +6,10 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include "CPUConvolution.h"
+#include <chrono>
+#include <map>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -851,6 +855,189 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Autotuned CPU convolution engine implementation.
+// For 2D convolutions with full sharing, computes the forward pass with the fastest of the
+// enabled algorithms: unrolling + GEMM, blocked direct convolution and, for 3x3 kernels with
+// stride 1, Winograd F(2x2,3x3) and F(4x4,3x3) (see CPUConvolution.h). The algorithms are
+// timed on the actual data of the first minibatch (and again whenever the minibatch gets larger),
+// and the choice is shared by all engines with the same geometry.
+// Like the GEMM engine, at most maxTempMemSizeInSamples samples are processed at a time.
+// Backward passes use the GEMM engine.
+//------------------------------------------------------------------
+template <class ElemType>
+class CpuConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    CpuConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad,
+                         ConvolutionEngineKind enabledEngines, const std::wstring& logPrefix)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), m_logPrefix(logPrefix), m_tunedBatchSize(0), m_algorithm(Algorithm::Gemm)
+    {
+        if (!CpuConvolutionDims::TryGet(*geometry, m_dims))
+            LogicError("CPU convolution engine supports only 2D convolutions with full sharing.");
+
+        auto isEnabled = [=](ConvolutionEngineKind eng) { return ((int)enabledEngines & (int)eng) != 0; };
+        if (isEnabled(ConvolutionEngineKind::Gemm))
+            m_candidates.push_back(Algorithm::Gemm);
+        if (isEnabled(ConvolutionEngineKind::Direct))
+            m_candidates.push_back(Algorithm::Direct);
+        if (isEnabled(ConvolutionEngineKind::Winograd) && m_dims.IsWinogradCompatible())
+        {
+            m_candidates.push_back(Algorithm::Winograd2x2);
+            m_candidates.push_back(Algorithm::Winograd4x4);
+        }
+        if (m_candidates.empty())
+            LogicError("CPU convolution engine: none of the enabled algorithms supports the geometry.");
+        m_algorithm = m_candidates.front();
+    }
+
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind, ConvolutionEngineKind enabledEngines)
+    {
+        CpuConvolutionDims dims;
+        if (deviceId >= 0 || poolKind != PoolKind::None || !CpuConvolutionDims::TryGet(*geometry, dims))
+            return false;
+        return ((int)enabledEngines & (int)ConvolutionEngineKind::Direct) != 0 ||
+               (((int)enabledEngines & (int)ConvolutionEngineKind::Winograd) != 0 && dims.IsWinogradCompatible());
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_maxTempMemSizeInSamples;
+
+    enum class Algorithm
+    {
+        Gemm,
+        Direct,
+        Winograd2x2,
+        Winograd4x4
+    };
+
+    static const char* ToString(Algorithm algorithm)
+    {
+        switch (algorithm)
+        {
+        case Algorithm::Gemm:        return "GEMM";
+        case Algorithm::Direct:      return "direct";
+        case Algorithm::Winograd2x2: return "Winograd F(2x2,3x3)";
+        case Algorithm::Winograd4x4: return "Winograd F(4x4,3x3)";
+        }
+        return "unknown";
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        size_t batchSize = in.GetNumCols();
+        if (batchSize > m_tunedBatchSize)
+        {
+            // Tuning computes the output as well.
+            Tune(in, kernel, out, workspace);
+            m_tunedBatchSize = batchSize;
+        }
+        else
+            Run(m_algorithm, in, kernel, out, workspace);
+    }
+
+private:
+    void Run(Algorithm algorithm, const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        if (algorithm == Algorithm::Gemm)
+        {
+            Base::ForwardCore(in, kernel, out, workspace);
+            return;
+        }
+
+        // Like the GEMM engine, process at most m_maxTempMemSizeInSamples samples at a time to bound the workspace.
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        size_t tileSize = algorithm == Algorithm::Winograd2x2 ? 2 : 4;
+        workspace.Resize(1, algorithm == Algorithm::Direct ? CpuConvolution<ElemType>::DirectWorkspaceSize(m_dims, subBatchSize)
+                                                           : CpuConvolution<ElemType>::WinogradWorkspaceSize(m_dims, tileSize, subBatchSize));
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t count = min(subBatchSize, batchSize - start);
+            const ElemType* inData = in.Data() + start * in.GetNumRows();
+            ElemType* outData = out.Data() + start * out.GetNumRows();
+            if (algorithm == Algorithm::Direct)
+                CpuConvolution<ElemType>::Direct(m_dims, inData, kernel.Data(), outData, count, workspace.Data());
+            else
+                CpuConvolution<ElemType>::Winograd(m_dims, tileSize, inData, kernel.Data(), outData, count, workspace.Data());
+        }
+    }
+
+    void Tune(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        size_t batchSize = in.GetNumCols();
+        std::string key = (std::string)(*m_geometry) + ", minibatch size: " + std::to_string(batchSize) + ", algorithms:";
+        for (auto candidate : m_candidates)
+            key += std::string(" ") + ToString(candidate);
+
+        {
+            std::lock_guard<std::mutex> lock(TuningMutex());
+            auto found = TuningResults().find(key);
+            if (found != TuningResults().end())
+            {
+                m_algorithm = found->second;
+                Run(m_algorithm, in, kernel, out, workspace);
+                return;
+            }
+        }
+
+        // Every candidate is run twice, the first run warms up caches and allocates the workspace.
+        // All candidates compute the same output, so the one of the last run is kept.
+        double bestTime = 0;
+        std::string timings;
+        for (auto candidate : m_candidates)
+        {
+            double time = 0;
+            if (m_candidates.size() > 1)
+            {
+                Run(candidate, in, kernel, out, workspace);
+                auto start = std::chrono::steady_clock::now();
+                Run(candidate, in, kernel, out, workspace);
+                time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                timings += msra::strfun::strprintf(" %s %.3f ms;", ToString(candidate), time);
+            }
+            else
+                Run(candidate, in, kernel, out, workspace);
+
+            if (candidate == m_candidates.front() || time < bestTime)
+            {
+                m_algorithm = candidate;
+                bestTime = time;
+            }
+        }
+
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing %s CPU convolution for minibatch size %d (%s) for geometry: %s.\n",
+                    m_logPrefix.c_str(), ToString(m_algorithm), (int)batchSize, timings.empty() ? "not tuned" : timings.c_str() + 1, ((std::string)(*m_geometry)).c_str());
+
+        std::lock_guard<std::mutex> lock(TuningMutex());
+        TuningResults()[key] = m_algorithm;
+    }
+
+    static std::mutex& TuningMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::map<std::string, Algorithm>& TuningResults()
+    {
+        static std::map<std::string, Algorithm> results;
+        return results;
+    }
+
+    CpuConvolutionDims m_dims;
+    std::wstring m_logPrefix;
+    std::vector<Algorithm> m_candidates;
+    size_t m_tunedBatchSize;
+    Algorithm m_algorithm;
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -886,6 +1073,15 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms, poolIncludePad);
     }
 
+    // The autotuned engine chooses its algorithm by timing, so its results are not reproducible.
+    if (!forceDeterministicAlgorithms && CpuConvolutionEngine<ElemType>::IsSupported(deviceId, geometry, poolKind, enabledEngines))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing autotuned CPU convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<CpuConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad, enabledEngines, logPrefix);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         if (GetMathLibTraceLevel() > 0)
@@ -22,8 +22,13 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Direct    = 1 << 4, // Blocked direct convolution without unrolling, CPU only. Works only for 2D convos with full sharing.
+    Winograd  = 1 << 5, // Winograd F(2x2,3x3)/F(4x4,3x3), CPU only. Works only for 2D 3x3 convos with stride 1 and full sharing.
 
-    All       = Reference | CuDnn | Legacy | Gemm
+    All       = Reference | CuDnn | Legacy | Gemm,
+    // Direct and Winograd are opt-in (see Globals::ShouldUseFastCpuConvolution()): the autotuned engine that uses them
+    // picks an algorithm by timing, and F(4x4,3x3) is less accurate.
+    AllWithFastCpu = All | Direct | Winograd
 };
 
 enum class PoolKind
@@ -1640,7 +1640,8 @@ void Matrix<ElemType>::MomentumSGDUpdate(Matrix<ElemType>& gradients,
                                          Matrix<ElemType>& smoothedGradients,
                                          ElemType learnRatePerSample,
                                          ElemType momentum,
-                                         bool unitGainMomentum)
+                                         bool unitGainMomentum,
+                                         SparseUpdateHistory* history)
 {
     DecideAndMoveToRightDevice(smoothedGradients, gradients, *this);
 
@@ -1666,13 +1667,9 @@ void Matrix<ElemType>::MomentumSGDUpdate(Matrix<ElemType>& gradients,
             // 1) sg_t = momentum * sg_{t-1} + g_{t-1}
             // Unit-gain momentum (unitGainFactor == 1.0 - momentum):
             // 1) sg_t = momentum * sg_{t-1} + (1.0 - momentum) * g_{t-1}
-            // 2) g'_{t-1} = sg_t
-            // 3) w_t = w_{t-1} - learnRatePerSample * g'_{t-1}
-            if (momentum != 0)
-            {
-                gradients.m_CPUSparseMatrix->NormalGrad(*smoothedGradients.m_CPUMatrix, momentum, unitGainMomentum);
-            }
-            ScaleAndAdd(-learnRatePerSample, gradients, *this);
+            // 2) w_t = w_{t-1} - learnRatePerSample * sg_t
+            // Only the columns of the gradient are updated.
+            gradients.m_CPUSparseMatrix->MomentumSGDUpdate(*smoothedGradients.m_CPUMatrix, *m_CPUMatrix, learnRatePerSample, momentum, unitGainMomentum, /*nesterov=*/false, history);
         },
         { 
             if (momentum != 0)
@@ -1690,7 +1687,8 @@ void Matrix<ElemType>::NesterovAcceleratedMomentumSGDUpdate(Matrix<ElemType>& gr
                                                             Matrix<ElemType>& smoothedGradients,
                                                             ElemType learnRatePerSample,
                                                             ElemType momentum,
-                                                            bool unitGainMomentum)
+                                                            bool unitGainMomentum,
+                                                            SparseUpdateHistory* history)
 {
     DecideAndMoveToRightDevice(smoothedGradients, gradients, *this);
 
@@ -1714,16 +1712,10 @@ void Matrix<ElemType>::NesterovAcceleratedMomentumSGDUpdate(Matrix<ElemType>& gr
             ScaleAndAdd(-unitGainFactor * learnRatePerSample, gradients, *this);
         },
         { /* CPU sparse */
-            if (momentum != 0)
-            {
-                // Identical to the above, except that as a side effect "NormalGrad" modifies 
-                // gradient values in place, so that gradientCache is needed to store the original values.
-                Matrix<ElemType> gradientCache(gradients.GetDeviceId());
-                gradientCache.AssignValuesOf(gradients);
-                gradients.m_CPUSparseMatrix->NormalGrad(*smoothedGradients.m_CPUMatrix, momentum, unitGainMomentum);
-                ScaleAndAdd(-momentum, smoothedGradients, *this);
-                ScaleAndAdd(-unitGainFactor * learnRatePerSample, gradientCache, *this);
-            }
+            // As the sparse momentum SGD update above, the smoothed gradients do not include the learning rate:
+            //  sg_t = momentum * sg_{t-1} + unitGainFactor * g_{t-1}
+            //  w_t = w_{t-1} - learnRatePerSample * (momentum * sg_t + unitGainFactor * g_{t-1})
+            gradients.m_CPUSparseMatrix->MomentumSGDUpdate(*smoothedGradients.m_CPUMatrix, *m_CPUMatrix, learnRatePerSample, momentum, unitGainMomentum, /*nesterov=*/true, history);
         },
         { /* GPU sparse */
             if (momentum != 0)
@@ -1760,7 +1752,8 @@ ElemType Matrix<ElemType>::Adagrad(Matrix<ElemType>& gradients, const bool needA
 //  - the model itself
 template <class ElemType>
 void Matrix<ElemType>::FSAdagradUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const double targetAdagradAvDenom_x_sqrtAdagradSqrFrames,
-                                       const double learnRatePerSample, const double meanMomentum, const double varMomentum, bool unitGainMomentum)
+                                       const double learnRatePerSample, const double meanMomentum, const double varMomentum, bool unitGainMomentum,
+                                       SparseUpdateHistory* history)
 {
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { 
@@ -1775,7 +1768,12 @@ void Matrix<ElemType>::FSAdagradUpdate(Matrix<ElemType>& gradients, Matrix<ElemT
                                    (ElemType)targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum);
             SetDataLocation(GPU); 
         },
-        { NOT_IMPLEMENTED; },
+        {
+            gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix,
+                                                   (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum,
+                                                   (ElemType)targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum, history);
+            SetDataLocation(CPU);
+        },
         {
             gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, 
                                                    (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum,
@@ -1792,7 +1790,8 @@ void Matrix<ElemType>::FSAdagradUpdate(Matrix<ElemType>& gradients, Matrix<ElemT
 ///
 template <class ElemType>
 void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const double smoothedCount,
-    const double learnRatePerSample, const double meanMomentum, const double varMomentum, const double epsilon, bool unitGainMomentum, bool adamax)
+    const double learnRatePerSample, const double meanMomentum, const double varMomentum, const double epsilon, bool unitGainMomentum, bool adamax,
+    SparseUpdateHistory* history)
 {
     // Bias correction
     let biasCorrection = adamax? (ElemType)(1. / (1- pow(meanMomentum, smoothedCount))) : (ElemType)(sqrt(1- pow(varMomentum, smoothedCount))/(1- pow(meanMomentum, smoothedCount)));
@@ -1810,7 +1809,13 @@ void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>&
         biasCorrection, (ElemType)epsilon, unitGainMomentum, adamax);
         SetDataLocation(GPU);
     },
-    { NOT_IMPLEMENTED; },
+    {
+        // the bias correction of the skipped updates differs from the one of this update
+        gradients.m_CPUSparseMatrix->Adam(*m_CPUMatrix, *functionValues.m_CPUMatrix,
+        (ElemType)learnRatePerSample, meanMomentum, varMomentum,
+        smoothedCount, (ElemType)epsilon, unitGainMomentum, adamax, history);
+        SetDataLocation(CPU);
+    },
     { gradients.m_GPUSparseMatrix->Adam(*m_GPUMatrix, *functionValues.m_GPUMatrix, 
         (ElemType)learnRatePerSample, (ElemType)meanMomentum, 
         (ElemType)varMomentum, biasCorrection, (ElemType)epsilon, unitGainMomentum, adamax); 
@@ -1827,14 +1832,15 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
                                    ElemType RMS_WGT_DEC,
                                    ElemType RMS_WGT_MIN,
                                    const bool needAveMultiplier,
-                                   const bool initialized)
+                                   const bool initialized,
+                                   SparseUpdateHistory* history)
 {
     DecideAndMoveToRightDevice(*this, gradients);
 
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { return m_CPUMatrix->RmsProp(*gradients.m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier, initialized); SetDataLocation(CPU); },
         { return m_GPUMatrix->RmsProp(*gradients.m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier, initialized); SetDataLocation(GPU); },
-        { NOT_IMPLEMENTED; },
+        { return gradients.m_CPUSparseMatrix->RmsProp(*m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier, initialized, history); SetDataLocation(CPU); },
         { return gradients.m_GPUSparseMatrix->RmsProp(*m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier, initialized); SetDataLocation(GPU); });
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
@@ -4736,7 +4742,7 @@ void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<E
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNForward(*(inputX.m_CPUMatrix), *(paramW.m_CPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNForward(*(inputX.m_GPUMatrix), *(paramW.m_GPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4751,7 +4757,7 @@ void Matrix<ElemType>::RNNBackwardData(const Matrix<ElemType>& outputDY, const M
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNBackwardData(*(outputDY.m_CPUMatrix), *(paramW.m_CPUMatrix), *(outputDX.m_CPUMatrix), rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNBackwardData(*(outputDY.m_GPUMatrix), *(paramW.m_GPUMatrix), *(outputDX.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4766,7 +4772,7 @@ void Matrix<ElemType>::RNNBackwardWeights(const Matrix<ElemType>& inputX, const
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNBackwardWeights(*(inputX.m_CPUMatrix), *(outputY.m_CPUMatrix), *(dw.m_CPUMatrix), rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNBackwardWeights(*(inputX.m_GPUMatrix), *(outputY.m_GPUMatrix), *(dw.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -5093,7 +5099,13 @@ template <class ElemType>
                     GPUSparseMatrix<ElemType>::ScaleAndAdd(alpha, *a.m_GPUSparseMatrix, *c.m_GPUMatrix);
                 c.SetDataLocation(GPU);
             },
-            { NOT_IMPLEMENTED; },
+            {
+                // as on the GPU, adding a dense matrix makes c dense, e.g. for the L2 regularization of a sparse gradient
+                c.m_CPUMatrix = make_shared<CPUMatrix<ElemType>>(c.m_CPUSparseMatrix->CopyColumnSliceToDense(0, c.GetNumCols()));
+                CPUMatrix<ElemType>::ScaleAndAdd(alpha, *a.m_CPUMatrix, *c.m_CPUMatrix);
+                c.SetDataLocation(CPU, DENSE);
+                c.m_CPUSparseMatrix = nullptr;
+            },
             {
                 c.m_GPUMatrix = make_shared<GPUMatrix<ElemType>>(c.m_GPUSparseMatrix->CopyToDenseMatrix());
                 GPUSparseMatrix<ElemType>::ScaleAndAdd(alpha, *a.m_GPUMatrix, 1, *c.m_GPUSparseMatrix, *c.m_GPUMatrix);
@@ -4,6 +4,7 @@
 //
 #pragma once
 #include "Quantizers.h"
+#include "BlockMultiplierEngine.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -14,6 +15,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 template <class ElemType>
 class QuantizedMultiplier
 {
+protected:
     // Quantizers for matrices A and B
     shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerA;
     shared_ptr<QuantizerBase<ElemType, short>> m_pQuantizerB;
@@ -41,8 +43,10 @@ public:
     {
     };
 
+    virtual ~QuantizedMultiplier() {}
+
     // A[m,k]*B[k,n] = C[m,n]
-    void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
+    virtual void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
     {
         // Quantize
         if (!m_isAConstant || m_firstPass)
@@ -86,4 +90,82 @@ public:
     void SetIsBConstant(bool v) { m_isBConstant = v; }
 };
 
+// Quantized product of constant weights A with B by the BlockMultiplier, using the AVX2 block handler if the
+// CPU supports it and the SSE one otherwise. A is quantized and rewritten in block order on the first product
+// only, and again if a different A is passed in or the caller reports a new version of its values by
+// SetVersionOfA() (e.g. the eval time stamp of the weights).
+template <class ElemType>
+class BlockQuantizedMultiplier : public QuantizedMultiplier<ElemType>
+{
+    typedef QuantizedMultiplier<ElemType> Base;
+
+    std::unique_ptr<BlockMultiplierEngine> m_pEngine;
+
+    // The A that was prepared last
+    const ElemType* m_preparedA;
+    int m_preparedM;
+    int m_preparedK;
+    uint64_t m_preparedVersion;
+
+    uint64_t m_versionOfA;
+
+    vector<int32_t> m_product;
+
+public:
+    BlockQuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB) :
+        Base(pQuantizerA, true, pQuantizerB, false), m_preparedA(nullptr), m_preparedM(0), m_preparedK(0), m_preparedVersion(0), m_versionOfA(0)
+    {
+    }
+
+    // Sets the version of the values of A for the following products. A is prepared again if it differs from
+    // the one A was prepared with, even if A is at the same address.
+    void SetVersionOfA(uint64_t version) { m_versionOfA = version; }
+
+    // The block multiplier saturates its 32-bit sums instead of wrapping around. This returns the smallest bit shift of
+    // symmetric quantizers for A and B for which a sum of k products cannot overflow: the quantized values are below
+    // 2^(15 - bitShift), so k products fit if k <= 2^(1 + 2 * bitShift).
+    static size_t SafeBitShift(size_t k)
+    {
+        size_t bitShift = 1;
+        while (bitShift < 14 && ((size_t)1 << (1 + 2 * bitShift)) < k)
+            bitShift++;
+        return bitShift;
+    }
+
+    // A[m,k]*B[k,n] = C[m,n]
+    // In column-major storage, this is the row-major product B'[n,k]*A'[k,m] = C'[n,m], so A is the right-hand side of
+    // the block multiplier, which is the one it prepares once.
+    void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C) override
+    {
+        if (!m_pEngine)
+            m_pEngine = BlockMultiplierEngine::Create();
+
+        if (A != m_preparedA || m != m_preparedM || k != m_preparedK || m_versionOfA != m_preparedVersion)
+        {
+            this->m_pMatA.resize(m*k);
+            ArrayRef<short> refMatA(this->m_pMatA.data(), this->m_pMatA.size());
+            this->m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, this->m_pMatA.size()), refMatA);
+            m_pEngine->PrepareB(this->m_pMatA.data(), k, m);
+            m_preparedA = A;
+            m_preparedM = m;
+            m_preparedK = k;
+            m_preparedVersion = m_versionOfA;
+        }
+
+        this->m_pMatB.resize(n*k);
+        ArrayRef<short> refMatB(this->m_pMatB.data(), this->m_pMatB.size());
+        this->m_pQuantizerB->Quantize(ArrayRef<ElemType>(B, this->m_pMatB.size()), refMatB);
+
+        int mn = m*n;
+        m_product.resize(mn);
+        m_pEngine->Multiply(this->m_pMatB.data(), n, m_product.data());
+        for (int i = 0; i < mn; i++)
+            C[i] = (ElemType)m_product[i];
+
+        // De-quantize
+        this->m_pQuantizerB->Dequantize(C, C, mn);
+        this->m_pQuantizerA->Dequantize(C, C, mn);
+    }
+};
+
 }}}
\ No newline at end of file
@@ -66,6 +66,8 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helpe
     BinaryChunkDeserializer(helper.GetFilePath())
 {
     SetTraceLevel(helper.GetTraceLevel());
+    m_useMemoryMapping = helper.ShouldUseMemoryMapping();
+    m_prefetchMappedChunks = helper.ShouldPrefetchMappedChunks();
 
     Initialize(helper.GetRename(), helper.GetElementType());
 }
@@ -75,6 +77,8 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const std::wstring& filename) :
     DataDeserializerBase(true),
     m_filename(filename),
     m_file(nullptr),
+    m_useMemoryMapping(false),
+    m_prefetchMappedChunks(false),
     m_headerOffset(0),
     m_chunkTableOffset(0),
     m_traceLevel(0)
@@ -150,6 +154,14 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     // Note it's possible in distributed reading mode to only want to read
     // a subset of the offsets table.
     ReadChunkTable(m_file);
+
+    // The header and the chunk table are small, so they are read through m_file either way. The chunks
+    // themselves are then accessed through the mapping.
+    m_mappedFile.reset();
+    if (m_useMemoryMapping)
+    {
+        m_mappedFile = make_shared<MemoryMappedFile>(m_filename);
+    }
 }
 
 ChunkDescriptions BinaryChunkDeserializer::GetChunkDescriptions()
@@ -177,10 +189,18 @@ void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vec
     auto numberOfSequences = m_chunkTable->GetNumSequences(chunkId);
     unique_ptr<uint32_t[]> numSamplesPerSequence(new uint32_t[numberOfSequences]);
 
-    // Seek to the start of the chunk
-    CNTKBinaryFileHelper::SeekOrDie(m_file, offset, SEEK_SET);
-    // read 'numberOfSequences' unsigned ints
-    CNTKBinaryFileHelper::ReadOrDie(numSamplesPerSequence.get(), sizeof(uint32_t), numberOfSequences, m_file);
+    if (m_mappedFile)
+    {
+        // copy 'numberOfSequences' unsigned ints from the mapping
+        memcpy(numSamplesPerSequence.get(), m_mappedFile->Data(offset, sizeof(uint32_t) * numberOfSequences), sizeof(uint32_t) * numberOfSequences);
+    }
+    else
+    {
+        // Seek to the start of the chunk
+        CNTKBinaryFileHelper::SeekOrDie(m_file, offset, SEEK_SET);
+        // read 'numberOfSequences' unsigned ints
+        CNTKBinaryFileHelper::ReadOrDie(numSamplesPerSequence.get(), sizeof(uint32_t), numberOfSequences, m_file);
+    }
 
     auto startId = m_chunkTable->GetStartIndex(chunkId);
     for (decltype(numberOfSequences) i = 0; i < numberOfSequences; i++)
@@ -215,8 +235,29 @@ unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 }
 
 
+const byte* BinaryChunkDeserializer::GetMappedChunk(ChunkIdType chunkId)
+{
+    auto dataStartOffset = m_chunkTable->GetDataStartOffset(chunkId);
+    size_t chunkSize = m_chunkTable->GetChunkSize(chunkId);
+    const byte* data = (const byte*)m_mappedFile->Data(dataStartOffset, chunkSize);
+
+    // The randomizer requests chunks ahead of the time they are needed (it prefetches the next chunk in
+    // the randomized order on a background thread), and no I/O happens here otherwise, so this is the
+    // point to ask the OS to start reading the chunk in.
+    if (m_prefetchMappedChunks)
+        m_mappedFile->WillNeed(dataStartOffset, chunkSize);
+
+    return data;
+}
+
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
+    if (m_mappedFile)
+    {
+        // Point into the mapping instead of copying
+        return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), m_mappedFile, GetMappedChunk(chunkId), m_deserializers);
+    }
+
     // Read the chunk into memory
     unique_ptr<byte[]> buffer = ReadChunk(chunkId);
 
@@ -10,6 +10,7 @@
 #include "CorpusDescriptor.h"
 #include "BinaryDataChunk.h"
 #include "BinaryDataDeserializer.h"
+#include "MemoryMappedFile.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -108,6 +109,9 @@ private:
     // Reads a chunk from disk into buffer
     unique_ptr<byte[]> ReadChunk(ChunkIdType chunkId);
 
+    // Returns a pointer to the data of the chunk in the memory mapped file
+    const byte* GetMappedChunk(ChunkIdType chunkId);
+
     BinaryChunkDeserializer(const wstring& filename);
 
     void SetTraceLevel(unsigned int traceLevel);
@@ -116,6 +120,11 @@ private:
     const wstring m_filename;
     FILE* m_file;
 
+    // If not null, the file is memory mapped and chunks point directly into the mapping.
+    MemoryMappedFilePtr m_mappedFile;
+    bool m_useMemoryMapping;
+    bool m_prefetchMappedChunks;
+
     int64_t m_headerOffset, m_chunkTableOffset;
 
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
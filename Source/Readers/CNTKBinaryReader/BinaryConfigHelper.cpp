@@ -64,6 +64,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         m_filepath = msra::strfun::utf16(config(L"file"));
         m_keepDataInMemory = config(L"keepDataInMemory", false);
+        m_chunkCacheSizeInBytes = config(L"chunkCacheSizeInBytes", (size_t)0);
+        m_useMemoryMapping = config(L"useMemoryMapping", false);
+        m_prefetchMappedChunks = config(L"prefetchMappedChunks", true);
 
         m_randomizationWindow = GetRandomizationWindowFromConfig(config);
         m_sampleBasedRandomizationWindow = config(L"sampleBasedRandomizationWindow", false);
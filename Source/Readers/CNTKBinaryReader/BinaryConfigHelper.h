@@ -34,6 +34,12 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    size_t GetChunkCacheSize() const { return m_chunkCacheSizeInBytes; }
+
+    bool ShouldUseMemoryMapping() const { return m_useMemoryMapping; }
+
+    bool ShouldPrefetchMappedChunks() const { return m_prefetchMappedChunks; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(BinaryConfigHelper);
@@ -48,6 +54,9 @@ private:
     bool m_sampleBasedRandomizationWindow;
     unsigned int m_traceLevel;
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_chunkCacheSizeInBytes; // if not 0 (and not keepDataInMemory), chunks are cached up to this size
+    bool m_useMemoryMapping; // if true the file is memory mapped, and chunks point into the mapping instead of being read into buffers
+    bool m_prefetchMappedChunks; // if true (and memory mapping), the OS is asked to read chunks ahead as soon as they are requested
 };
 
 } } }
@@ -10,6 +10,7 @@
 #include "CorpusDescriptor.h"
 #include "BinaryChunkDeserializer.h"
 #include "BinaryDataDeserializer.h"
+#include "MemoryMappedFile.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 class BinaryDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
@@ -23,6 +24,21 @@ public:
         m_numSequences(numSequences), 
         m_buffer(std::move(buffer)), 
         m_deserializers(deserializer)
+    {
+        m_chunkData = m_buffer.get();
+    }
+
+    // Creates a chunk that points directly into a memory mapped file, without copying the data.
+    explicit BinaryDataChunk(ChunkIdType chunkId,
+        size_t numSequences,
+        MemoryMappedFilePtr mappedFile,
+        const byte* chunkData,
+        std::vector<BinaryDataDeserializerPtr> deserializer)
+        : m_chunkId(chunkId),
+        m_numSequences(numSequences),
+        m_mappedFile(mappedFile),
+        m_chunkData(chunkData),
+        m_deserializers(deserializer)
     { }
 
     // Gets a sequence using its index inside the chunk.
@@ -58,7 +74,7 @@ protected:
         size_t bytesProcessed = 0;
         // Now call all of the deserializers on the chunk, in order
         for (size_t i = 0; i < m_deserializers.size(); i++)
-            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, m_buffer.get() + bytesProcessed, m_data[i]);
+            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, const_cast<byte*>(m_chunkData) + bytesProcessed, m_data[i]);
     }
 
     // chunk id (copied from the descriptor)
@@ -71,6 +87,13 @@ protected:
     // This is the actual chunk read from disk. We will call back to the deserializer for it to be deserialized
     unique_ptr<byte[]> m_buffer;
 
+    // Alternatively, the file the chunk is memory mapped from (kept alive as long as the chunk is).
+    MemoryMappedFilePtr m_mappedFile;
+
+    // The chunk data: either m_buffer, or a pointer into the mapped file. The sequences point into it,
+    // and never write to it (the mapping is read-only).
+    const byte* m_chunkData;
+
     // This is the deserializer who knows how to interpret the m_data chunk that we read in
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
     
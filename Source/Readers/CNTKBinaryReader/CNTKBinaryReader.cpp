@@ -29,11 +29,19 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
     {
         m_deserializer = shared_ptr<IDataDeserializer>(new BinaryChunkDeserializer(configHelper));
 
+        if (configHelper.ShouldUseMemoryMapping())
+            log << " | memory mapped";
+
         if (configHelper.ShouldKeepDataInMemory())
         {
             m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer));
             log << " | keeping data in memory";
         }
+        else if (configHelper.GetChunkCacheSize() > 0)
+        {
+            m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer, configHelper.GetChunkCacheSize()));
+            log << " | caching up to " << configHelper.GetChunkCacheSize() / (1024 * 1024) << " MB of chunks";
+        }
 
         size_t window = configHelper.GetRandomizationWindow();
         if (window > 0)
@@ -35,6 +35,8 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
 
         if (configHelper.ShouldKeepDataInMemory())
             m_deserializer = make_shared<ChunkCache>(m_deserializer);
+        else if (configHelper.GetChunkCacheSize() > 0)
+            m_deserializer = make_shared<ChunkCache>(m_deserializer, configHelper.GetChunkCacheSize());
 
         size_t window = configHelper.GetRandomizationWindow();
         if (window > 0)
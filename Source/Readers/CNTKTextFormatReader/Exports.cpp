@@ -10,6 +10,7 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "CNTKTextFormatReader.h"
+#include "TextToBinaryConverter.h"
 #include "HeapMemoryProvider.h"
 #include "StringUtil.h"
 
@@ -57,5 +58,10 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
     return true;
 }
 
+// Converts a text file into the CNTK binary format, see TextToBinaryConverter for the configuration.
+extern "C" DATAREADER_API void ConvertTextToBinary(const ConfigParameters* config)
+{
+    TextToBinaryConverter(*config).Convert();
+}
 
 }}}
@@ -124,6 +124,9 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_traceLevel = config(L"traceLevel", 1);
     m_chunkSizeBytes = config(L"chunkSizeInBytes", g_32MB); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
+    m_chunkCacheSizeInBytes = config(L"chunkCacheSizeInBytes", (size_t)0);
+    m_cacheIndex = config(L"cacheIndex", false);
+    m_numParsingThreads = config(L"numParsingThreads", (size_t)0);
     m_frameMode = config(L"frameMode", false);
 
     m_randomizationWindow = GetRandomizationWindowFromConfig(config);
@@ -39,6 +39,12 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    size_t GetChunkCacheSize() const { return m_chunkCacheSizeInBytes; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
+    size_t GetNumParsingThreads() const { return m_numParsingThreads; }
+
     bool IsInFrameMode() const { return m_frameMode; }
 
     ElementType GetElementType() const { return m_elementType; }
@@ -58,6 +64,9 @@ private:
     unsigned int m_traceLevel;
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_chunkCacheSizeInBytes; // if not 0 (and not keepDataInMemory), chunks are cached up to this size
+    bool m_cacheIndex; // if true the index is kept in a sidecar file next to the input file
+    size_t m_numParsingThreads; // number of threads that parse a chunk, 0 means one per hardware thread (for large enough chunks)
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
 };
 
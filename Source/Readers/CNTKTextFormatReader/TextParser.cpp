@@ -7,9 +7,13 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
+#include <future>
+#include <thread>
 #include "Indexer.h"
+#include "IndexCache.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
+#include "TimerUtility.h"
 
 #define isSign(c) ((c == '-' || c == '+'))
 #define isE(c) ((c == 'e' || c == 'E'))
@@ -21,6 +25,93 @@ inline bool IsDigit(char c)
     return '0' <= c && c <= '9';
 }
 
+// A fast path for TextParser::TryReadRealNumber(), for a number that lies entirely in [pos, end),
+// as do all numbers of a chunk that is parsed from memory. Computes exactly the same value as the
+// state machine there, but in a few tight loops over the characters, without checking the buffer
+// for every one of them. Returns false without consuming anything if the number is malformed, or
+// if it may continue beyond 'end'; the state machine then takes over (and reports the problem).
+template <class ElemType>
+static inline bool TryParseRealNumber(const char*& pos, const char* end, ElemType& value)
+{
+    const char* p = pos;
+    bool negative = false;
+    if (p != end && isSign(*p))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+    if (p == end || !IsDigit(*p))
+        return false;
+
+    double number = 0;
+    for (; p != end && IsDigit(*p); ++p)
+        number = number * 10 + (*p - '0');
+    if (p == end)
+        return false;
+
+    double coefficient;
+    if (*p == '.')
+    {
+        ++p;
+        if (p == end)
+            return false;
+        if (!IsDigit(*p))
+        {
+            value = static_cast<ElemType>(negative ? -number : number);
+            pos = p;
+            return true;
+        }
+
+        coefficient = number;
+        double fraction = 0, divider = 1;
+        for (; p != end && IsDigit(*p); ++p)
+        {
+            fraction = fraction * 10 + (*p - '0');
+            divider *= 10;
+        }
+        if (p == end)
+            return false;
+        coefficient += fraction / divider;
+        if (!isE(*p))
+        {
+            value = static_cast<ElemType>(negative ? -coefficient : coefficient);
+            pos = p;
+            return true;
+        }
+        if (negative)
+            coefficient = -coefficient;
+    }
+    else if (isE(*p))
+    {
+        coefficient = negative ? -number : number;
+    }
+    else
+    {
+        value = static_cast<ElemType>(negative ? -number : number);
+        pos = p;
+        return true;
+    }
+
+    // the exponent
+    ++p;
+    bool negativeExponent = false;
+    if (p != end && isSign(*p))
+    {
+        negativeExponent = (*p == '-');
+        ++p;
+    }
+    if (p == end || !IsDigit(*p))
+        return false;
+    double exponent = 0;
+    for (; p != end && IsDigit(*p); ++p)
+        exponent = exponent * 10 + (*p - '0');
+    if (p == end)
+        return false;
+    value = static_cast<ElemType>(coefficient * pow(10.0, negativeExponent ? -exponent : exponent));
+    pos = p;
+    return true;
+}
+
 enum State
 {
     Init = 0,
@@ -65,6 +156,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), primary)
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetCacheIndex(helper.ShouldCacheIndex());
+    SetNumParsingThreads(helper.GetNumParsingThreads());
 
     Initialize();
 }
@@ -89,6 +182,9 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_hadWarnings(false),
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
+    m_cacheIndex(false),
+    m_hasMainStream(false),
+    m_numParsingThreads(0),
     m_numRetries(5),
     m_corpus(corpus)
 {
@@ -118,6 +214,36 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_scratch = unique_ptr<char[]>(new char[m_maxAliasLength + 1]);
 }
 
+template <class ElemType>
+TextParser<ElemType>::TextParser(const TextParser& parent, const char* data, size_t size, size_t fileOffset) :
+    DataDeserializerBase(parent.m_primary),
+    m_streamDescriptors(parent.m_streamDescriptors),
+    m_filename(parent.m_filename),
+    m_file(nullptr),
+    m_streamInfos(parent.m_streamInfos),
+    m_maxAliasLength(parent.m_maxAliasLength),
+    m_aliasToIdMap(parent.m_aliasToIdMap),
+    m_indexer(nullptr),
+    m_fileOffsetStart(fileOffset),
+    m_fileOffsetEnd(fileOffset + size),
+    m_bufferStart(data),
+    m_bufferEnd(data + size),
+    m_pos(data),
+    m_scratch(new char[parent.m_maxAliasLength + 1]),
+    m_chunkSizeBytes(parent.m_chunkSizeBytes),
+    m_traceLevel(parent.m_traceLevel),
+    m_hadWarnings(false),
+    m_numAllowedErrors(parent.m_numAllowedErrors),
+    m_skipSequenceIds(parent.m_skipSequenceIds),
+    m_cacheIndex(parent.m_cacheIndex),
+    m_hasMainStream(parent.m_hasMainStream),
+    m_numParsingThreads(1),
+    m_numRetries(parent.m_numRetries),
+    m_corpus(parent.m_corpus)
+{
+    m_streams = parent.m_streams;
+}
+
 template <class ElemType>
 TextParser<ElemType>::~TextParser()
 {
@@ -180,8 +306,9 @@ void TextParser<ElemType>::Initialize()
                 RuntimeError("Only a single stream is allowed to define the minibatch size, but %zu found.", streams.size());
         }
 
+        m_hasMainStream = !mainStreamAlias.empty();
         m_indexer = make_unique<Indexer>(m_file, m_primary, m_skipSequenceIds, NAME_PREFIX, m_chunkSizeBytes, mainStreamAlias);
-        m_indexer->Build(m_corpus);
+        m_indexer->Build(m_corpus, m_cacheIndex ? IndexCache::GetPathFor(m_filename) : L"");
     });
 
     assert(m_indexer != nullptr);
@@ -275,14 +402,140 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 template <class ElemType>
 void TextParser<ElemType>::LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor)
 {
+    Timer timer;
+    timer.Start();
+
     chunk->m_sequenceMap.resize(descriptor.Sequences().size());
-    for (size_t sequenceIndex = 0; sequenceIndex < descriptor.Sequences().size(); ++sequenceIndex)
+    size_t numberOfThreads = GetNumberOfParsingThreads(descriptor);
+    if (numberOfThreads > 1)
     {
-        const auto& sequenceDescriptor = descriptor.Sequences()[sequenceIndex];
-        chunk->m_sequenceMap[sequenceIndex] = LoadSequence(sequenceDescriptor, descriptor.m_offset);
+        LoadChunkInParallel(chunk, descriptor, numberOfThreads);
+    }
+    else
+    {
+        for (size_t sequenceIndex = 0; sequenceIndex < descriptor.Sequences().size(); ++sequenceIndex)
+        {
+            const auto& sequenceDescriptor = descriptor.Sequences()[sequenceIndex];
+            chunk->m_sequenceMap[sequenceIndex] = LoadSequence(sequenceDescriptor, descriptor.m_offset);
+        }
+    }
+
+    timer.Stop();
+    // above Info, because the times differ from run to run, unlike the rest of the output
+    if (m_traceLevel > Info)
+    {
+        double megabytes = descriptor.SizeInBytes() / (1024.0 * 1024.0);
+        double seconds = timer.ElapsedSeconds();
+        fprintf(stderr,
+            "INFO: Parsed a chunk of %.2f MB (%" PRIu64 " sequences) on %" PRIu64 " thread(s)"
+            " in %.3f seconds (%.1f MB/s).\n",
+            megabytes, descriptor.Sequences().size(), numberOfThreads,
+            seconds, seconds > 0 ? megabytes / seconds : 0.0);
     }
 }
 
+template <class ElemType>
+size_t TextParser<ElemType>::GetNumberOfParsingThreads(const ChunkDescriptor& descriptor) const
+{
+    size_t numberOfThreads = m_numParsingThreads;
+    if (numberOfThreads == 0)
+    {
+        numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+        numberOfThreads = std::min(numberOfThreads, descriptor.SizeInBytes() / c_minBytesPerParsingThread);
+    }
+    return std::max<size_t>(1, std::min(numberOfThreads, descriptor.Sequences().size()));
+}
+
+template <class ElemType>
+void TextParser<ElemType>::LoadChunkInParallel(TextChunkPtr& chunk, const ChunkDescriptor& descriptor, size_t numberOfThreads)
+{
+    // Read the whole chunk with a single read, the threads then only access memory.
+    size_t chunkSize = descriptor.SizeInBytes();
+    unique_ptr<char[]> data(new char[chunkSize]);
+    int rc = _fseeki64(m_file, descriptor.m_offset, SEEK_SET);
+    if (rc)
+    {
+        PrintWarningNotification();
+        RuntimeError("Error seeking to position %" PRIu64 " in the input file (%ls).",
+            descriptor.m_offset, m_filename.c_str());
+    }
+    size_t bytesRead = fread(data.get(), 1, chunkSize, m_file);
+    if (bytesRead < chunkSize && ferror(m_file))
+    {
+        PrintWarningNotification();
+        RuntimeError("Could not read from the input file (%ls).", m_filename.c_str());
+    }
+
+    // The buffer no longer matches the file position, the next LoadSequence() has to seek.
+    m_fileOffsetStart = m_fileOffsetEnd = descriptor.m_offset + bytesRead;
+    m_bufferStart = m_bufferEnd = m_pos = m_buffer.get();
+
+    // Split the sequences into ranges of about the same size in bytes.
+    const auto& sequences = descriptor.Sequences();
+    vector<size_t> rangeBegin(numberOfThreads + 1, sequences.size());
+    rangeBegin[0] = 0;
+    for (size_t sequenceIndex = 0, range = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
+    {
+        size_t rangeOfSequence = std::min(numberOfThreads - 1, sequences[sequenceIndex].OffsetInChunk() * numberOfThreads / chunkSize);
+        while (range < rangeOfSequence)
+            rangeBegin[++range] = sequenceIndex;
+    }
+
+    // Each thread parses with its own copy of the parser state and error budget,
+    // these are combined once all threads are done.
+    vector<unique_ptr<TextParser>> parsers;
+    for (size_t i = 0; i < numberOfThreads; i++)
+        parsers.push_back(unique_ptr<TextParser>(new TextParser(*this, data.get(), bytesRead, descriptor.m_offset)));
+
+    vector<std::future<void>> workers;
+    for (size_t i = 0; i < numberOfThreads; i++)
+    {
+        TextParser* parser = parsers[i].get();
+        size_t begin = rangeBegin[i], end = rangeBegin[i + 1];
+        workers.push_back(std::async(std::launch::async, [parser, begin, end, &chunk, &descriptor]()
+        {
+            for (size_t sequenceIndex = begin; sequenceIndex < end; ++sequenceIndex)
+                chunk->m_sequenceMap[sequenceIndex] = parser->LoadSequence(descriptor.Sequences()[sequenceIndex], descriptor.m_offset);
+        }));
+    }
+
+    // wait for all threads before touching their results, then rethrow the first error, if any
+    std::exception_ptr error;
+    for (auto& worker : workers)
+    {
+        try
+        {
+            worker.get();
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+
+    size_t numErrors = 0;
+    for (const auto& parser : parsers)
+    {
+        m_hadWarnings |= parser->m_hadWarnings;
+        numErrors += m_numAllowedErrors - parser->m_numAllowedErrors;
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    // Each thread stays within the budget on its own, but all of them together may not.
+    if (numErrors > m_numAllowedErrors)
+    {
+        PrintWarningNotification();
+        RuntimeError("Reached the maximum number of allowed errors"
+            " while reading the input file (%ls).",
+            m_filename.c_str());
+    }
+    m_numAllowedErrors -= static_cast<unsigned int>(numErrors);
+}
+
 template <class ElemType>
 void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 {
@@ -299,6 +552,12 @@ void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 template <class ElemType>
 bool TextParser<ElemType>::TryRefillBuffer()
 {
+    if (m_file == nullptr)
+    {
+        // the parser of a chunk in memory (see LoadChunkInParallel()) has nothing more to read
+        return false;
+    }
+
     size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
 
     if (bytesRead == (size_t)-1)
@@ -367,7 +626,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     }
 
     size_t numRowsRead = 0, expectedRowCount = sequenceDsc.m_numberOfSamples;
-    bool checkExpectedAsMax = m_indexer->MainStream().empty();
+    bool checkExpectedAsMax = !m_hasMainStream;
     size_t rowNumber = 1;
     while(bytesToRead)
     {
@@ -1030,6 +1289,16 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
+    if (bytesToRead && CanRead())
+    {
+        const char* start = m_pos;
+        if (TryParseRealNumber(m_pos, m_pos + std::min<size_t>(bytesToRead, m_bufferEnd - m_pos), value))
+        {
+            bytesToRead -= m_pos - start;
+            return true;
+        }
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
@@ -1285,12 +1554,24 @@ void TextParser<ElemType>::SetChunkSize(size_t size)
     m_chunkSizeBytes = size;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cacheIndex)
+{
+    m_cacheIndex = cacheIndex;
+}
+
 template <class ElemType>
 void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
 {
     m_numRetries = numRetries;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetNumParsingThreads(size_t numThreads)
+{
+    m_numParsingThreads = numThreads;
+}
+
 template <class ElemType>
 std::wstring TextParser<ElemType>::GetFileInfo()
 {
@@ -35,9 +35,16 @@ public:
 
     bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
 
+    // Minimum chunk size per thread when the number of parsing threads is chosen automatically.
+    static const size_t c_minBytesPerParsingThread = 4 * 1024 * 1024;
+
 private:
     TextParser(CorpusDescriptorPtr corpus, const std::wstring& filename, const vector<StreamDescriptor>& streams, bool primary = true);
 
+    // A parser for the sequences of a chunk that 'parent' has read into memory (data, size bytes, read from
+    // fileOffset in the file), used by one of the threads of LoadChunkInParallel(). Has no file of its own.
+    TextParser(const TextParser& parent, const char* data, size_t size, size_t fileOffset);
+
     // Builds an index of the input data.
     void Initialize();
 
@@ -121,6 +128,9 @@ private:
     bool m_hadWarnings;
     unsigned int m_numAllowedErrors;
     bool m_skipSequenceIds;
+    bool m_cacheIndex; // if true, the index is kept in a sidecar file (see IndexCache)
+    bool m_hasMainStream; // true, if one of the streams defines the number of samples of a sequence
+    size_t m_numParsingThreads; // number of threads that parse the sequences of a chunk, 0 = automatic
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
                                // file operation should be repeated (default value is 5).
 
@@ -181,6 +191,13 @@ private:
     // Given a descriptor, retrieves the data for the corresponding chunk from the file.
     void LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor);
 
+    // Number of threads to parse the given chunk on.
+    size_t GetNumberOfParsingThreads(const ChunkDescriptor& descriptor) const;
+
+    // Reads the whole chunk into memory and parses its sequences on several threads,
+    // each one taking a contiguous range of sequences.
+    void LoadChunkInParallel(TextChunkPtr& chunk, const ChunkDescriptor& descriptor, size_t numberOfThreads);
+
     // Fills some metadata members to be conformant to the exposed SequenceData interface.
     void FillSequenceMetadata(SequenceBuffer& sequenceBuffer, const KeyType& sequenceKey);
 
@@ -192,8 +209,12 @@ private:
 
     void SetChunkSize(size_t size);
 
+    void SetCacheIndex(bool cacheIndex);
+
     void SetNumRetries(unsigned int numRetries);
 
+    void SetNumParsingThreads(size_t numThreads);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     DISABLE_COPY_AND_MOVE(TextParser);
@@ -0,0 +1,252 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <atomic>
+#include <future>
+#include <numeric>
+#include <thread>
+#include "TextToBinaryConverter.h"
+#include "../CNTKBinaryReader/FileHelper.h"
+#include "TimerUtility.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Version of the binary format that is written, see BinaryChunkDeserializer::s_currentVersion.
+static const uint32_t s_binaryFormatVersion = 1;
+
+// Encodings and data types of the streams in the binary format, see BinaryChunkDeserializer.
+static const unsigned char s_denseEncoding = 0;
+static const unsigned char s_sparseCscEncoding = 1;
+static const unsigned char s_floatDataType = 0;
+static const unsigned char s_doubleDataType = 1;
+
+template <class T>
+static void Append(std::vector<char>& bytes, const T* values, size_t count)
+{
+    const char* begin = reinterpret_cast<const char*>(values);
+    bytes.insert(bytes.end(), begin, begin + count * sizeof(T));
+}
+
+template <class T>
+static void Append(std::vector<char>& bytes, const T& value)
+{
+    Append(bytes, &value, 1);
+}
+
+template <class T>
+static void Write(FILE* file, T value)
+{
+    fwriteOrDie(&value, sizeof(value), 1, file);
+}
+
+TextToBinaryConverter::TextToBinaryConverter(const ConfigParameters& config)
+    : m_helper(config)
+{
+    m_outputFile = msra::strfun::utf16(config(L"outputFile"));
+    m_numEncodingThreads = config(L"numEncodingThreads", (size_t)0);
+    if (m_numEncodingThreads == 0)
+    {
+        m_numEncodingThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+void TextToBinaryConverter::Convert()
+{
+    if (m_helper.GetElementType() == ElementType::tdouble)
+        Convert<double>();
+    else
+        Convert<float>();
+}
+
+template <class ElemType>
+void TextToBinaryConverter::Convert()
+{
+    Timer timer;
+    timer.Start();
+
+    TextParser<ElemType> parser(std::make_shared<CorpusDescriptor>(true), m_helper, /*primary=*/true);
+    ChunkDescriptions chunkDescriptions = parser.GetChunkDescriptions();
+    const size_t numberOfStreams = m_helper.GetStreams().size();
+
+    FILE* file = fopenOrDie(m_outputFile, L"wb");
+
+    // The file starts with the magic number and the version, the header follows the chunks.
+    Write(file, CNTKBinaryFileHelper::MAGIC_NUMBER);
+    Write(file, s_binaryFormatVersion);
+
+    std::vector<ChunkInfo> chunks;
+    size_t totalNumberOfSamples = 0;
+    std::future<ChunkPtr> nextChunk;
+    if (!chunkDescriptions.empty())
+    {
+        nextChunk = std::async(std::launch::async, [&parser]() { return parser.GetChunk(0); });
+    }
+
+    for (ChunkIdType chunkId = 0; chunkId < chunkDescriptions.size(); ++chunkId)
+    {
+        ChunkPtr chunk = nextChunk.get();
+
+        // parse the next chunk while this one is encoded and written
+        if (chunkId + 1 < chunkDescriptions.size())
+        {
+            nextChunk = std::async(std::launch::async, [&parser, chunkId]() { return parser.GetChunk(chunkId + 1); });
+        }
+
+        size_t numberOfSequences = chunkDescriptions[chunkId]->m_numberOfSequences;
+        std::vector<std::vector<SequenceDataPtr>> sequences(numberOfSequences);
+        std::vector<uint32_t> sequenceLengths(numberOfSequences, 0);
+        for (size_t i = 0; i < numberOfSequences; ++i)
+        {
+            chunk->GetSequence(i, sequences[i]);
+            for (const auto& data : sequences[i])
+            {
+                sequenceLengths[i] = std::max(sequenceLengths[i], data->m_numberOfSamples);
+            }
+        }
+
+        // Split every stream into ranges of sequences, and let the threads encode them in any order.
+        size_t numberOfRanges = std::max<size_t>(1, std::min(m_numEncodingThreads, numberOfSequences));
+        std::vector<std::vector<char>> encoded(numberOfStreams * numberOfRanges);
+        std::atomic<size_t> nextTask(0);
+        auto encode = [&]()
+        {
+            for (size_t task = nextTask++; task < encoded.size(); task = nextTask++)
+            {
+                size_t streamIndex = task / numberOfRanges, range = task % numberOfRanges;
+                size_t begin = numberOfSequences * range / numberOfRanges;
+                size_t end = numberOfSequences * (range + 1) / numberOfRanges;
+                EncodeStream<ElemType>(sequences, streamIndex, begin, end, encoded[task]);
+            }
+        };
+        std::vector<std::future<void>> workers;
+        for (size_t i = 1; i < std::min(m_numEncodingThreads, encoded.size()); i++)
+        {
+            workers.push_back(std::async(std::launch::async, encode));
+        }
+        encode();
+        for (auto& worker : workers) // rethrows the first error, if any
+        {
+            worker.get();
+        }
+
+        // A chunk is the length of each of its sequences, followed by the sequences of each stream.
+        ChunkInfo info;
+        info.m_offset = CNTKBinaryFileHelper::TellOrDie(file);
+        info.m_numberOfSequences = static_cast<uint32_t>(numberOfSequences);
+        info.m_numberOfSamples = std::accumulate(sequenceLengths.begin(), sequenceLengths.end(), 0u);
+        chunks.push_back(info);
+        totalNumberOfSamples += info.m_numberOfSamples;
+
+        fwriteOrDie(sequenceLengths, file);
+        for (const auto& bytes : encoded)
+        {
+            fwriteOrDie(bytes, file);
+        }
+
+        if (m_helper.GetTraceLevel() >= 2)
+        {
+            fprintf(stderr, "ConvertTextToBinary: Converted chunk %u of %" PRIu64 " (%" PRIu64 " sequences).\n",
+                    chunkId + 1, chunkDescriptions.size(), numberOfSequences);
+        }
+    }
+
+    WriteHeader(file, chunks);
+    fcloseOrDie(file);
+
+    timer.Stop();
+    if (m_helper.GetTraceLevel() >= 1)
+    {
+        double seconds = timer.ElapsedSeconds();
+        fprintf(stderr, "ConvertTextToBinary: Converted '%ls' into '%ls' (%" PRIu64 " chunks, %" PRIu64 " samples) in %.1f seconds.\n",
+                m_helper.GetFilePath().c_str(), m_outputFile.c_str(), chunks.size(), totalNumberOfSamples, seconds);
+    }
+}
+
+// Dense sequences are the number of samples followed by the values. Sparse sequences are the number of samples,
+// the total number of non-zero values, the values, their row indices (ascending within each sample) and the number
+// of non-zero values of each sample. See DenseBinaryDataDeserializer and SparseBinaryDataDeserializer.
+template <class ElemType>
+void TextToBinaryConverter::EncodeStream(const std::vector<std::vector<SequenceDataPtr>>& sequences, size_t streamIndex,
+                                         size_t begin, size_t end, std::vector<char>& bytes) const
+{
+    const StreamDescriptor& stream = m_helper.GetStreams()[streamIndex];
+    std::vector<size_t> order;
+    std::vector<IndexType> indices;
+    std::vector<ElemType> values;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        const SequenceDataPtr& data = sequences[i][streamIndex];
+        uint32_t numberOfSamples = data->m_numberOfSamples;
+        Append(bytes, numberOfSamples);
+
+        const ElemType* buffer = static_cast<const ElemType*>(data->GetDataBuffer());
+        if (stream.m_storageType == StorageType::dense)
+        {
+            Append(bytes, buffer, numberOfSamples * stream.m_sampleDimension);
+            continue;
+        }
+
+        auto sparse = static_cast<SparseSequenceData*>(data.get());
+        int32_t nnz = static_cast<int32_t>(sparse->m_totalNnzCount);
+        Append(bytes, nnz);
+
+        // the text format may list the values of a sample in any order
+        values.resize(nnz);
+        indices.resize(nnz);
+        size_t offset = 0;
+        for (IndexType count : sparse->m_nnzCounts)
+        {
+            order.resize(count);
+            std::iota(order.begin(), order.end(), offset);
+            std::stable_sort(order.begin(), order.end(), [sparse](size_t a, size_t b) { return sparse->m_indices[a] < sparse->m_indices[b]; });
+            for (size_t j = 0; j < count; ++j)
+            {
+                values[offset + j] = buffer[order[j]];
+                indices[offset + j] = sparse->m_indices[order[j]];
+            }
+            offset += count;
+        }
+        Append(bytes, values.data(), values.size());
+        Append(bytes, indices.data(), indices.size());
+        Append(bytes, sparse->m_nnzCounts.data(), sparse->m_nnzCounts.size());
+    }
+}
+
+// The header is the magic number, the number of chunks and streams, the description of each stream and
+// the chunk table, followed by its own offset.
+void TextToBinaryConverter::WriteHeader(FILE* file, const std::vector<ChunkInfo>& chunks) const
+{
+    int64_t headerOffset = CNTKBinaryFileHelper::TellOrDie(file);
+    const auto& streams = m_helper.GetStreams();
+
+    Write(file, CNTKBinaryFileHelper::MAGIC_NUMBER);
+    Write(file, static_cast<uint32_t>(chunks.size()));
+    Write(file, static_cast<uint32_t>(streams.size()));
+    for (const auto& stream : streams)
+    {
+        Write(file, stream.m_storageType == StorageType::dense ? s_denseEncoding : s_sparseCscEncoding);
+        std::string name = msra::strfun::utf8(stream.m_name);
+        Write(file, static_cast<uint32_t>(name.size()));
+        fwriteOrDie(name.data(), sizeof(char), name.size(), file);
+        Write(file, m_helper.GetElementType() == ElementType::tdouble ? s_doubleDataType : s_floatDataType);
+        Write(file, static_cast<uint32_t>(stream.m_sampleDimension));
+    }
+
+    for (const auto& chunk : chunks)
+    {
+        Write(file, chunk.m_offset);
+        Write(file, chunk.m_numberOfSequences);
+        Write(file, chunk.m_numberOfSamples);
+    }
+
+    Write(file, headerOffset);
+}
+
+}}}
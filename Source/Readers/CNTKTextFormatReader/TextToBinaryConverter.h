@@ -0,0 +1,59 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "TextConfigHelper.h"
+#include "TextParser.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Converts a file in the CNTK text format into the CNTK binary format read by the CNTKBinaryReader
+// (see BinaryChunkDeserializer), the same as Scripts/ctf2bin.py does.
+//
+// The input is read chunk by chunk with the TextParser, so each chunk of the text file becomes a chunk
+// of the binary file. While a chunk is encoded and written, the next one is already being parsed, and
+// the streams and sequences of a chunk are encoded on several threads.
+//
+// The configuration is that of a CNTKTextFormatDeserializer (file, input, precision, chunkSizeInBytes, ...),
+// plus:
+//   outputFile: the binary file to write
+//   numEncodingThreads: number of threads to encode a chunk on, 0 (default) = one per hardware thread
+class TextToBinaryConverter
+{
+public:
+    explicit TextToBinaryConverter(const ConfigParameters& config);
+
+    // Converts the whole input, overwriting the output file.
+    void Convert();
+
+    DISABLE_COPY_AND_MOVE(TextToBinaryConverter);
+
+private:
+    // Offset and size of a chunk in the output, as in the chunk table of the binary format.
+    struct ChunkInfo
+    {
+        int64_t m_offset;
+        uint32_t m_numberOfSequences;
+        uint32_t m_numberOfSamples;
+    };
+
+    template <class ElemType>
+    void Convert();
+
+    // Appends the encoding of the sequences [begin, end) of the given stream to 'bytes'.
+    // 'sequences' holds the data of all streams of each sequence of a chunk.
+    template <class ElemType>
+    void EncodeStream(const std::vector<std::vector<SequenceDataPtr>>& sequences, size_t streamIndex,
+                      size_t begin, size_t end, std::vector<char>& bytes) const;
+
+    void WriteHeader(FILE* file, const std::vector<ChunkInfo>& chunks) const;
+
+    TextConfigHelper m_helper;
+    std::wstring m_outputFile;
+    size_t m_numEncodingThreads;
+};
+
+}}}
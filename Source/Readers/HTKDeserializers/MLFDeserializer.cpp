@@ -10,6 +10,7 @@
 #include "SequenceData.h"
 #include "StringUtil.h"
 #include "ReaderConstants.h"
+#include "IndexCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -295,6 +296,7 @@ MLFDeserializer::MLFDeserializer(CorpusDescriptorPtr corpus, const ConfigParamet
     // Same behavior as for the old deserializer - keep almost all in memory,
     // because there are a lot of none aligned sets.
     m_chunkSizeBytes = cfg(L"chunkSizeInBytes", g_64MB);
+    m_cacheIndex = cfg(L"cacheIndex", false);
 
     ConfigParameters input = cfg("input");
     auto inputName = input.GetMemberIds().front();
@@ -339,6 +341,7 @@ MLFDeserializer::MLFDeserializer(CorpusDescriptorPtr corpus, const ConfigParamet
     // Same behavior as for the old deserializer - keep almost all in memory,
     // because there are a lot of none aligned sets.
     m_chunkSizeBytes = labelConfig(L"chunkSizeInBytes", g_64MB);
+    m_cacheIndex = labelConfig(L"cacheIndex", false);
 
     wstring precision = labelConfig(L"precision", L"float");;
     m_elementType = AreEqualIgnoreCase(precision, L"float") ? ElementType::tfloat : ElementType::tdouble;
@@ -377,7 +380,7 @@ void MLFDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, co
         {
             auto file = shared_ptr<FILE>(fopenOrDie(path, L"rbS"), [](FILE *f) { if (f) fclose(f); });
             indexer = make_shared<MLFIndexer>(file.get(), m_frameMode, m_chunkSizeBytes);
-            indexer->Build(corpus);
+            indexer->Build(corpus, m_cacheIndex ? IndexCache::GetPathFor(path) : L"");
         });
 
         m_mlfFiles.push_back(path);
@@ -76,6 +76,9 @@ private:
     size_t m_dimension;
     size_t m_chunkSizeBytes;
 
+    // Keep the index of each MLF file in a sidecar file, to avoid re-reading the MLF on every run.
+    bool m_cacheIndex;
+
     // Track phone boundaries
     bool m_withPhoneBoundaries;
 
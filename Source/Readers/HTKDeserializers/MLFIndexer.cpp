@@ -8,6 +8,7 @@
 #include "MLFIndexer.h"
 #include "MLFUtils.h"
 #include "ReaderUtil.h"
+#include "IndexCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -87,17 +88,35 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return distance(line.begin(), line.end()) == 1 && *line.begin() == '.';
     }
 
+    void MLFIndexer::Build(CorpusDescriptorPtr corpus, const wstring& indexCachePath)
+    {
+        if (!m_index.IsEmpty())
+            return;
+
+        if (indexCachePath.empty())
+        {
+            BuildIndex(corpus, corpus->KeyToId);
+            return;
+        }
+
+        string parameters = "mlf chunkSize=" + to_string(m_index.m_maxChunkSize) + " frameMode=" + to_string(m_index.m_trackFirstSamples);
+        IndexCache cache(indexCachePath, m_file, parameters);
+        uint32_t flags = 0;
+        if (cache.TryLoad(corpus, m_index, flags))
+            return;
+
+        BuildIndex(corpus, cache.GetKeyToId(corpus));
+        cache.Save(corpus, m_index, 0);
+    }
+
     // Building an index of the MLF file:
     //     MLF file -> MLF Header [MLF Utterance]+
     //     MLF Utterance -> Key EOL [Frame Range EOL]+ "." EOL
     // MLF file should start with the MLF header (State::Header -> State:UtteranceKey).
     // Each utterance starts with an utterance key (State::UtteranceKey -> State::UtteranceFrames).
     // End of utterance is indicated by a single dot on a line (State::UtteranceFrames -> State::UtteranceKey)
-    void MLFIndexer::Build(CorpusDescriptorPtr corpus)
+    void MLFIndexer::BuildIndex(CorpusDescriptorPtr corpus, const function<size_t(const string&)>& keyToId)
     {
-        if (!m_index.IsEmpty())
-            return;
-
         m_index.Reserve(filesize(m_file));
 
         RefillBuffer(); // read the first block of data
@@ -138,7 +157,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                         continue;
 
                     sequenceStartOffset = m_fileOffsetStart + lines[i].begin() - m_buffer.data();
-                    isValid = TryParseSequenceKey(lines[i], id, corpus->KeyToId);
+                    isValid = TryParseSequenceKey(lines[i], id, keyToId);
                     currentState = State::UtteranceFrames;
                 }
                 break;
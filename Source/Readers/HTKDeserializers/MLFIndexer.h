@@ -17,7 +17,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     public:
         MLFIndexer(FILE* file, bool frameMode, size_t chunkSize = 64 * 1024 * 1024, size_t bufferSize = 64 * 1024 * 1024);
 
-        void Build(CorpusDescriptorPtr corpus);
+        // If indexCachePath is not empty, the index is loaded from this file when it is up to date,
+        // otherwise it is written there after it has been built (see IndexCache).
+        void Build(CorpusDescriptorPtr corpus, const std::wstring& indexCachePath = L"");
 
         // Returns input data index (chunk and sequence metadata)
         const Index& GetIndex() const { return m_index; }
@@ -42,6 +44,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         std::string m_lastNonEmptyLine;           // Last non empty estring, used for parsing sequence length.
 
+        // Builds the index from the input file, translating sequence keys with keyToId.
+        void BuildIndex(CorpusDescriptorPtr corpus, const std::function<size_t(const std::string&)>& keyToId);
+
         // fills up the buffer with data from file, all previously buffered data
         // will be overwritten.
         void RefillBuffer();
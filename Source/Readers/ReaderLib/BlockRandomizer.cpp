@@ -41,6 +41,7 @@ BlockRandomizer::BlockRandomizer(
     assert(deserializer != nullptr);
 
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
+    m_chunkCache = std::dynamic_pointer_cast<ChunkCache>(deserializer);
 
     m_streams = m_deserializer->GetStreamDescriptions();
     m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
@@ -84,6 +85,7 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
 
     m_epochStartPosition = m_epochSize * config.m_epochIndex;
     SetCurrentSamplePosition(m_epochStartPosition);
+    UpdateChunkCacheSchedule(); // the worker configuration may have changed
     if (m_verbosity >= Notification)
     {
         size_t epochStartFrame = config.m_epochIndex * m_epochSize;
@@ -115,7 +117,30 @@ void BlockRandomizer::PrepareNewSweepIfNeeded(size_t samplePosition)
         // Resetting sequence randomizer.
         m_sequenceRandomizer->Reset(m_seedOffset + m_sweep);
         m_currentWindowRange = {};
+
+        if (m_chunkCache && m_verbosity >= Notification)
+        {
+            auto statistics = m_chunkCache->GetStatistics();
+            fprintf(stderr, "BlockRandomizer::PrepareNewSweepIfNeeded: chunk cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " prefetched, %" PRIu64 " evicted, %.1f MB in use\n",
+                    statistics.m_hits, statistics.m_misses, statistics.m_prefetches, statistics.m_evictions,
+                    statistics.m_sizeInBytes / (1024.0 * 1024.0));
+        }
+        UpdateChunkCacheSchedule();
+    }
+}
+
+void BlockRandomizer::UpdateChunkCacheSchedule()
+{
+    if (!m_chunkCache || m_sweep == SIZE_MAX || m_config.m_numberOfWorkers == 0)
+        return;
+
+    std::vector<ChunkIdType> schedule;
+    for (const auto& chunk : m_chunkRandomizer->GetRandomizedChunks())
+    {
+        if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank)
+            schedule.push_back(chunk.m_original->m_id);
     }
+    m_chunkCache->SetChunkSchedule(schedule);
 }
 
 // Gets next sequences not exceeding global and local sample counts.
@@ -12,6 +12,7 @@
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
 #include "ReaderUtil.h"
+#include "ChunkCache.h"
 #include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -103,6 +104,9 @@ private:
     // Returns next candidate for the prefetch in the given range.
     ChunkIdType GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange);
 
+    // Passes the order in which this worker will request the chunks of the current sweep to the chunk cache, if any.
+    void UpdateChunkCacheSchedule();
+
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
 
@@ -126,6 +130,9 @@ private:
 
     IDataDeserializerPtr m_deserializer;
 
+    // The deserializer if it is a chunk cache, which can use the chunk schedule for prefetching and eviction.
+    std::shared_ptr<ChunkCache> m_chunkCache;
+
     // Chunk randomizer.
     ChunkRandomizerPtr m_chunkRandomizer;
 
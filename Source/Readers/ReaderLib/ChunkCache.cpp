@@ -6,21 +6,265 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "ChunkCache.h"
+#include "ReaderUtil.h"
+#include <algorithm>
+#include <stdint.h>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Maximum number of sequences of a chunk that are looked at to estimate its size.
+static const size_t c_maxSequencesToMeasure = 16;
+
+ChunkCache::ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes, size_t prefetchDepth)
+    : m_deserializer(deserializer),
+      m_streams(deserializer->GetStreamDescriptions()),
+      m_maxSizeInBytes(maxSizeInBytes),
+      m_prefetchDepth(prefetchDepth),
+      m_sizeInBytes(0),
+      m_useCounter(0),
+      m_scheduleCursor(0),
+      m_chunkInFlight(CHUNKID_MAX),
+      m_stop(false),
+      m_statistics()
+{
+}
+
+ChunkCache::~ChunkCache()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    if (m_prefetchThread.joinable())
+        m_prefetchThread.join();
+}
+
 ChunkPtr ChunkCache::GetChunk(ChunkIdType chunkId)
 {
-    auto it = m_chunkMap.find(chunkId);
-    if (it != m_chunkMap.end())
     {
-        return it->second;
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // Advance in the schedule, and start loading what comes next.
+        size_t position = chunkId < m_schedulePosition.size() ? m_schedulePosition[chunkId] : SIZE_MAX;
+        if (position != SIZE_MAX && position >= m_scheduleCursor)
+        {
+            m_scheduleCursor = position + 1;
+            SchedulePrefetch();
+        }
+
+        // If the chunk is being prefetched, wait for it.
+        m_changed.wait(lock, [this, chunkId] { return m_chunkInFlight != chunkId; });
+
+        auto it = m_chunkMap.find(chunkId);
+        if (it != m_chunkMap.end())
+        {
+            m_statistics.m_hits++;
+            it->second.m_lastUse = ++m_useCounter;
+            return it->second.m_chunk;
+        }
+    }
+
+    std::unique_lock<std::mutex> loadLock(m_loadMutex);
+    size_t sizeInBytes;
+    ChunkPtr chunk = LoadChunk(chunkId, sizeInBytes);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_statistics.m_misses++;
+    if ((m_maxSizeInBytes == 0 || sizeInBytes <= m_maxSizeInBytes) && m_chunkMap.find(chunkId) == m_chunkMap.end())
+    {
+        // The chunk is needed now, so anything can be evicted for it.
+        MakeRoom(sizeInBytes, 0);
+        m_chunkMap[chunkId] = CachedChunk{ chunk, sizeInBytes, ++m_useCounter };
+        m_sizeInBytes += sizeInBytes;
     }
- 
+    return chunk;
+}
+
+void ChunkCache::SetChunkSchedule(const std::vector<ChunkIdType>& schedule)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_schedule = schedule;
+    m_schedulePosition.clear();
+    for (size_t i = 0; i < schedule.size(); ++i)
+    {
+        if (schedule[i] >= m_schedulePosition.size())
+            m_schedulePosition.resize(schedule[i] + 1, SIZE_MAX);
+        m_schedulePosition[schedule[i]] = i;
+    }
+    m_scheduleCursor = 0;
+
+    if (m_prefetchDepth > 0 && !m_prefetchThread.joinable())
+        m_prefetchThread = std::thread([this] { PrefetchLoop(); });
+    SchedulePrefetch();
+}
+
+ChunkCacheStatistics ChunkCache::GetStatistics() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ChunkCacheStatistics result = m_statistics;
+    result.m_sizeInBytes = m_sizeInBytes;
+    return result;
+}
+
+size_t ChunkCache::NextUse(ChunkIdType chunkId) const
+{
+    size_t position = chunkId < m_schedulePosition.size() ? m_schedulePosition[chunkId] : SIZE_MAX;
+    return position >= m_scheduleCursor ? position : SIZE_MAX;
+}
+
+bool ChunkCache::MakeRoom(size_t sizeInBytes, size_t neededAt)
+{
+    if (m_maxSizeInBytes == 0)
+        return true;
+
+    // Check that enough bytes can be freed before evicting anything.
+    size_t evictableBytes = 0;
+    for (const auto& c : m_chunkMap)
+    {
+        if (NextUse(c.first) >= neededAt)
+            evictableBytes += c.second.m_sizeInBytes;
+    }
+    if (m_sizeInBytes - evictableBytes + sizeInBytes > m_maxSizeInBytes)
+        return false;
+
+    while (m_sizeInBytes + sizeInBytes > m_maxSizeInBytes)
+    {
+        // Evict the chunk that is needed again last; among the ones not needed in this sweep, the least recently used.
+        auto victim = m_chunkMap.end();
+        size_t victimNextUse = 0;
+        for (auto it = m_chunkMap.begin(); it != m_chunkMap.end(); ++it)
+        {
+            size_t nextUse = NextUse(it->first);
+            if (nextUse < neededAt)
+                continue;
+            if (victim == m_chunkMap.end() || nextUse > victimNextUse ||
+                (nextUse == victimNextUse && it->second.m_lastUse < victim->second.m_lastUse))
+            {
+                victim = it;
+                victimNextUse = nextUse;
+            }
+        }
+
+        if (victim == m_chunkMap.end())
+            return false;
+
+        m_sizeInBytes -= victim->second.m_sizeInBytes;
+        m_chunkMap.erase(victim);
+        m_statistics.m_evictions++;
+    }
+    return true;
+}
+
+ChunkPtr ChunkCache::LoadChunk(ChunkIdType chunkId, size_t& sizeInBytes)
+{
     ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
-    m_chunkMap[chunkId] = chunk;
- 
+    sizeInBytes = EstimateSizeInBytes(chunkId, chunk);
     return chunk;
 }
 
+size_t ChunkCache::EstimateSizeInBytes(ChunkIdType chunkId, const ChunkPtr& chunk)
+{
+    std::vector<SequenceDescription> sequences;
+    m_deserializer->GetSequencesForChunk(chunkId, sequences);
+    if (sequences.empty())
+        return 0;
+
+    // Measure evenly spaced sequences and extrapolate by the number of samples.
+    size_t step = (sequences.size() + c_maxSequencesToMeasure - 1) / c_maxSequencesToMeasure;
+    size_t measuredBytes = 0, measuredSamples = 0, totalSamples = 0;
+    std::vector<SequenceDataPtr> data;
+    for (size_t i = 0; i < sequences.size(); ++i)
+    {
+        totalSamples += sequences[i].m_numberOfSamples;
+        if (i % step != 0)
+            continue;
+
+        data.clear();
+        chunk->GetSequence(sequences[i].m_indexInChunk, data);
+        for (size_t j = 0; j < data.size() && j < m_streams.size(); ++j)
+        {
+            size_t elementSize = GetSizeByType(m_streams[j]->m_elementType);
+            if (m_streams[j]->m_storageType == StorageType::dense)
+            {
+                measuredBytes += data[j]->m_numberOfSamples * m_streams[j]->m_sampleLayout->GetNumElements() * elementSize;
+            }
+            else
+            {
+                auto sparse = static_cast<SparseSequenceData*>(data[j].get());
+                measuredBytes += sparse->m_totalNnzCount * (elementSize + sizeof(IndexType)) +
+                                 sparse->m_nnzCounts.size() * sizeof(IndexType);
+            }
+        }
+        measuredSamples += sequences[i].m_numberOfSamples;
+    }
+
+    if (measuredSamples == 0)
+        return measuredBytes;
+    return (size_t)((double)measuredBytes * totalSamples / measuredSamples);
+}
+
+void ChunkCache::SchedulePrefetch()
+{
+    if (!m_prefetchThread.joinable())
+        return;
+
+    m_prefetchQueue.clear();
+    size_t end = std::min(m_scheduleCursor + m_prefetchDepth, m_schedule.size());
+    for (size_t i = m_scheduleCursor; i < end; ++i)
+    {
+        if (m_chunkMap.find(m_schedule[i]) == m_chunkMap.end() && m_chunkInFlight != m_schedule[i])
+            m_prefetchQueue.push_back(m_schedule[i]);
+    }
+
+    if (!m_prefetchQueue.empty())
+        m_changed.notify_all();
+}
+
+void ChunkCache::PrefetchLoop()
+{
+    for (;;)
+    {
+        ChunkIdType chunkId;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this] { return m_stop || !m_prefetchQueue.empty(); });
+            if (m_stop)
+                return;
+            chunkId = m_prefetchQueue.front();
+            m_prefetchQueue.pop_front();
+            if (m_chunkMap.find(chunkId) != m_chunkMap.end())
+                continue;
+            m_chunkInFlight = chunkId;
+        }
+
+        std::unique_lock<std::mutex> loadLock(m_loadMutex);
+        size_t sizeInBytes = 0;
+        ChunkPtr chunk;
+        try
+        {
+            chunk = LoadChunk(chunkId, sizeInBytes);
+        }
+        catch (...)
+        {
+            // The error is reported when the chunk is requested and loaded again.
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            // Only keep the chunk if it fits without evicting chunks that are needed before it.
+            size_t position = chunkId < m_schedulePosition.size() ? m_schedulePosition[chunkId] : SIZE_MAX;
+            if (chunk && position != SIZE_MAX && (m_maxSizeInBytes == 0 || sizeInBytes <= m_maxSizeInBytes) &&
+                MakeRoom(sizeInBytes, position + 1))
+            {
+                m_chunkMap[chunkId] = CachedChunk{ chunk, sizeInBytes, ++m_useCounter };
+                m_sizeInBytes += sizeInBytes;
+                m_statistics.m_prefetches++;
+            }
+            m_chunkInFlight = CHUNKID_MAX;
+        }
+        m_changed.notify_all();
+    }
+}
+
 } } }
@@ -6,21 +6,43 @@
 #pragma once
 
 #include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// A cache to store the complete dataset (all chunks) in memory. The caching can
-// be switched on/off by a boolean flag in the reader config section, independent 
-// of the randomization and chunking parameters. The caching should only be enabled 
-// when the whole dataset fits in memory.
-// Implemented as a wrapping proxy around a deserializer that stores pointers to
-// all chunks it sees in an internal map.
+// Counters of the chunk cache.
+struct ChunkCacheStatistics
+{
+    size_t m_hits;          // chunks returned from the cache (including prefetched ones)
+    size_t m_misses;        // chunks loaded from the deserializer on request
+    size_t m_prefetches;    // chunks loaded from the deserializer in the background
+    size_t m_evictions;     // chunks dropped from the cache to stay within the budget
+    size_t m_sizeInBytes;   // (estimated) size of the cached chunks
+};
+
+// A cache of chunks, implemented as a wrapping proxy around a deserializer.
+//
+// Without a size limit, it stores all chunks it sees, i.e. the complete dataset. This should only be
+// used when the whole dataset fits in memory. The caching can be switched on/off by a boolean flag
+// in the reader config section, independent of the randomization and chunking parameters.
+//
+// With a size limit, the chunks are kept until their (estimated) total size exceeds the limit.
+// If the randomizer provides its chunk schedule (see SetChunkSchedule), the chunks that are needed
+// again last (or not anymore in the current sweep) are evicted first, and the next chunks of the
+// schedule are loaded ahead on a background thread, as long as they fit. Otherwise the least
+// recently used chunks are evicted.
 class ChunkCache : public IDataDeserializer
 {
 public:
+    // maxSizeInBytes: size limit of the cache, 0 for no limit.
+    // prefetchDepth: number of scheduled chunks to load ahead of the last requested one.
+    ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes = 0, size_t prefetchDepth = 2);
 
-    ChunkCache(IDataDeserializerPtr deserializer) : m_deserializer(deserializer) { }
+    ~ChunkCache();
 
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
@@ -34,21 +56,77 @@ public:
 
     virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override
     {
+        std::unique_lock<std::mutex> lock(m_loadMutex);
         return m_deserializer->GetSequencesForChunk(chunkId, descriptions);
     }
 
     virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description) override
     {
+        std::unique_lock<std::mutex> lock(m_loadMutex);
         return m_deserializer->GetSequenceDescription(primary, description);
     }
 
     // Gets chunk data given its id.
-    virtual ChunkPtr GetChunk(ChunkIdType chunkId);
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Sets the order in which the chunks will be requested in the current sweep
+    // (original chunk ids, each at most once).
+    void SetChunkSchedule(const std::vector<ChunkIdType>& schedule);
+
+    ChunkCacheStatistics GetStatistics() const;
 
 private:
-    // A map of currently loaded chunks
-    std::map<size_t, ChunkPtr> m_chunkMap;
+    struct CachedChunk
+    {
+        ChunkPtr m_chunk;
+        size_t m_sizeInBytes;
+        size_t m_lastUse;   // value of m_useCounter when the chunk was last requested
+    };
+
+    // Position of the chunk in the schedule if it is still to be requested in the current sweep, otherwise SIZE_MAX.
+    size_t NextUse(ChunkIdType chunkId) const;
+
+    // Evicts chunks until a chunk of the given size fits, only evicting chunks that are not needed
+    // before the given schedule position. Returns false, without evicting anything, if this is not possible.
+    bool MakeRoom(size_t sizeInBytes, size_t neededAt);
+
+    // Loads the chunk from the deserializer and estimates its size. Must hold m_loadMutex.
+    ChunkPtr LoadChunk(ChunkIdType chunkId, size_t& sizeInBytes);
+
+    // Estimates the size of the chunk data from a sample of its sequences. Must hold m_loadMutex.
+    size_t EstimateSizeInBytes(ChunkIdType chunkId, const ChunkPtr& chunk);
+
+    // Queues the next chunks of the schedule for prefetching. Must hold m_mutex.
+    void SchedulePrefetch();
+
+    void PrefetchLoop();
+
     IDataDeserializerPtr m_deserializer;
+    std::vector<StreamDescriptionPtr> m_streams;
+    const size_t m_maxSizeInBytes;
+    const size_t m_prefetchDepth;
+
+    // Guards all members below. m_loadMutex serializes calls into the deserializer, which need not be thread safe,
+    // and is always acquired before m_mutex.
+    mutable std::mutex m_mutex;
+    std::mutex m_loadMutex;
+    std::condition_variable m_changed;
+
+    // A map of currently loaded chunks
+    std::map<size_t, CachedChunk> m_chunkMap;
+    size_t m_sizeInBytes;
+    size_t m_useCounter;
+
+    std::vector<size_t> m_schedulePosition;     // position of each chunk in the schedule, SIZE_MAX if not scheduled
+    std::vector<ChunkIdType> m_schedule;
+    size_t m_scheduleCursor;                    // position after the last requested chunk of the schedule
+
+    std::deque<ChunkIdType> m_prefetchQueue;
+    ChunkIdType m_chunkInFlight;                // chunk being prefetched, CHUNKID_MAX if none
+    std::thread m_prefetchThread;
+    bool m_stop;
+
+    ChunkCacheStatistics m_statistics;
 
     DISABLE_COPY_AND_MOVE(ChunkCache);
 };
@@ -0,0 +1,319 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "IndexCache.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using std::string;
+using std::wstring;
+using std::vector;
+
+// Bump the version whenever the layout of the cache file or the way the indexers build the index changes.
+static const char c_indexCacheMagic[8] = { 'C', 'N', 'T', 'K', 'I', 'D', 'X', '\0' };
+static const uint32_t c_indexCacheVersion = 1;
+
+// Number of bytes at the start and at the end of the input file that are hashed.
+static const size_t c_hashedBytes = 64 * 1024;
+
+static uint64_t Fnv1a(const char* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Reads the given range of the file, failing if fewer bytes are available.
+static void ReadRange(FILE* file, int64_t offset, vector<char>& buffer)
+{
+    if (_fseeki64(file, offset, SEEK_SET) != 0)
+        RuntimeError("Error seeking in the input file.");
+    if (!buffer.empty())
+        freadOrDie(buffer.data(), 1, buffer.size(), file);
+}
+
+IndexCache::IndexCache(const wstring& cachePath, FILE* dataFile, const string& parameters)
+    : m_cachePath(cachePath), m_parameters(parameters)
+{
+    if (dataFile == nullptr)
+        RuntimeError("Input file not open for reading");
+
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_fstat64(_fileno(dataFile), &info) != 0)
+#else
+    struct stat info;
+    if (fstat(fileno(dataFile), &info) != 0)
+#endif
+        RuntimeError("Error retrieving the attributes of the input file for the index cache '%ls'.", cachePath.c_str());
+
+    m_dataFileSize = (uint64_t)info.st_size;
+    m_dataFileTime = (int64_t)info.st_mtime;
+
+    // Hash the head and the tail, which changes with most edits that keep the size and the time stamp
+    // (e.g. files regenerated by a script, or copied without preserving the time stamp).
+    int64_t position = _ftelli64(dataFile);
+    vector<char> buffer((size_t)std::min<uint64_t>(m_dataFileSize, c_hashedBytes));
+    ReadRange(dataFile, 0, buffer);
+    m_dataFileHash = Fnv1a(buffer.data(), buffer.size());
+    if (m_dataFileSize > c_hashedBytes)
+    {
+        buffer.resize((size_t)std::min<uint64_t>(m_dataFileSize - c_hashedBytes, c_hashedBytes));
+        ReadRange(dataFile, m_dataFileSize - buffer.size(), buffer);
+        m_dataFileHash = Fnv1a(buffer.data(), buffer.size(), m_dataFileHash);
+    }
+    if (position < 0 || _fseeki64(dataFile, position, SEEK_SET) != 0)
+        RuntimeError("Error restoring the position in the input file.");
+}
+
+std::function<size_t(const string&)> IndexCache::GetKeyToId(CorpusDescriptorPtr corpus)
+{
+    return [this, corpus](const string& key)
+    {
+        size_t id = corpus->KeyToId(key);
+        if (m_keyIndexById.emplace(id, m_keys.size()).second)
+            m_keys.push_back(key);
+        return id;
+    };
+}
+
+// Helpers for the flat binary layout of the cache file.
+namespace
+{
+    class CacheWriter
+    {
+    public:
+        template <class T>
+        void Write(const T& value)
+        {
+            const char* p = reinterpret_cast<const char*>(&value);
+            m_data.insert(m_data.end(), p, p + sizeof(T));
+        }
+
+        void WriteString(const string& value)
+        {
+            Write((uint32_t)value.size());
+            m_data.insert(m_data.end(), value.begin(), value.end());
+        }
+
+        vector<char> m_data;
+    };
+
+    // All reads fail (return false) if they would read beyond the end of the data.
+    class CacheReader
+    {
+    public:
+        CacheReader(const char* data, size_t size) : m_current(data), m_end(data + size) {}
+
+        template <class T>
+        bool Read(T& value)
+        {
+            if ((size_t)(m_end - m_current) < sizeof(T))
+                return false;
+            memcpy(&value, m_current, sizeof(T));
+            m_current += sizeof(T);
+            return true;
+        }
+
+        bool ReadString(string& value)
+        {
+            uint32_t size;
+            if (!Read(size) || (size_t)(m_end - m_current) < size)
+                return false;
+            value.assign(m_current, size);
+            m_current += size;
+            return true;
+        }
+
+        size_t Left() const { return m_end - m_current; }
+
+    private:
+        const char* m_current;
+        const char* m_end;
+    };
+
+#pragma pack(push, 1)
+    struct SequenceRecord
+    {
+        uint64_t m_key;         // sequence id for numeric keys, otherwise index into the key list
+        uint64_t m_offset;      // offset of the sequence in the input file
+        uint32_t m_size;        // size of the sequence in bytes
+        uint32_t m_numberOfSamples;
+    };
+#pragma pack(pop)
+}
+
+// Layout: header (magic, version, identity of the input file, parameters, flags),
+// key list, sequence records, and an FNV-1a hash of everything before it.
+bool IndexCache::TryLoad(CorpusDescriptorPtr corpus, Index& index, uint32_t& flags) const
+{
+    if (!index.IsEmpty())
+        LogicError("The index cache can only be loaded into an empty index.");
+
+    if (!fexists(m_cachePath))
+        return false;
+
+    // Index is an in-memory structure, so the whole file is read in one go.
+    vector<char> data;
+    try
+    {
+        auto file = std::shared_ptr<FILE>(fopenOrDie(m_cachePath, L"rb"), [](FILE* f) { if (f) fclose(f); });
+        data.resize(filesize(file.get()));
+        if (!data.empty())
+            freadOrDie(data.data(), 1, data.size(), file.get());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot read the index cache '%ls', rebuilding the index: %s\n", m_cachePath.c_str(), e.what());
+        return false;
+    }
+
+    auto invalid = [this](const char* reason)
+    {
+        fprintf(stderr, "Index cache '%ls' is not used: %s.\n", m_cachePath.c_str(), reason);
+        return false;
+    };
+
+    uint64_t checksum;
+    if (data.size() < sizeof(checksum))
+        return invalid("the file is truncated");
+    size_t payloadSize = data.size() - sizeof(checksum);
+    memcpy(&checksum, data.data() + payloadSize, sizeof(checksum));
+    if (checksum != Fnv1a(data.data(), payloadSize))
+        return invalid("the file is corrupt");
+
+    CacheReader reader(data.data(), payloadSize);
+    char magic[sizeof(c_indexCacheMagic)];
+    uint32_t version;
+    if (!reader.Read(magic) || memcmp(magic, c_indexCacheMagic, sizeof(magic)) != 0 ||
+        !reader.Read(version) || version != c_indexCacheVersion)
+        return invalid("unknown format or version");
+
+    uint64_t dataFileSize, dataFileHash;
+    int64_t dataFileTime;
+    string parameters;
+    uint8_t numericKeys;
+    if (!reader.Read(dataFileSize) || !reader.Read(dataFileTime) || !reader.Read(dataFileHash) ||
+        !reader.ReadString(parameters) || !reader.Read(flags) || !reader.Read(numericKeys))
+        return invalid("the file is truncated");
+
+    if (dataFileSize != m_dataFileSize || dataFileTime != m_dataFileTime || dataFileHash != m_dataFileHash)
+        return invalid("the input file has changed");
+    if (parameters != m_parameters)
+        return invalid("it was built with different parameters");
+    if ((numericKeys != 0) != corpus->IsNumericSequenceKeys())
+        return invalid("it was built for a different type of sequence keys");
+
+    uint64_t numberOfKeys;
+    if (!reader.Read(numberOfKeys) || numberOfKeys > reader.Left())
+        return invalid("the file is truncated");
+    vector<string> keys((size_t)numberOfKeys);
+    for (auto& key : keys)
+        if (!reader.ReadString(key))
+            return invalid("the file is truncated");
+
+    uint64_t numberOfSequences;
+    if (!reader.Read(numberOfSequences) || numberOfSequences * sizeof(SequenceRecord) != reader.Left())
+        return invalid("the file is truncated");
+    vector<SequenceRecord> sequences((size_t)numberOfSequences);
+    for (auto& sequence : sequences)
+    {
+        reader.Read(sequence);
+        if ((!numericKeys && sequence.m_key >= numberOfKeys) ||
+            sequence.m_offset > m_dataFileSize || sequence.m_size > m_dataFileSize - sequence.m_offset)
+            return invalid("the file is corrupt");
+    }
+
+    // Everything has been validated, now register the keys in their original order.
+    vector<size_t> ids(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        ids[i] = corpus->KeyToId(keys[i]);
+
+    index.Reserve((size_t)m_dataFileSize);
+    for (const auto& sequence : sequences)
+    {
+        size_t key = numericKeys ? (size_t)sequence.m_key : ids[(size_t)sequence.m_key];
+        index.AddSequence(SequenceDescriptor{ key, sequence.m_numberOfSamples },
+                          (size_t)sequence.m_offset, (size_t)(sequence.m_offset + sequence.m_size));
+    }
+    return true;
+}
+
+void IndexCache::Save(CorpusDescriptorPtr corpus, const Index& index, uint32_t flags) const
+{
+    try
+    {
+        WriteFile(corpus, index, flags);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot write the index cache '%ls': %s\n", m_cachePath.c_str(), e.what());
+    }
+}
+
+void IndexCache::WriteFile(CorpusDescriptorPtr corpus, const Index& index, uint32_t flags) const
+{
+    bool numericKeys = corpus->IsNumericSequenceKeys();
+
+    CacheWriter writer;
+    writer.Write(c_indexCacheMagic);
+    writer.Write(c_indexCacheVersion);
+    writer.Write(m_dataFileSize);
+    writer.Write(m_dataFileTime);
+    writer.Write(m_dataFileHash);
+    writer.WriteString(m_parameters);
+    writer.Write(flags);
+    writer.Write((uint8_t)(numericKeys ? 1 : 0));
+
+    writer.Write((uint64_t)m_keys.size());
+    for (const auto& key : m_keys)
+        writer.WriteString(key);
+
+    uint64_t numberOfSequences = 0;
+    for (const auto& chunk : index.Chunks())
+        numberOfSequences += chunk.Sequences().size();
+    writer.Write(numberOfSequences);
+
+    for (const auto& chunk : index.Chunks())
+    {
+        for (const auto& sequence : chunk.Sequences())
+        {
+            SequenceRecord record;
+            if (numericKeys)
+                record.m_key = sequence.m_key;
+            else
+            {
+                auto found = m_keyIndexById.find(sequence.m_key);
+                if (found == m_keyIndexById.end())
+                    LogicError("Sequence id %zu has not been registered through the index cache.", sequence.m_key);
+                record.m_key = found->second;
+            }
+            record.m_offset = chunk.m_offset + sequence.OffsetInChunk();
+            record.m_size = sequence.SizeInBytes();
+            record.m_numberOfSamples = sequence.m_numberOfSamples;
+            writer.Write(record);
+        }
+    }
+    writer.Write(Fnv1a(writer.m_data.data(), writer.m_data.size()));
+
+    // Write to a temporary file first, so that concurrent readers (e.g. other workers of the same job)
+    // never see a partially written cache.
+    wstring temporaryPath = m_cachePath + L".tmp" + std::to_wstring(GetCurrentProcessId());
+    {
+        auto file = std::shared_ptr<FILE>(fopenOrDie(temporaryPath, L"wb"), [](FILE* f) { if (f) fclose(f); });
+        fwriteOrDie(writer.m_data.data(), 1, writer.m_data.size(), file.get());
+        fflushOrDie(file.get());
+    }
+    renameOrDie(temporaryPath, m_cachePath);
+}
+
+}}}
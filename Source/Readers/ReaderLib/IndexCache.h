@@ -0,0 +1,69 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Indexer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Persistent copy of the index of an input file, kept in a sidecar file next to it, so that
+// the input does not have to be re-read on every run.
+//
+// The cache stores the sequences (key, file offset, size and number of samples) in file order;
+// replaying them into Index::AddSequence() rebuilds exactly the same chunks. It is only used if the
+// size, modification time and a hash of the head and tail of the input file, as well as the
+// parameters the index depends on (chunk size, main stream, etc.), are the same as when it was written.
+//
+// Symbolic sequence keys are translated into ids by the corpus, and these ids depend on the order
+// in which keys are registered. The cache therefore stores the keys in the order the indexer passed
+// them to the corpus, and passes them to the corpus in the same order when it is loaded.
+class IndexCache
+{
+public:
+    // cachePath: path of the cache file.
+    // dataFile: the input file, open for reading; its position is preserved.
+    // parameters: description of the indexer settings that the index depends on.
+    IndexCache(const std::wstring& cachePath, FILE* dataFile, const std::string& parameters);
+
+    // Default cache path for the given input file.
+    static std::wstring GetPathFor(const std::wstring& dataFile) { return dataFile + L".cntkidx"; }
+
+    // Returns a function to use instead of corpus->KeyToId while building the index,
+    // which remembers the keys for Save().
+    std::function<size_t(const std::string&)> GetKeyToId(CorpusDescriptorPtr corpus);
+
+    // Fills the (empty) index from the cache file, if it exists and matches the input file.
+    // flags: indexer specific flags passed to Save().
+    // Returns false if the cache cannot be used; the index and the corpus are not changed in that case.
+    bool TryLoad(CorpusDescriptorPtr corpus, Index& index, uint32_t& flags) const;
+
+    // Writes the index to the cache file. Failures are reported as warnings, since the cache
+    // is only an optimization.
+    void Save(CorpusDescriptorPtr corpus, const Index& index, uint32_t flags) const;
+
+private:
+    std::wstring m_cachePath;
+    std::string m_parameters;
+
+    // Identity of the input file.
+    uint64_t m_dataFileSize;
+    int64_t m_dataFileTime;
+    uint64_t m_dataFileHash;
+
+    // Symbolic keys in the order they have been registered with the corpus, and the index of each id in it.
+    std::vector<std::string> m_keys;
+    std::unordered_map<size_t, uint64_t> m_keyIndexById;
+
+    void WriteFile(CorpusDescriptorPtr corpus, const Index& index, uint32_t flags) const;
+
+    DISABLE_COPY_AND_MOVE(IndexCache);
+};
+
+}}}
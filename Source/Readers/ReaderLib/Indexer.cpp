@@ -7,16 +7,27 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <inttypes.h>
 #include "Indexer.h"
+#include "IndexCache.h"
 #include <boost/utility/string_ref.hpp>
 #include <boost/algorithm/string.hpp>
+#include <future>
+#include <sstream>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 using std::string;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-Indexer::Indexer(FILE* file, bool primary, bool skipSequenceIds, char streamPrefix, size_t chunkSize, const std::string& mainStream, size_t bufferSize) :
+Indexer::Indexer(FILE* file, bool primary, bool skipSequenceIds, char streamPrefix, size_t chunkSize, const std::string& mainStream, size_t bufferSize, size_t numberOfThreads) :
     m_streamPrefix(streamPrefix),
     m_buffer(bufferSize, !mainStream.empty()),
+    m_bufferSize(bufferSize),
+    m_numberOfThreads(numberOfThreads),
     m_file(file),
     m_hasSequenceIds(!skipSequenceIds),
     m_index(chunkSize, primary),
@@ -52,20 +63,55 @@ void Indexer::BuildFromLines()
     }
 }
 
-void Indexer::Build(CorpusDescriptorPtr corpus)
+// Flags stored with the cached index.
+static const uint32_t c_indexHasSequenceIds = 1;
+
+std::string Indexer::GetIndexParameters() const
+{
+    std::ostringstream parameters;
+    parameters << "text chunkSize=" << m_index.m_maxChunkSize << " streamPrefix=" << m_streamPrefix
+               << " mainStream=" << m_mainStream << " skipSequenceIds=" << !m_hasSequenceIds;
+    return parameters.str();
+}
+
+void Indexer::Build(CorpusDescriptorPtr corpus, const std::wstring& indexCachePath)
 {
     if (!m_index.IsEmpty())
     {
         return;
     }
 
+    if (indexCachePath.empty())
+    {
+        BuildIndex(corpus, corpus->KeyToId);
+        return;
+    }
+
+    IndexCache cache(indexCachePath, m_file, GetIndexParameters());
+    uint32_t flags = 0;
+    if (cache.TryLoad(corpus, m_index, flags))
+    {
+        m_hasSequenceIds = (flags & c_indexHasSequenceIds) != 0;
+        m_index.MapSequenceKeyToLocation();
+
+        // Leave the file at the end, as building the index does.
+        _fseeki64(m_file, 0, SEEK_END);
+        return;
+    }
+
+    BuildIndex(corpus, cache.GetKeyToId(corpus));
+    cache.Save(corpus, m_index, m_hasSequenceIds ? c_indexHasSequenceIds : 0);
+}
+
+void Indexer::BuildIndex(CorpusDescriptorPtr corpus, const std::function<size_t(const std::string&)>& keyToId)
+{
     // Create a lambda to read symbolic or numeric sequence ids,
     // depending on what the corpus expects.
     std::function<bool(size_t&)> tryGetSequenceId;
     if (corpus->IsNumericSequenceKeys())
         tryGetSequenceId = [this](size_t& id) { return TryGetNumericSequenceId(id); };
     else
-        tryGetSequenceId = [this, corpus](size_t& id) { return TryGetSymbolicSequenceId(id, corpus->KeyToId); };
+        tryGetSequenceId = [this, &keyToId](size_t& id) { return TryGetSymbolicSequenceId(id, keyToId); };
 
     m_index.Reserve(m_fileSize);
 
@@ -85,7 +131,19 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
             RuntimeError("Corpus expects non-numeric sequence keys present but the input file does not have them."
                 "Please use the configuration to enable numeric keys instead.");
 
-        BuildFromLines();
+        size_t numberOfRanges = GetNumberOfRanges(m_buffer.GetFileOffset());
+        if (numberOfRanges > 1)
+            BuildFromLinesInParallel(m_buffer.GetFileOffset(), numberOfRanges);
+        else
+            BuildFromLines();
+        m_index.MapSequenceKeyToLocation();
+        return;
+    }
+
+    size_t numberOfRanges = GetNumberOfRanges(m_buffer.GetFileOffset());
+    if (numberOfRanges > 1)
+    {
+        BuildInParallel(keyToId, corpus->IsNumericSequenceKeys(), m_buffer.GetFileOffset(), numberOfRanges);
         m_index.MapSequenceKeyToLocation();
         return;
     }
@@ -131,6 +189,306 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     m_index.MapSequenceKeyToLocation();
 }
 
+// Reads up to 'size' bytes at the given file offset. Does not use the FILE* buffer and position,
+// so several threads can read from the same file concurrently.
+static size_t ReadAt(FILE* file, int64_t offset, char* buffer, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+#ifdef _WIN32
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)(offset + total);
+        overlapped.OffsetHigh = (DWORD)((offset + total) >> 32);
+        DWORD bytesRead = 0;
+        if (!ReadFile(handle, buffer + total, (DWORD)std::min<size_t>(size - total, 1 << 30), &bytesRead, &overlapped) &&
+            GetLastError() != ERROR_HANDLE_EOF)
+            RuntimeError("Could not read from the input file at offset %" PRIi64 ".", offset + (int64_t)total);
+#else
+        ssize_t bytesRead = pread(fileno(file), buffer + total, size - total, offset + total);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            RuntimeError("Could not read from the input file at offset %" PRIi64 ": %s.", offset + (int64_t)total, strerror(errno));
+        }
+#endif
+        if (bytesRead == 0)
+            break;
+        total += bytesRead;
+    }
+    return total;
+}
+
+// Returns the lines of a file one by one, starting at a given offset, reading the file in blocks with ReadAt().
+class LineReader
+{
+public:
+    LineReader(FILE* file, int64_t fileSize, int64_t offset, size_t bufferSize)
+        : m_file(file), m_fileSize(fileSize), m_buffer(std::max<size_t>(bufferSize, 1)), m_bufferOffset(offset), m_begin(0), m_end(0)
+    {}
+
+    // Offset of the next line.
+    int64_t Offset() const { return m_bufferOffset + (int64_t)m_begin; }
+
+    // Gets the next line (without the new line character), returns false at the end of the file.
+    // 'terminated' is false if the line is the last one and is not terminated by a new line.
+    bool NextLine(const char*& line, size_t& length, bool& terminated)
+    {
+        if (Offset() >= m_fileSize)
+            return false;
+
+        size_t searchFrom = m_begin;
+        for (;;)
+        {
+            const char* pos = (const char*)memchr(m_buffer.data() + searchFrom, g_rowDelimiter, m_end - searchFrom);
+            if (pos)
+            {
+                line = m_buffer.data() + m_begin;
+                length = pos - line;
+                terminated = true;
+                m_begin += length + 1;
+                return true;
+            }
+
+            if (m_bufferOffset + (int64_t)m_end >= m_fileSize)
+            {
+                // the last line, without a new line character
+                line = m_buffer.data() + m_begin;
+                length = m_end - m_begin;
+                terminated = false;
+                m_begin = m_end;
+                return true;
+            }
+
+            // Move the partial line to the front, grow the buffer if the line does not fit, and read more.
+            searchFrom = m_end - m_begin;
+            memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+            m_bufferOffset += m_begin;
+            m_end -= m_begin;
+            m_begin = 0;
+            if (m_end == m_buffer.size())
+                m_buffer.resize(m_buffer.size() * 2);
+            size_t bytesRead = ReadAt(m_file, m_bufferOffset + m_end, m_buffer.data() + m_end, m_buffer.size() - m_end);
+            if (bytesRead == 0)
+                RuntimeError("Unexpected end of the input file at offset %" PRIi64 ".", m_bufferOffset + (int64_t)m_end);
+            m_end += bytesRead;
+        }
+    }
+
+private:
+    FILE* m_file;
+    int64_t m_fileSize;
+    std::vector<char> m_buffer;
+    int64_t m_bufferOffset; // file offset of m_buffer[0]
+    size_t m_begin;         // start of the next line in m_buffer
+    size_t m_end;           // end of the valid data in m_buffer
+};
+
+struct Indexer::RangeIndex
+{
+    // A run of lines that starts with a new sequence id within the range.
+    struct Sequence
+    {
+        size_t m_id;           // numeric id (numeric keys only)
+        std::string m_key;     // symbolic key (symbolic keys only); translated to an id when merging, in file order
+        int64_t m_offset;
+        uint32_t m_numberOfSamples;
+    };
+
+    // Samples in the lines at the beginning of the range that precede the first sequence id in it.
+    // They belong to the last sequence of the preceding range.
+    uint32_t m_leadingSamples = 0;
+    std::vector<Sequence> m_sequences;
+
+    // Offsets of the lines starting in the range (when each line is a sequence).
+    std::vector<int64_t> m_lineOffsets;
+};
+
+size_t Indexer::GetNumberOfRanges(int64_t dataStart) const
+{
+    int64_t dataSize = m_fileSize - dataStart;
+    if (dataSize <= 1)
+        return 1;
+
+    size_t numberOfRanges = m_numberOfThreads;
+    if (numberOfRanges == 0)
+    {
+        numberOfRanges = std::max(1u, std::thread::hardware_concurrency());
+        numberOfRanges = std::min(numberOfRanges, (size_t)(dataSize / c_minBytesPerIndexingThread));
+    }
+    return std::max<size_t>(1, std::min(numberOfRanges, (size_t)dataSize));
+}
+
+void Indexer::IndexRange(int64_t begin, int64_t end, bool isFirstRange, bool fromLines, bool numericKeys, RangeIndex& result) const
+{
+    const char* line;
+    size_t length;
+    bool terminated;
+
+    // Resync: unless this is the first range, skip the line that contains the byte preceding the range,
+    // the next line is the first one that starts in the range.
+    LineReader reader(m_file, m_fileSize, isFirstRange ? begin : begin - 1, m_bufferSize);
+    if (!isFirstRange)
+        reader.NextLine(line, length, terminated);
+
+    RangeIndex::Sequence* current = nullptr;
+    while (reader.Offset() < end)
+    {
+        int64_t offset = reader.Offset();
+        if (!reader.NextLine(line, length, terminated))
+            break;
+
+        if (fromLines)
+        {
+            result.m_lineOffsets.push_back(offset);
+            continue;
+        }
+
+        // Read the sequence id, the same way TryGetNumericSequenceId() and TryGetSymbolicSequenceId() do.
+        // An id is only found if it is followed by another character (the one on which the sequential
+        // indexer stops); at the end of the file, the line is consumed completely and yields no sample.
+        const char* lineEnd = line + length;
+        const char* idEnd = line;
+        size_t id = 0;
+        if (numericKeys)
+        {
+            for (; idEnd < lineEnd && isdigit(*idEnd); ++idEnd)
+            {
+                size_t temp = id;
+                id = id * 10 + (*idEnd - '0');
+                if (temp > id)
+                    RuntimeError("Overflow while reading a numeric sequence id (%zu-bit value).", sizeof(id));
+            }
+        }
+        else
+        {
+            while (idEnd < lineEnd && !isspace(*idEnd))
+                ++idEnd;
+        }
+
+        bool consumedToEof = !terminated && idEnd == lineEnd;
+        bool found = idEnd != line && !consumedToEof;
+        if (isFirstRange && offset == begin && !found)
+            RuntimeError("Expected a sequence id at the offset %" PRIi64 ", none was found.", offset);
+
+        if (found)
+        {
+            bool sameSequence = current && (numericKeys ? current->m_id == id : current->m_key.compare(0, std::string::npos, line, idEnd - line) == 0);
+            if (!sameSequence)
+            {
+                result.m_sequences.push_back(RangeIndex::Sequence{ id, numericKeys ? std::string() : std::string(line, idEnd), offset, 0 });
+                current = &result.m_sequences.back();
+            }
+        }
+
+        uint32_t samples = 0;
+        if (!consumedToEof)
+            samples = m_mainStream.empty() || boost::string_ref(idEnd, lineEnd - idEnd).find(m_mainStream) != boost::string_ref::npos ? 1 : 0;
+
+        if (current)
+            current->m_numberOfSamples += samples;
+        else
+            result.m_leadingSamples += samples;
+    }
+}
+
+void Indexer::BuildFromLinesInParallel(int64_t dataStart, size_t numberOfRanges)
+{
+    m_hasSequenceIds = false;
+
+    std::vector<RangeIndex> ranges(numberOfRanges);
+    std::vector<std::future<void>> workers;
+    int64_t rangeSize = (m_fileSize - dataStart) / numberOfRanges;
+    for (size_t i = 0; i < numberOfRanges; i++)
+    {
+        int64_t begin = dataStart + i * rangeSize;
+        int64_t end = i + 1 == numberOfRanges ? m_fileSize : begin + rangeSize;
+        workers.push_back(std::async(std::launch::async, [this, begin, end, i, &ranges]()
+        {
+            IndexRange(begin, end, i == 0, /*fromLines=*/true, /*numericKeys=*/true, ranges[i]);
+        }));
+    }
+    for (auto& worker : workers) // rethrows the first error, if any
+        worker.get();
+
+    // Each line is a sequence, with its line number as the key.
+    size_t lineNumber = 0;
+    for (size_t i = 0; i < numberOfRanges; i++)
+    {
+        const auto& offsets = ranges[i].m_lineOffsets;
+        for (size_t j = 0; j < offsets.size(); j++, lineNumber++)
+        {
+            int64_t next = j + 1 < offsets.size() ? offsets[j + 1] : m_fileSize;
+            for (size_t k = i + 1; j + 1 == offsets.size() && k < numberOfRanges; k++)
+            {
+                if (!ranges[k].m_lineOffsets.empty())
+                {
+                    next = ranges[k].m_lineOffsets.front();
+                    break;
+                }
+            }
+            m_index.AddSequence(SequenceDescriptor{ lineNumber, 1 }, offsets[j], next);
+        }
+        std::vector<int64_t>().swap(ranges[i].m_lineOffsets);
+    }
+
+    // Leave the file at the end, as the sequential pass does.
+    _fseeki64(m_file, 0, SEEK_END);
+}
+
+void Indexer::BuildInParallel(const std::function<size_t(const std::string&)>& keyToId, bool numericKeys, int64_t dataStart, size_t numberOfRanges)
+{
+    std::vector<RangeIndex> ranges(numberOfRanges);
+    std::vector<std::future<void>> workers;
+    int64_t rangeSize = (m_fileSize - dataStart) / numberOfRanges;
+    for (size_t i = 0; i < numberOfRanges; i++)
+    {
+        int64_t begin = dataStart + i * rangeSize;
+        int64_t end = i + 1 == numberOfRanges ? m_fileSize : begin + rangeSize;
+        workers.push_back(std::async(std::launch::async, [this, begin, end, i, numericKeys, &ranges]()
+        {
+            IndexRange(begin, end, i == 0, /*fromLines=*/false, numericKeys, ranges[i]);
+        }));
+    }
+    for (auto& worker : workers) // rethrows the first error, if any
+        worker.get();
+
+    // Merge in file order. A range may start in the middle of a sequence (with lines without an id,
+    // or lines with the same id as the last sequence of the previous range); these are appended to it.
+    // Symbolic keys are translated here, so that ids are assigned in the same order as in a sequential pass.
+    bool first = true;
+    size_t previousId = 0;
+    int64_t sequenceOffset = 0;
+    uint32_t numberOfSamples = 0;
+    for (auto& range : ranges)
+    {
+        numberOfSamples += range.m_leadingSamples;
+        for (auto& sequence : range.m_sequences)
+        {
+            size_t id = numericKeys ? sequence.m_id : keyToId(sequence.m_key);
+            if (first || id != previousId)
+            {
+                if (!first)
+                    m_index.AddSequence(SequenceDescriptor{ previousId, numberOfSamples }, sequenceOffset, sequence.m_offset);
+                first = false;
+                sequenceOffset = sequence.m_offset;
+                previousId = id;
+                numberOfSamples = 0;
+            }
+            numberOfSamples += sequence.m_numberOfSamples;
+        }
+        std::vector<RangeIndex::Sequence>().swap(range.m_sequences);
+    }
+
+    assert(!first); // the first range starts with a sequence id, otherwise IndexRange() fails
+    m_index.AddSequence(SequenceDescriptor{ previousId, numberOfSamples }, sequenceOffset, m_fileSize);
+
+    // Leave the file at the end, as the sequential pass does.
+    _fseeki64(m_file, 0, SEEK_END);
+}
+
 void Indexer::SkipLine()
 {
     while (!m_buffer.Eof())
@@ -184,14 +184,22 @@ public:
 // others specify size and file offset of the respective structure).
 // As opposed to the data deserializer, indexer performs almost no parsing 
 // and therefore is several magnitudes faster.
+// Large files are split into byte ranges that are indexed on separate threads. Each thread resyncs
+// to the first line that starts in its range, and the per-range results are then merged in file order,
+// which gives the same index as a single sequential pass.
 class Indexer
 {
 public:
-    Indexer(FILE* file, bool isPrimary, bool skipSequenceIds = false, char streamPrefix = '|', size_t chunkSize = 32 * 1024 * 1024, const std::string& mainStream = "", size_t bufferSize = 2 * 1024 * 1024);
+    // numberOfThreads: number of byte ranges to index in parallel; 0 means one per hardware thread,
+    // but no more than one per c_minBytesPerIndexingThread bytes of input.
+    Indexer(FILE* file, bool isPrimary, bool skipSequenceIds = false, char streamPrefix = '|', size_t chunkSize = 32 * 1024 * 1024, const std::string& mainStream = "", size_t bufferSize = 2 * 1024 * 1024,
+            size_t numberOfThreads = 0);
 
     // Reads the input file, building and index of chunks and corresponding
     // sequences.
-    void Build(CorpusDescriptorPtr corpus);
+    // If indexCachePath is not empty, the index is loaded from this file when it is up to date,
+    // otherwise it is written there after it has been built (see IndexCache).
+    void Build(CorpusDescriptorPtr corpus, const std::wstring& indexCachePath = L"");
 
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
@@ -206,10 +214,15 @@ public:
         return m_mainStream;
     }
 
+    // Minimum input size per thread when the number of threads is chosen automatically.
+    static const size_t c_minBytesPerIndexingThread = 64 * 1024 * 1024;
+
 private:
     FILE* m_file;
     int64_t m_fileSize;
     MemoryBuffer m_buffer;
+    size_t m_bufferSize;
+    size_t m_numberOfThreads;
     bool m_hasSequenceIds; // true, when input contains one sequence per line 
                            // or when sequence id column was ignored during indexing.
 
@@ -239,11 +252,31 @@ private:
     // It reads a symbolic key and converts it to numeric id using provided keyToId function.
     bool TryGetSymbolicSequenceId(size_t& id, std::function<size_t(const std::string&)> keyToId);
 
+    // Builds the index from the input file, translating symbolic sequence keys with keyToId.
+    void BuildIndex(CorpusDescriptorPtr corpus, const std::function<size_t(const std::string&)>& keyToId);
+
+    // Description of the settings the index depends on, for the index cache.
+    std::string GetIndexParameters() const;
+
     // Build a chunk/sequence index, treating each line as an individual sequence.
     // Does not do any sequence parsing, instead uses line number as 
     // the corresponding sequence id.
     void BuildFromLines();
 
+    // Sequences found in one byte range of the input by a parallel indexing thread.
+    struct RangeIndex;
+
+    // Number of byte ranges to index in parallel, for the data starting at dataStart.
+    size_t GetNumberOfRanges(int64_t dataStart) const;
+
+    // Indexes the byte ranges on separate threads, then merges the results into m_index.
+    // Same as BuildFromLines() and the sequential part of Build(), respectively.
+    void BuildFromLinesInParallel(int64_t dataStart, size_t numberOfRanges);
+    void BuildInParallel(const std::function<size_t(const std::string&)>& keyToId, bool numericKeys, int64_t dataStart, size_t numberOfRanges);
+
+    // Indexes the lines that start within [begin, end) of the file.
+    void IndexRange(int64_t begin, int64_t end, bool isFirstRange, bool fromLines, bool numericKeys, RangeIndex& result) const;
+
     DISABLE_COPY_AND_MOVE(Indexer);
 };
 
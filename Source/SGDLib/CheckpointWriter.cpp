@@ -0,0 +1,112 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "CheckpointWriter.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// The background writes go out in large blocks.
+static const size_t CheckpointWriteBufferSize = 16 * 1024 * 1024;
+
+CheckpointWriter::~CheckpointWriter()
+{
+    try
+    {
+        Wait();
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "CheckpointWriter: writing a checkpoint failed: %s\n", e.what());
+    }
+}
+
+std::shared_ptr<File> CheckpointWriter::Open(const std::wstring& fileName, FileOptions fileFormat)
+{
+    if (m_async)
+        return std::make_shared<File>(fileName, fileFormat | FileOptions::fileOptionsWrite | FileOptions::fileOptionsMemory);
+
+    auto file = std::make_shared<File>(fileName + L".tmp", fileFormat | FileOptions::fileOptionsWrite);
+    // Buffer writes in memory then flush to filesystem, which reduces number of small writes
+    file->Setvbuf();
+    return file;
+}
+
+void CheckpointWriter::Commit(const std::wstring& fileName, std::shared_ptr<File>&& file)
+{
+    std::wstring tempFileName = fileName + L".tmp";
+    if (!m_async)
+    {
+        try
+        {
+            file->Flush();
+            file.reset(); // closes the file
+            renameOrDie(tempFileName, fileName);
+        }
+        catch (...)
+        {
+            file.reset();
+            _wunlink(tempFileName.c_str()); // do not leave a partial file behind
+            throw;
+        }
+        return;
+    }
+
+    std::shared_ptr<File> snapshot = std::move(file);
+    RunInBackground([snapshot, fileName, tempFileName]()
+    {
+        FILE* f = nullptr;
+        try
+        {
+            f = fopenOrDie(tempFileName, L"wb");
+            setvbuf(f, nullptr, _IOFBF, CheckpointWriteBufferSize);
+            snapshot->CopyMemoryTo(f);
+            fflushOrDie(f);
+            fsyncOrDie(f); // make sure the content is on the disk before the rename makes it the checkpoint
+            FILE* written = f;
+            f = nullptr;
+            fcloseOrDie(written);
+            renameOrDie(tempFileName, fileName);
+        }
+        catch (...)
+        {
+            if (f)
+                fclose(f);
+            _wunlink(tempFileName.c_str()); // do not leave a partial file behind
+            throw;
+        }
+    });
+}
+
+void CheckpointWriter::Remove(const std::wstring& fileName)
+{
+    if (!m_async)
+        _wunlink(fileName.c_str());
+    else
+        RunInBackground([fileName]() { _wunlink(fileName.c_str()); });
+}
+
+void CheckpointWriter::Wait()
+{
+    if (!m_pending.valid())
+        return;
+    auto pending = std::move(m_pending);
+    m_pending = std::shared_future<void>();
+    pending.get();
+}
+
+void CheckpointWriter::RunInBackground(std::function<void()>&& operation)
+{
+    auto previous = m_pending;
+    m_pending = std::async(std::launch::async, [previous, operation]()
+    {
+        if (previous.valid())
+            previous.get(); // rethrows the error of a failed operation, skipping this one
+        operation();
+    }).share();
+}
+
+}}}
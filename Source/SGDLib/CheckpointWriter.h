@@ -0,0 +1,58 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CheckpointWriter.h -- writes model and checkpoint files, optionally in the background
+//
+
+#pragma once
+
+#include "File.h"
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Writes the files of a checkpoint such that a file either has its complete new content or does not exist:
+// the content goes to a temporary file that is renamed when done, and that is deleted if writing it fails.
+//
+// In asynchronous mode, Open() returns a File in memory. Serializing into it on the training thread is just a
+// copy of the model and optimizer state, while Commit() leaves writing it to the disk, syncing and renaming to a
+// background thread, so that training continues meanwhile. The background operations run in the order in which
+// they were requested; if one fails, the ones after it are skipped and Wait() throws its error.
+class CheckpointWriter
+{
+public:
+    CheckpointWriter(bool async = false)
+        : m_async(async)
+    {
+    }
+
+    ~CheckpointWriter(); // waits for the background operations
+
+    void SetAsync(bool async) { m_async = async; }
+    bool IsAsync() const { return m_async; }
+
+    // Returns a File to write the content of 'fileName' to.
+    std::shared_ptr<File> Open(const std::wstring& fileName, FileOptions fileFormat = FileOptions::fileOptionsBinary);
+
+    // Moves the content written to the File returned by Open() to 'fileName'. The File must not be used afterwards.
+    void Commit(const std::wstring& fileName, std::shared_ptr<File>&& file);
+
+    // Deletes 'fileName' once the preceding Commit()s are done, so that an older checkpoint file is kept until
+    // the newer one is complete.
+    void Remove(const std::wstring& fileName);
+
+    // Waits for the background operations, e.g. before reading back a checkpoint file. Throws if one of them failed.
+    void Wait();
+
+private:
+    void RunInBackground(std::function<void()>&& operation);
+
+    bool m_async;
+    std::shared_future<void> m_pending; // the last background operation
+};
+
+}}}
@@ -0,0 +1,355 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DataParallelReplicas.h -- data-parallel training on several threads of one process
+//
+
+#pragma once
+
+#include "ComputationNetwork.h"
+#include "ComputationNode.h"
+#include "TrainingNodes.h"
+#include "DataReader.h"
+#include "CPUMatrix.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Copies of a network that share its LearnableParameters, each with a thread of its own. Every minibatch is split
+// by parallel sequences into one slice per replica, and the replicas run forward and backprop over their slices
+// concurrently, each with its share of the CPU threads. Afterwards, either ReduceGradients() sums their gradients
+// into the network's (synchronous mode), or the replicas update the shared parameters themselves without any
+// locking (Hogwild). The network itself is not evaluated; its criterion and evaluation nodes receive the sums of
+// the replicas' values, so that the caller can accumulate them as usual. The replicas are created once and used for
+// every epoch between StartEpoch() and EndEpoch().
+template <class ElemType>
+class DataParallelReplicas
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    DataParallelReplicas(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode,
+                         const std::vector<ComputationNodeBasePtr>& evaluationNodes, const std::list<ComputationNodeBasePtr>& learnableNodes,
+                         size_t numReplicas)
+        : m_net(net), m_stopping(false), m_generation(0), m_epoch(0), m_numPending(0), m_work(nullptr), m_serializeUpdates(true)
+    {
+        if (numReplicas < 2)
+            InvalidArgument("DataParallelReplicas: At least two replicas are needed.");
+        if (net->GetDeviceId() != CPUDEVICE)
+            InvalidArgument("DataParallelReplicas: Training on several threads of one process is only supported on the CPU.");
+
+        // The network's nodes get the sums of the replicas' values, which only works for scalars.
+        m_criterionNodes.push_back(criterionNode);
+        m_criterionNodes.insert(m_criterionNodes.end(), evaluationNodes.begin(), evaluationNodes.end());
+        for (const auto& node : m_criterionNodes)
+        {
+            if (node->HasMBLayout())
+                InvalidArgument("DataParallelReplicas: Criterion node '%ls' has a minibatch layout. Only criteria that are summed over the minibatch are supported.", node->NodeName().c_str());
+        }
+        // Their running statistics would diverge between the replicas.
+        if (!net->GetNodesWithType(OperationNameOf(BatchNormalizationNode), criterionNode).empty())
+            InvalidArgument("DataParallelReplicas: Networks with BatchNormalization nodes are not supported.");
+
+        m_numThreadsPerReplica = std::max(1, CPUMatrix<ElemType>::GetMaxNumThreads() / (int)numReplicas);
+        m_previousNumThreads = CPUMatrix<ElemType>::GetMaxNumThreads();
+
+        for (size_t k = 0; k < numReplicas; k++)
+        {
+            Replica replica;
+            replica.m_net = net->CloneSharingParameters();
+            replica.m_net->Environment().SetOperationMode(NetworkOperationMode::training);
+            for (const auto& node : m_criterionNodes)
+                replica.m_criterionNodes.push_back(replica.m_net->GetNodeFromName(node->NodeName()));
+            std::vector<ComputationNodeBasePtr> replicaEvaluationNodes(replica.m_criterionNodes.begin() + 1, replica.m_criterionNodes.end());
+            replica.m_net->AllocateAllMatrices(replicaEvaluationNodes, {}, replica.m_criterionNodes[0]);
+            replica.m_net->StartEvaluateMinibatchLoop(replicaEvaluationNodes);
+            replica.m_net->StartEvaluateMinibatchLoop(replica.m_criterionNodes[0]);
+
+            for (const auto& node : learnableNodes)
+                replica.m_learnableNodes.push_back(replica.m_net->GetNodeFromName(node->NodeName()));
+            replica.m_actualMBSize = 0;
+            m_replicas.push_back(std::move(replica));
+        }
+
+        for (size_t k = 0; k < numReplicas; k++)
+            m_threads.emplace_back(&DataParallelReplicas<ElemType>::WorkerLoop, this, k);
+    }
+
+    ~DataParallelReplicas()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+        // The BLAS thread count is global, so the workers changed it for everyone.
+        EndEpoch();
+    }
+
+    size_t NumReplicas() const { return m_replicas.size(); }
+    size_t NumThreadsPerReplica() const { return (size_t)m_numThreadsPerReplica; }
+
+    // Gives every replica its own random numbers for the epoch, e.g. for dropout, and divides the CPU threads
+    // among the replicas (with their first work of the epoch) until EndEpoch().
+    void StartEpoch(size_t randSeedBase)
+    {
+        size_t numReplicas = m_replicas.size();
+        for (size_t k = 0; k < numReplicas; k++)
+            ComputationNetwork::SetIRngUserSeed(m_replicas[k].m_net, m_replicas[k].m_criterionNodes[0], randSeedBase * numReplicas + k);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_epoch++;
+        m_serializeUpdates = true;
+    }
+
+    // Gives the CPU threads back, e.g. to the cross-validation between the epochs.
+    void EndEpoch()
+    {
+        CPUMatrix<ElemType>::SetNumThreads(m_previousNumThreads);
+    }
+
+    // Splits the minibatch in the network's input nodes by parallel sequences into one slice per replica. With fewer
+    // parallel sequences than replicas, some of the replicas get nothing to do.
+    void Scatter(const StreamMinibatchInputs& inputMatrices)
+    {
+        auto pMBLayout = m_net->GetMBLayoutPtrOfNetwork();
+        for (const auto& iter : inputMatrices)
+        {
+            if (iter.second.pMBLayout != pMBLayout)
+                RuntimeError("DataParallelReplicas: All inputs must share the minibatch layout of the network.");
+        }
+
+        size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+        size_t numReplicas = m_replicas.size();
+        for (size_t k = 0; k < numReplicas; k++)
+        {
+            auto& replica = m_replicas[k];
+            size_t begin = numParallelSequences * k / numReplicas;
+            size_t end = numParallelSequences * (k + 1) / numReplicas;
+            replica.m_actualMBSize = 0;
+            if (begin == end)
+                continue;
+
+            // the sequences in [begin, end), shifted to start at 0 (as DecimateMinibatch())
+            auto replicaMBLayout = replica.m_net->GetMBLayoutPtrOfNetwork();
+            replicaMBLayout->Init(end - begin, numTimeSteps);
+            for (const auto& seq : pMBLayout->GetAllSequences())
+            {
+                if (seq.s >= begin && seq.s < end)
+                {
+                    auto shiftedSeq = seq;
+                    shiftedSeq.s -= begin;
+                    replicaMBLayout->AddSequence(shiftedSeq);
+                }
+            }
+
+            for (const auto& iter : inputMatrices)
+            {
+                const auto& input = inputMatrices.GetInputMatrix<ElemType>(iter.first);
+                auto replicaNode = dynamic_pointer_cast<ComputationNode<ElemType>>(replica.m_net->GetNodeFromName(iter.first));
+                auto& value = replicaNode->Value();
+                if (numTimeSteps == 1) // each column is a sequence; this also works for sparse inputs
+                    value.SetValue(input.ColumnSlice(begin, end - begin));
+                else if (input.GetMatrixType() == DENSE)
+                {
+                    size_t numRows = input.GetNumRows();
+                    value.AssignRowSliceValuesOf(input.Reshaped(numRows * numParallelSequences, numTimeSteps), begin * numRows, (end - begin) * numRows);
+                    value.Reshape(numRows, (end - begin) * numTimeSteps);
+                }
+                else
+                    RuntimeError("DataParallelReplicas: Sparse input '%ls' with sequences longer than one sample cannot be split.", iter.first.c_str());
+                replicaNode->NotifyFunctionValuesMBSizeModified();
+                replicaNode->BumpEvalTimeStamp();
+            }
+            replica.m_actualMBSize = replica.m_net->DetermineActualMBSizeFromFeatures();
+        }
+    }
+
+    // Runs forward prop, and backprop if 'backprop', on every replica that got a slice of the minibatch. Then calls
+    // 'update' (if given) on the replica's thread, with the replica's copies of the learnable nodes and its number of
+    // samples; for Hogwild, this updates the shared parameters with the replica's gradients. The first updates of
+    // an epoch run one at a time, since the optimizers (re)allocate their shared state on their first call, e.g.
+    // FSAdaGrad and RmsProp grow it to 2 and 3 times the size of the parameter, which must not happen concurrently.
+    // Finally sums the criterion and evaluation values of the replicas into the network's nodes.
+    void ForwardBackward(bool backprop, const std::function<void(const std::list<ComputationNodeBasePtr>&, size_t)>& update)
+    {
+        Run([this, backprop, &update](size_t k)
+        {
+            auto& replica = m_replicas[k];
+            if (replica.m_actualMBSize == 0)
+                return;
+            for (const auto& node : replica.m_learnableNodes) // possibly updated by someone else
+                node->BumpEvalTimeStamp();
+            for (const auto& node : replica.m_net->GetNodesWithType(OperationNameOf(DropoutNode), replica.m_criterionNodes[0])) // new random masks
+                node->SetEvalTimeStampOutdatedWrtAll();
+            replica.m_net->ForwardProp(replica.m_criterionNodes);
+            if (backprop)
+            {
+                replica.m_net->Backprop(replica.m_criterionNodes[0]);
+                if (update && m_serializeUpdates)
+                {
+                    std::lock_guard<std::mutex> lock(m_updateMutex);
+                    update(replica.m_learnableNodes, replica.m_actualMBSize);
+                }
+                else if (update)
+                    update(replica.m_learnableNodes, replica.m_actualMBSize);
+            }
+        });
+        if (backprop && update && std::any_of(m_replicas.begin(), m_replicas.end(), [](const Replica& replica) { return replica.m_actualMBSize > 0; }))
+            m_serializeUpdates = false; // (read by the workers only within Run(), which synchronizes with them)
+
+        for (size_t i = 0; i < m_criterionNodes.size(); i++)
+        {
+            auto& sum = dynamic_pointer_cast<ComputationNode<ElemType>>(m_criterionNodes[i])->Value();
+            bool first = true;
+            for (const auto& replica : m_replicas)
+            {
+                if (replica.m_actualMBSize == 0)
+                    continue;
+                const auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(replica.m_criterionNodes[i])->Value();
+                if (first)
+                    sum.SetValue(value);
+                else
+                    sum += value;
+                first = false;
+            }
+        }
+    }
+
+    // Sums the gradients of the replicas in a binary tree, one level at a time with the pairs in parallel, and
+    // stores the sum in the gradients of the network's learnable nodes (in the order of the constructor's list).
+    // Returns false if no replica had any samples.
+    bool ReduceGradients(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        size_t numReplicas = m_replicas.size();
+        std::vector<char> hasGradients(numReplicas); // (not vector<bool>, whose elements cannot be written concurrently)
+        for (size_t k = 0; k < numReplicas; k++)
+            hasGradients[k] = (m_replicas[k].m_actualMBSize > 0);
+
+        for (size_t stride = 1; stride < numReplicas; stride *= 2)
+        {
+            Run([this, stride, &hasGradients](size_t k)
+            {
+                if ((k % (2 * stride)) != 0 || (k + stride) >= m_replicas.size() || !hasGradients[k + stride])
+                    return;
+                auto to = m_replicas[k].m_learnableNodes.begin();
+                auto from = m_replicas[k + stride].m_learnableNodes.begin();
+                for (; to != m_replicas[k].m_learnableNodes.end(); to++, from++)
+                {
+                    if (!(*to)->IsParameterUpdateRequired())
+                        continue;
+                    auto& toGradient = dynamic_pointer_cast<ComputationNode<ElemType>>(*to)->Gradient();
+                    const auto& fromGradient = dynamic_pointer_cast<ComputationNode<ElemType>>(*from)->Gradient();
+                    if (!hasGradients[k])
+                        toGradient.SetValue(fromGradient);
+                    else if (toGradient.GetMatrixType() == DENSE && fromGradient.GetMatrixType() == DENSE)
+                        toGradient += fromGradient;
+                    else
+                        RuntimeError("DataParallelReplicas: The sparse gradient of '%ls' cannot be summed; use Hogwild updates for this network.", (*to)->NodeName().c_str());
+                }
+                hasGradients[k] = true; // (no one else touches the entries of this level's pairs)
+            });
+        }
+        if (!hasGradients[0])
+            return false;
+
+        auto from = m_replicas[0].m_learnableNodes.begin();
+        for (auto to = learnableNodes.begin(); to != learnableNodes.end(); to++, from++)
+        {
+            if ((*to)->IsParameterUpdateRequired())
+                dynamic_pointer_cast<ComputationNode<ElemType>>(*to)->Gradient().SetValue(dynamic_pointer_cast<ComputationNode<ElemType>>(*from)->Gradient());
+        }
+        return true;
+    }
+
+private:
+    // Runs 'work' for every replica on its thread, and waits for all of them. Rethrows the first error.
+    void Run(const std::function<void(size_t)>& work)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_work = &work;
+        m_numPending = m_replicas.size();
+        m_error = nullptr;
+        m_generation++;
+        m_workAvailable.notify_all();
+        m_workDone.wait(lock, [this] { return m_numPending == 0; });
+        m_work = nullptr;
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+
+    void WorkerLoop(size_t k)
+    {
+        size_t generation = 0;
+        size_t epoch = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_workAvailable.wait(lock, [this, generation] { return m_stopping || m_generation != generation; });
+            if (m_stopping)
+                return;
+            generation = m_generation;
+            const auto& work = *m_work;
+            bool newEpoch = (epoch != m_epoch);
+            epoch = m_epoch;
+
+            lock.unlock();
+            // The OpenMP thread count is per thread, while the BLAS one is global, and EndEpoch() restored it.
+            if (newEpoch)
+                CPUMatrix<ElemType>::SetNumThreads(m_numThreadsPerReplica);
+            std::exception_ptr error;
+            try
+            {
+                work(k);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            if (error && !m_error)
+                m_error = error;
+            if (--m_numPending == 0)
+                m_workDone.notify_all();
+        }
+    }
+
+    struct Replica
+    {
+        ComputationNetworkPtr m_net;
+        std::vector<ComputationNodeBasePtr> m_criterionNodes; // the training criterion, then the evaluation nodes
+        std::list<ComputationNodeBasePtr> m_learnableNodes;   // in the order of the network's
+        size_t m_actualMBSize;                                // of the current slice; 0 if there is none
+    };
+
+    ComputationNetworkPtr m_net;
+    std::vector<ComputationNodeBasePtr> m_criterionNodes;
+    std::vector<Replica> m_replicas;
+    int m_numThreadsPerReplica;
+    int m_previousNumThreads;
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workDone;
+    bool m_stopping;
+    size_t m_generation;
+    size_t m_epoch; // counts StartEpoch()
+    size_t m_numPending;
+    const std::function<void(size_t)>* m_work;
+    std::exception_ptr m_error;
+    std::mutex m_updateMutex;
+    bool m_serializeUpdates; // until the first Hogwild update of the epoch
+};
+
+}}}
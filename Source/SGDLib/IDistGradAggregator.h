@@ -19,6 +19,29 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) = 0;
 
+    // Optional overlapping of the aggregation with backprop. EnableOverlappedAggregation() is passed the gradients
+    // in the order in which backprop finishes them, and returns false if the aggregator does not overlap. Otherwise,
+    // the caller reports every gradient to OnGradientReady() as soon as backprop has finished it, and must call
+    // WaitForGradient() for a gradient before using it after AggregateGradients(). FinishOverlappedAggregation() must be
+    // called after every minibatch, including ones whose gradients are not used, and before the gradients are written
+    // again or the aggregator is destroyed, since the all-reduces may still be in flight and own the gradients' memory.
+    virtual bool EnableOverlappedAggregation(const std::vector<Matrix<ElemType>*>& /*gradientsInBackpropOrder*/)
+    {
+        return false;
+    }
+
+    virtual void OnGradientReady(Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
+    virtual void WaitForGradient(Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
+    virtual void FinishOverlappedAggregation()
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -35,13 +58,59 @@ public:
     }
 
 protected:
+    // Initiates the receive of the headers into recvHeaders (one for every other node) on the main node, and the send
+    // of the header from all other nodes. 'tag' must be the same on all nodes.
+    void StartHeaderAggregation(DistGradHeader* headerCPU, const std::vector<DistGradHeader*>& recvHeaders, int tag, std::vector<MPI_Request>& recvHeaderRequests, MPI_Request& sendHeaderRequest)
+    {
+        recvHeaderRequests.resize(NumProc() - 1);
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                m_mpi->Irecv(recvHeaders[j], recvHeaders[j]->Size(), MPI_CHAR, source, tag, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+        }
+        else
+            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), tag, &sendHeaderRequest) || MpiFail("MPI_Isend");
+    }
+
+    // On the main node waits for the headers to arrive and aggregates them, then broadcasts the result to all nodes.
+    void FinishHeaderAggregation(DistGradHeader* headerCPU, const std::vector<DistGradHeader*>& recvHeaders, std::vector<MPI_Request>& recvHeaderRequests)
+    {
+        if (m_mpi->IsMainNode())
+        {
+            size_t numNodesHeadersReceivedFrom = 0;
+            while (numNodesHeadersReceivedFrom < (NumProc() - 1))
+            {
+                int idx = MPI_UNDEFINED;
+                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (idx == MPI_UNDEFINED)
+                {
+                    break;
+                }
+
+                numNodesHeadersReceivedFrom++;
+
+                headerCPU->Aggregate(recvHeaders[idx], true);
+            }
+
+            assert(numNodesHeadersReceivedFrom == (NumProc() - 1));
+        }
+
+        // Broadcast the aggregated header to all nodes
+        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+    }
+
     MPIWrapperPtr m_mpi;
 };
 
-#define UsingIDistGradAggregatorMembers           \
+#define UsingIDistGradAggregatorMembers                          \
     \
-protected:                                        \
-    using IDistGradAggregator<ElemType>::m_mpi;   \
-    using IDistGradAggregator<ElemType>::NumProc; \
-    using IDistGradAggregator<ElemType>::MyRank
+protected:                                                       \
+    using IDistGradAggregator<ElemType>::m_mpi;                  \
+    using IDistGradAggregator<ElemType>::NumProc;                \
+    using IDistGradAggregator<ElemType>::MyRank;                 \
+    using IDistGradAggregator<ElemType>::StartHeaderAggregation; \
+    using IDistGradAggregator<ElemType>::FinishHeaderAggregation
 } } }
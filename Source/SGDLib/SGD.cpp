@@ -33,6 +33,10 @@
 #include "CNTKLibraryInternals.h"
 #include "SimpleDistGradAggregator.h"
 #include "V2SimpleDistGradAggregator.h"
+#include "SparseDistGradAggregator.h"
+#include "DataParallelReplicas.h"
+#include "NodeProfiler.h"
+#include "GPUMatrix.h"                  // for SyncGuard
 #include "ProgressTracing.h"
 #include "PerformanceProfiler.h"
 
@@ -204,6 +208,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 {
     let& criterionNodes = GetTrainCriterionNodes(net);
 
+    m_replicas.reset(); // of an earlier training run that failed, which belong to a different network
+
     fprintf(stderr, "\n");
     if (criterionNodes.size() == 1)
     {
@@ -507,6 +513,35 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         tensorBoardWriter = make_shared<::CNTK::Internal::TensorBoardFileWriter>(m_tensorBoardLogDir, net);
     }
 
+    // Per-node profile of forward and backward propagation.
+    shared_ptr<NodeProfiler> nodeProfiler;
+    if (m_profileNodes)
+    {
+        nodeProfiler = make_shared<NodeProfiler>(m_profileNodesMaxTraceEvents);
+        net->Environment().nodeProfiler = nodeProfiler;
+        if (net->GetDeviceId() != CPUDEVICE)
+        {
+            // otherwise the time of a kernel would be attributed to whichever node happens to wait for it
+            LOGPRINTF(stderr, "profileNodes: GPU kernels will be executed synchronously.\n");
+            SyncGuard::EnableSync();
+        }
+    }
+
+    if (m_sparseEmbeddingGradients)
+    {
+        if (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD || m_numSubminiBatches > 1 || m_maxSamplesInRAM < SIZE_MAX ||
+            (m_numReplicas > 1 && !m_replicaUpdateHogwild))
+            LOGPRINTF(stderr, "WARNING: 'sparseEmbeddingGradients' is ignored, since parallel training, sub-minibatches and synchronous replicas need dense gradients.\n");
+        else
+            net->SetSparseEmbeddingGradients(true);
+    }
+
+    if (m_interOpThreads > 1)
+    {
+        LOGPRINTF(stderr, "Evaluating independent nodes concurrently on %d threads.\n", (int) m_interOpThreads);
+        net->SetInterOpParallelism(m_interOpThreads);
+    }
+
     // --- MAIN EPOCH LOOP
     for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
@@ -782,6 +817,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     // roll back
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     LOGPRINTF(stderr, "Loading (rolling back to) previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    m_checkpointWriter.Wait(); // the model may still be being written
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalTrainingSamplesSeen,
@@ -861,6 +897,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // Persist model and check-point info
         if ((m_mpi == nullptr) || m_mpi->IsMainNode())
         {
+            // Keep at most one checkpoint in flight, so that snapshots do not pile up in memory if writing is slow.
+            m_checkpointWriter.Wait();
+
             if (loadedPrevModel)
             {
                 // If previous best model is loaded, we will first remove epochs that lead to worse results
@@ -896,25 +935,28 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     chosenMinibatchSize);
                 auto modelName = GetModelNameForEpoch(i);
                 if (m_traceLevel > 0)
-                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'%s\n", modelName.c_str(), m_checkpointWriter.IsAsync() ? " in the background" : "");
+                auto modelFile = m_checkpointWriter.Open(modelName);
+                net->Save(*modelFile);
+                m_checkpointWriter.Commit(modelName, std::move(modelFile));
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
+                    // (with asyncCheckpoint only after the new one has been written)
                     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch && m_loadBestModel)
                     {
                         if (epochsSinceLastLearnRateAdjust != 1)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                            m_checkpointWriter.Remove(GetCheckPointFileNameForEpoch(i - 1));
                         }
                         if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                            m_checkpointWriter.Remove(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval));
                         }
                     }
                     else
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        m_checkpointWriter.Remove(GetCheckPointFileNameForEpoch(i - 1));
                     }
                 }
             }
@@ -936,6 +978,26 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    // Finish writing the last checkpoint in the background, if any. This throws if writing a checkpoint failed.
+    m_checkpointWriter.Wait();
+
+    m_replicas.reset();
+
+    net->SetInterOpParallelism(0);
+    net->SetSparseEmbeddingGradients(false);
+
+    if (nodeProfiler)
+    {
+        net->Environment().nodeProfiler = nullptr;
+        if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+        {
+            nodeProfiler->WriteTable(stderr);
+            wstring traceFileName = m_modelPath + L".nodeprofile.json";
+            nodeProfiler->WriteChromeTrace(traceFileName);
+            LOGPRINTF(stderr, "Node profile trace written to %ls.\n", traceFileName.c_str());
+        }
+    }
+
     // Check if we need to save best model per criterion and this is the main node as well.
     if (m_saveBestModelPerCriterion && ((m_mpi == nullptr) || m_mpi->IsMainNode()))
     {
@@ -1032,6 +1094,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     }
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
+    bool useOverlappedAggregation = false; // gradients are aggregated while backprop runs, see below
     Profiler profiler(m_numMBsToCUDAProfile);
 
     // resetting this, so profiling is performed for one epoch only
@@ -1066,6 +1129,22 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     if (numSubminibatchesNeeded > 1)
         smbDispatcher.Init(net, learnableNodes, criterionNodes, evaluationNodes);
 
+    // in-process data parallelism: copies of the network that share its parameters train on slices of each
+    // minibatch on threads of their own. They are kept for the whole training run.
+    DataParallelReplicas<ElemType>* replicas = nullptr;
+    if (m_numReplicas > 1)
+    {
+        if (useParallelTrain || numSubminibatchesNeeded > 1 || m_doGradientCheck ||
+            (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode))
+            InvalidArgument("numReplicas > 1 cannot be combined with parallel training, sub-minibatches, gradient checking or KL adaptation.");
+        if (!evaluationNodesWhichAccumulateResult.empty())
+            InvalidArgument("numReplicas > 1 does not support evaluation nodes that accumulate their result over the epoch.");
+        if (!m_replicas)
+            m_replicas = make_shared<DataParallelReplicas<ElemType>>(net, criterionNodes[0], evaluationNodes, learnableNodes, m_numReplicas);
+        replicas = m_replicas.get();
+        replicas->StartEpoch(epochNumber);
+    }
+
     // The following is a special feature only supported by the Kaldi2Reader for more efficient sequence training.
     // This attemps to compute the error signal for the whole utterance, which will
     // be fed to the neural network as features. Currently it is a workaround
@@ -1101,6 +1180,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         if (useDistributedMBReading)
             fprintf(stderr, ", distributed reading is ENABLED");
 
+        if (replicas)
+            fprintf(stderr, ", %d replicas with %d threads each (%s updates)",
+                    (int) replicas->NumReplicas(), (int) replicas->NumThreadsPerReplica(), m_replicaUpdateHogwild ? "Hogwild" : "synchronous");
+
         if (numSubminibatchesNeeded > 1)
         {
             if (m_maxSamplesInRAM < SIZE_MAX)
@@ -1228,39 +1311,62 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
             // do forward and back propagation
 
-            // We optionally break the minibatch into sub-minibatches.
-            // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
-            size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
-            for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
+            if (replicas)
             {
-                if (actualNumSubminibatches > 1)
+                // The replicas sum their criteria into the nodes of 'net', and, unless they update the parameters
+                // themselves (Hogwild), their gradients into its parameters' gradients.
+                bool backprop = learnRatePerSample > 0.01 * m_minLearnRate; // only compute gradient when learning rate is large enough
+                replicas->Scatter(*inputMatrices);
+                if (m_replicaUpdateHogwild)
+                {
+                    replicas->ForwardBackward(backprop, [&](const std::list<ComputationNodeBasePtr>& replicaLearnableNodes, size_t numSamples)
+                    {
+                        UpdateWeightsOfNodes(replicaLearnableNodes, smoothedGradients, smoothedCounts, learnRatePerSample, epochNumber, net, numSamples);
+                    });
+                }
+                else
                 {
-                    smbDispatcher.GetSubMinibatchToNet(ismb); // get sub-minibatch from full-size one
-                    ComputationNetwork::BumpEvalTimeStamp(featureNodes);
-                    ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                    replicas->ForwardBackward(backprop, nullptr);
+                    if (backprop)
+                        replicas->ReduceGradients(learnableNodes);
                 }
+            }
+            else
+            {
+                // We optionally break the minibatch into sub-minibatches.
+                // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
+                size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
+                for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
+                {
+                    if (actualNumSubminibatches > 1)
+                    {
+                        smbDispatcher.GetSubMinibatchToNet(ismb); // get sub-minibatch from full-size one
+                        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                        ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                    }
 
-                // ===========================================================
-                // forward prop for evaluate eval nodes
-                // ===========================================================
+                    // ===========================================================
+                    // forward prop for evaluate eval nodes
+                    // ===========================================================
 
-                // compute eval node first since when gradient is computed the forward function values
-                // may be changed and need to be recomputed when gradient and function value share the same matrix
-                net->ForwardProp(forwardPropRoots); // the bulk of this evaluation is reused in ComputeGradient() below
+                    // compute eval node first since when gradient is computed the forward function values
+                    // may be changed and need to be recomputed when gradient and function value share the same matrix
+                    net->ForwardProp(forwardPropRoots); // the bulk of this evaluation is reused in ComputeGradient() below
 
-                // ===========================================================
-                // backprop
-                // ===========================================================
+                    // ===========================================================
+                    // backprop
+                    // ===========================================================
 
-                if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                    if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
+                        net->Backprop(criterionNodes[0]);
 
-                // house-keeping for sub-minibatching
+                    // house-keeping for sub-minibatching
+                    if (actualNumSubminibatches > 1)
+                        smbDispatcher.DoneWithCurrentSubMinibatch(ismb); // page state out
+                }                                                        // end sub-minibatch loop
                 if (actualNumSubminibatches > 1)
-                    smbDispatcher.DoneWithCurrentSubMinibatch(ismb); // page state out
-            }                                                        // end sub-minibatch loop
-            if (actualNumSubminibatches > 1)
-                smbDispatcher.DoneWithCurrentMinibatch();
+                    smbDispatcher.DoneWithCurrentMinibatch();
+            }
         } // if (actualMBSize > 0)
         // WARNING: If actualMBSize == 0, then criterion nodes have NOT been updated, and contain garbage (last MB's) values.
 
@@ -1321,6 +1427,31 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                         learnParamsGradients.push_back(currParamsGradient);
                     }
                 }
+
+                // From the next minibatch on, let the aggregator start on the gradients as soon as backprop has
+                // finished them. Parameters come after all their consumers in backprop order. With sub-minibatches,
+                // the gradients are only final after the last one, so there is nothing to overlap with.
+                if (numSubminibatchesNeeded <= 1)
+                {
+                    std::vector<Matrix<ElemType>*> gradientsInBackpropOrder;
+                    const auto& evalOrder = net->GetEvalOrder(criterionNodes[0]);
+                    for (auto nodeIter = evalOrder.rbegin(); nodeIter != evalOrder.rend(); nodeIter++)
+                    {
+                        if ((*nodeIter)->OperationName() == OperationNameOf(LearnableParameter) && (*nodeIter)->IsParameterUpdateRequired())
+                            gradientsInBackpropOrder.push_back(&dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Gradient());
+                    }
+
+                    useOverlappedAggregation = (gradientsInBackpropOrder.size() == learnParamsGradients.size()) &&
+                                               m_distGradAgg->EnableOverlappedAggregation(gradientsInBackpropOrder);
+                    if (useOverlappedAggregation)
+                    {
+                        auto distGradAgg = m_distGradAgg;
+                        net->SetGradientReadyCallback([distGradAgg](const ComputationNodeBasePtr& node)
+                        {
+                            distGradAgg->OnGradientReady(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                        });
+                    }
+                }
             }
 
             // hoist the criterion into CPU space for all-reduce
@@ -1366,8 +1497,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         ProfilerTimeEnd(profGradientAgg, profilerEvtMainGradient);
         auto profWeights = ProfilerTimeBegin();
 
-        // update model parameters
-        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+        // update model parameters (Hogwild replicas have done that already)
+        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && !(replicas && m_replicaUpdateHogwild))
         {
 #if 1       // BUGBUG: We must skip gaps in our momentum, clipping, regularization etc. criteria.
             // This will break test cases. So for now, we will only enable this for per-sample criteria.
@@ -1393,6 +1524,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                     double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
                     double nodeDependentRegMultiplier = dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
                     double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+                    if (useOverlappedAggregation)
+                        m_distGradAgg->WaitForGradient(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
                     // TODO: Check why l2Factor is not applied to L1. Bug?
                     // BUGBUG (Issue #95): Access to net MBLayout can no longer be done if we have multiple input layouts
                     UpdateWeights(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(),
@@ -1411,6 +1544,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             }
         }
 
+        // The update only waited for the gradients it used, or for none if it was skipped (no samples, or a learning
+        // rate below the minimum); the all-reduces must be complete before backprop writes into the gradients again.
+        if (useOverlappedAggregation)
+            m_distGradAgg->FinishOverlappedAggregation();
+
 
         // aggregation by model averaging or block momentum 
         if (useModelAggregation)
@@ -1638,6 +1776,15 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         nSamplesSinceLastModelSync = 0;
     }
 
+    if (useOverlappedAggregation)
+    {
+        m_distGradAgg->FinishOverlappedAggregation();
+        net->SetGradientReadyCallback(nullptr);
+    }
+
+    if (replicas)
+        replicas->EndEpoch();
+
     // hoist the accumulated criterion value from GPU side to our 'out'  variables
     // (unless we useGradientAggregation, in which case they are accumulated in the 'out' variables directly)
     if (!useGradientAggregation)
@@ -2263,7 +2410,18 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
 {
     assert(GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD);
 
-    if (numGradientBits != (8 * sizeof(ElemType)))
+    if (m_sparseGradientRatio > 0 || m_sparseGradientThreshold > 0)
+    {
+        if (traceLevel > 0)
+        {
+            if (m_sparseGradientRatio > 0)
+                fprintf(stderr, "Initializing dataParallelSGD with sparse aggregation of the top %.4g%% gradient entries.\n", 100 * m_sparseGradientRatio);
+            else
+                fprintf(stderr, "Initializing dataParallelSGD with sparse aggregation of the gradient entries of magnitude >= %.6g.\n", m_sparseGradientThreshold);
+        }
+        m_distGradAgg = std::make_shared<SparseDistGradAggregator<ElemType>>(m_mpi, m_syncStatsTrace, m_sparseGradientRatio, m_sparseGradientThreshold);
+    }
+    else if (numGradientBits != (8 * sizeof(ElemType)))
     {
         if (traceLevel > 0)
             fprintf(stderr, "Initializing dataParallelSGD for %d-bit quantization.\n", numGradientBits);
@@ -2286,7 +2444,7 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
             m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, ::CNTK::MPICommunicator(m_packThresholdSizeInBytes));
         else
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes);
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes, m_gradientBucketSizeInBytes);
     }
 
     m_gradHeader.reset(DistGradHeader::Create(numEvalNodes), [](DistGradHeader* ptr) { DistGradHeader::Destroy(ptr); });
@@ -2333,6 +2491,34 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
 
 // public:
 // UpdateWeights() - actual weight update, implementing various update rules
+// Called concurrently by the replicas, which share the parameters, smoothed gradients and counts without locking
+// (except for the first updates of an epoch, which allocate the smoothed gradients; see DataParallelReplicas).
+template <class ElemType>
+void SGD<ElemType>::UpdateWeightsOfNodes(const std::list<ComputationNodeBasePtr>& replicaLearnableNodes,
+                                         std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                                         const double learnRatePerSample, const int epochNumber,
+                                         const ComputationNetworkPtr& net, size_t numSamples) const
+{
+    double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+    auto smoothedGradientIter = smoothedGradients.begin();
+    auto smoothedCountIter = smoothedCounts.begin();
+    for (auto nodeIter = replicaLearnableNodes.begin(); nodeIter != replicaLearnableNodes.end(); nodeIter++, smoothedGradientIter++, smoothedCountIter++)
+    {
+        ComputationNodeBasePtr node = *nodeIter;
+        if (!node->IsParameterUpdateRequired())
+            continue;
+        double nodeDependentLearningRatePerSample = learnRatePerSample * node->GetLearningRateMultiplier();
+        double nodeDependentRegMultiplier = dynamic_pointer_cast<LearnableParameter<ElemType>>(node)->GetRegMultiplier();
+        UpdateWeights(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(),
+                      dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
+                      *smoothedGradientIter, *smoothedCountIter,
+                      nodeDependentLearningRatePerSample, momentumPerSample,
+                      numSamples,
+                      m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier,
+                      m_needAveMultiplier, m_useNesterovMomentum);
+    }
+}
+
 template <class ElemType>
 void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemType>& gradientValues,
                                   Matrix<ElemType>& smoothedGradientValues, double& smoothedCount,
@@ -2472,14 +2658,12 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
     if ((m_mpi == nullptr) || m_mpi->IsMainNode())
     {
         wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
-        // Saving into temporary file and then renaming it to the checkPointFileName
+        // The checkpoint writer saves into a temporary file and then renames it to the checkPointFileName
         // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
-        wstring tempFileName = checkPointFileName + L".tmp";
+        auto file = m_checkpointWriter.Open(checkPointFileName);
 
         {
-            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
-            // Buffer writes in memory then flush to filesystem, which reduces number of small writes
-            fstream.Setvbuf();
+            File& fstream = *file;
             fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
             fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
@@ -2529,8 +2713,8 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
             fstream.Flush();
         }
 
-        _wunlink(checkPointFileName.c_str());
-        renameOrDie(tempFileName, checkPointFileName);
+        // With asyncCheckpoint, this only hands the file to the background writer.
+        m_checkpointWriter.Commit(checkPointFileName, std::move(file));
     }
 }
 
@@ -2835,6 +3019,13 @@ static GradientsUpdateType ParseGradUpdateType(const wstring& s)
     else InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad )");
 }
 
+static bool IsHogwildReplicaUpdate(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"sync")) return false;
+    else if (EqualCI(s, L"hogwild"))                 return true;
+    else InvalidArgument("IsHogwildReplicaUpdate: Invalid replica update. Valid values are (sync | hogwild)");
+}
+
 static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
 {
     if      (EqualCI(s, L"") || EqualCI(s, L"none")) return ParallelizationMethod::none;
@@ -2905,8 +3096,13 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_truncated = configSGD(L"truncated", false);
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
+    m_numReplicas = configSGD(L"numReplicas", (size_t) 1);
+    m_replicaUpdateHogwild = IsHogwildReplicaUpdate(configSGD(L"replicaUpdate", L"sync"));
+    if (m_numReplicas == 0)
+        InvalidArgument("numReplicas must be at least 1.");
 
     m_packThresholdSizeInBytes = configSGD(L"packThresholdSizeInKB", DEFAULT_PACK_THRESHOLD_SIZE_IN_KB) * 1024;
+    m_gradientBucketSizeInBytes = configSGD(L"gradientBucketSizeInKB", (size_t) 0) * 1024;
 
     if (configAALR.Exists(L"numMiniBatch4LRSearch"))
     {
@@ -3119,6 +3315,8 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = vector<int>{8 * (int)sizeofElemType}; // means no quantization
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_sparseGradientRatio = 0;
+    m_sparseGradientThreshold = 0;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
@@ -3157,6 +3355,23 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 if (m_numGradientBits[i] < 1 || m_numGradientBits[i] > defaultGradientBits)
                     InvalidArgument("gradientBits values must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double.");
             }
+
+            m_sparseGradientRatio = configDataParallelSGD(L"sparseGradientRatio", 0.0);
+            m_sparseGradientThreshold = configDataParallelSGD(L"sparseGradientThreshold", 0.0);
+            if (m_sparseGradientRatio > 0 || m_sparseGradientThreshold > 0)
+            {
+                if (m_sparseGradientRatio > 0 && m_sparseGradientThreshold > 0)
+                    InvalidArgument("Only one of sparseGradientRatio and sparseGradientThreshold may be specified.");
+                if (m_sparseGradientRatio > 1)
+                    InvalidArgument("sparseGradientRatio must be in the range (0, 1].");
+                if (m_bufferedAsyncGradientAggregation)
+                    InvalidArgument("Sparse gradient aggregation cannot be combined with useBufferedAsyncGradientAggregation.");
+                for (size_t i = 0; i < m_numGradientBits.size(); i++)
+                {
+                    if (m_numGradientBits[i] != defaultGradientBits)
+                        InvalidArgument("Sparse gradient aggregation cannot be combined with gradient quantization (gradientBits).");
+                }
+            }
         }
         if (configParallelTrain.Exists(L"ModelAveragingSGD"))
         {
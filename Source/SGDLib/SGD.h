@@ -18,6 +18,7 @@
 #include <chrono>
 #include <random>
 #include "Profiler.h"
+#include "CheckpointWriter.h"
 #include "MASGD.h"
 #include "ASGDHelper.h"
 #include <map>
@@ -201,6 +202,13 @@ protected:
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
 
+    // in-process data parallelism on the CPU: each minibatch is split over this many copies of the network, which
+    // share the parameters and run on threads of their own (1 = off)
+    size_t m_numReplicas;
+    // true: the replicas update the parameters with their own gradients without any locking (Hogwild);
+    // false: their gradients are summed, and the parameters are updated once per minibatch as usual
+    bool m_replicaUpdateHogwild;
+
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
     size_t m_maxComputedEpochSize;
@@ -217,6 +225,9 @@ protected:
     // Threshold size in bytes for single gradient to do packing
     size_t m_packThresholdSizeInBytes;
 
+    // Size in bytes of the buckets in which gradients are aggregated while backprop runs (0 = after backprop)
+    size_t m_gradientBucketSizeInBytes;
+
     LearningRateSearchAlgorithm m_autoLearnRateSearchType;
 
     AdaptationRegType m_adaptationRegType;
@@ -293,6 +304,8 @@ protected:
     intargvector m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    double m_sparseGradientRatio;     // > 0: send only this fraction of every gradient's entries (top-k)
+    double m_sparseGradientThreshold; // > 0: send only the gradient entries of at least this magnitude
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
@@ -332,6 +345,9 @@ protected:
 template <class ElemType>
 class IDistGradAggregator;
 
+template <class ElemType>
+class DataParallelReplicas;
+
 // -----------------------------------------------------------------------
 // class SGD
 // -----------------------------------------------------------------------
@@ -353,12 +369,18 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_asyncCheckpoint(configSGD(L"asyncCheckpoint", false)),
+          m_checkpointWriter(m_asyncCheckpoint),
           m_saveBestModelPerCriterion(configSGD(L"saveBestModelPerCriterion", false)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesCategory(configSGD(L"traceNodeNamesCategory", ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesSparse  (configSGD(L"traceNodeNamesSparse",   ConfigRecordType::Array(stringargvector()))),
+          m_profileNodes(configSGD(L"profileNodes", false)),
+          m_profileNodesMaxTraceEvents(configSGD(L"profileNodesMaxTraceEvents", (size_t) 1000000)),
+          m_interOpThreads(configSGD(L"interOpThreads", (size_t) 0)),
+          m_sparseEmbeddingGradients(configSGD(L"sparseEmbeddingGradients", false)),
           m_prevChosenMinibatchSize(0),
           m_lastFinishedEpochTrainLoss(0.0),
           m_distGradAgg(nullptr),
@@ -523,6 +545,11 @@ public:
                        const double L2RegWeight, const double L1RegWeight,
                        const bool needAveMultiplier,
                        const bool useNesterovMomentum) const;
+    // Hogwild update of the parameters that a replica of 'net' shares with it, with the replica's gradients
+    void UpdateWeightsOfNodes(const std::list<ComputationNodeBasePtr>& replicaLearnableNodes,
+                              std::list<Matrix<ElemType>>& smoothedGradients, std::vector<double>& smoothedCounts,
+                              const double learnRatePerSample, const int epochNumber,
+                              const ComputationNetworkPtr& net, size_t numSamples) const;
     // return -1 if nothing exists
     int DetermineStartEpoch(const bool makeMode);
 
@@ -575,6 +602,8 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    bool m_asyncCheckpoint; // write model and checkpoint files in the background while training continues
+    CheckpointWriter m_checkpointWriter;
     bool m_saveBestModelPerCriterion;
     // Mapping from criterion to the best epoch on validation data set.
     std::map<std::wstring, BestEpoch> m_criteriaBestEpoch;
@@ -587,6 +616,21 @@ protected:
     std::vector<std::wstring> m_traceNodeNamesCategory;
     std::vector<std::wstring> m_traceNodeNamesSparse;
 
+    // time every node in forward and backward propagation; the profile is printed, and written as a Chrome trace
+    // to <modelPath>.nodeprofile.json, when training ends
+    bool m_profileNodes;
+    size_t m_profileNodesMaxTraceEvents; // node evaluations beyond this are only counted in the printed profile
+
+    // number of threads on which independent nodes are evaluated concurrently (CPU only); 0 or 1 evaluates one node
+    // at a time. The math library's threads are divided among them.
+    size_t m_interOpThreads;
+
+    // compute sparse gradients of the LookupTable embeddings with sparse inputs (CPU only), so that only the columns of
+    // the words in the minibatch are updated. This also applies to the momentum and the other per-weight state of the
+    // update, which the other columns keep until their words come up. Not with gradient aggregation, sub-minibatches
+    // or synchronous replicas, which need dense gradients.
+    bool m_sparseEmbeddingGradients;
+
     size_t m_prevChosenMinibatchSize;
     double m_lastFinishedEpochTrainLoss;
 
@@ -595,6 +639,9 @@ protected:
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    // in-process data-parallel copies of the network (numReplicas > 1); created by the first epoch of a training run
+    shared_ptr<DataParallelReplicas<ElemType>> m_replicas;
+
 private:
     void MarkDropoutNodesEvalTimeStampAsOutdated(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode);
     std::shared_ptr<ASGDHelper<ElemType>> m_pASGDHelper;
@@ -23,9 +23,10 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES)
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, size_t bucketSizeInBytes = 0)
         : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace),
-        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes)
+        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes),
+        m_bucketSizeInBytes(bucketSizeInBytes), m_numBucketsLaunched(0), m_overlappedRoundAggregated(false)
     {}
 
     ~SimpleDistGradAggregator()
@@ -44,7 +45,12 @@ public:
         bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
         m_iterationCount++;
 
-        if (m_useAsyncAggregation)
+        if (!m_buckets.empty())
+        {
+            AggregateGradientsOverlapped(gradients, headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
+        else if (m_useAsyncAggregation)
         {
             // If we are performing async gradient aggregation, let's wait for the pending gradient aggregation to finish
             // then swap the contents of the buffered gradients and the new gradient matrices and fire an async aggreagation
@@ -125,7 +131,136 @@ public:
         }
     }
 
+    // Splits the gradients into buckets of about m_bucketSizeInBytes, in backprop order. Every bucket is all-reduced
+    // as soon as backprop has finished all of its gradients, and all buckets before it have been started, so that all
+    // nodes start the same all-reduces in the same order, independent of when their gradients become ready.
+    bool EnableOverlappedAggregation(const std::vector<Matrix<ElemType>*>& gradientsInBackpropOrder) override
+    {
+        if (m_bucketSizeInBytes == 0 || m_useAsyncAggregation || m_nccl.IsSupported() || m_mpi->UseGpuGdr())
+            return false;
+        if (!m_buckets.empty()) // already set up for an earlier epoch
+            return true;
+        if (m_initialized || gradientsInBackpropOrder.empty())
+            return false;
+        for (auto gradient : gradientsInBackpropOrder)
+        {
+            if (gradient->GetMatrixType() != DENSE)
+                return false;
+        }
+
+        int deviceId = gradientsInBackpropOrder[0]->GetDeviceId();
+        if (ShouldCopyDataToCPU(deviceId))
+            m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
+
+        for (auto gradient : gradientsInBackpropOrder)
+        {
+            if (m_buckets.empty() || (sizeof(ElemType) * (m_buckets.back()->m_numElements + gradient->GetNumElements()) > m_bucketSizeInBytes))
+                m_buckets.push_back(std::make_unique<GradientBucket>());
+
+            auto& bucket = *m_buckets.back();
+            bucket.m_gradients.push_back(gradient);
+            bucket.m_numElements += gradient->GetNumElements();
+            m_bucketIndex[gradient] = m_buckets.size() - 1;
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            // A single gradient is reduced in place.
+            if (bucket->m_gradients.size() > 1)
+                bucket->m_buffer.reset(new Matrix<ElemType>(1, bucket->m_numElements, deviceId));
+            if (ShouldCopyDataToCPU(deviceId))
+            {
+                bucket->m_gpuDataTransferer = std::make_unique<GPUDataTransferer>(deviceId, /*useConcurrentStreams=*/false);
+                bucket->m_intermediateCPUBuffer = AllocateIntermediateBuffer(deviceId, bucket->m_numElements);
+            }
+        }
+
+        fprintf(stderr, "Overlapping gradient aggregation with backprop, in %d buckets of up to %d KB.\n", (int)m_buckets.size(), (int)(m_bucketSizeInBytes / 1024));
+        return true;
+    }
+
+    void OnGradientReady(Matrix<ElemType>* gradient) override
+    {
+        if (m_buckets.empty())
+            return;
+
+        // The caller did not finish the previous minibatch.
+        if (m_overlappedRoundAggregated)
+            FinishOverlappedRound();
+
+        auto iter = m_bucketIndex.find(gradient);
+        if (iter == m_bucketIndex.end())
+            LogicError("OnGradientReady: Gradient matrix was not passed to EnableOverlappedAggregation().");
+        auto& bucket = *m_buckets[iter->second];
+        if (bucket.m_launched)
+            LogicError("OnGradientReady: Gradient matrix was reported after its aggregation had started.");
+        bucket.m_numReady++;
+
+        while (m_numBucketsLaunched < m_buckets.size() && m_buckets[m_numBucketsLaunched]->m_numReady == m_buckets[m_numBucketsLaunched]->m_gradients.size())
+            LaunchBucket(*m_buckets[m_numBucketsLaunched]);
+    }
+
+    void WaitForGradient(Matrix<ElemType>* gradient) override
+    {
+        if (m_buckets.empty())
+            return;
+
+        if (!m_overlappedRoundAggregated)
+            LogicError("WaitForGradient: Called before AggregateGradients().");
+        auto iter = m_bucketIndex.find(gradient);
+        if (iter == m_bucketIndex.end())
+            LogicError("WaitForGradient: Gradient matrix was not passed to EnableOverlappedAggregation().");
+        auto& bucket = *m_buckets[iter->second];
+        if (bucket.m_completed)
+            return;
+
+        m_mpi->Wait(&bucket.m_request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+        bucket.m_completed = true;
+
+        ElemType* reducedData = bucket.m_buffer ? bucket.m_buffer->Data() : bucket.m_gradients[0]->Data();
+        if (bucket.m_gpuDataTransferer)
+        {
+            bucket.m_gpuDataTransferer->CopyCPUToGPUAsync(bucket.m_intermediateCPUBuffer.get(), bucket.m_numElements, reducedData);
+            bucket.m_gpuDataTransferer->WaitForCopyCPUToGPUAsync();
+        }
+
+        if (bucket.m_buffer)
+        {
+            size_t offset = 0;
+            for (auto bucketGradient : bucket.m_gradients)
+            {
+                bucketGradient->AssignValuesOf(bucket.m_buffer->ColumnSlice(offset, bucketGradient->GetNumElements()).Reshaped(bucketGradient->GetNumRows(), bucketGradient->GetNumCols()));
+                offset += bucketGradient->GetNumElements();
+            }
+        }
+    }
+
+    void FinishOverlappedAggregation() override
+    {
+        if (!m_buckets.empty())
+            FinishOverlappedRound();
+    }
+
 private:
+    // gradients that are all-reduced together when overlapping aggregation with backprop
+    struct GradientBucket
+    {
+        GradientBucket()
+            : m_numElements(0), m_numReady(0), m_launched(false), m_completed(false)
+        {}
+
+        std::vector<Matrix<ElemType>*> m_gradients;
+        size_t m_numElements;
+        std::unique_ptr<Matrix<ElemType>> m_buffer; // packed gradients; null for a single gradient, which is reduced in place
+        std::unique_ptr<GPUDataTransferer> m_gpuDataTransferer;
+        std::shared_ptr<ElemType> m_intermediateCPUBuffer;
+        size_t m_numReady;
+        bool m_launched;
+        bool m_completed;
+        MPI_Request m_request;
+    };
+
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -157,6 +292,17 @@ private:
         if (!m_initialized)
         {
             m_initialized = true;
+
+            if (m_mpi->IsMainNode())
+            {
+                for (size_t i = 0; i < NumProc() - 1; ++i)
+                    m_recvHeaders.push_back(DistGradHeader::Create(numEvalNodes));
+            }
+
+            // With overlapped aggregation, the buckets take the place of the buffers below.
+            if (!m_buckets.empty())
+                return;
+
             int deviceId = gradients[0]->GetDeviceId();
 
             // Initial preparation for data copy from GPU to CPU
@@ -225,12 +371,6 @@ private:
                 m_bufferedGradHeader = DistGradHeader::Create(numEvalNodes);
                 m_bufferedGradHeader->Clear();
             }
-
-            if (m_mpi->IsMainNode())
-            {
-                for (size_t i = 0; i < NumProc() - 1; ++i)
-                    m_recvHeaders.push_back(DistGradHeader::Create(numEvalNodes));
-            }
         }
         else if (resetState)
         {
@@ -249,6 +389,90 @@ private:
         }
     }
 
+    // Starts the all-reduce of a bucket whose gradients are final.
+    void LaunchBucket(GradientBucket& bucket)
+    {
+        ElemType* reductionBuffer = bucket.m_gradients[0]->Data();
+        if (bucket.m_buffer)
+        {
+            size_t offset = 0;
+            for (auto gradient : bucket.m_gradients)
+            {
+                bucket.m_buffer->ColumnSlice(offset, gradient->GetNumElements()).AssignValuesOf(gradient->Reshaped(1, gradient->GetNumElements()));
+                offset += gradient->GetNumElements();
+            }
+            reductionBuffer = bucket.m_buffer->Data();
+        }
+
+        if (bucket.m_gpuDataTransferer)
+        {
+            bucket.m_gpuDataTransferer->CopyGPUToCPUAsync(reductionBuffer, bucket.m_numElements, bucket.m_intermediateCPUBuffer.get());
+            bucket.m_gpuDataTransferer->WaitForCopyGPUToCPUAsync();
+            reductionBuffer = bucket.m_intermediateCPUBuffer.get();
+        }
+
+        m_mpi->Iallreduce(MPI_IN_PLACE, reductionBuffer, (int)bucket.m_numElements, MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, &bucket.m_request) || MpiFail("MPI_Iallreduce");
+        bucket.m_launched = true;
+        m_numBucketsLaunched++;
+    }
+
+    // Completes all outstanding all-reduces, without using their results, and gets ready for the next minibatch.
+    void FinishOverlappedRound()
+    {
+        for (auto& bucket : m_buckets)
+        {
+            if (bucket->m_launched && !bucket->m_completed)
+                m_mpi->Wait(&bucket->m_request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            bucket->m_numReady = 0;
+            bucket->m_launched = false;
+            bucket->m_completed = false;
+        }
+        m_numBucketsLaunched = 0;
+        m_overlappedRoundAggregated = false;
+    }
+
+    // Starts the all-reduce of the buckets that backprop did not get to (e.g. because there was no data), and
+    // aggregates the header. The gradients are only waited for in WaitForGradient().
+    void AggregateGradientsOverlapped(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        if (m_overlappedRoundAggregated)
+            FinishOverlappedRound();
+
+        // If the current node did not process any samples, the gradients should be zero'd
+        if (headerCPU->numSamples == 0)
+        {
+            for (size_t i = m_numBucketsLaunched; i < m_buckets.size(); i++)
+            {
+                for (auto gradient : m_buckets[i]->m_gradients)
+                    gradient->SetValue(0);
+            }
+        }
+
+        std::vector<MPI_Request> recvHeaderRequests;
+        MPI_Request sendHeaderRequest;
+        StartHeaderAggregation(headerCPU, m_recvHeaders, (int)gradients.size(), recvHeaderRequests, sendHeaderRequest);
+
+        while (m_numBucketsLaunched < m_buckets.size())
+            LaunchBucket(*m_buckets[m_numBucketsLaunched]);
+
+        FinishHeaderAggregation(headerCPU, m_recvHeaders, recvHeaderRequests);
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+
+        m_overlappedRoundAggregated = true;
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Actual gradient aggregation time (after backprop, excluding waits for buckets): %.6g\n", gradientAggregationTime);
+        }
+    }
+
     void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
         Timer aggregationTimer;
@@ -309,22 +533,10 @@ private:
             }
         }
 
-        // Initiate receive of the header on the main node
-        std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
-        if (m_mpi->IsMainNode())
-        {
-            for (size_t j = 0; j < NumProc() - 1; ++j)
-            {
-                int source = (j >= MyRank()) ? (j + 1) : j;
-                // We use a tag of 'numGradMatrices' for the pre-aggregation header
-                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
-            }
-        }
-
-        // Send the headers from all nodes but the main node
+        // Initiate the transfer of the headers to the main node. We use a tag of 'numGradMatrices' for the pre-aggregation header
+        std::vector<MPI_Request> recvHeaderRequests;
         MPI_Request sendHeaderRequest;
-        if (!m_mpi->IsMainNode())
-            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+        StartHeaderAggregation(headerCPU, m_recvHeaders, (int)numGradMatrices, recvHeaderRequests, sendHeaderRequest);
 
         // Perform async allreduce on the gradient data
         std::vector<MPI_Request> allReduceRequests;
@@ -365,29 +577,7 @@ private:
             m_nccl.AllReduce(ncclReduceGradients);
         }
 
-        // On the main node wait for the headers to arrive and aggregate
-        if (m_mpi->IsMainNode())
-        {
-            size_t numNodesHeadersReceivedFrom = 0;
-            while (numNodesHeadersReceivedFrom < (NumProc() - 1))
-            {
-                int idx = MPI_UNDEFINED;
-                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
-                if (idx == MPI_UNDEFINED)
-                {
-                    break;
-                }
-
-                numNodesHeadersReceivedFrom++;
-
-                headerCPU->Aggregate(m_recvHeaders[idx], true);
-            }
-
-            assert(numNodesHeadersReceivedFrom == (NumProc() - 1));
-        }
-
-        // Broadcast the aggregated header to all nodes
-        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+        FinishHeaderAggregation(headerCPU, m_recvHeaders, recvHeaderRequests);
 
         if (m_nccl.IsSupported())
         {
@@ -463,6 +653,14 @@ private:
     std::vector<size_t> m_packedGradientsIndex;
     std::vector<size_t> m_gradientIndexToAggregate;
 
+    // Overlapped aggregation (see EnableOverlappedAggregation()). Buckets are launched in order; a round starts
+    // with the first gradient that backprop reports and ends when the next one starts.
+    const size_t m_bucketSizeInBytes;
+    std::vector<std::unique_ptr<GradientBucket>> m_buckets;
+    std::unordered_map<Matrix<ElemType>*, size_t> m_bucketIndex;
+    size_t m_numBucketsLaunched;
+    bool m_overlappedRoundAggregated; // AggregateGradients() was called for the current round
+
     int m_syncStatsTrace;
 
     // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
@@ -0,0 +1,228 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "TimerUtility.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Aggregates the gradients by exchanging only their largest entries. Every node adds its gradient to the residual
+// of the entries it did not send before, sends the selected entries of the sum as (index, value) pairs, and keeps
+// the rest as the new residual (error feedback, as the outResidual of the 1-bit quantizer). The entries are either
+// the 'ratio' fraction of each gradient with the largest magnitude (top-k), or the ones with a magnitude of at
+// least 'threshold'. After aggregation every node holds the sum of the sparse gradients of all nodes.
+template <class ElemType>
+class SparseDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    SparseDistGradAggregator(const MPIWrapperPtr& mpi, int syncStatsTrace, double ratio, double threshold)
+        : IDistGradAggregator<ElemType>(mpi), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_ratio(ratio), m_threshold(threshold)
+    {
+        if ((ratio > 0) == (threshold > 0))
+            InvalidArgument("SparseDistGradAggregator: Exactly one of the ratio and the threshold must be positive.");
+        if (ratio > 1)
+            InvalidArgument("SparseDistGradAggregator: The ratio of the gradient entries to send must not exceed 1.");
+    }
+
+    ~SparseDistGradAggregator()
+    {
+        for (size_t i = 0; i < m_recvHeaders.size(); ++i)
+            DistGradHeader::Destroy(m_recvHeaders[i]);
+    }
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) override
+    {
+        if (m_recvHeaders.empty() && m_mpi->IsMainNode())
+        {
+            for (size_t i = 0; i < NumProc() - 1; ++i)
+                m_recvHeaders.push_back(DistGradHeader::Create(headerCPU->numEvalNode));
+        }
+
+        // The residuals belong to the model state that is being discarded.
+        if (resetState)
+            m_residuals.clear();
+
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        // If the current node did not process any samples, the gradients should be zero'd
+        if (headerCPU->numSamples == 0)
+        {
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        // The entries are exchanged with int indices into the concatenation of all gradients.
+        size_t totalNumElements = 0;
+        for (auto gradient : gradients)
+        {
+            if (gradient->GetMatrixType() != DENSE)
+                RuntimeError("SparseDistGradAggregator: Only dense gradient matrices are supported.");
+            totalNumElements += gradient->GetNumElements();
+        }
+        if (totalNumElements > INT_MAX)
+            RuntimeError("SparseDistGradAggregator: The gradients have %llu elements in total, which exceeds the supported maximum of %d.", (unsigned long long)totalNumElements, INT_MAX);
+
+        std::vector<MPI_Request> recvHeaderRequests;
+        MPI_Request sendHeaderRequest;
+        StartHeaderAggregation(headerCPU, m_recvHeaders, (int)gradients.size(), recvHeaderRequests, sendHeaderRequest);
+
+        // Select the entries to send from every gradient.
+        m_sendIndices.clear();
+        m_sendValues.clear();
+        size_t offset = 0;
+        for (auto gradient : gradients)
+        {
+            SelectEntries(*gradient, offset);
+            offset += gradient->GetNumElements();
+        }
+
+        // Sparse all-gather: every node contributes the same number of entries, padded with an index of -1.
+        size_t numProc = NumProc();
+        size_t numSend = m_sendIndices.size();
+        m_recvCounts.resize(numProc);
+        m_mpi->AllGather(&numSend, 1, m_recvCounts.data(), 1);
+        size_t maxCount = *std::max_element(m_recvCounts.begin(), m_recvCounts.end());
+        m_sendIndices.resize(maxCount, -1);
+        m_sendValues.resize(maxCount, 0);
+        m_recvIndices.resize(maxCount * numProc);
+        m_recvValues.resize(maxCount * numProc);
+        if (maxCount > 0)
+        {
+            m_mpi->AllGather(m_sendIndices.data(), maxCount, m_recvIndices.data(), maxCount);
+            m_mpi->AllGather(m_sendValues.data(), maxCount, m_recvValues.data(), maxCount);
+        }
+
+        // Sort the received entries by index, so that they can be summed into the gradients one gradient at a time.
+        m_order.resize(m_recvIndices.size());
+        for (size_t j = 0; j < m_order.size(); ++j)
+            m_order[j] = j;
+        std::sort(m_order.begin(), m_order.end(), [this](size_t a, size_t b) { return m_recvIndices[a] < m_recvIndices[b]; });
+
+        size_t next = 0;
+        while (next < m_order.size() && m_recvIndices[m_order[next]] < 0)
+            next++;
+        offset = 0;
+        for (auto gradient : gradients)
+        {
+            size_t numElements = gradient->GetNumElements();
+            ElemType* data = BeginAccess(*gradient);
+            std::fill(data, data + numElements, (ElemType)0);
+            for (; next < m_order.size() && (size_t)m_recvIndices[m_order[next]] < offset + numElements; next++)
+                data[m_recvIndices[m_order[next]] - offset] += m_recvValues[m_order[next]];
+            EndAccess(*gradient);
+            offset += numElements;
+        }
+
+        FinishHeaderAggregation(headerCPU, m_recvHeaders, recvHeaderRequests);
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g, sent %d of %d gradient entries (%.4g%%).\n",
+                    gradientAggregationTime, (int)numSend, (int)totalNumElements, totalNumElements ? (100.0 * numSend / totalNumElements) : 0.0);
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    // Adds the gradient to its residual, moves the selected entries of the sum to the send buffers, and leaves the
+    // rest in the residual.
+    void SelectEntries(Matrix<ElemType>& gradient, size_t offset)
+    {
+        size_t numElements = gradient.GetNumElements();
+        auto& residual = m_residuals[&gradient];
+        if (residual.size() != numElements)
+            residual.assign(numElements, 0);
+
+        const ElemType* data = BeginAccess(gradient); // read only, so no EndAccess()
+        for (size_t i = 0; i < numElements; ++i)
+            residual[i] += data[i];
+
+        size_t firstSent = m_sendIndices.size();
+        if (m_ratio > 0)
+        {
+            size_t k = std::min(numElements, std::max((size_t)1, (size_t)std::ceil(m_ratio * numElements)));
+            if (numElements == 0)
+                k = 0;
+            m_order.resize(numElements);
+            for (size_t i = 0; i < numElements; ++i)
+                m_order[i] = i;
+            if (k < numElements)
+                std::nth_element(m_order.begin(), m_order.begin() + k, m_order.end(), [&residual](size_t a, size_t b) { return std::abs(residual[a]) > std::abs(residual[b]); });
+            for (size_t j = 0; j < k; ++j)
+                m_sendIndices.push_back((int)(offset + m_order[j]));
+        }
+        else
+        {
+            for (size_t i = 0; i < numElements; ++i)
+            {
+                if (std::abs(residual[i]) >= m_threshold)
+                    m_sendIndices.push_back((int)(offset + i));
+            }
+        }
+
+        for (size_t j = firstSent; j < m_sendIndices.size(); ++j)
+        {
+            ElemType& value = residual[m_sendIndices[j] - offset];
+            m_sendValues.push_back(value);
+            value = 0;
+        }
+    }
+
+    // Returns a CPU pointer to the gradient's elements; for gradients on the GPU, a copy that EndAccess() writes back.
+    ElemType* BeginAccess(Matrix<ElemType>& gradient)
+    {
+        if (gradient.GetDeviceId() == CPUDEVICE)
+            return gradient.Data();
+
+        m_stagingBuffer.resize(gradient.GetNumElements());
+        gradient.CopySection(gradient.GetNumRows(), gradient.GetNumCols(), m_stagingBuffer.data(), gradient.GetNumRows());
+        return m_stagingBuffer.data();
+    }
+
+    void EndAccess(Matrix<ElemType>& gradient)
+    {
+        if (gradient.GetDeviceId() != CPUDEVICE)
+            gradient.SetValue(gradient.GetNumRows(), gradient.GetNumCols(), gradient.GetDeviceId(), m_stagingBuffer.data());
+    }
+
+    std::vector<DistGradHeader*> m_recvHeaders;
+
+    // The entries of every gradient that have not been sent yet.
+    std::unordered_map<Matrix<ElemType>*, std::vector<ElemType>> m_residuals;
+
+    std::vector<int> m_sendIndices;
+    std::vector<ElemType> m_sendValues;
+    std::vector<size_t> m_recvCounts;
+    std::vector<int> m_recvIndices;
+    std::vector<ElemType> m_recvValues;
+    std::vector<size_t> m_order;
+    std::vector<ElemType> m_stagingBuffer;
+
+    int m_syncStatsTrace;
+    size_t m_iterationCount;
+
+    double m_ratio;
+    double m_threshold;
+};
+
+} } }
@@ -7,6 +7,7 @@
 #include "ComputationNode.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -415,5 +416,69 @@ BOOST_AUTO_TEST_CASE(EvalRNNTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalPoolConcurrentTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    const size_t numWorkers = 3;
+    const size_t numClients = 6;
+    const size_t numPasses = 50;
+
+    IEvaluateModelExtended<float> *eval;
+    GetEvalExtendedPoolF(&eval);
+    eval->Init("numCPUThreads=1 numEvalWorkers=" + std::to_string(numWorkers));
+    eval->CreateNetwork(modelDefinition);
+
+    VariableSchema outputLayouts = eval->GetOutputSchema();
+    eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+    outputLayouts = eval->GetOutputSchema();
+
+    // Every client evaluates its own inputs, and all run at the same time.
+    std::vector<size_t> numCorrect(numClients, 0);
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < numClients; c++)
+    {
+        clients.emplace_back([&, c]
+        {
+            Values<float> inputBuffer(1);
+            Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+            for (size_t pass = 0; pass < numPasses; pass++)
+            {
+                float x = (float)(c * numPasses + pass);
+                inputBuffer[0].m_buffer = { x, 1, 2, 3 };
+                eval->ForwardPass(inputBuffer, outputBuffer);
+                if (outputBuffer[0].m_buffer.size() == 1 && outputBuffer[0].m_buffer[0] == 2 * (x + 6))
+                    numCorrect[c]++;
+            }
+        });
+    }
+    for (auto& client : clients)
+        client.join();
+
+    for (size_t c = 0; c < numClients; c++)
+        BOOST_CHECK_EQUAL(numCorrect[c], numPasses);
+
+    // Errors of a worker are passed on to the caller.
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 1, 2, 3 };
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputBuffer, outputBuffer), std::exception);
+
+    // The recurrent state cannot be carried over when the calls go to different workers.
+    inputBuffer[0].m_buffer = { 1, 2, 3, 4 };
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputBuffer, outputBuffer, false), std::exception);
+
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
@@ -323,6 +323,180 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationBackward)
     }
 }
 
+// Batch normalization of column-major data in double precision, with the semantics of the CNTK engines
+// (see ComputeBatchMeanAndInvStdDev in CntkBatchNormalization.cuh). For inferenceOnly, only out is computed.
+static void BatchNormalizationForwardReference(const vec& x, size_t crow, size_t ccol, const vec& scale, const vec& bias,
+                                               bool inferenceOnly, double expAvgFactor, double blendFactor, vec& runMean, vec& runVariance,
+                                               double eps, vec& out, vec& savedMean, vec& savedInvStdDev)
+{
+    size_t numChannels = scale.size();
+    size_t spatialSize = crow / numChannels;
+    size_t m = spatialSize * ccol;
+    out.resize(crow * ccol);
+    savedMean.resize(numChannels);
+    savedInvStdDev.resize(numChannels);
+    for (size_t c = 0; c < numChannels; c++)
+    {
+        auto at = [&](size_t j, size_t k) { return j * crow + c * spatialSize + k; };
+        double mean, invStdDev;
+        if (inferenceOnly)
+        {
+            mean = runMean[c];
+            invStdDev = 1 / sqrt(runVariance[c] + eps);
+        }
+        else
+        {
+            double sum = 0, sumOfSquares = 0;
+            for (size_t j = 0; j < ccol; j++)
+                for (size_t k = 0; k < spatialSize; k++)
+                    sum += x[at(j, k)];
+            double mbMean = sum / m;
+            for (size_t j = 0; j < ccol; j++)
+                for (size_t k = 0; k < spatialSize; k++)
+                    sumOfSquares += (x[at(j, k)] - mbMean) * (x[at(j, k)] - mbMean);
+            runMean[c] = (float)(expAvgFactor * mbMean + (1 - expAvgFactor) * runMean[c]);
+            runVariance[c] = (float)(expAvgFactor * (m > 1 ? sumOfSquares / (m - 1) : 0) + (1 - expAvgFactor) * runVariance[c]);
+            mean = blendFactor * runMean[c] + (1 - blendFactor) * mbMean;
+            invStdDev = blendFactor / sqrt(runVariance[c] + eps) + (1 - blendFactor) / sqrt(sumOfSquares / m + eps);
+            savedMean[c] = (float)mean;
+            savedInvStdDev[c] = (float)invStdDev;
+        }
+        for (size_t j = 0; j < ccol; j++)
+            for (size_t k = 0; k < spatialSize; k++)
+                out[at(j, k)] = (float)(scale[c] * (x[at(j, k)] - mean) * invStdDev + bias[c]);
+    }
+}
+
+// Gradients of the batch normalization in double precision (see kBackpropagateBatchNormGradients in
+// CntkBatchNormalization.cuh). The data gradient is added to dx.
+static void BatchNormalizationBackwardReference(const vec& x, const vec& dy, size_t crow, size_t ccol, const vec& scale, double blendFactor,
+                                                const vec& savedMean, const vec& savedInvStdDev, vec& dx, vec& dScale, vec& dBias)
+{
+    size_t numChannels = scale.size();
+    size_t spatialSize = crow / numChannels;
+    size_t m = spatialSize * ccol;
+    dScale.resize(numChannels);
+    dBias.resize(numChannels);
+    for (size_t c = 0; c < numChannels; c++)
+    {
+        auto at = [&](size_t j, size_t k) { return j * crow + c * spatialSize + k; };
+        double ds = 0, db = 0;
+        for (size_t j = 0; j < ccol; j++)
+            for (size_t k = 0; k < spatialSize; k++)
+            {
+                ds += dy[at(j, k)] * (x[at(j, k)] - savedMean[c]) * savedInvStdDev[c];
+                db += dy[at(j, k)];
+            }
+        dScale[c] = (float)ds;
+        dBias[c] = (float)db;
+        for (size_t j = 0; j < ccol; j++)
+            for (size_t k = 0; k < spatialSize; k++)
+            {
+                double xHat = (x[at(j, k)] - savedMean[c]) * savedInvStdDev[c];
+                dx[at(j, k)] += (float)(scale[c] * savedInvStdDev[c] * (dy[at(j, k)] - (1 - blendFactor) * (xHat * ds + db) / m));
+            }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BatchNormalizationCpuEngine)
+{
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+    auto randomVector = [&](size_t n)
+    {
+        vec v(n);
+        std::generate(begin(v), end(v), [&] { return nd(rng); });
+        return v;
+    };
+
+    // (shape, spatial): non-spatial with more rows than one block of the engine, spatial with small and
+    // large spatial dimensions, and spatial with a spatial size of 1.
+    std::vector<std::pair<TensorShape, bool>> shapes = {
+        { TensorShape(6), false }, { TensorShape(300), false }, { TensorShape(2, 2, 2), false },
+        { TensorShape(5, 3, 4), true }, { TensorShape(11, 11, 13), true }, { TensorShape(8), true } };
+    // (inferenceOnly, expAvgFactor, blendFactor)
+    std::vector<std::tuple<bool, double, double>> modes = {
+        std::make_tuple(true, 0.0, 1.0), std::make_tuple(false, 1.0, 0.0), std::make_tuple(false, 0.1, 0.0),
+        std::make_tuple(false, 0.1, 0.5), std::make_tuple(false, 0.0, 1.0) };
+    double eps = 1e-5;
+
+    for (const auto& shape : shapes)
+    for (size_t batchSize : { 1, 7, 32 })
+    for (const auto& mode : modes)
+    {
+        const auto& inOutT = shape.first;
+        bool spatial = shape.second;
+        bool inferenceOnly = std::get<0>(mode);
+        double expAvg = std::get<1>(mode);
+        double blendFactor = std::get<2>(mode);
+
+        auto eng = BNEng::Create(CPUDEVICE, inOutT, spatial, ImageLayoutKind::CHW, BatchNormEngineKind::Cntk);
+
+        size_t crow = inOutT.GetNumElements();
+        size_t ccol = batchSize;
+        size_t crowScaleBias = spatial ? inOutT[inOutT.GetRank() - 1] : inOutT.GetNumElements();
+
+        vec xData = randomVector(crow * ccol);
+        vec scaleData = randomVector(crowScaleBias);
+        vec biasData = randomVector(crowScaleBias);
+        vec runMeanData = randomVector(crowScaleBias);
+        vec runVarianceData = randomVector(crowScaleBias);
+        for (auto& v : runVarianceData)
+            v = v * v;
+
+        SingleMatrix x(crow, ccol, xData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix scale(crowScaleBias, 1, scaleData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix bias(crowScaleBias, 1, biasData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix runMean(crowScaleBias, 1, runMeanData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix runVariance(crowScaleBias, 1, runVarianceData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix out(crow, ccol, CPUDEVICE);
+        SingleMatrix saveMean(CPUDEVICE);
+        SingleMatrix saveInvStdDev(CPUDEVICE);
+
+        eng->Forward(x, scale, bias, inferenceOnly, expAvg, blendFactor, runMean, runVariance, out, eps, saveMean, saveInvStdDev);
+
+        vec outRef, saveMeanRef, saveInvStdDevRef;
+        BatchNormalizationForwardReference(xData, crow, ccol, scaleData, biasData, inferenceOnly, expAvg, blendFactor,
+                                           runMeanData, runVarianceData, eps, outRef, saveMeanRef, saveInvStdDevRef);
+
+        std::stringstream tmsg;
+        tmsg << "inOut tensor: " << (std::string)inOutT << ", spatial = " << (spatial ? "true" : "false") << ", batch size = " << batchSize
+             << ", inferenceOnly = " << inferenceOnly << ", expAvg = " << expAvg << ", blendFactor = " << blendFactor;
+        std::string msg = " are not equal, " + tmsg.str();
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        auto reference = [](const vec& data, size_t r, size_t c) { return SingleMatrix(r, c, const_cast<float*>(data.data()), CPUDEVICE, matrixFlagNormal); };
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, reference(outRef, crow, ccol), emsg, relErr * 10, absErr * 10), "out" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(runMean, reference(runMeanData, crowScaleBias, 1), emsg, relErr, absErr), "runMean" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(runVariance, reference(runVarianceData, crowScaleBias, 1), emsg, relErr, absErr), "runVariance" << msg << ". " << emsg);
+        if (inferenceOnly)
+        {
+            BOOST_REQUIRE_MESSAGE(saveMean.IsEmpty() && saveInvStdDev.IsEmpty(), "saved statistics must not be produced in inference mode, " << tmsg.str());
+            continue;
+        }
+        BOOST_REQUIRE_MESSAGE(CheckEqual(saveMean, reference(saveMeanRef, crowScaleBias, 1), emsg, relErr, absErr), "saveMean" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(saveInvStdDev, reference(saveInvStdDevRef, crowScaleBias, 1), emsg, relErr * 10, absErr * 10), "saveInvStdDev" << msg << ". " << emsg);
+
+        vec dyData = randomVector(crow * ccol);
+        vec dxData = randomVector(crow * ccol);
+        SingleMatrix dy(crow, ccol, dyData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix dx(crow, ccol, dxData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix dScale(crowScaleBias, 1, CPUDEVICE);
+        SingleMatrix dBias(crowScaleBias, 1, CPUDEVICE);
+
+        eng->Backward(x, dy, dx, scale, blendFactor, saveMean, saveInvStdDev, dScale, dBias);
+
+        vec dScaleRef, dBiasRef;
+        BatchNormalizationBackwardReference(xData, dyData, crow, ccol, scaleData, blendFactor, saveMeanRef, saveInvStdDevRef, dxData, dScaleRef, dBiasRef);
+
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dx, reference(dxData, crow, ccol), emsg, relErr * 16, absErr * 32), "dx" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dScale, reference(dScaleRef, crowScaleBias, 1), emsg, relErr * 16, absErr * 16), "dScale" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dBias, reference(dBiasRef, crowScaleBias, 1), emsg, relErr * 16, absErr * 16), "dBias" << msg << ". " << emsg);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/BlockMultiplier.h"
+#include "../../../Source/Math/BlockMultiplierEngine.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace TEST {
 
@@ -185,5 +186,51 @@ BOOST_AUTO_TEST_CASE(BlockMultiplyTestAllKFourRowsMultiThread)
     TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(4, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
 }
 
+// The AVX2 block handler is only built if all code is compiled for AVX2.
+#ifdef SUPPORT_AVX2
+static const bool c_avx2BlockHandlerBuilt = true;
+#else
+static const bool c_avx2BlockHandlerBuilt = false;
+#endif
+
+// The engine with either block handler, with a prepared B that is used for several products
+BOOST_AUTO_TEST_CASE(BlockMultiplierEngineTest)
+{
+    const int k = 128 + 64 + 32 + 16 + 8 + 1, n = 5;
+    int ompThreads = omp_get_max_threads();
+
+    ReferenceMultiplier<int16_t, int16_t, int32_t> refMult;
+    std::vector<int16_t> B(k * n);
+    RandInitIntMatrix<int16_t>(B.data(), k, n, 63);
+
+    for (auto instructionSet : { CPUInstructionSet::Generic, CPUInstructionSet::AVX2 })
+    {
+        auto engine = BlockMultiplierEngine::Create(instructionSet, 2);
+        if (!engine)
+        {
+            BOOST_CHECK(GetSupportedCPUInstructionSet() < instructionSet || !c_avx2BlockHandlerBuilt);
+            continue;
+        }
+        BOOST_CHECK(engine->GetInstructionSet() == instructionSet);
+        engine->PrepareB(B.data(), k, n);
+
+        for (int m : { 1, 7, 8 })
+        {
+            std::vector<int16_t> A(m * k);
+            RandInitIntMatrix<int16_t>(A.data(), m, k, 63);
+            std::vector<int32_t> refC(m * n), testC(m * n, -1);
+            refMult.MultiplyMatrices(A.data(), m, k, B.data(), n, refC.data());
+            engine->Multiply(A.data(), m, testC.data());
+            CompareMatricesAndDump(refC.data(), testC.data(), m, k, n);
+        }
+    }
+
+    // The engine picks the best handler, and leaves the OpenMP settings alone.
+    auto engine = BlockMultiplierEngine::Create();
+    bool useAVX2 = c_avx2BlockHandlerBuilt && GetSupportedCPUInstructionSet() >= CPUInstructionSet::AVX2;
+    BOOST_CHECK(engine->GetInstructionSet() == (useAVX2 ? CPUInstructionSet::AVX2 : CPUInstructionSet::Generic));
+    BOOST_CHECK_EQUAL(omp_get_max_threads(), ompThreads);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}} //end namespaces
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/RNNCommon.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -1087,6 +1088,125 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherFromTarget, RandomSeedFixture)
     BOOST_CHECK(m2.IsEqualTo(expect, 1e-6));
 }
 
+// Reference single-layer, unidirectional LSTM in the cuDNN parameter layout, one sequence at a time.
+static void ReferenceLSTM(const DMatrix& w, const DMatrix& x, size_t hidden, const vector<size_t>& numSequencesForFrame, DMatrix& y)
+{
+    const size_t xDim = x.GetNumRows();
+    const size_t gateDim = 4 * hidden;
+    const double* W = w.Data();
+    const double* R = W + xDim * gateDim;
+    const double* bW = R + hidden * gateDim;
+    const double* bR = bW + gateDim;
+    auto sigmoid = [](double v) { return 1 / (1 + exp(-v)); };
+
+    y.Resize(hidden, x.GetNumCols());
+    vector<size_t> frameOffsets;
+    size_t offset = 0;
+    for (auto n : numSequencesForFrame)
+    {
+        frameOffsets.push_back(offset);
+        offset += n;
+    }
+    for (size_t j = 0; j < numSequencesForFrame[0]; j++)
+    {
+        vector<double> h(hidden, 0), c(hidden, 0), a(gateDim);
+        for (size_t t = 0; t < numSequencesForFrame.size() && j < numSequencesForFrame[t]; t++)
+        {
+            const size_t col = frameOffsets[t] + j;
+            for (size_t g = 0; g < gateDim; g++)
+            {
+                a[g] = bW[g] + bR[g];
+                for (size_t k = 0; k < xDim; k++)
+                    a[g] += W[g * xDim + k] * x(k, col);
+                for (size_t k = 0; k < hidden; k++)
+                    a[g] += R[g * hidden + k] * h[k];
+            }
+            for (size_t k = 0; k < hidden; k++)
+            {
+                c[k] = sigmoid(a[k + hidden]) * c[k] + sigmoid(a[k]) * tanh(a[k + 2 * hidden]);
+                h[k] = sigmoid(a[k + 3 * hidden]) * tanh(c[k]);
+                y(k, col) = h[k];
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNForwardLSTM, RandomSeedFixture)
+{
+    const size_t xDim = 5, hidden = 3;
+    const vector<size_t> numSequencesForFrame = { 3, 3, 2, 2, 1 }; // sequence lengths 5, 4, 2
+    RnnAttributes rnnAttributes(false, 1, hidden, L"lstm", -1);
+    auto numParameters = rnnAttributes.GetNumParameters(xDim);
+
+    DMatrix w(numParameters.first, numParameters.second);
+    w.SetUniformRandomValue(-0.5, 0.5, IncrementCounter());
+    DMatrix x(xDim, 11);
+    x.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    DMatrix y, reserve, workspace;
+    y.RNNForward(x, w, xDim, hidden, numSequencesForFrame, rnnAttributes, reserve, workspace);
+
+    DMatrix expected;
+    ReferenceLSTM(w, x, hidden, numSequencesForFrame, expected);
+    BOOST_CHECK(y.IsEqualTo(expected, 1e-10));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNGradients, RandomSeedFixture)
+{
+    const size_t xDim = 3, hidden = 4, numLayers = 2;
+    const vector<size_t> numSequencesForFrame = { 3, 3, 2, 1 }; // sequence lengths 4, 3, 2
+    const size_t numFrames = 9;
+    const double epsilon = 1e-6;
+
+    for (auto recurrentOp : { L"lstm", L"gru", L"rnnTanh", L"rnnReLU" })
+    {
+        for (bool bidirectional : { false, true })
+        {
+            RnnAttributes rnnAttributes(bidirectional, numLayers, hidden, recurrentOp, -1);
+            const size_t yDim = (bidirectional ? 2 : 1) * hidden;
+            auto numParameters = rnnAttributes.GetNumParameters(xDim);
+
+            DMatrix w(numParameters.first, numParameters.second);
+            w.SetUniformRandomValue(-0.5, 0.5, IncrementCounter());
+            DMatrix x(xDim, numFrames);
+            x.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DMatrix dy(yDim, numFrames); // the loss is sum(y .* dy)
+            dy.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+            DMatrix y, reserve, workspace;
+            y.RNNForward(x, w, xDim, yDim, numSequencesForFrame, rnnAttributes, reserve, workspace);
+            DMatrix dx(xDim, numFrames);
+            y.RNNBackwardData(dy, w, dx, rnnAttributes, reserve, workspace);
+            DMatrix dw(numParameters.first, numParameters.second);
+            dw.SetValue(0);
+            y.RNNBackwardWeights(x, y, dw, rnnAttributes, reserve, workspace);
+
+            auto loss = [&]()
+            {
+                DMatrix y1, reserve1, workspace1;
+                y1.RNNForward(x, w, xDim, yDim, numSequencesForFrame, rnnAttributes, reserve1, workspace1);
+                return DMatrix::InnerProductOfMatrices(y1, dy);
+            };
+            auto checkGradient = [&](DMatrix& m, const DMatrix& gradient)
+            {
+                for (size_t i = 0; i < m.GetNumElements(); i++)
+                {
+                    const double v = m.Data()[i];
+                    m.Data()[i] = v + epsilon;
+                    const double lossPlus = loss();
+                    m.Data()[i] = v - epsilon;
+                    const double lossMinus = loss();
+                    m.Data()[i] = v;
+                    const double numeric = (lossPlus - lossMinus) / (2 * epsilon);
+                    BOOST_CHECK_SMALL(numeric - gradient.Data()[i], 1e-6 + 1e-5 * fabs(numeric));
+                }
+            };
+            checkGradient(x, dx);
+            checkGradient(w, dw);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -116,6 +116,127 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAdd, RandomSeedFixture)
     }
 }
 
+// products of sparse matrices whose columns have very different numbers of nonzeros with dense matrices,
+// for all transpositions, compared with the dense products
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAddUnevenColumns, RandomSeedFixture)
+{
+    const size_t k = 300;
+    const size_t n = 40;
+    const size_t m = 70;
+
+    // every 8th column is dense, the others have about 1% nonzeros
+    DenseMatrix dmSparse(k, n);
+    dmSparse.SetUniformRandomValue(0, 1, IncrementCounter());
+    foreach_coord (row, col, dmSparse)
+        dmSparse(row, col) = (col % 8 == 0 || dmSparse(row, col) < 0.01) ? dmSparse(row, col) - 0.5 : 0;
+
+    DenseMatrix dmSparseT(n, k);
+    dmSparseT.AssignTransposeOf(dmSparse);
+
+    auto toSparse = [](const DenseMatrix& dm)
+    {
+        SparseMatrix sm(MatrixFormat::matrixFormatSparseCSC, dm.GetNumRows(), dm.GetNumCols(), 0);
+        foreach_coord (row, col, dm)
+        {
+            if (dm(row, col) != 0)
+                sm.SetValue(row, col, dm(row, col));
+        }
+        return sm;
+    };
+    SparseMatrix sm = toSparse(dmSparse);
+    SparseMatrix smT = toSparse(dmSparseT);
+
+    for (bool transposeA : { false, true })
+    {
+        for (bool transposeB : { false, true })
+        {
+            // dense * sparse: op(a) is m x k, op(b) is k x n
+            DenseMatrix dmA(transposeA ? k : m, transposeA ? m : k);
+            dmA.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DenseMatrix dmC(m, n);
+            dmC.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DenseMatrix dmExpected(dmC);
+
+            DenseMatrix::MultiplyAndWeightedAdd(0.5, dmA, transposeA, transposeB ? dmSparseT : dmSparse, transposeB, 0.7, dmExpected);
+            SparseMatrix::MultiplyAndWeightedAdd(0.5, dmA, transposeA, transposeB ? smT : sm, transposeB, 0.7, dmC);
+            BOOST_CHECK(dmC.IsEqualTo(dmExpected, c_epsilonFloatE4));
+
+            // sparse * dense: op(a) is n x k, op(b) is k x m
+            DenseMatrix dmB(transposeB ? m : k, transposeB ? k : m);
+            dmB.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DenseMatrix dmC2(n, m);
+            DenseMatrix dmExpected2(n, m);
+
+            DenseMatrix::MultiplyAndWeightedAdd(1, transposeA ? dmSparse : dmSparseT, transposeA, dmB, transposeB, 0, dmExpected2);
+            SparseMatrix::MultiplyAndWeightedAdd(1, transposeA ? sm : smT, transposeA, dmB, transposeB, 0, dmC2);
+            BOOST_CHECK(dmC2.IsEqualTo(dmExpected2, c_epsilonFloatE4));
+        }
+
+        // dense * sparse^T into a SparseBlockCol matrix, as for the gradient of a weight matrix
+        DenseMatrix dmA(transposeA ? n : m, transposeA ? m : n);
+        dmA.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix dmExpected(m, k);
+        DenseMatrix::MultiplyAndWeightedAdd(1, dmA, transposeA, dmSparse, true, 0, dmExpected);
+
+        SparseMatrix smBlockCol(MatrixFormat::matrixFormatSparseBlockCol, m, k, 0);
+        SparseMatrix::MultiplyAndAdd(1, dmA, transposeA, sm, true, smBlockCol);
+        foreach_coord (row, col, dmExpected)
+        {
+            BOOST_CHECK(abs(smBlockCol(row, col) - dmExpected(row, col)) < c_epsilonFloatE4);
+        }
+    }
+}
+
+// embedding lookup with one-hot vectors and its gradient, where some words occur several times, and some columns
+// (e.g. the gaps between sequences) have no word at all
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixOneHotEmbedding, RandomSeedFixture)
+{
+    const size_t dim = 20;
+    const size_t vocabSize = 1000;
+    const size_t noWord = vocabSize; // no word in the column
+    const std::vector<size_t> words = { noWord, 7, 999, 7, noWord, noWord, 0, 42, 7, 999, 3, noWord };
+    const size_t n = words.size();
+
+    DenseMatrix dmEmbedding(dim, vocabSize);
+    dmEmbedding.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    DenseMatrix dmOneHot(vocabSize, n);
+    dmOneHot.SetValue(0);
+    SparseMatrix smOneHot(MatrixFormat::matrixFormatSparseCSC, vocabSize, n, 0);
+    for (size_t col = 0; col < n; col++)
+    {
+        if (words[col] == noWord)
+            continue;
+        dmOneHot(words[col], col) = col == 2 ? 0.5 : 1; // not necessarily one
+        smOneHot.SetValue(words[col], col, dmOneHot(words[col], col));
+    }
+
+    for (double beta : { 0.0, 0.7, 1.0 })
+    {
+        DenseMatrix dmOutput(dim, n);
+        dmOutput.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix dmExpected(dmOutput);
+
+        DenseMatrix::MultiplyAndWeightedAdd(2, dmEmbedding, false, dmOneHot, false, beta, dmExpected);
+        SparseMatrix::MultiplyAndWeightedAdd(2, dmEmbedding, false, smOneHot, false, beta, dmOutput);
+        BOOST_CHECK(dmOutput.IsEqualTo(dmExpected, c_epsilonFloatE4));
+    }
+
+    // the gradient has one block for each distinct word, accumulated over its occurrences
+    DenseMatrix dmOutputGradient(dim, n);
+    dmOutputGradient.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix dmExpected(dim, vocabSize);
+    DenseMatrix::MultiplyAndWeightedAdd(1, dmOutputGradient, false, dmOneHot, true, 0, dmExpected);
+
+    SparseMatrix smGradient(MatrixFormat::matrixFormatSparseBlockCol, dim, vocabSize, 0);
+    SparseMatrix::MultiplyAndAdd(1, dmOutputGradient, false, smOneHot, true, smGradient);
+    BOOST_CHECK_EQUAL(smGradient.GetBlockSize(), 5);
+    foreach_coord (row, col, dmExpected)
+    {
+        BOOST_CHECK(abs(smGradient(row, col) - dmExpected(row, col)) < c_epsilonFloatE4);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixDoGatherColumnsOf, RandomSeedFixture)
 {
     const size_t m = 100;
@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include <algorithm>
 #include <array>
+#include <functional>
 #include <random>
 #include <numeric>
 #include <boost/random/normal_distribution.hpp>
@@ -14,6 +15,7 @@
 #include "../../../Source/Math/CPUMatrix.h"
 #include "../../../Source/Math/GPUMatrix.h"
 #include "../../../Source/Math/ConvolutionEngine.h"
+#include "../../../Source/Math/CPUConvolution.h"
 #include "../../../Source/Math/CuDnnFactories.h"
 #include "common.h"
 
@@ -62,6 +64,10 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Autotuned CPU engine restricted to the direct or the Winograd algorithms (the geometries they do not support use the reference engine).
+    res.push_back(std::make_tuple((ConvolutionEngineKind)((int)ConvolutionEngineKind::Direct | (int)ConvolutionEngineKind::Reference), -1, 0));
+    res.push_back(std::make_tuple((ConvolutionEngineKind)((int)ConvolutionEngineKind::Winograd | (int)ConvolutionEngineKind::Reference), -1, 0));
     return res;
 }
 
@@ -233,6 +239,136 @@ BOOST_AUTO_TEST_CASE(ConvolutionForward)
     }
 }
 
+// Compares the CPU forward algorithms that do not unroll the input (and the autotuned engine that uses them)
+// with the reference engine, so unlike the tests above it does not need a GPU.
+BOOST_AUTO_TEST_CASE(ConvolutionForwardCpu)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    auto geometries = GenerateConvTestConfigs();
+    // Channel and map counts that are not multiples of the block sizes, larger inputs and kernels, padding and strides.
+    for (size_t kernel : {3, 5})
+    {
+        for (size_t stride : {1, 2})
+        {
+            for (bool autoPad : {true, false})
+            {
+                geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(13, 10, 11),
+                    TensorShape(kernel, kernel, 11), TensorShape(19), TensorShape(stride, stride, 11),
+                    ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{autoPad, autoPad, false},
+                    TensorShape(0), TensorShape(0)));
+            }
+        }
+    }
+    // Explicit, asymmetric padding.
+    geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(9, 7, 16),
+        TensorShape(3, 3, 16), TensorShape(8), TensorShape(1, 1, 16),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(1, 1, 0), TensorShape(0, 1, 0)));
+
+    int deviceId = -1;
+    size_t tested = 0;
+    for (const auto& g : geometries)
+    {
+        CpuConvolutionDims dims;
+        if (!CpuConvolutionDims::TryGet(*g, dims))
+            continue;
+        tested++;
+
+        auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+        auto tunedEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::AllWithFastCpu);
+        // without GEMM, and on at most 2 samples at a time
+        auto fastEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 2, PoolKind::None,
+                                       (ConvolutionEngineKind)((int)ConvolutionEngineKind::Direct | (int)ConvolutionEngineKind::Winograd));
+        // deterministic algorithms must not depend on timings, i.e. use GEMM only
+        auto gemmEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Gemm);
+        auto deterministicEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::AllWithFastCpu, L"", /*forceDeterministicAlgorithms=*/true);
+
+        size_t n = batchSizeG(rng);
+        vec buf(g->InputShape().GetNumElements() * n);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        buf.resize(g->KernelShape().GetNumElements() * mapCount);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+        size_t crowOut = g->OutputShape().GetNumElements();
+        SingleMatrix outB(crowOut, n, deviceId);
+        SingleMatrix workspace(deviceId);
+        baseEng->Forward(in, kernel, outB, workspace);
+
+        std::stringstream tmsg;
+        tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+        std::string emsg;
+        // Rounding errors of the sums grow with the number of products (the algorithms sum in a different order than the reference engine).
+        float relErr = Err<float>::Rel * 16;
+        float absErr = Err<float>::Abs * 4 * g->KernelShape().GetNumElements();
+
+        // The output is surrounded by NaNs to detect writes outside of it.
+        auto check = [&](const std::string& name, float maxRelError, float maxAbsError, const std::function<void(SingleMatrix&)>& forward)
+        {
+            SingleMatrix outBuf(crowOut, 3 * n, deviceId);
+            outBuf.SetValue(std::numeric_limits<float>::quiet_NaN());
+            SingleMatrix out = outBuf.ColumnSlice(n, n);
+            forward(out);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, maxRelError, maxAbsError), name << " output is not equal, " << tmsg.str() << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CountNans(outBuf) == crowOut * 2 * n, name << " output has buffer overflow/underflow, " << tmsg.str());
+        };
+
+        check("Direct", relErr, absErr, [&](SingleMatrix& out)
+        {
+            workspace.Resize(1, CpuConvolution<float>::DirectWorkspaceSize(dims, n));
+            workspace.SetValue(std::numeric_limits<float>::quiet_NaN());
+            CpuConvolution<float>::Direct(dims, in.Data(), kernel.Data(), out.Data(), n, workspace.Data());
+        });
+        if (dims.IsWinogradCompatible())
+        {
+            for (size_t tileSize : {2, 4})
+            {
+                // The transforms add and subtract values of the size of the output, so small outputs have larger relative errors,
+                // which are even larger with F(4x4,3x3).
+                float scale = tileSize == 2 ? 4.0f : 32.0f;
+                check("Winograd" + std::to_string(tileSize), relErr * scale, absErr * scale, [&](SingleMatrix& out)
+                {
+                    workspace.Resize(1, CpuConvolution<float>::WinogradWorkspaceSize(dims, tileSize, n));
+                    workspace.SetValue(std::numeric_limits<float>::quiet_NaN());
+                    CpuConvolution<float>::Winograd(dims, tileSize, in.Data(), kernel.Data(), out.Data(), n, workspace.Data());
+                });
+            }
+        }
+        // Twice, for the autotuning and for the tuned algorithm.
+        for (int i = 0; i < 2; i++)
+        {
+            check("Autotuned engine", relErr * 32, absErr * 32, [&](SingleMatrix& out)
+            {
+                tunedEng->Forward(in, kernel, out, workspace);
+            });
+            check("Autotuned engine with limited workspace", relErr * 32, absErr * 32, [&](SingleMatrix& out)
+            {
+                fastEng->Forward(in, kernel, out, workspace);
+            });
+            size_t maxWorkspaceSize = CpuConvolution<float>::DirectWorkspaceSize(dims, std::min<size_t>(n, 2));
+            if (dims.IsWinogradCompatible())
+            {
+                for (size_t tileSize : {2, 4})
+                    maxWorkspaceSize = std::max(maxWorkspaceSize, CpuConvolution<float>::WinogradWorkspaceSize(dims, tileSize, std::min<size_t>(n, 2)));
+            }
+            BOOST_REQUIRE_MESSAGE(workspace.GetNumElements() <= maxWorkspaceSize, "Workspace is larger than needed for 2 samples, " << tmsg.str());
+        }
+
+        SingleMatrix outG(crowOut, n, deviceId);
+        SingleMatrix outD(crowOut, n, deviceId);
+        gemmEng->Forward(in, kernel, outG, workspace);
+        deterministicEng->Forward(in, kernel, outD, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(outD, outG, emsg, 0.0f, 0.0f), "Deterministic engine output is not that of the GEMM engine, " << tmsg.str() << ". " << emsg);
+    }
+    BOOST_REQUIRE(tested > 0);
+}
+
 BOOST_AUTO_TEST_CASE(ConvolutionBackwardData)
 {
     std::mt19937 rng(0);
@@ -114,5 +114,118 @@ BOOST_FIXTURE_TEST_CASE(AdaDeltaSparse, MatrixLearnerFixture)
     });
 }
 
+// tests that the CPU sparse updates, which only touch the columns of the gradient, catch up with the
+// skipped updates of a column once it is touched again, so that they end up with the dense results
+BOOST_FIXTURE_TEST_CASE(LazySparseUpdatesCatchUp, MatrixLearnerFixture)
+{
+    // columns with a gradient in each update, the last update touches all of them
+    std::vector<std::vector<size_t>> columns = { { 0, 5 }, { 1 }, { 5, 7 }, { 3 }, { 0, 3, 9 }, { 2 } };
+    columns.push_back({});
+    for (size_t col = 0; col < dim2; col++)
+        columns.back().push_back(col);
+
+    enum { momentumSGD, nesterov, fsAdagrad, adam, rmsProp };
+    for (int learner : { momentumSGD, nesterov, fsAdagrad, adam, rmsProp })
+    {
+        SingleMatrix smoothed(CPUDEVICE), smoothedSparse(CPUDEVICE);
+        SingleMatrix model = SingleMatrix::RandomGaussian(dim1, dim2, CPUDEVICE, -1.0f, 1.0f, IncrementCounter());
+        SingleMatrix modelSparse(model.DeepClone());
+        if (learner == momentumSGD || learner == nesterov)
+        {
+            smoothed.Resize(dim1, dim2);
+            smoothed.SetValue(0);
+            smoothedSparse.Resize(dim1, dim2);
+            smoothedSparse.SetValue(0);
+        }
+        SparseUpdateHistory history;
+
+        for (size_t t = 0; t < columns.size(); t++)
+        {
+            // gradient = X * selection^T, where the selection puts the columns of X at the given columns
+            const size_t n = columns[t].size();
+            std::vector<float> selectionData(dim2 * n, 0.0f);
+            for (size_t k = 0; k < n; k++)
+                selectionData[k * dim2 + columns[t][k]] = 1.0f;
+            SingleMatrix selection(dim2, n, selectionData.data(), CPUDEVICE, matrixFlagNormal);
+            SingleMatrix selectionCSC(selection.DeepClone());
+            selectionCSC.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+            SingleMatrix x = SingleMatrix::RandomGaussian(dim1, n, CPUDEVICE, -1.0f, 1.0f, IncrementCounter());
+
+            SingleMatrix gradient(CPUDEVICE), gradientBSC(CPUDEVICE);
+            SingleMatrix::MultiplyAndWeightedAdd(1, x, false, selection, true, 0, gradient);
+            gradientBSC.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseBlockCol, false);
+            SingleMatrix::MultiplyAndAdd(x, false, selectionCSC, true, gradientBSC);
+
+            switch (learner)
+            {
+            case momentumSGD:
+                model.MomentumSGDUpdate(gradient, smoothed, 0.01f, 0.9f);
+                modelSparse.MomentumSGDUpdate(gradientBSC, smoothedSparse, 0.01f, 0.9f, true, &history);
+                break;
+            case nesterov:
+                model.NesterovAcceleratedMomentumSGDUpdate(gradient, smoothed, 0.01f, 0.9f);
+                modelSparse.NesterovAcceleratedMomentumSGDUpdate(gradientBSC, smoothedSparse, 0.01f, 0.9f, true, &history);
+                break;
+            case fsAdagrad:
+                smoothed.FSAdagradUpdate(gradient, model, 0.5, 0.01, 0.9, 0.99);
+                smoothedSparse.FSAdagradUpdate(gradientBSC, modelSparse, 0.5, 0.01, 0.9, 0.99, true, &history);
+                break;
+            case adam:
+                smoothed.AdamUpdate(gradient, model, t + 1.0, 0.01, 0.9, 0.99, 1e-8);
+                smoothedSparse.AdamUpdate(gradientBSC, modelSparse, t + 1.0, 0.01, 0.9, 0.99, 1e-8, true, false, &history);
+                break;
+            case rmsProp: // without the average multiplier, which the sparse update averages over the touched columns only
+                BOOST_CHECK_EQUAL(smoothed.RmsProp(gradient, 0.99f, 1.2f, 10.0f, 0.75f, 0.1f, false, t > 0), 1.0f);
+                BOOST_CHECK_EQUAL(smoothedSparse.RmsProp(gradientBSC, 0.99f, 1.2f, 10.0f, 0.75f, 0.1f, false, t > 0, &history), 1.0f);
+                SingleMatrix::ScaleAndAdd(-0.01f, gradient, model);
+                SingleMatrix::ScaleAndAdd(-0.01f, gradientBSC, modelSparse);
+                break;
+            }
+        }
+
+        // the dense momentum SGD includes the learning rate in the smoothed gradients, the sparse one does not
+        if (learner != momentumSGD && learner != nesterov)
+            BOOST_CHECK(smoothed.IsEqualTo(smoothedSparse, c_epsilonFloatE4));
+        BOOST_CHECK(model.IsEqualTo(modelSparse, c_epsilonFloatE4));
+    }
+}
+
+// tests that the sparse Adam catches up with a long run of skipped updates, which it stops replaying
+// once the rest of the momentum is below the precision of the weights
+BOOST_FIXTURE_TEST_CASE(LazySparseAdamCatchesUpLongGap, MatrixLearnerFixture)
+{
+    const size_t numUpdates = 500;
+    SingleMatrix smoothed(CPUDEVICE), smoothedSparse(CPUDEVICE);
+    SingleMatrix model = SingleMatrix::RandomGaussian(dim1, dim2, CPUDEVICE, -1.0f, 1.0f, IncrementCounter());
+    SingleMatrix modelSparse(model.DeepClone());
+    SparseUpdateHistory history;
+
+    for (size_t t = 0; t < numUpdates; t++)
+    {
+        // column 0 has a gradient in every update, column 1 only in the first and the last one
+        std::vector<size_t> columns = { 0 };
+        if (t == 0 || t + 1 == numUpdates)
+            columns.push_back(1);
+        const size_t n = columns.size();
+        std::vector<float> selectionData(dim2 * n, 0.0f);
+        for (size_t k = 0; k < n; k++)
+            selectionData[k * dim2 + columns[k]] = 1.0f;
+        SingleMatrix selection(dim2, n, selectionData.data(), CPUDEVICE, matrixFlagNormal);
+        SingleMatrix selectionCSC(selection.DeepClone());
+        selectionCSC.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+        SingleMatrix x = SingleMatrix::RandomGaussian(dim1, n, CPUDEVICE, -1.0f, 1.0f, IncrementCounter());
+
+        SingleMatrix gradient(CPUDEVICE), gradientBSC(CPUDEVICE);
+        SingleMatrix::MultiplyAndWeightedAdd(1, x, false, selection, true, 0, gradient);
+        gradientBSC.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseBlockCol, false);
+        SingleMatrix::MultiplyAndAdd(x, false, selectionCSC, true, gradientBSC);
+
+        smoothed.AdamUpdate(gradient, model, t + 1.0, 0.01, 0.9, 0.99, 1e-8);
+        smoothedSparse.AdamUpdate(gradientBSC, modelSparse, t + 1.0, 0.01, 0.9, 0.99, 1e-8, true, false, &history);
+    }
+
+    BOOST_CHECK(model.IsEqualTo(modelSparse, c_epsilonFloatE4));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "../../../Source/Math/QuantizedOperations.h"
 #include "../../../Source/Math/Helpers.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -50,6 +51,53 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
         BOOST_CHECK_EQUAL(round(C_upd[i]), C_expected_upd[i]);
 }
 
+BOOST_FIXTURE_TEST_CASE(BlockMultiplyMatchesMultiply, RandomSeedFixture)
+{
+    // A[m,k]*B[k,n] = C[m,n], with sizes that are not multiples of the block sizes
+    int m = 13, n = 6, k = 203;
+    std::vector<float> A(m*k), B(n*k), A2(m*k);
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (auto& a : A) a = dist(rng);
+    for (auto& b : B) b = dist(rng);
+    for (auto& a : A2) a = dist(rng);
+
+    // With this bit shift, the integer sums cannot overflow, so they are the same, and so are the results.
+    size_t bitShift = BlockQuantizedMultiplier<float>::SafeBitShift(k);
+    BOOST_CHECK_EQUAL(bitShift, 4);
+    shared_ptr<QuantizerBase<float, short>> quantA(new SymmetricQuantizer<float, short>(bitShift));
+    shared_ptr<QuantizerBase<float, short>> quantB(new SymmetricQuantizer<float, short>(bitShift));
+    shared_ptr<QuantizerBase<float, short>> blockQuantA(new SymmetricQuantizer<float, short>(bitShift));
+    shared_ptr<QuantizerBase<float, short>> blockQuantB(new SymmetricQuantizer<float, short>(bitShift));
+    QuantizedMultiplier<float> mult(quantA, true, quantB, false);
+    BlockQuantizedMultiplier<float> blockMult(blockQuantA, blockQuantB);
+
+    std::vector<float> C(m*n), blockC(m*n);
+    mult.Multiply(m, n, k, A.data(), B.data(), C.data());
+    for (int pass = 0; pass < 2; pass++)
+    {
+        blockMult.Multiply(m, n, k, A.data(), B.data(), blockC.data());
+        for (size_t i = 0; i < m*n; i++)
+            BOOST_CHECK_EQUAL(blockC[i], C[i]);
+    }
+
+    // Different weights are prepared again.
+    shared_ptr<QuantizerBase<float, short>> quantA2(new SymmetricQuantizer<float, short>(bitShift));
+    QuantizedMultiplier<float> mult2(quantA2, true, quantB, false);
+    mult2.Multiply(m, n, k, A2.data(), B.data(), C.data());
+    blockMult.Multiply(m, n, k, A2.data(), B.data(), blockC.data());
+    for (size_t i = 0; i < m*n; i++)
+        BOOST_CHECK_EQUAL(blockC[i], C[i]);
+
+    // So are weights that are written in place, once their new version is set.
+    std::copy(A.begin(), A.end(), A2.begin());
+    blockMult.SetVersionOfA(1);
+    blockMult.Multiply(m, n, k, A2.data(), B.data(), blockC.data());
+    mult.Multiply(m, n, k, A.data(), B.data(), C.data());
+    for (size_t i = 0; i < m*n; i++)
+        BOOST_CHECK_EQUAL(blockC[i], C[i]);
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
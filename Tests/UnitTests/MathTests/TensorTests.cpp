@@ -5,6 +5,7 @@
 //
 #include "stdafx.h"
 #include "TensorView.h"
+#include "CPUTensorKernels.h"
 #include "Sequences.h"
 #include "TensorTestsHelper.h"
 
@@ -100,6 +101,106 @@ BOOST_AUTO_TEST_CASE(OldRnnForwardProp)
     TestOldRnnForwardPropSRP<float>();
 }
 
+// Runs the same TensorOps with the generic TensorOp code and with the vectorized kernels of the CPU (if any), and compares.
+// Elementwise arithmetic must match exactly; transcendentals and reductions (which may be evaluated in a different order) within tolerance.
+template <class ElemType>
+static void TestVectorizedTensorKernelsMatchGeneric(double transcendentalTolerance, double reductionTolerance)
+{
+    const CPUInstructionSet supported = GetSupportedCPUInstructionSet();
+    BOOST_TEST_MESSAGE("Comparing vectorized TensorOp kernels for instruction set " << (int) supported << " against the generic code");
+
+    // inputs: random values, plus special values that are outside the range of the vectorized approximations
+    auto createTensor = [](const TensorShape& shape, int seed, float range, bool withSpecialValues)
+    {
+        std::mt19937 rng(seed);
+        boost::random::uniform_real_distribution<float> nd(-range, range);
+        vector<ElemType> init(shape.GetNumElements());
+        generate(begin(init), end(init), [&] { return (ElemType) nd(rng); });
+        const ElemType special[] = { 0, (ElemType) -0.0, 1e-38f, -1e-38f, 1e-30f, 88.7f, -88.7f, 100, -100, 1000, -1000, std::numeric_limits<ElemType>::quiet_NaN() };
+        for (size_t i = 0; withSpecialValues && i < _countof(special) && i * 7 < init.size(); i++)
+            init[i * 7] = special[i];
+        return TensorView<ElemType>(make_shared<Matrix<ElemType>>(init.size(), 1, init.data(), CPUDEVICE), shape);
+    };
+    // runs 'op' into a result of the given shape (pre-filled with values, to test beta != 0)
+    auto run = [&](CPUInstructionSet instructionSet, const TensorShape& resultShape, const function<void(TensorView<ElemType>&)>& op)
+    {
+        SetCPUTensorKernelInstructionSet(instructionSet);
+        auto result = createTensor(resultShape, 99, 1, false);
+        op(result);
+        SetCPUTensorKernelInstructionSet(supported);
+        return vector<ElemType>(result.GetSOB().Data(), result.GetSOB().Data() + resultShape.GetNumElements());
+    };
+    auto compare = [&](const char* what, const TensorShape& resultShape, double tolerance, const function<void(TensorView<ElemType>&)>& op)
+    {
+        auto expected = run(CPUInstructionSet::Generic, resultShape, op);
+        auto actual = run(supported, resultShape, op);
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            if (std::isnan(expected[i]) || std::isnan(actual[i]))
+                BOOST_CHECK_MESSAGE(std::isnan(expected[i]) && std::isnan(actual[i]), what << " [" << i << "]: NaN mismatch");
+            else if (tolerance == 0 || std::isinf(expected[i]))
+                BOOST_CHECK_MESSAGE(expected[i] == actual[i], what << " [" << i << "]: " << expected[i] << " != " << actual[i]);
+            else
+                BOOST_CHECK_MESSAGE(fabs(expected[i] - actual[i]) <= tolerance * max((ElemType) 1, fabs(expected[i])), what << " [" << i << "]: " << expected[i] << " vs. " << actual[i]);
+        }
+    };
+
+    // odd dimensions, to exercise the scalar tails
+    const TensorShape shape{ 37, 129 };
+    auto a = createTensor(shape, 1, 10, true);
+    auto b = createTensor(shape, 2, 1, true);
+    auto bColumn = createTensor(TensorShape{ 37, 1 }, 3, 1, false); // broadcast along the columns
+    auto bRow = createTensor(TensorShape{ 1, 129 }, 4, 1, false);   // broadcast along the rows (stride 0 in the innermost dimension)
+
+    const struct { ElementWiseOperator op; const char* name; bool transcendental; } unaryOps[] =
+    {
+        { ElementWiseOperator::opCopy, "copy", false },
+        { ElementWiseOperator::opLinearRectifier, "linearRectifier", false },
+        { ElementWiseOperator::opSigmoid, "sigmoid", true },
+        { ElementWiseOperator::opTanh, "tanh", true },
+        { ElementWiseOperator::opExp, "exp", true },
+        { ElementWiseOperator::opLog, "log", true },
+    };
+    const struct { ElementWiseOperator op; const char* name; } binaryOps[] =
+    {
+        { ElementWiseOperator::opSum, "sum" },
+        { ElementWiseOperator::opDifference, "difference" },
+        { ElementWiseOperator::opElementwiseProduct, "elementwiseProduct" },
+        { ElementWiseOperator::opElementwiseProductWithSigmoidDerivativeFromOutput, "sigmoidDerivative" },
+        { ElementWiseOperator::opElementwiseProductWithTanhDerivativeFromOutput, "tanhDerivative" },
+        { ElementWiseOperator::opElementwiseProductWithLinearRectifierDerivativeFromOutput, "linearRectifierDerivative" },
+        { ElementWiseOperator::opElementwiseProductWithLogDerivativeFromOutput, "logDerivative" },
+    };
+    const struct { ElemType beta, alpha; } scalings[] = { { 0, 1 }, { 0, (ElemType) 0.3 }, { (ElemType) 0.7, 1 }, { -2, (ElemType) 1.5 } };
+
+    for (const auto& s : scalings)
+    {
+        for (const auto& u : unaryOps)
+            compare(u.name, shape, u.transcendental ? transcendentalTolerance : 0, [&](TensorView<ElemType>& c) { c.DoUnaryOpOf(s.beta, a, s.alpha, u.op, ElementWiseOperator::opSum); });
+        for (const auto& bo : binaryOps)
+        {
+            compare(bo.name, shape, 0, [&](TensorView<ElemType>& c) { c.DoBinaryOpOf(s.beta, a, b, s.alpha, bo.op, ElementWiseOperator::opSum); });
+            compare(bo.name, shape, 0, [&](TensorView<ElemType>& c) { c.DoBinaryOpOf(s.beta, a, bColumn, s.alpha, bo.op, ElementWiseOperator::opSum); });
+            compare(bo.name, shape, 0, [&](TensorView<ElemType>& c) { c.DoBinaryOpOf(s.beta, bRow, a, s.alpha, bo.op, ElementWiseOperator::opSum); });
+        }
+
+        // reductions: along the innermost dimension (column sums), the outermost one (bias gradient), and over all elements
+        // (no special values, as the result of max with NaN depends on the order of evaluation)
+        auto reduced = createTensor(TensorShape{ 257, 1031 }, 5, 1, false);
+        for (const TensorShape& resultShape : { TensorShape{ 1, 1031 }, TensorShape{ 257, 1 }, TensorShape{ 1, 1 } })
+        {
+            compare("reduceSum", resultShape, reductionTolerance, [&](TensorView<ElemType>& c) { c.DoUnaryOpOf(s.beta, reduced, s.alpha, ElementWiseOperator::opCopy, ElementWiseOperator::opSum); });
+            compare("reduceMax", resultShape, reductionTolerance, [&](TensorView<ElemType>& c) { c.DoUnaryOpOf(s.beta, reduced, s.alpha, ElementWiseOperator::opCopy, ElementWiseOperator::opMax); });
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(VectorizedTensorKernelsMatchGeneric)
+{
+    TestVectorizedTensorKernelsMatchGeneric<float>(1e-6, 1e-6);
+    TestVectorizedTensorKernelsMatchGeneric<double>(0, 1e-13);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}}}
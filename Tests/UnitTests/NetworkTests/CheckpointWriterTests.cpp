@@ -0,0 +1,140 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/SGDLib/CheckpointWriter.h"
+#include "fileutil.h"
+#include <boost/filesystem.hpp>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// A fresh directory for the files of a test, which is deleted afterwards.
+struct CheckpointWriterFixture
+{
+    CheckpointWriterFixture()
+        : m_directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cntk-checkpoint-%%%%-%%%%"))
+    {
+        boost::filesystem::create_directories(m_directory);
+    }
+
+    ~CheckpointWriterFixture()
+    {
+        boost::system::error_code error;
+        boost::filesystem::remove_all(m_directory, error);
+    }
+
+    std::wstring Path(const std::wstring& name) const { return (m_directory / name).wstring(); }
+
+    static bool Exists(const std::wstring& fileName) { return boost::filesystem::exists(fileName); }
+
+    static void WriteContent(File& file, int value)
+    {
+        file.PutMarker(fileMarkerBeginSection, std::wstring(L"BCheckpoint"));
+        file << value;
+        for (int i = 0; i < 100000; i++) // larger than the buffers of the file and of the memory stream
+            file << (float)i;
+        file.PutMarker(fileMarkerEndSection, std::wstring(L"ECheckpoint"));
+    }
+
+    static bool HasContent(const std::wstring& fileName, int value)
+    {
+        File file(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+        file.GetMarker(fileMarkerBeginSection, std::wstring(L"BCheckpoint"));
+        int readValue;
+        file >> readValue;
+        bool correct = readValue == value;
+        for (int i = 0; i < 100000; i++)
+        {
+            float x;
+            file >> x;
+            correct &= x == (float)i;
+        }
+        file.GetMarker(fileMarkerEndSection, std::wstring(L"ECheckpoint"));
+        return correct && file.GetPosition() == file.Size();
+    }
+
+    boost::filesystem::path m_directory;
+};
+
+BOOST_FIXTURE_TEST_SUITE(CheckpointWriterTests, CheckpointWriterFixture)
+
+BOOST_AUTO_TEST_CASE(CheckpointWriterWritesTempFileThenRenames)
+{
+    CheckpointWriter writer;
+    std::wstring fileName = Path(L"model.0");
+    auto file = writer.Open(fileName);
+    BOOST_CHECK(Exists(fileName + L".tmp"));
+    BOOST_CHECK(!Exists(fileName));
+    WriteContent(*file, 1);
+
+    writer.Commit(fileName, std::move(file));
+    BOOST_CHECK(!Exists(fileName + L".tmp"));
+    BOOST_CHECK(HasContent(fileName, 1));
+
+    // A new version replaces the file.
+    file = writer.Open(fileName);
+    WriteContent(*file, 2);
+    writer.Commit(fileName, std::move(file));
+    BOOST_CHECK(HasContent(fileName, 2));
+}
+
+BOOST_AUTO_TEST_CASE(CheckpointWriterWritesInTheBackground)
+{
+    CheckpointWriter writer(/*async=*/true);
+    std::wstring fileName = Path(L"model.1");
+    std::wstring olderFileName = Path(L"model.0");
+    fclose(fopenOrDie(olderFileName, L"wb"));
+
+    // The content is serialized into memory, without touching the disk.
+    auto file = writer.Open(fileName);
+    WriteContent(*file, 3);
+    BOOST_CHECK(!Exists(fileName + L".tmp"));
+    BOOST_CHECK(!Exists(fileName));
+
+    writer.Commit(fileName, std::move(file));
+    writer.Remove(olderFileName);
+    writer.Wait();
+    BOOST_CHECK(!Exists(fileName + L".tmp"));
+    BOOST_CHECK(HasContent(fileName, 3));
+    BOOST_CHECK(!Exists(olderFileName));
+}
+
+BOOST_AUTO_TEST_CASE(CheckpointWriterLeavesNoPartialFileOnError)
+{
+    // Renaming onto a directory fails after the content has been written.
+    std::wstring fileName = Path(L"model.0");
+    boost::filesystem::create_directory(fileName);
+
+    CheckpointWriter writer(/*async=*/true);
+    auto file = writer.Open(fileName);
+    WriteContent(*file, 4);
+    writer.Commit(fileName, std::move(file));
+
+    // The operations after a failed one are skipped, so that an older file is not deleted.
+    std::wstring nextFileName = Path(L"model.1");
+    std::wstring olderFileName = Path(L"model.older");
+    fclose(fopenOrDie(olderFileName, L"wb"));
+    file = writer.Open(nextFileName);
+    WriteContent(*file, 5);
+    writer.Commit(nextFileName, std::move(file));
+    writer.Remove(olderFileName);
+
+    BOOST_CHECK_THROW(writer.Wait(), std::exception);
+    BOOST_CHECK(!Exists(fileName + L".tmp"));
+    BOOST_CHECK(boost::filesystem::is_directory(fileName));
+    BOOST_CHECK(!Exists(nextFileName));
+    BOOST_CHECK(Exists(olderFileName));
+
+    // The same without the background thread.
+    writer.SetAsync(false);
+    file = writer.Open(fileName);
+    WriteContent(*file, 6);
+    BOOST_CHECK_THROW(writer.Commit(fileName, std::move(file)), std::exception);
+    BOOST_CHECK(!Exists(fileName + L".tmp"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
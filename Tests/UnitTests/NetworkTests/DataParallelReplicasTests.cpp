@@ -0,0 +1,140 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/SGDLib/DataParallelReplicas.h"
+#include "../../../Source/SGDLib/DataReaderHelpers.h"
+#include "TestHelpers.h"
+#include <atomic>
+#include <cmath>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Trains the shared softmax regression with the full minibatch and with data-parallel replicas.
+struct DataParallelReplicasFixture : SoftmaxRegressionNetwork
+{
+    // The values of the criterion and evaluation nodes, followed by the gradients of the learnable parameters.
+    std::vector<float> Results() const
+    {
+        std::vector<float> results;
+        for (const auto& node : { m_criterion, m_evaluation })
+            results.push_back(dynamic_pointer_cast<ComputationNode<float>>(node)->Value().Get00Element());
+        for (const auto& node : m_learnableNodes)
+        {
+            const auto& gradient = dynamic_pointer_cast<ComputationNode<float>>(node)->Gradient();
+            results.insert(results.end(), gradient.Data(), gradient.Data() + gradient.GetNumElements());
+        }
+        return results;
+    }
+
+    // Trains on the full minibatch with the network itself.
+    std::vector<float> FullMinibatchResults()
+    {
+        m_net->ForwardProp(std::vector<ComputationNodeBasePtr>{ m_criterion, m_evaluation });
+        m_net->Backprop(m_criterion);
+        return Results();
+    }
+
+    std::vector<float> ReplicaResults(DataParallelReplicas<float>& replicas)
+    {
+        replicas.Scatter(DataReaderHelpers::RetrieveInputMatrices(m_inputNodes));
+        replicas.ForwardBackward(/*backprop=*/true, nullptr);
+        BOOST_REQUIRE(replicas.ReduceGradients(m_learnableNodes));
+        return Results();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(DataParallelReplicasTests, DataParallelReplicasFixture)
+
+BOOST_AUTO_TEST_CASE(ReplicasMatchFullMinibatch)
+{
+    // 2 divides the minibatch of 8 samples, 3 does not, and 10 leaves some of the replicas without samples.
+    for (size_t numReplicas : { 2, 3, 10 })
+    {
+        DataParallelReplicas<float> replicas(m_net, m_criterion, { m_evaluation }, m_learnableNodes, numReplicas);
+
+        // The same replicas are used for several epochs and minibatch sizes.
+        for (size_t epoch = 0; epoch < 2; epoch++)
+        {
+            replicas.StartEpoch(epoch);
+            for (size_t numSamples : { 8, 5 })
+            {
+                SetMinibatch(numSamples);
+                auto expected = FullMinibatchResults();
+                auto actual = ReplicaResults(replicas);
+                BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+                BOOST_CHECK_MESSAGE(AreEqual(expected.data(), actual.data(), expected.size(), 1e-4f),
+                                    numReplicas << " replicas differ from the full minibatch of " << numSamples << " samples");
+            }
+            replicas.EndEpoch();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HogwildUpdatesSharedParameters)
+{
+    DataParallelReplicas<float> replicas(m_net, m_criterion, { m_evaluation }, m_learnableNodes, 4);
+
+    // The smoothed gradients start at the size of the parameters, as in SGD; RmsProp triples them on its first call.
+    std::list<Matrix<float>> smoothedGradients;
+    std::vector<float> initialValues;
+    for (const auto& node : m_learnableNodes)
+    {
+        const auto& value = dynamic_pointer_cast<ComputationNode<float>>(node)->Value();
+        smoothedGradients.push_back(Matrix<float>(value.GetNumRows(), value.GetNumCols(), CPUDEVICE));
+        initialValues.insert(initialValues.end(), value.Data(), value.Data() + value.GetNumElements());
+    }
+
+    std::atomic<int> numUpdating(0), maxNumUpdating(0);
+    auto update = [&](const std::list<ComputationNodeBasePtr>& replicaLearnableNodes, size_t)
+    {
+        int n = ++numUpdating;
+        for (int max = maxNumUpdating; n > max && !maxNumUpdating.compare_exchange_weak(max, n);)
+            ;
+        auto smoothedGradient = smoothedGradients.begin();
+        for (const auto& node : replicaLearnableNodes)
+        {
+            auto& value = dynamic_pointer_cast<ComputationNode<float>>(node)->Value();
+            auto& gradient = dynamic_pointer_cast<ComputationNode<float>>(node)->Gradient();
+            float aveMultiplier = smoothedGradient->RmsProp(gradient, 0.99f, 1.2f, 10.0f, 0.75f, 0.1f, /*needAveMultiplier=*/true, /*initialized=*/true);
+            Matrix<float>::ScaleAndAdd(-0.01f / aveMultiplier, gradient, value);
+            smoothedGradient++;
+        }
+        --numUpdating;
+    };
+
+    for (size_t epoch = 0; epoch < 2; epoch++)
+    {
+        replicas.StartEpoch(epoch);
+        for (size_t minibatch = 0; minibatch < 3; minibatch++)
+        {
+            SetMinibatch(16);
+            maxNumUpdating = 0;
+            replicas.Scatter(DataReaderHelpers::RetrieveInputMatrices(m_inputNodes));
+            replicas.ForwardBackward(/*backprop=*/true, update);
+            // The first updates of an epoch must not allocate the shared state concurrently.
+            if (minibatch == 0)
+                BOOST_CHECK_EQUAL(maxNumUpdating.load(), 1);
+        }
+        replicas.EndEpoch();
+    }
+
+    // The replicas updated the parameters of the network, which they share.
+    std::vector<float> values;
+    auto smoothedGradient = smoothedGradients.begin();
+    for (const auto& node : m_learnableNodes)
+    {
+        const auto& value = dynamic_pointer_cast<ComputationNode<float>>(node)->Value();
+        BOOST_CHECK_EQUAL(smoothedGradient->GetNumCols(), 3 * value.GetNumCols());
+        values.insert(values.end(), value.Data(), value.Data() + value.GetNumElements());
+        smoothedGradient++;
+    }
+    BOOST_CHECK(std::all_of(values.begin(), values.end(), [](float v) { return std::isfinite(v); }));
+    BOOST_CHECK(!AreEqual(initialValues.data(), values.data(), values.size(), 1e-4f));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
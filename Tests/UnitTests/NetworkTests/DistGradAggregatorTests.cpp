@@ -0,0 +1,222 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the gradient aggregators, in jobs of the shared-memory MPIWrapper started by RunShmJob().
+//
+
+#include "stdafx.h"
+#include "TestHelpers.h"
+#include "../../../Source/SGDLib/SimpleDistGradAggregator.h"
+#include "../../../Source/SGDLib/SparseDistGradAggregator.h"
+
+#ifndef _WIN32
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// The value of element j of the gradient with the given index, as computed by the given rank.
+static float LocalGradientValue(size_t index, size_t j, size_t rank)
+{
+    return (float)(100 * index + j + 1000 * rank);
+}
+
+static void SetLocalGradient(Matrix<float>& gradient, size_t index, size_t rank)
+{
+    std::vector<float> values(gradient.GetNumElements());
+    for (size_t j = 0; j < values.size(); j++)
+        values[j] = LocalGradientValue(index, j, rank);
+    gradient.SetValue(gradient.GetNumRows(), gradient.GetNumCols(), CPUDEVICE, values.data());
+}
+
+// Returns whether the gradient is the sum of the local gradients of the given ranks.
+static bool IsSumOfLocalGradients(const Matrix<float>& gradient, size_t index, const std::vector<size_t>& ranks)
+{
+    std::vector<float> expected(gradient.GetNumElements(), 0);
+    for (size_t j = 0; j < expected.size(); j++)
+    {
+        for (size_t rank : ranks)
+            expected[j] += LocalGradientValue(index, j, rank);
+    }
+    return AreEqual(expected.data(), gradient.Data(), expected.size(), 1e-3f);
+}
+
+// Runs a round of the aggregation of the two gradients, which are set to the given values, and returns whether
+// the aggregated ones are the expected values.
+static bool IsAggregatedSparsely(IDistGradAggregator<float>& aggregator, Matrix<float>& g0, Matrix<float>& g1,
+                                 const std::vector<float>& values0, const std::vector<float>& values1,
+                                 const std::vector<float>& expected0, const std::vector<float>& expected1, bool resetState = false)
+{
+    g0.SetValue(g0.GetNumRows(), g0.GetNumCols(), CPUDEVICE, const_cast<float*>(values0.data()));
+    g1.SetValue(g1.GetNumRows(), g1.GetNumCols(), CPUDEVICE, const_cast<float*>(values1.data()));
+    std::unique_ptr<DistGradHeader, void (*)(DistGradHeader*)> header(DistGradHeader::Create(0), DistGradHeader::Destroy);
+    header->Clear();
+    header->numSamples = 1;
+    return aggregator.AggregateGradients({ &g0, &g1 }, header.get(), resetState) &&
+           AreEqual(expected0.data(), g0.Data(), expected0.size(), 1e-6f) &&
+           AreEqual(expected1.data(), g1.Data(), expected1.size(), 1e-6f);
+}
+
+BOOST_AUTO_TEST_SUITE(DistGradAggregatorTests)
+
+BOOST_AUTO_TEST_CASE(OverlappedAggregationBucketsAndWaits)
+{
+    BOOST_CHECK(RunShmJob(2, [](MPIWrapper& mpi)
+    {
+        size_t rank = mpi.CurrentNodeRank();
+        const std::vector<size_t> allRanks{ 0, 1 };
+        const std::vector<size_t> myRank{ rank };
+        bool correct = true;
+        {
+            // Buckets of up to 30 elements: { g0, g1 }, which is packed into a buffer, and { g2 }, which is reduced
+            // in place. The shared-memory all-reduce completes right away, so the gradients of a launched bucket are
+            // summed as soon as it is launched if they are reduced in place, but only in WaitForGradient() otherwise.
+            SimpleDistGradAggregator<float> aggregator(mpi.shared_from_this(), /*useAsyncAggregation=*/false, CPUDEVICE, /*syncStatsTrace=*/0,
+                                                       DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, /*bucketSizeInBytes=*/30 * sizeof(float));
+            Matrix<float> g0(10, 1, CPUDEVICE), g1(4, 5, CPUDEVICE), g2(5, 1, CPUDEVICE);
+            std::vector<Matrix<float>*> gradients{ &g0, &g1, &g2 }; // in backprop order
+            if (!aggregator.EnableOverlappedAggregation(gradients))
+                return false;
+
+            std::unique_ptr<DistGradHeader, void (*)(DistGradHeader*)> header(DistGradHeader::Create(0), DistGradHeader::Destroy);
+            auto startRound = [&](size_t numSamples)
+            {
+                for (size_t i = 0; i < gradients.size(); i++)
+                    SetLocalGradient(*gradients[i], i, rank);
+                header->Clear();
+                header->numSamples = numSamples;
+                header->numSamplesWithLabel = numSamples;
+            };
+
+            // A minibatch whose gradients are all used. The bucket of g2 is only launched after the one before it.
+            startRound(1);
+            aggregator.OnGradientReady(&g2);
+            correct &= IsSumOfLocalGradients(g2, 2, myRank);
+            aggregator.OnGradientReady(&g0);
+            aggregator.OnGradientReady(&g1);
+            correct &= IsSumOfLocalGradients(g2, 2, allRanks);
+            correct &= IsSumOfLocalGradients(g0, 0, myRank) && IsSumOfLocalGradients(g1, 1, myRank);
+            correct &= aggregator.AggregateGradients(gradients, header.get(), /*resetState=*/true);
+            correct &= header->numSamples == 2;
+            aggregator.WaitForGradient(&g0); // unpacks its whole bucket
+            correct &= IsSumOfLocalGradients(g0, 0, allRanks) && IsSumOfLocalGradients(g1, 1, allRanks);
+            aggregator.WaitForGradient(&g1);
+            aggregator.WaitForGradient(&g2);
+            correct &= IsSumOfLocalGradients(g1, 1, allRanks) && IsSumOfLocalGradients(g2, 2, allRanks);
+            aggregator.FinishOverlappedAggregation();
+
+            // A minibatch whose model update is skipped: finishing it completes the all-reduces without using them.
+            startRound(1);
+            for (auto gradient : gradients)
+                aggregator.OnGradientReady(gradient);
+            correct &= aggregator.AggregateGradients(gradients, header.get(), /*resetState=*/false);
+            aggregator.FinishOverlappedAggregation();
+            correct &= IsSumOfLocalGradients(g0, 0, myRank) && IsSumOfLocalGradients(g1, 1, myRank);
+            try
+            {
+                aggregator.WaitForGradient(&g0);
+                correct = false;
+            }
+            catch (const std::logic_error&)
+            {
+            }
+
+            // A minibatch without data on rank 1, which starts all buckets in AggregateGradients(), with zeros.
+            startRound(rank == 0 ? 1 : 0);
+            if (rank == 0)
+            {
+                for (auto gradient : gradients)
+                    aggregator.OnGradientReady(gradient);
+            }
+            correct &= aggregator.AggregateGradients(gradients, header.get(), /*resetState=*/false);
+            correct &= header->numSamples == 1;
+            for (size_t i = 0; i < gradients.size(); i++)
+            {
+                aggregator.WaitForGradient(gradients[i]);
+                correct &= IsSumOfLocalGradients(*gradients[i], i, { 0 });
+            }
+            aggregator.FinishOverlappedAggregation();
+        }
+        mpi.Finalize();
+        return correct;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(SparseAggregationSelectsTopEntriesAndKeepsResidual)
+{
+    BOOST_CHECK(RunShmJob(1, [](MPIWrapper& mpi)
+    {
+        bool correct = true;
+        {
+            // The 2 (of 8) and 1 (of 4) entries with the largest magnitude are sent.
+            SparseDistGradAggregator<float> aggregator(mpi.shared_from_this(), /*syncStatsTrace=*/0, /*ratio=*/0.25, /*threshold=*/0);
+            Matrix<float> g0(4, 2, CPUDEVICE), g1(4, 1, CPUDEVICE);
+            correct &= IsAggregatedSparsely(aggregator, g0, g1, { 1, -8, 3, 0.5f, -2, 7, 0, 4 }, { 0.1f, -0.2f, 5, 0.3f },
+                                            { 0, -8, 0, 0, 0, 7, 0, 0 }, { 0, 0, 5, 0 });
+
+            // Without new gradients, the next round sends the largest of the entries that were left.
+            correct &= IsAggregatedSparsely(aggregator, g0, g1, std::vector<float>(8, 0), std::vector<float>(4, 0),
+                                            { 0, 0, 3, 0, 0, 0, 0, 4 }, { 0, 0, 0, 0.3f });
+
+            // Resetting the state drops the residual.
+            correct &= IsAggregatedSparsely(aggregator, g0, g1, std::vector<float>(8, 0), std::vector<float>(4, 0),
+                                            std::vector<float>(8, 0), std::vector<float>(4, 0), /*resetState=*/true);
+        }
+        mpi.Finalize();
+        return correct;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(SparseAggregationSendsEntriesAboveThreshold)
+{
+    BOOST_CHECK(RunShmJob(1, [](MPIWrapper& mpi)
+    {
+        bool correct = true;
+        {
+            SparseDistGradAggregator<float> aggregator(mpi.shared_from_this(), /*syncStatsTrace=*/0, /*ratio=*/0, /*threshold=*/0.9);
+            Matrix<float> g0(4, 2, CPUDEVICE), g1(4, 1, CPUDEVICE);
+            correct &= IsAggregatedSparsely(aggregator, g0, g1, { 1, -8, 3, 0.5f, -2, 7, 0, 4 }, { 0.1f, -0.2f, 5, 0.3f },
+                                            { 1, -8, 3, 0, -2, 7, 0, 4 }, { 0, 0, 5, 0 });
+
+            // The entry of 0.5 that was left reaches the threshold with the next one.
+            correct &= IsAggregatedSparsely(aggregator, g0, g1, std::vector<float>(8, 0.5f), std::vector<float>(4, 0),
+                                            { 0, 0, 0, 1, 0, 0, 0, 0 }, { 0, 0, 0, 0 });
+        }
+        mpi.Finalize();
+        return correct;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(SparseAggregationOfAllEntriesIsTheDenseSum)
+{
+    BOOST_CHECK(RunShmJob(3, [](MPIWrapper& mpi)
+    {
+        size_t rank = mpi.CurrentNodeRank();
+        bool correct = true;
+        {
+            // With a ratio of 1 every entry is sent, so merging the entries of all nodes gives the sum of the gradients.
+            SparseDistGradAggregator<float> aggregator(mpi.shared_from_this(), /*syncStatsTrace=*/0, /*ratio=*/1, /*threshold=*/0);
+            Matrix<float> g0(4, 2, CPUDEVICE), g1(4, 1, CPUDEVICE);
+            std::vector<float> values0(8), values1(4), expected0(8, 0), expected1(4, 0);
+            for (size_t j = 0; j < 8; j++)
+                values0[j] = LocalGradientValue(0, j, rank);
+            for (size_t j = 0; j < 4; j++)
+                values1[j] = LocalGradientValue(1, j, rank);
+            for (size_t r = 0; r < 3; r++)
+            {
+                for (size_t j = 0; j < 8; j++)
+                    expected0[j] += LocalGradientValue(0, j, r);
+                for (size_t j = 0; j < 4; j++)
+                    expected1[j] += LocalGradientValue(1, j, r);
+            }
+            correct &= IsAggregatedSparsely(aggregator, g0, g1, values0, values1, expected0, expected1);
+        }
+        mpi.Finalize();
+        return correct;
+    }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
+
+#endif
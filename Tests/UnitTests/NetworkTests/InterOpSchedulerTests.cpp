@@ -0,0 +1,99 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/ComputationNetworkLib/InterOpScheduler.h"
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include "../../../Source/ComputationNetworkLib/NonlinearityNodes.h"
+#include "TestHelpers.h"
+#include <cmath>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(InterOpSchedulerTests)
+
+static void ConnectAndAllocate(const ComputationNodeBasePtr& node, const vector<ComputationNodeBasePtr>& inputs)
+{
+    node->AttachInputs(inputs);
+    node->Validate(true);
+    dynamic_pointer_cast<ComputationNode<float>>(node)->CreateValueMatrixIfNull();
+}
+
+BOOST_AUTO_TEST_CASE(InterOpSchedulerKeepsMatrixSharingOrder)
+{
+    const size_t minibatchSize = 8;
+    vector<float> data(4 * minibatchSize);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = 0.1f * i - 1.0f;
+    auto x = make_shared<DummyNodeTest<float>>(CPUDEVICE, minibatchSize, SmallVector<size_t>{4}, data);
+
+    // two independent branches that are joined, plus a node that reuses the matrix of one branch once the join has read it
+    auto b = make_shared<TanhNode<float>>(CPUDEVICE, L"b");
+    auto c = make_shared<SigmoidNode<float>>(CPUDEVICE, L"c");
+    auto d = make_shared<PlusNode<float>>(CPUDEVICE, L"d");
+    auto f = make_shared<SigmoidNode<float>>(CPUDEVICE, L"f");
+    ConnectAndAllocate(b, {x});
+    ConnectAndAllocate(c, {x});
+    ConnectAndAllocate(d, {b, c});
+    ConnectAndAllocate(f, {x});
+    f->ValuePtrRef() = b->ValuePtrRef(); // as the MatrixPool would share it
+    vector<ComputationNodeBasePtr> nodes = {x, b, c, d, f};
+
+    InterOpScheduler scheduler(3);
+    for (size_t iteration = 0; iteration < 20; iteration++)
+    {
+        d->Value().SetValue(0);
+        vector<ComputationNodeBasePtr> doneNodes;
+        scheduler.Run(nodes, /*backward=*/false, [](const ComputationNodeBasePtr& node)
+        {
+            FrameRange fr(node->GetMBLayout());
+            node->BeginForwardProp();
+            node->ForwardProp(fr);
+            node->EndForwardProp();
+        },
+        [&doneNodes](const ComputationNodeBasePtr& node) { doneNodes.push_back(node); });
+
+        BOOST_CHECK_EQUAL(doneNodes.size(), nodes.size());
+        auto position = [&doneNodes](const ComputationNodeBasePtr& node) { return find(doneNodes.begin(), doneNodes.end(), node) - doneNodes.begin(); };
+        BOOST_CHECK(position(d) > position(b) && position(d) > position(c));
+        BOOST_CHECK(position(f) > position(d));
+
+        vector<float> expected(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+            expected[i] = tanh(data[i]) + 1 / (1 + exp(-data[i]));
+        BOOST_CHECK(AreEqual(expected.data(), d->Value().Data(), expected.size(), 1e-5f));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(InterOpSchedulerRethrowsErrors)
+{
+    const size_t minibatchSize = 2;
+    vector<float> data(2 * minibatchSize, 1.0f);
+    auto x = make_shared<DummyNodeTest<float>>(CPUDEVICE, minibatchSize, SmallVector<size_t>{2}, data);
+    auto b = make_shared<TanhNode<float>>(CPUDEVICE, L"b");
+    auto c = make_shared<SigmoidNode<float>>(CPUDEVICE, L"c");
+    ConnectAndAllocate(b, {x});
+    ConnectAndAllocate(c, {x});
+    vector<ComputationNodeBasePtr> nodes = {x, b, c};
+
+    InterOpScheduler scheduler(2);
+    BOOST_CHECK_THROW(scheduler.Run(nodes, /*backward=*/true, [&c](const ComputationNodeBasePtr& node)
+    {
+        if (node == c)
+            RuntimeError("failed");
+    }), std::runtime_error);
+
+    // the scheduler remains usable
+    size_t numRun = 0;
+    scheduler.Run(nodes, /*backward=*/true, [](const ComputationNodeBasePtr&) {}, [&numRun](const ComputationNodeBasePtr&) { numRun++; });
+    BOOST_CHECK_EQUAL(numRun, nodes.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetworkBuilder.h"
+#include "TestHelpers.h"
+#include "../../../Source/SGDLib/SimpleDistGradAggregator.h"
+#include "../../../Source/SGDLib/SparseDistGradAggregator.h"
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// An embedding z = LookupTable(E, x) of one-hot words, with a cross-entropy criterion, once with a sparse and once
+// with a dense input x, but the same embedding E and the same words. The network with the sparse input computes
+// sparse gradients of the embedding if sparseEmbeddingGradients is set.
+struct LookupTableNodeFixture
+{
+    const size_t dim = 4, vocabSize = 10;
+
+    struct Network
+    {
+        ComputationNetworkPtr net;
+        ComputationNodeBasePtr criterion;
+        shared_ptr<ComputationNode<float>> x, y, embedding;
+    };
+
+    LookupTableNodeFixture()
+        : m_sparse(CreateNetwork(/*sparse=*/true)), m_dense(CreateNetwork(/*sparse=*/false))
+    {
+        m_sparse.net->SetSparseEmbeddingGradients(true);
+        std::vector<float> values(dim * vocabSize);
+        for (size_t i = 0; i < values.size(); i++)
+            values[i] = (float)((i * 7) % 11) / 11 - 0.5f;
+        for (auto network : { &m_sparse, &m_dense })
+            network->embedding->Value().SetValue(dim, vocabSize, CPUDEVICE, values.data());
+    }
+
+    Network CreateNetwork(bool sparse)
+    {
+        Network network;
+        network.net = make_shared<ComputationNetwork>(CPUDEVICE);
+        ComputationNetworkBuilder<float> builder(*network.net);
+        network.x = sparse ? builder.CreateSparseInputNode(L"x", vocabSize) : builder.CreateInputNode(L"x", vocabSize);
+        network.y = builder.CreateInputNode(L"y", dim);
+        network.embedding = builder.CreateLearnableParameter(L"E", dim, vocabSize);
+        auto z = builder.LookupTable(network.embedding, network.x, L"z");
+        network.criterion = builder.CrossEntropyWithSoftmax(network.y, z, L"ce");
+        network.net->AddToNodeGroup(L"feature", network.x);
+        network.net->AddToNodeGroup(L"label", network.y);
+        network.net->AddToNodeGroup(L"criterion", network.criterion);
+        network.net->CompileNetwork();
+        network.net->Environment().SetOperationMode(NetworkOperationMode::training);
+        network.net->AllocateAllMatrices({}, {}, network.criterion);
+        network.net->StartEvaluateMinibatchLoop(network.criterion);
+        return network;
+    }
+
+    // Computes the gradients of both networks for a minibatch of the given words, each labeled with the class word % dim.
+    void RunMinibatch(const std::vector<size_t>& words)
+    {
+        const size_t n = words.size();
+        std::vector<float> oneHot(vocabSize * n, 0), labels(dim * n, 0);
+        for (size_t j = 0; j < n; j++)
+        {
+            oneHot[j * vocabSize + words[j]] = 1;
+            labels[j * dim + words[j] % dim] = 1;
+        }
+        Matrix<float> input(vocabSize, n, oneHot.data(), CPUDEVICE);
+        for (auto network : { &m_sparse, &m_dense })
+        {
+            network->net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(n);
+            if (network->x->Value().GetMatrixType() == SPARSE)
+            {
+                Matrix<float> sparseInput(input.DeepClone());
+                sparseInput.SwitchToMatrixType(SPARSE, matrixFormatSparseCSC, true);
+                network->x->Value().SetValue(sparseInput);
+            }
+            else
+                network->x->Value().SetValue(input);
+            network->y->Value().SetValue(dim, n, CPUDEVICE, labels.data());
+            for (auto node : { network->x, network->y })
+            {
+                node->NotifyFunctionValuesMBSizeModified();
+                node->BumpEvalTimeStamp();
+            }
+            network->net->ForwardProp(network->criterion);
+            network->net->Backprop(network->criterion);
+        }
+    }
+
+    static std::vector<float> DenseValues(const Matrix<float>& matrix)
+    {
+        Matrix<float> dense(matrix.DeepClone());
+        dense.SwitchToMatrixType(DENSE, matrixFormatDense, true);
+        return std::vector<float>(dense.Data(), dense.Data() + dense.GetNumElements());
+    }
+
+    bool AreGradientsEqual() const
+    {
+        auto expected = DenseValues(m_dense.embedding->Gradient());
+        auto actual = DenseValues(m_sparse.embedding->Gradient());
+        return AreEqual(expected.data(), actual.data(), expected.size(), 1e-5f);
+    }
+
+    Network m_sparse, m_dense;
+};
+
+BOOST_FIXTURE_TEST_SUITE(LookupTableNodeTests, LookupTableNodeFixture)
+
+BOOST_AUTO_TEST_CASE(LookupTableNodeGradientIsSparseForSparseInput)
+{
+    RunMinibatch({ 3, 7, 3, 0 });
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetMatrixType() == SPARSE);
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetFormat() == matrixFormatSparseBlockCol);
+    BOOST_CHECK(m_dense.embedding->Gradient().GetMatrixType() == DENSE);
+    BOOST_CHECK(AreGradientsEqual());
+
+    RunMinibatch({ 9, 3 });
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetMatrixType() == SPARSE);
+    BOOST_CHECK(AreGradientsEqual());
+}
+
+BOOST_AUTO_TEST_CASE(LookupTableNodeGradientBecomesDenseWithL2Regularization)
+{
+    // The L2 regularization of SGD adds the (dense) weights to the gradient, which makes the sparse gradient dense.
+    RunMinibatch({ 3, 7, 3, 0 });
+    for (auto network : { &m_sparse, &m_dense })
+        Matrix<float>::ScaleAndAdd(0.1f, network->embedding->Value(), network->embedding->Gradient());
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetMatrixType() == DENSE);
+    BOOST_CHECK(AreGradientsEqual());
+
+    // It stays dense for the following minibatches.
+    RunMinibatch({ 9, 3 });
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetMatrixType() == DENSE);
+    BOOST_CHECK(AreGradientsEqual());
+}
+
+BOOST_AUTO_TEST_CASE(LookupTableNodeGradientIsDenseByDefault)
+{
+    m_sparse.net->SetSparseEmbeddingGradients(false);
+    RunMinibatch({ 3, 7, 3, 0 });
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetMatrixType() == DENSE);
+    BOOST_CHECK(AreGradientsEqual());
+
+    // A sparse gradient of an earlier training run is made dense again.
+    m_sparse.net->SetSparseEmbeddingGradients(true);
+    RunMinibatch({ 9, 3 });
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetMatrixType() == SPARSE);
+    m_sparse.net->SetSparseEmbeddingGradients(false);
+    RunMinibatch({ 3, 7, 3, 0 });
+    BOOST_CHECK(m_sparse.embedding->Gradient().GetMatrixType() == DENSE);
+    BOOST_CHECK(AreGradientsEqual());
+}
+
+#ifndef _WIN32
+// As SGD does with parallel training, the default dense gradient of a sparse input can be aggregated.
+BOOST_AUTO_TEST_CASE(LookupTableNodeGradientIsAggregated)
+{
+    m_sparse.net->SetSparseEmbeddingGradients(false);
+    BOOST_CHECK(RunShmJob(2, [this](MPIWrapper& mpi)
+    {
+        bool correct = true;
+        {
+            SimpleDistGradAggregator<float> simpleAggregator(mpi.shared_from_this(), /*useAsyncAggregation=*/false, CPUDEVICE, /*syncStatsTrace=*/0);
+            SparseDistGradAggregator<float> sparseAggregator(mpi.shared_from_this(), /*syncStatsTrace=*/0, /*ratio=*/1, /*threshold=*/0);
+            for (IDistGradAggregator<float>* aggregator : std::vector<IDistGradAggregator<float>*>{ &simpleAggregator, &sparseAggregator })
+            {
+                // Every rank computes the gradient of the same words, so the aggregated gradient is twice that.
+                RunMinibatch({ 3, 7, 3, 0 });
+                auto& gradient = m_sparse.embedding->Gradient();
+                correct &= gradient.GetMatrixType() == DENSE;
+                std::unique_ptr<DistGradHeader, void (*)(DistGradHeader*)> header(DistGradHeader::Create(0), DistGradHeader::Destroy);
+                header->Clear();
+                header->numSamples = 4;
+                correct &= aggregator->AggregateGradients({ &gradient }, header.get(), /*resetState=*/true);
+
+                auto expected = DenseValues(m_dense.embedding->Gradient());
+                for (auto& value : expected)
+                    value *= 2;
+                correct &= AreEqual(expected.data(), gradient.Data(), expected.size(), 1e-5f);
+            }
+        }
+        mpi.Finalize();
+        return correct;
+    }));
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
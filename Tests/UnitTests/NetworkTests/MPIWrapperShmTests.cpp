@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests of the shared-memory MPIWrapper, in jobs started by RunShmJob().
+//
+
+#include "stdafx.h"
+#include "TestHelpers.h"
+
+#ifndef _WIN32
+#include <numeric>
+#include <unistd.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(MPIWrapperShmTests)
+
+BOOST_AUTO_TEST_CASE(ShmAllReduceSumsOverAllProcesses)
+{
+    BOOST_CHECK(RunShmJob(3, [](MPIWrapper& mpi)
+    {
+        // more than half a buffer, so that it is reduced in chunks
+        const size_t n = 300000;
+        float rank = (float)mpi.CurrentNodeRank();
+        std::vector<float> data(n);
+        for (size_t i = 0; i < n; i++)
+            data[i] = rank * 1000 + (float)(i % 1000);
+        mpi.AllReduce(data.data(), n);
+
+        std::vector<size_t> count{ 1 };
+        mpi.AllReduce(count);
+        bool correct = mpi.NumNodesInUse() == 3 && count[0] == 3;
+        for (size_t i = 0; i < n; i++)
+            correct &= data[i] == 3000 + 3 * (float)(i % 1000);
+        mpi.Finalize();
+        return correct;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(ShmBcastAndAllGather)
+{
+    BOOST_CHECK(RunShmJob(3, [](MPIWrapper& mpi)
+    {
+        size_t rank = mpi.CurrentNodeRank();
+        const size_t n = 100000;
+        std::vector<double> data(n, rank == 1 ? 0.0 : -1.0);
+        if (rank == 1)
+            std::iota(data.begin(), data.end(), 0.0);
+        mpi.Bcast(data.data(), n, 1);
+        bool correct = true;
+        for (size_t i = 0; i < n; i++)
+            correct &= data[i] == (double)i;
+
+        int send[2] = { (int)rank, (int)rank * 10 };
+        int received[6];
+        mpi.AllGather(send, 2, received, 2);
+        for (int r = 0; r < 3; r++)
+            correct &= received[2 * r] == r && received[2 * r + 1] == r * 10;
+        mpi.Finalize();
+        return correct;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(ShmPointToPointMessages)
+{
+    BOOST_CHECK(RunShmJob(2, [](MPIWrapper& mpi)
+    {
+        // larger than a mailbox, so that it is sent in chunks
+        const int n = 400000;
+        std::vector<int> data(n);
+        MPI_Request request;
+        if (mpi.IsMainNode())
+        {
+            std::iota(data.begin(), data.end(), 0);
+            mpi.Isend(data.data(), n, MPI_INT, 1, 0, &request);
+        }
+        else
+            mpi.Irecv(data.data(), n, MPI_INT, 0, 0, &request);
+        mpi.Wait(&request);
+
+        bool correct = true;
+        for (int i = 0; i < n; i++)
+            correct &= data[i] == i;
+        mpi.Finalize();
+        return correct;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(ShmFailsWhenAProcessExits)
+{
+    // Rank 1 exits without taking part in the barrier, which rank 0 must notice instead of waiting forever.
+    BOOST_CHECK(RunShmJob(2, [](MPIWrapper& mpi)
+    {
+        if (!mpi.IsMainNode())
+            _exit(0);
+        try
+        {
+            mpi.WaitAll();
+        }
+        catch (const std::runtime_error& e)
+        {
+            return std::string(e.what()).find("has exited") != std::string::npos;
+        }
+        return false;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(ShmTimesOutWhenAProcessDoesNotStart)
+{
+    // Only rank 1 starts, so it must give up waiting for rank 0.
+    BOOST_CHECK(!RunShmJob(2, std::vector<int>{ 1 }, [](MPIWrapper&) { return true; }, /*timeoutSec=*/"1"));
+
+    // Only rank 0 starts, so it must give up waiting for rank 1 to attach.
+    BOOST_CHECK(!RunShmJob(2, std::vector<int>{ 0 }, [](MPIWrapper&) { return true; }, /*timeoutSec=*/"1"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
+
+#endif
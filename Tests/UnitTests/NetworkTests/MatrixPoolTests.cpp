@@ -0,0 +1,121 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNode.h"
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolTests)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolReplansForMinibatchSize)
+{
+    MBLayoutPtr pMBLayout = make_shared<MBLayout>(1, 10, L"X");
+    const size_t sampleSize = 10;
+
+    shared_ptr<Matrix<float>> a, b, d, p;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<float>(CPUDEVICE, &a, sampleSize, true, false, pMBLayout); // step 0
+    pool.RequestAllocate<float>(CPUDEVICE, &b, sampleSize, true, false, pMBLayout); // step 1
+    pool.RequestRelease<float>(&a);                                                 // step 2
+    pool.RequestAllocate<float>(CPUDEVICE, &d, sampleSize, true, false, pMBLayout); // step 3
+    pool.RequestRelease<float>(&b);                                                 // step 4
+    pool.RequestRelease<float>(&d);                                                 // step 5
+    pool.RequestAllocate<float>(CPUDEVICE, &p, 5, false, false);                    // step 6, never released
+    pool.OptimizedMemoryAllocation();
+
+    // a and b are live at the same time, d can reuse a
+    BOOST_CHECK(a != b);
+    BOOST_CHECK(a == d);
+    BOOST_CHECK(!pool.NeedsReplanning());
+
+    auto stats = pool.GetPlanStats()[CPUDEVICE];
+    BOOST_CHECK_EQUAL(stats.numRequests, 4);
+    BOOST_CHECK_EQUAL(stats.numBuffers, 2);
+    BOOST_CHECK_EQUAL(stats.requestedBytes, (3 * 100 + 5) * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.allocatedBytes, 2 * 100 * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.peakLiveBytes, 2 * 100 * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.arenaBytes, 2 * 100 * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.Fragmentation(), 0.0);
+
+    // a larger minibatch requires a new plan, which must keep the matrix of the persistent request
+    auto persistentMatrix = p;
+    pMBLayout->Init(2, 10);
+    BOOST_CHECK(pool.NeedsReplanning());
+    pool.OptimizedMemoryAllocation();
+    BOOST_CHECK(!pool.NeedsReplanning());
+    BOOST_CHECK(p == persistentMatrix);
+    BOOST_CHECK(a == d);
+
+    stats = pool.GetPlanStats()[CPUDEVICE];
+    BOOST_CHECK_EQUAL(stats.requestedBytes, (3 * 200 + 5) * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.peakLiveBytes, 2 * 200 * sizeof(float));
+
+    // a smaller minibatch keeps the plan
+    pMBLayout->Init(1, 5);
+    BOOST_CHECK(!pool.NeedsReplanning());
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolSizesRequestsByTheirOwnLayout)
+{
+    // e.g. a node that reduces the sequence axis: its output has one column per sequence,
+    // while its temporaries (a 1-row index vector and the unpacked input) have one per frame of the input
+    MBLayoutPtr pInputLayout = make_shared<MBLayout>(3, 10, L"X");
+    MBLayoutPtr pOutputLayout = make_shared<MBLayout>(3, 1, L"Y");
+    const size_t sampleSize = 4;
+
+    shared_ptr<Matrix<float>> output, indices, unpacked;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<float>(CPUDEVICE, &output, sampleSize, true, false, pOutputLayout);
+    pool.RequestAllocate<float>(CPUDEVICE, &indices, 1, true, false, pInputLayout);
+    pool.RequestAllocate<float>(CPUDEVICE, &unpacked, sampleSize, true, false, pInputLayout);
+    pool.RequestRelease<float>(&indices);
+    pool.RequestRelease<float>(&unpacked);
+    pool.RequestRelease<float>(&output);
+    pool.OptimizedMemoryAllocation();
+
+    auto stats = pool.GetPlanStats()[CPUDEVICE];
+    BOOST_CHECK_EQUAL(stats.numRequests, 3);
+    BOOST_CHECK_EQUAL(stats.requestedBytes, (sampleSize * 3 + 1 * 30 + sampleSize * 30) * sizeof(float));
+    BOOST_CHECK_EQUAL(stats.peakLiveBytes, stats.requestedBytes);
+
+    // only the input grows
+    pInputLayout->Init(3, 20);
+    BOOST_CHECK(pool.NeedsReplanning());
+    pool.OptimizedMemoryAllocation();
+    stats = pool.GetPlanStats()[CPUDEVICE];
+    BOOST_CHECK_EQUAL(stats.requestedBytes, (sampleSize * 3 + 1 * 60 + sampleSize * 60) * sizeof(float));
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolArenaPacksSmallRequestsIntoLargeBuffer)
+{
+    // one large request followed by two smaller ones that are live at the same time:
+    // matrix-level sharing needs an extra matrix, while an arena can place both inside the large one
+    shared_ptr<Matrix<double>> large, small1, small2;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<double>(CPUDEVICE, &large, 100, false, false);
+    pool.RequestRelease<double>(&large);
+    pool.RequestAllocate<double>(CPUDEVICE, &small1, 40, false, false);
+    pool.RequestAllocate<double>(CPUDEVICE, &small2, 40, false, false);
+    pool.RequestRelease<double>(&small1);
+    pool.RequestRelease<double>(&small2);
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK(small1 != small2);
+
+    auto stats = pool.GetPlanStats()[CPUDEVICE];
+    BOOST_CHECK_EQUAL(stats.numBuffers, 2);
+    BOOST_CHECK_EQUAL(stats.allocatedBytes, 140 * sizeof(double));
+    BOOST_CHECK_EQUAL(stats.peakLiveBytes, 100 * sizeof(double));
+    BOOST_CHECK_EQUAL(stats.arenaBytes, 100 * sizeof(double));
+    BOOST_CHECK_CLOSE(stats.Fragmentation(), 1.0 - 100.0 / 140.0, 1e-8);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
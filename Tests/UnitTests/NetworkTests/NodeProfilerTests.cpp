@@ -0,0 +1,170 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "NodeProfiler.h"
+#include "fileutil.h"
+#include "TestHelpers.h"
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// The shared softmax regression, whose evaluations are recorded by a NodeProfiler.
+struct NodeProfilerFixture : SoftmaxRegressionNetwork
+{
+    const size_t numSamples = 4;
+
+    NodeProfilerFixture()
+    {
+        SetMinibatch(numSamples);
+        m_fileName = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cntk-nodeprofile-%%%%-%%%%.json")).wstring();
+    }
+
+    ~NodeProfilerFixture()
+    {
+        boost::system::error_code error;
+        boost::filesystem::remove(m_fileName, error);
+    }
+
+    // Evaluates the criterion on the same minibatch again, and computes the gradients if training.
+    void RunMinibatch(NetworkOperationMode mode)
+    {
+        ScopedNetworkOperationMode modeGuard(m_net, mode);
+        for (const auto& node : m_inputNodes)
+        {
+            node->NotifyFunctionValuesMBSizeModified();
+            node->BumpEvalTimeStamp();
+        }
+        m_net->ForwardProp(m_criterion);
+        if (mode == NetworkOperationMode::training)
+            m_net->Backprop(m_criterion);
+    }
+
+    // The table written by WriteTable().
+    static std::string Table(const NodeProfiler& profiler)
+    {
+        FILE* f = tmpfile();
+        profiler.WriteTable(f);
+        rewind(f);
+        std::string table;
+        char buffer[1024];
+        while (fgets(buffer, sizeof(buffer), f))
+            table += buffer;
+        fclose(f);
+        return table;
+    }
+
+    // The numbers of forward and backward evaluations in the table row of the given node.
+    static bool GetCounts(const std::string& table, const std::string& nodeName, int& forwardCount, int& backwardCount)
+    {
+        std::istringstream lines(table);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (line.size() <= nodeName.size() || line.compare(line.size() - nodeName.size() - 1, std::string::npos, " " + nodeName) != 0)
+                continue;
+            double totalMs, percent, forwardMs, backwardMs;
+            return sscanf(line.c_str(), "%lf %lf%% %lf %lf %d %d", &totalMs, &percent, &forwardMs, &backwardMs, &forwardCount, &backwardCount) == 6;
+        }
+        return false;
+    }
+
+    std::string ChromeTrace(const NodeProfiler& profiler) const
+    {
+        profiler.WriteChromeTrace(m_fileName);
+        std::ifstream file(boost::filesystem::path(m_fileName).string());
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    static size_t Count(const std::string& s, const std::string& pattern)
+    {
+        size_t count = 0;
+        for (size_t pos = s.find(pattern); pos != std::string::npos; pos = s.find(pattern, pos + 1))
+            count++;
+        return count;
+    }
+
+    std::wstring m_fileName;
+};
+
+BOOST_FIXTURE_TEST_SUITE(NodeProfilerTests, NodeProfilerFixture)
+
+BOOST_AUTO_TEST_CASE(NodeProfilerRecordsEvaluations)
+{
+    NodeProfiler profiler;
+    auto node = m_net->GetNodeFromName(L"Wx");
+    profiler.Record(node, /*backward=*/false, NodeProfiler::Clock::now());
+    profiler.Record(node, /*backward=*/false, NodeProfiler::Clock::now());
+    profiler.Record(node, /*backward=*/true, NodeProfiler::Clock::now());
+
+    std::string table = Table(profiler);
+    int forwardCount, backwardCount;
+    BOOST_REQUIRE(GetCounts(table, "Wx", forwardCount, backwardCount));
+    BOOST_CHECK_EQUAL(forwardCount, 2);
+    BOOST_CHECK_EQUAL(backwardCount, 1);
+    BOOST_CHECK(table.find("in 1 nodes") != std::string::npos);
+
+    std::string trace = ChromeTrace(profiler);
+    BOOST_CHECK_EQUAL(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0);
+    BOOST_CHECK_EQUAL(Count(trace, "\"name\":\"Wx\""), 3);
+    BOOST_CHECK_EQUAL(Count(trace, "\"cat\":\"forward\""), 2);
+    BOOST_CHECK_EQUAL(Count(trace, "\"cat\":\"backward\""), 1);
+    BOOST_CHECK_EQUAL(Count(trace, "\"operation\":\"Times\""), 3);
+
+    // Nothing is recorded while disabled, or after a reset.
+    profiler.Enable(false);
+    profiler.Record(node, /*backward=*/false, NodeProfiler::Clock::now());
+    BOOST_REQUIRE(GetCounts(Table(profiler), "Wx", forwardCount, backwardCount));
+    BOOST_CHECK_EQUAL(forwardCount, 2);
+    profiler.Enable(true);
+    profiler.Reset();
+    BOOST_CHECK(!GetCounts(Table(profiler), "Wx", forwardCount, backwardCount));
+    BOOST_CHECK_EQUAL(Count(ChromeTrace(profiler), "\"name\""), 0);
+}
+
+BOOST_AUTO_TEST_CASE(NodeProfilerKeepsStatisticsOfDroppedTraceEvents)
+{
+    NodeProfiler profiler(/*maxTraceEvents=*/2);
+    auto node = m_net->GetNodeFromName(L"z");
+    for (size_t i = 0; i < 5; i++)
+        profiler.Record(node, /*backward=*/false, NodeProfiler::Clock::now());
+
+    std::string table = Table(profiler);
+    int forwardCount, backwardCount;
+    BOOST_REQUIRE(GetCounts(table, "z", forwardCount, backwardCount));
+    BOOST_CHECK_EQUAL(forwardCount, 5);
+    BOOST_CHECK(table.find("3 node evaluations did not fit into the trace") != std::string::npos);
+    BOOST_CHECK_EQUAL(Count(ChromeTrace(profiler), "\"name\":\"z\""), 2);
+}
+
+BOOST_AUTO_TEST_CASE(NodeProfilerRecordsOnlyTraining)
+{
+    auto profiler = make_shared<NodeProfiler>();
+    m_net->Environment().nodeProfiler = profiler;
+    RunMinibatch(NetworkOperationMode::training);
+    RunMinibatch(NetworkOperationMode::inferring); // e.g. the cross-validation
+    RunMinibatch(NetworkOperationMode::preComputing);
+    RunMinibatch(NetworkOperationMode::training);
+    m_net->Environment().nodeProfiler = nullptr;
+
+    std::string table = Table(*profiler);
+    int forwardCount, backwardCount;
+    BOOST_REQUIRE(GetCounts(table, "ce", forwardCount, backwardCount));
+    BOOST_CHECK_EQUAL(forwardCount, 2);
+    BOOST_CHECK_EQUAL(backwardCount, 2);
+    BOOST_REQUIRE(GetCounts(table, "Wx", forwardCount, backwardCount));
+    BOOST_CHECK_EQUAL(forwardCount, 2);
+    BOOST_CHECK_EQUAL(backwardCount, 2);
+    BOOST_CHECK_EQUAL(Count(ChromeTrace(*profiler), "\"name\":\"ce\""), 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
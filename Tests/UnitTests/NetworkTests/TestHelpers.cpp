@@ -4,6 +4,12 @@
 //
 
 #include "TestHelpers.h"
+#include "ComputationNetworkBuilder.h"
+#ifndef _WIN32
+#include <numeric>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 using namespace Microsoft::MSR::CNTK;
 using namespace Microsoft::MSR::CNTK::Test;
@@ -71,4 +77,117 @@ void DummyNodeTest<ElemType>::SetMinibatch(size_t minibatchSize, SmallVector<siz
 }
 
 template class DummyNodeTest<float>;
-template class DummyNodeTest<double>;
\ No newline at end of file
+template class DummyNodeTest<double>;
+
+SoftmaxRegressionNetwork::SoftmaxRegressionNetwork()
+    : m_rng(0)
+{
+    m_net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*m_net);
+    auto x = builder.CreateInputNode(L"x", inputDim);
+    auto y = builder.CreateInputNode(L"y", numClasses);
+    auto W = builder.CreateLearnableParameter(L"W", numClasses, inputDim);
+    auto b = builder.CreateLearnableParameter(L"b", numClasses, 1);
+    auto z = builder.Plus(builder.Times(W, x, 1, L"Wx"), b, L"z");
+    m_criterion = builder.CrossEntropyWithSoftmax(y, z, L"ce");
+    m_evaluation = builder.ClassificationError(y, z, L"err");
+    m_net->AddToNodeGroup(L"feature", x);
+    m_net->AddToNodeGroup(L"label", y);
+    m_net->AddToNodeGroup(L"criterion", m_criterion);
+    m_net->AddToNodeGroup(L"evaluation", m_evaluation);
+    m_net->CompileNetwork();
+    m_net->Environment().SetOperationMode(NetworkOperationMode::training);
+
+    SetRandom(W->Value());
+    SetRandom(b->Value());
+    m_inputNodes = { x, y };
+    m_net->AllocateAllMatrices({ m_evaluation }, {}, m_criterion);
+    m_net->StartEvaluateMinibatchLoop(m_evaluation);
+    m_net->StartEvaluateMinibatchLoop(m_criterion);
+    m_learnableNodes = m_net->LearnableParameterNodes(m_criterion);
+}
+
+void SoftmaxRegressionNetwork::SetRandom(Matrix<float>& matrix)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> values(matrix.GetNumElements());
+    for (auto& value : values)
+        value = dist(m_rng);
+    matrix.SetValue(matrix.GetNumRows(), matrix.GetNumCols(), CPUDEVICE, values.data());
+}
+
+void SoftmaxRegressionNetwork::SetMinibatch(size_t numSamples)
+{
+    m_net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    auto x = dynamic_pointer_cast<ComputationNode<float>>(m_inputNodes[0]);
+    auto y = dynamic_pointer_cast<ComputationNode<float>>(m_inputNodes[1]);
+    x->Value().Resize(inputDim, numSamples);
+    SetRandom(x->Value());
+    std::vector<float> labels(numClasses * numSamples, 0);
+    for (size_t j = 0; j < numSamples; j++)
+        labels[j * numClasses + m_rng() % numClasses] = 1;
+    y->Value().SetValue(numClasses, numSamples, CPUDEVICE, labels.data());
+    for (const auto& node : m_inputNodes)
+    {
+        node->NotifyFunctionValuesMBSizeModified();
+        node->BumpEvalTimeStamp();
+    }
+}
+#ifndef _WIN32
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Defined in MPIWrapperShm.cpp.
+MPIWrapper* CreateMPIWrapperShm();
+
+bool Test::RunShmJob(int numProcesses, const std::vector<int>& ranks, const std::function<bool(MPIWrapper&)>& body,
+                     const char* timeoutSec)
+{
+    static int jobCount = 0;
+    std::string name = "cntk-shm-test-" + std::to_string(getpid()) + "-" + std::to_string(jobCount++);
+
+    std::vector<pid_t> children;
+    for (int rank : ranks)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            setenv("CNTK_SHM_NUM_PROCESSES", std::to_string(numProcesses).c_str(), 1);
+            setenv("CNTK_SHM_RANK", std::to_string(rank).c_str(), 1);
+            setenv("CNTK_SHM_NAME", name.c_str(), 1);
+            setenv("CNTK_SHM_BUFFER_MB", "1", 1); // so that larger data goes in chunks
+            setenv("CNTK_SHM_TIMEOUT_SEC", timeoutSec, 1);
+            int exitCode = 1;
+            try
+            {
+                MPIWrapperPtr mpi(CreateMPIWrapperShm());
+                if (body(*mpi))
+                    exitCode = 0;
+            }
+            catch (const std::exception& e)
+            {
+                fprintf(stderr, "rank %d: %s\n", rank, e.what());
+            }
+            _exit(exitCode);
+        }
+        children.push_back(pid);
+    }
+
+    bool succeeded = true;
+    for (pid_t pid : children)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        succeeded &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return succeeded;
+}
+
+bool Test::RunShmJob(int numProcesses, const std::function<bool(MPIWrapper&)>& body)
+{
+    std::vector<int> ranks(numProcesses);
+    std::iota(ranks.begin(), ranks.end(), 0);
+    return RunShmJob(numProcesses, ranks, body);
+}
+
+} } }
+#endif
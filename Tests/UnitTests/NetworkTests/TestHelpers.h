@@ -5,7 +5,12 @@
 
 #pragma once
 
+#include "ComputationNetwork.h"
 #include "ComputationNode.h"
+#include "MPIWrapper.h"
+#include <functional>
+#include <list>
+#include <random>
 #include <vector>
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -41,4 +46,37 @@ public:
 
     void SetMinibatch(size_t minibatchSize, SmallVector<size_t> sampleDimensions, std::vector<ElemType>& data);
 };
+
+// A softmax regression on the CPU, z = W * x + b, with a cross-entropy criterion "ce" and a classification-error
+// evaluation node "err". The network is compiled in training mode with the matrices of both nodes allocated, and W and
+// b are random. Used as a base class of test fixtures, which get the network and its nodes as members.
+struct SoftmaxRegressionNetwork
+{
+    const size_t inputDim = 3, numClasses = 2;
+
+    SoftmaxRegressionNetwork();
+
+    void SetRandom(Matrix<float>& matrix);
+
+    // Puts a minibatch of random samples into the input nodes.
+    void SetMinibatch(size_t numSamples);
+
+    std::mt19937 m_rng;
+    ComputationNetworkPtr m_net;
+    ComputationNodeBasePtr m_criterion;
+    ComputationNodeBasePtr m_evaluation;
+    std::vector<ComputationNodeBasePtr> m_inputNodes;
+    std::list<ComputationNodeBasePtr> m_learnableNodes;
+};
+
+#ifndef _WIN32
+// Starts the given ranks of a job of numProcesses processes that communicate through the shared-memory MPIWrapper,
+// runs the body in each, and returns whether all of them returned true. Every rank is a forked process, which creates
+// its own MPIWrapperShm (it is a singleton per process), held by a shared_ptr, and reports through its exit code.
+bool RunShmJob(int numProcesses, const std::vector<int>& ranks, const std::function<bool(MPIWrapper&)>& body,
+               const char* timeoutSec = "30");
+
+// Same, with all ranks.
+bool RunShmJob(int numProcesses, const std::function<bool(MPIWrapper&)>& body);
+#endif
 } } } }
\ No newline at end of file
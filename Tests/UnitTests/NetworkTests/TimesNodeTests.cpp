@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include "../../../Source/ComputationNetworkLib/InputAndParamNodes.h"
+#include "TestHelpers.h"
+#include <memory>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// The quantized product is only implemented on the CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// Extends times node to provide access to protected members.
+template <class ElemType>
+class TimesNodeTest : public TimesNode<ElemType>
+{
+public:
+    TimesNodeTest(DEVICEID_TYPE deviceId, bool quantizedGemm)
+        : TimesNode<ElemType>(deviceId, L"TimesNodeTest", 1, TimesNode<ElemType>::NoInferredInputRank, quantizedGemm)
+    {
+    }
+
+    using TimesNodeBase<ElemType, false>::Validate;
+
+    void ForwardPass()
+    {
+        this->CreateValueMatrixIfNull();
+        this->BeginForwardProp();
+        this->ForwardProp(FrameRange(this->GetMBLayout()));
+        this->EndForwardProp();
+    }
+
+    bool IsQuantized() const { return this->m_pQuantizedMultiplier != nullptr; }
+};
+
+struct TimesNodeQuantizedGemmFixture
+{
+    // W[m,k] * X[k,n], with random values, so that quantizing them changes the product
+    const size_t m = 5, k = 40, n = 3;
+
+    TimesNodeQuantizedGemmFixture()
+    {
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        vector<float> weights(m * k);
+        for (auto& w : weights) w = dist(rng);
+        for (auto& x : m_inputValues) x = dist(rng);
+
+        m_weights = make_shared<LearnableParameter<float>>(c_deviceId, L"W", m, k);
+        m_weights->Value().SetValue(m, k, c_deviceId, weights.data());
+        m_input = make_shared<DummyNodeTest<float>>(c_deviceId, n, SmallVector<size_t>{k}, m_inputValues);
+
+        m_expected.assign(m * n, 0);
+        for (size_t j = 0; j < n; j++)
+            for (size_t i = 0; i < m; i++)
+                for (size_t l = 0; l < k; l++)
+                    m_expected[j * m + i] += weights[l * m + i] * m_inputValues[j * k + l];
+
+        m_environment = make_shared<ComputationEnvironment>();
+    }
+
+    shared_ptr<TimesNodeTest<float>> CreateTimesNode(bool quantizedGemm)
+    {
+        auto times = make_shared<TimesNodeTest<float>>(c_deviceId, quantizedGemm);
+        times->AttachInputs({m_weights, m_input});
+        times->SetEnvironment(m_environment);
+        times->Validate(true);
+        return times;
+    }
+
+    void SetMode(NetworkOperationMode mode) { m_environment->networkOperationMode = mode; }
+
+    bool IsOutputEqualTo(const TimesNodeTest<float>& times, float threshold) const
+    {
+        return AreEqual(m_expected.data(), times.Value().Data(), m_expected.size(), threshold);
+    }
+
+    vector<float> m_inputValues = vector<float>(k * n);
+    vector<float> m_expected;
+    shared_ptr<LearnableParameter<float>> m_weights;
+    shared_ptr<DummyNodeTest<float>> m_input;
+    ComputationEnvironmentPtr m_environment;
+};
+
+BOOST_AUTO_TEST_SUITE(TimesNodeTestSuite)
+
+BOOST_FIXTURE_TEST_CASE(TimesNodeQuantizesOnlyWhenInferring, TimesNodeQuantizedGemmFixture)
+{
+    auto times = CreateTimesNode(/*quantizedGemm=*/true);
+
+    // The weights are learnable, but the network only evaluates, so they are quantized.
+    SetMode(NetworkOperationMode::inferring);
+    times->ForwardPass();
+    BOOST_CHECK(times->IsQuantized());
+    BOOST_CHECK(IsOutputEqualTo(*times, 0.05f));
+
+    // Training computes the exact product and drops the quantized weights.
+    SetMode(NetworkOperationMode::training);
+    times->ForwardPass();
+    BOOST_CHECK(!times->IsQuantized());
+    BOOST_CHECK(IsOutputEqualTo(*times, 1e-5f));
+
+    // So does the precomputation, which is part of training.
+    SetMode(NetworkOperationMode::preComputing);
+    times->ForwardPass();
+    BOOST_CHECK(!times->IsQuantized());
+
+    // Evaluating again (e.g. the cross-validation during training) quantizes the weights again.
+    SetMode(NetworkOperationMode::inferring);
+    times->ForwardPass();
+    BOOST_CHECK(times->IsQuantized());
+    BOOST_CHECK(IsOutputEqualTo(*times, 0.05f));
+}
+
+BOOST_FIXTURE_TEST_CASE(TimesNodeDoesNotQuantizeByDefault, TimesNodeQuantizedGemmFixture)
+{
+    auto times = CreateTimesNode(/*quantizedGemm=*/false);
+
+    SetMode(NetworkOperationMode::inferring);
+    times->ForwardPass();
+    BOOST_CHECK(!times->IsQuantized());
+    BOOST_CHECK(IsOutputEqualTo(*times, 1e-5f));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
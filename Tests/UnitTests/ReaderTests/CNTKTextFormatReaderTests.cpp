@@ -16,6 +16,7 @@
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
 #include "TextParser.h"
+#include "TextToBinaryConverter.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -33,13 +34,14 @@ public:
     ChunkPtr m_chunk;
 
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, size_t numParsingThreads = 0) :
         m_parser(std::make_shared<CorpusDescriptor>(true), wstring(filename.begin(), filename.end()), streams, true)
     {
         m_parser.SetMaxAllowedErrors(maxErrors);
         m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
         m_parser.SetChunkSize(SIZE_MAX);
         m_parser.SetNumRetries(0);
+        m_parser.SetNumParsingThreads(numParsingThreads);
         m_parser.Initialize();
     }
     // Retrieves a chunk of data.
@@ -895,6 +897,152 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_extra_input_should_be_ignored)
     }
 };
 
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_parallel_chunk_parsing)
+{
+    vector<StreamDescriptor> streams(2);
+    streams[0].m_alias = "A";
+    streams[0].m_name = L"A";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = 3;
+
+    streams[1].m_alias = "B";
+    streams[1].m_name = L"B";
+    streams[1].m_storageType = StorageType::sparse_csc;
+    streams[1].m_sampleDimension = 10;
+
+    string filename = "parallel_chunk_parsing.txt";
+    const size_t numSequences = 200;
+    {
+        boost::filesystem::remove(filename);
+        std::ofstream file;
+        file.open(filename, std::ofstream::out);
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            for (size_t j = 0; j <= i % 4; j++)
+            {
+                file << i << " |A " << i << " -" << j << ".5 " << (i + j) << "e-3"
+                     << "\t|B " << (i % 10) << ":" << j << ".25\n";
+            }
+        }
+    }
+
+    // the same data, whether the chunk is parsed on one thread or several
+    CNTKTextFormatReaderTestRunner<float> sequential(filename, streams, 0, 1);
+    CNTKTextFormatReaderTestRunner<float> parallel(filename, streams, 0, 4);
+    sequential.LoadChunk();
+    parallel.LoadChunk();
+    for (size_t i = 0; i < numSequences; i++)
+    {
+        vector<SequenceDataPtr> expected, actual;
+        sequential.m_chunk->GetSequence(i, expected);
+        parallel.m_chunk->GetSequence(i, actual);
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+
+        BOOST_REQUIRE_EQUAL(actual[0]->m_numberOfSamples, i % 4 + 1);
+        BOOST_REQUIRE_EQUAL(actual[0]->m_key.m_sequence, expected[0]->m_key.m_sequence);
+        auto expectedDense = reinterpret_cast<const float*>(expected[0]->GetDataBuffer());
+        auto actualDense = reinterpret_cast<const float*>(actual[0]->GetDataBuffer());
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(actualDense, actualDense + 3 * actual[0]->m_numberOfSamples,
+            expectedDense, expectedDense + 3 * expected[0]->m_numberOfSamples);
+
+        auto expectedSparse = static_pointer_cast<SparseSequenceData>(expected[1]);
+        auto actualSparse = static_pointer_cast<SparseSequenceData>(actual[1]);
+        BOOST_REQUIRE_EQUAL(actualSparse->m_totalNnzCount, expectedSparse->m_totalNnzCount);
+        auto expectedValues = reinterpret_cast<const float*>(expectedSparse->GetDataBuffer());
+        auto actualValues = reinterpret_cast<const float*>(actualSparse->GetDataBuffer());
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(actualValues, actualValues + actualSparse->m_totalNnzCount,
+            expectedValues, expectedValues + expectedSparse->m_totalNnzCount);
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(actualSparse->m_indices, actualSparse->m_indices + actualSparse->m_totalNnzCount,
+            expectedSparse->m_indices, expectedSparse->m_indices + expectedSparse->m_totalNnzCount);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_parallel_chunk_parsing_shares_error_budget)
+{
+    vector<StreamDescriptor> streams(1);
+    streams[0].m_alias = "A";
+    streams[0].m_name = L"A";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = 1;
+
+    // one malformed row at the beginning and one at the end, parsed by different threads;
+    // each of them counts as three errors (the sample, the row and the sequence)
+    string filename = "parallel_chunk_parsing_errors.txt";
+    {
+        boost::filesystem::remove(filename);
+        std::ofstream file;
+        file.open(filename, std::ofstream::out);
+        for (size_t i = 0; i < 100; i++)
+        {
+            file << i << " |A 1\n";
+            if (i == 0 || i == 99)
+                file << i << " |A 1.+\n";
+        }
+    }
+
+    CNTKTextFormatReaderTestRunner<float> withinBudget(filename, streams, 6, 4);
+    withinBudget.LoadChunk();
+
+    CNTKTextFormatReaderTestRunner<float> overBudget(filename, streams, 5, 4);
+    BOOST_REQUIRE_EXCEPTION(
+        overBudget.LoadChunk(),
+        std::runtime_error,
+        [](std::runtime_error const& ex)
+    {
+        return string("Reached the maximum number of allowed errors"
+            " while reading the input file (parallel_chunk_parsing_errors.txt).") == ex.what();
+    });
+};
+
+// the converted dense files must be identical to those made with Scripts/ctf2bin.py for the CNTKBinaryReader tests
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_convert_to_binary)
+{
+    auto test = [](const string& textFile, const string& binaryFile, const string& input)
+    {
+        string outputFile = "converted_" + binaryFile;
+        ConfigParameters config;
+        config.Parse("file=" + textFile + ";outputFile=" + outputFile + ";precision=float;traceLevel=0;"
+                     "numEncodingThreads=3;input=[" + input + "]");
+        TextToBinaryConverter(config).Convert();
+
+        std::ifstream expected("../CNTKBinaryReader/" + binaryFile, std::ifstream::binary);
+        std::ifstream actual(outputFile, std::ifstream::binary);
+        std::istreambuf_iterator<char> end;
+        vector<char> expectedBytes((std::istreambuf_iterator<char>(expected)), end);
+        vector<char> actualBytes((std::istreambuf_iterator<char>(actual)), end);
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(actualBytes.begin(), actualBytes.end(), expectedBytes.begin(), expectedBytes.end());
+    };
+
+    test("10x10_dense.txt", "10x10_dense.bin", "features=[alias=F0;dim=5;format=dense]");
+    test("Simple_dense.txt", "Simple_dense.bin", "features=[alias=F;dim=2;format=dense];labels=[alias=L;dim=2;format=dense]");
+
+    // Sparse values may differ from those of ctf2bin.py in the last bit, so the converted file is read back instead:
+    // the CNTKBinaryReader must return the same minibatches as the CNTKTextFormatReader does for the text file.
+    auto testSparse = [this](const string& name, size_t epochSize)
+    {
+        const string input = "input=[features=[alias=F0;dim=100;format=sparse]]";
+        string binaryFile = "converted_" + name + ".bin";
+        ConfigParameters config;
+        config.Parse("file=" + name + ".txt;outputFile=" + binaryFile + ";precision=float;traceLevel=0;numEncodingThreads=3;" + input);
+        TextToBinaryConverter(config).Convert();
+
+        auto read = [this, epochSize](const string& readerConfig, const string& outputFile)
+        {
+            ConfigParameters config;
+            config.Parse("precision=float;randomize=false;" + readerConfig);
+            DataReader reader(config);
+            auto inputs = CreateStreamMinibatchInputs<float>(1, 0, /*sparseFeatures=*/true);
+            HelperWriteReaderContentToFile<float>(outputFile, reader, *inputs, 1, epochSize, epochSize, 1, 0, 0, 1);
+        };
+        read("readerType=CNTKTextFormatReader;file=" + name + ".txt;" + input, name + "_text_Output.txt");
+        read("readerType=CNTKBinaryReader;file=" + binaryFile, name + "_binary_Output.txt");
+        CheckFilesEquivalent(name + "_text_Output.txt", name + "_binary_Output.txt");
+    };
+
+    testSparse("10x10_sparse", 100);
+    testSparse("50x20_jagged_sequences_sparse", 564);
+};
+
 // 100 sequences with N samples for each of 3 inputs, where N is chosen at random
 // from [1, 100] for each sequence
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100x3)
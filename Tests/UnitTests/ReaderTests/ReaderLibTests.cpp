@@ -9,6 +9,7 @@
 #include "NoRandomizer.h"
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
+#include "ChunkCache.h"
 #include "CorpusDescriptor.h"
 #include "FramePacker.h"
 #include "SequencePacker.h"
@@ -16,6 +17,8 @@
 #include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
 #include "MemoryBuffer.h"
+#include "Indexer.h"
+#include "IndexCache.h"
 
 #pragma warning(push)
 // disable warning about possible mod 0 operation in uniform_int_distribution
@@ -2116,6 +2119,328 @@ BOOST_AUTO_TEST_CASE(TestTruncatedBpttPacker)
     BOOST_TEST(!mb.m_endOfSweep);
 }
 
+BOOST_AUTO_TEST_CASE(ChunkCacheEvictsChunksNeededLast)
+{
+    // 10 chunks of 10 sequences of 10 float samples, i.e. 400 bytes each.
+    vector<float> data(100);
+    iota(data.begin(), data.end(), 0.0f);
+    auto deserializer = make_shared<ReaderLibTests::MockDeserializer>(10, 10, data, 10);
+
+    // Room for two chunks, no prefetching.
+    ChunkCache cache(deserializer, 1000, 0);
+    auto getChunks = [&](const vector<ChunkIdType>& chunkIds)
+    {
+        for (auto chunkId : chunkIds)
+            BOOST_CHECK(cache.GetChunk(chunkId) != nullptr);
+    };
+
+    cache.SetChunkSchedule({ 0, 1, 2, 3 });
+    getChunks({ 0, 1, 2, 3 });
+    auto statistics = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_misses, 4u);
+    BOOST_CHECK_EQUAL(statistics.m_hits, 0u);
+    BOOST_CHECK_EQUAL(statistics.m_evictions, 2u);
+    BOOST_CHECK_EQUAL(statistics.m_sizeInBytes, 800u);
+
+    // Chunk 3 was used last, but chunk 2 is needed again in this sweep, so chunk 3 is evicted for chunk 0.
+    cache.SetChunkSchedule({ 3, 0, 2, 1 });
+    getChunks({ 3, 0, 2 });
+    statistics = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_hits, 2u);
+    BOOST_CHECK_EQUAL(statistics.m_misses, 5u);
+    BOOST_CHECK_EQUAL(statistics.m_evictions, 3u);
+
+    // Without a schedule, the least recently used chunk is evicted.
+    cache.SetChunkSchedule({});
+    getChunks({ 0, 5, 0, 2 });
+    statistics = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_hits, 4u);
+    BOOST_CHECK_EQUAL(statistics.m_misses, 7u);
+    BOOST_CHECK_EQUAL(statistics.m_evictions, 5u);
+    BOOST_CHECK_EQUAL(statistics.m_prefetches, 0u);
+
+    // Chunks that do not fit at all are not cached.
+    ChunkCache tinyCache(deserializer, 100, 0);
+    BOOST_CHECK(tinyCache.GetChunk(0) != nullptr);
+    BOOST_CHECK(tinyCache.GetChunk(0) != nullptr);
+    BOOST_CHECK_EQUAL(tinyCache.GetStatistics().m_misses, 2u);
+    BOOST_CHECK_EQUAL(tinyCache.GetStatistics().m_sizeInBytes, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkCachePrefetchesScheduledChunks)
+{
+    vector<float> data(100);
+    iota(data.begin(), data.end(), 0.0f);
+    auto deserializer = make_shared<ReaderLibTests::MockDeserializer>(10, 10, data, 10);
+    ChunkCache cache(deserializer, 1000, 2);
+
+    auto waitForPrefetches = [&](size_t count)
+    {
+        for (int i = 0; i < 1000 && cache.GetStatistics().m_prefetches < count; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        BOOST_REQUIRE_EQUAL(cache.GetStatistics().m_prefetches, count);
+    };
+
+    cache.SetChunkSchedule({ 4, 7, 1, 9 });
+    waitForPrefetches(2);
+    BOOST_CHECK(cache.GetChunk(4) != nullptr);
+    BOOST_CHECK_EQUAL(cache.GetStatistics().m_hits, 1u);
+
+    // Chunk 1 fits after evicting chunk 4, which has been used already.
+    waitForPrefetches(3);
+    BOOST_CHECK(cache.GetChunk(7) != nullptr);
+    BOOST_CHECK(cache.GetChunk(1) != nullptr);
+
+    // Then chunk 7 is evicted for chunk 9.
+    waitForPrefetches(4);
+    BOOST_CHECK(cache.GetChunk(9) != nullptr);
+    auto statistics = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_hits, 4u);
+    BOOST_CHECK_EQUAL(statistics.m_misses, 0u);
+    BOOST_CHECK_EQUAL(statistics.m_evictions, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerWithBoundedChunkCache)
+{
+    size_t chunkSizeInSamples = 1000;
+    size_t sweepNumberOfSamples = 50000;
+    uint32_t maxSequenceLength = 30;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    // Room for about a third of the chunks.
+    auto cache = make_shared<ChunkCache>(deserializer, sweepNumberOfSamples * sizeof(float) / 3);
+    auto expected = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false);
+    auto underTest = make_shared<BlockRandomizer>(0, randomizationWindow, cache, true, false);
+
+    for (size_t epoch = 0; epoch < 3; ++epoch)
+    {
+        auto expectedEpoch = ReadFullEpoch(expected, sweepNumberOfSamples, epoch);
+        auto actualEpoch = ReadFullEpoch(underTest, sweepNumberOfSamples, epoch);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expectedEpoch.begin(), expectedEpoch.end(), actualEpoch.begin(), actualEpoch.end());
+    }
+
+    auto statistics = cache->GetStatistics();
+    BOOST_CHECK(statistics.m_hits > 0);
+    BOOST_CHECK(statistics.m_evictions > 0);
+    BOOST_CHECK(statistics.m_sizeInBytes <= sweepNumberOfSamples * sizeof(float) / 3);
+}
+
+// Builds the index of the given text with the given number of threads, with a new corpus descriptor each time
+// (so that symbolic keys are assigned the same ids in the same order).
+static void CheckParallelIndexerMatchesSequential(const string& text, bool numericKeys, const string& mainStream, size_t bufferSize)
+{
+    FILE* test = fopen("test.tmp", "w+b");
+    fwrite(text.c_str(), 1, text.size(), test);
+    fclose(test);
+
+    auto buildIndex = [&](size_t numberOfThreads, vector<tuple<size_t, uint32_t, uint32_t, uint32_t>>& sequences, vector<pair<size_t, size_t>>& chunks)
+    {
+        FILE* file = fopen("test.tmp", "rb");
+        Indexer indexer(file, false, false, '|', 256, mainStream, bufferSize, numberOfThreads);
+        indexer.Build(make_shared<CorpusDescriptor>(numericKeys));
+        for (const auto& chunk : indexer.GetIndex().Chunks())
+        {
+            chunks.push_back(make_pair(chunk.m_offset, chunk.SizeInBytes()));
+            for (const auto& sequence : chunk.Sequences())
+                sequences.push_back(make_tuple(sequence.m_key, sequence.m_numberOfSamples, sequence.OffsetInChunk(), sequence.SizeInBytes()));
+        }
+        BOOST_CHECK_EQUAL(_ftelli64(file), (int64_t)text.size());
+        fclose(file);
+    };
+
+    vector<tuple<size_t, uint32_t, uint32_t, uint32_t>> expectedSequences;
+    vector<pair<size_t, size_t>> expectedChunks;
+    buildIndex(1, expectedSequences, expectedChunks);
+    BOOST_REQUIRE(!expectedSequences.empty());
+
+    for (size_t numberOfThreads : { 2, 3, 7, 16, 64 })
+    {
+        vector<tuple<size_t, uint32_t, uint32_t, uint32_t>> sequences;
+        vector<pair<size_t, size_t>> chunks;
+        buildIndex(numberOfThreads, sequences, chunks);
+        BOOST_CHECK(expectedSequences == sequences);
+        BOOST_CHECK(expectedChunks == chunks);
+    }
+
+    remove("test.tmp");
+}
+
+BOOST_AUTO_TEST_CASE(ParallelIndexerMatchesSequential)
+{
+    std::mt19937 rng(17);
+    boost::random::uniform_int_distribution<int> distr(0, 99);
+
+    // Sequences of up to 5 lines, with and without ids on the continuation lines, some of them with the main stream |b.
+    auto generate = [&](bool numericKeys, bool withBOM, bool withLastNewLine)
+    {
+        string text = withBOM ? "\xEF\xBB\xBF" : "";
+        for (int sequence = 0; sequence < 200; sequence++)
+        {
+            string key = numericKeys ? std::to_string(sequence % 7 == 6 ? sequence - 1 : sequence) : "seq" + std::to_string(distr(rng) % 50);
+            int numberOfLines = 1 + distr(rng) % 5;
+            for (int line = 0; line < numberOfLines; line++)
+            {
+                if (line == 0 || distr(rng) < 50)
+                    text += key;
+                text += distr(rng) < 50 ? "\t|a 1 2 3" : "\t|a 4 |b 5 6";
+                text += distr(rng) < 10 ? "\r\n" : "\n";
+            }
+        }
+        if (!withLastNewLine)
+            text += numericKeys ? "999\t|a 1" : "last\t|a 1";
+        return text;
+    };
+
+    for (bool numericKeys : { true, false })
+        for (bool withBOM : { false, true })
+            for (bool withLastNewLine : { true, false })
+            {
+                auto text = generate(numericKeys, withBOM, withLastNewLine);
+                CheckParallelIndexerMatchesSequential(text, numericKeys, "", 2 * 1024 * 1024);
+                CheckParallelIndexerMatchesSequential(text, numericKeys, "", 37);
+                CheckParallelIndexerMatchesSequential(text, numericKeys, "|b", 2 * 1024 * 1024);
+            }
+
+    // Each line is a sequence when there are no sequence ids.
+    string lines;
+    for (int line = 0; line < 500; line++)
+        lines += distr(rng) < 5 ? "\n" : "|a 1 2 3\n";
+    CheckParallelIndexerMatchesSequential(lines, true, "", 2 * 1024 * 1024);
+    CheckParallelIndexerMatchesSequential(lines + "|a 1", true, "", 29);
+}
+
+// Sequences and chunks of the index as (key, samples, offset in chunk, size) and (offset, size) tuples.
+typedef pair<vector<tuple<size_t, uint32_t, uint32_t, uint32_t>>, vector<pair<size_t, size_t>>> IndexContents;
+
+static IndexContents GetIndexContents(const Index& index)
+{
+    IndexContents result;
+    for (const auto& chunk : index.Chunks())
+    {
+        result.second.push_back(make_pair(chunk.m_offset, chunk.SizeInBytes()));
+        for (const auto& sequence : chunk.Sequences())
+            result.first.push_back(make_tuple(sequence.m_key, sequence.m_numberOfSamples, sequence.OffsetInChunk(), sequence.SizeInBytes()));
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(IndexCacheRestoresIndex)
+{
+    const wstring cachePath = IndexCache::GetPathFor(L"test.tmp");
+    auto writeText = [](const string& text)
+    {
+        FILE* test = fopen("test.tmp", "wb");
+        fwrite(text.c_str(), 1, text.size(), test);
+        fclose(test);
+    };
+
+    // Builds the index, optionally with the cache; the corpus already knows some other keys, as it would if
+    // another deserializer had been initialized first. Also returns the ids of some keys and the keys of all sequences.
+    auto buildIndex = [&](bool numericKeys, bool useCache, vector<string>& ids)
+    {
+        auto corpus = make_shared<CorpusDescriptor>(numericKeys);
+        if (!numericKeys)
+            corpus->KeyToId("other");
+        FILE* file = fopen("test.tmp", "rb");
+        Indexer indexer(file, false, false, '|', 256, "", 2 * 1024 * 1024, 1);
+        indexer.Build(corpus, useCache ? cachePath : L"");
+        BOOST_CHECK_EQUAL(_ftelli64(file), (int64_t)filesize(file));
+        BOOST_CHECK(indexer.HasSequenceIds());
+        fclose(file);
+        if (!numericKeys)
+        {
+            for (const string& key : { "other", "b", "a", "c" })
+                ids.push_back(std::to_string(corpus->KeyToId(key)));
+            for (const auto& chunk : indexer.GetIndex().Chunks())
+                for (const auto& sequence : chunk.Sequences())
+                    ids.push_back(corpus->IdToKey(sequence.m_key));
+        }
+        return GetIndexContents(indexer.GetIndex());
+    };
+
+    for (bool numericKeys : { true, false })
+    {
+        string text;
+        for (int sequence = 0; sequence < 100; sequence++)
+        {
+            string key = numericKeys ? std::to_string(sequence) : string(1, "bac"[sequence % 3]) + std::to_string(sequence);
+            for (int line = 0; line < 1 + sequence % 4; line++)
+                text += key + "\t|a 1 2 3\n";
+        }
+        // The last three sequences, in the order their keys are seen.
+        text += numericKeys ? "100\t|a 1\n101\t|a 2\n102\t|a 3\n" : "b\t|a 1\na\t|a 2\nc\t|a 3\n";
+        writeText(text);
+        _wunlink(cachePath.c_str());
+
+        vector<string> expectedIds, ids;
+        auto expected = buildIndex(numericKeys, false, expectedIds);
+
+        // Round trip through IndexCache directly, which also checks that the cache is actually used.
+        {
+            FILE* file = fopen("test.tmp", "rb");
+            auto corpus = make_shared<CorpusDescriptor>(numericKeys);
+            Index index(64, false, true);
+            IndexCache cache(cachePath, file, "test");
+            auto keyToId = cache.GetKeyToId(corpus);
+            index.AddSequence(SequenceDescriptor{ numericKeys ? 3 : keyToId("k3"), 2 }, 0, 40);
+            index.AddSequence(SequenceDescriptor{ numericKeys ? 1 : keyToId("k1"), 1 }, 40, 100);
+            index.AddSequence(SequenceDescriptor{ numericKeys ? 2 : keyToId("k2"), 3 }, 100, 110);
+            cache.Save(corpus, index, 5);
+
+            auto otherCorpus = make_shared<CorpusDescriptor>(numericKeys);
+            IndexCache otherCache(cachePath, file, "test");
+            Index otherIndex(64, false, true);
+            uint32_t flags = 0;
+            BOOST_REQUIRE(otherCache.TryLoad(otherCorpus, otherIndex, flags));
+            BOOST_CHECK_EQUAL(flags, 5u);
+            BOOST_CHECK(GetIndexContents(otherIndex) == GetIndexContents(index));
+            BOOST_CHECK(otherIndex.Chunks()[0].SequenceOffsetInSamples() == index.Chunks()[0].SequenceOffsetInSamples());
+            if (!numericKeys)
+                BOOST_CHECK_EQUAL(otherCorpus->IdToKey(otherIndex.Chunks()[1].Sequences()[0].m_key), "k1");
+
+            // Different parameters.
+            IndexCache differentCache(cachePath, file, "different");
+            Index differentIndex(64, false, true);
+            BOOST_CHECK(!differentCache.TryLoad(make_shared<CorpusDescriptor>(numericKeys), differentIndex, flags));
+            BOOST_CHECK(differentIndex.IsEmpty());
+            fclose(file);
+        }
+
+        // Writes the cache.
+        BOOST_CHECK(buildIndex(numericKeys, true, ids) == expected);
+        BOOST_CHECK(ids == expectedIds);
+        BOOST_REQUIRE(fexists(cachePath));
+
+        // Reads the cache.
+        ids.clear();
+        BOOST_CHECK(buildIndex(numericKeys, true, ids) == expected);
+        BOOST_CHECK(ids == expectedIds);
+
+        // A change of the content (with the same size) invalidates the cache.
+        text[text.size() - 2] = '4';
+        text.replace(0, 1, numericKeys ? "7" : "x");
+        writeText(text);
+        expectedIds.clear();
+        expected = buildIndex(numericKeys, false, expectedIds);
+        ids.clear();
+        BOOST_CHECK(buildIndex(numericKeys, true, ids) == expected);
+        BOOST_CHECK(ids == expectedIds);
+
+        // Corrupt caches are ignored.
+        FILE* cache = _wfopen(cachePath.c_str(), L"r+b");
+        fseek(cache, -20, SEEK_END);
+        fputc('?', cache);
+        fclose(cache);
+        ids.clear();
+        BOOST_CHECK(buildIndex(numericKeys, true, ids) == expected);
+        BOOST_CHECK(ids == expectedIds);
+    }
+
+    _wunlink(cachePath.c_str());
+    remove("test.tmp");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
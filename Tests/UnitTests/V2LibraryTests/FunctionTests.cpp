@@ -6,6 +6,7 @@
 #include "CNTKLibrary.h"
 #include "Common.h"
 #include <numeric>
+#include <thread>
 
 using namespace CNTK;
 
@@ -1096,6 +1097,64 @@ void SetRandomSeed(const DeviceDescriptor& device)
     FloatingPointVectorCompare(result2, result4, "SetRandomSeed: output does match the expected after resetting the dropout seed.");
 }
 
+void TestBatchingEvaluator(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 5;
+    const size_t outputDim = 3;
+    const size_t numClients = 4;
+    const size_t numRequestsPerClient = 10;
+    const size_t maxSequenceLength = 7;
+
+    auto input = InputVariable({ inputDim }, DataType::Float, L"input");
+    auto timesParam = Parameter({ outputDim, inputDim }, DataType::Float, GlorotUniformInitializer(), device);
+    auto model = Plus(Times(timesParam, input), Constant::Scalar(1.0f));
+
+    auto sequenceLengths = GenerateSequenceLengths(numClients * numRequestsPerClient, maxSequenceLength);
+    auto sequences = GenerateSequences<float>(sequenceLengths, input.Shape());
+    std::vector<std::vector<std::vector<float>>> results(sequences.size());
+    {
+        auto evaluator = CreateBatchingEvaluator(model, numClients, std::chrono::microseconds(5000), device);
+
+        // Each client submits its requests one after the other, so that the requests of different clients get batched.
+        std::vector<std::thread> clients;
+        for (size_t c = 0; c < numClients; ++c)
+        {
+            clients.emplace_back([&, c]
+            {
+                for (size_t r = c * numRequestsPerClient; r < (c + 1) * numRequestsPerClient; ++r)
+                {
+                    auto outputs = evaluator->Evaluate({ { input, Value::CreateSequence(input.Shape(), sequences[r], device) } });
+                    outputs.at(model->Output())->CopyVariableValueTo(model->Output(), results[r]);
+                }
+            });
+        }
+        for (auto& client : clients)
+            client.join();
+
+        auto statistics = evaluator->Statistics();
+        size_t numRequests = 0;
+        for (size_t n = 0; n < statistics.batchSizeHistogram.size(); ++n)
+            numRequests += n * statistics.batchSizeHistogram[n];
+        BOOST_TEST(numRequests == sequences.size());
+        BOOST_TEST(std::accumulate(statistics.queueDelayHistogram.begin(), statistics.queueDelayHistogram.end(), (size_t)0) == sequences.size());
+
+        // Requests with the wrong number of sequences are rejected by the caller's thread.
+        auto twoSequences = Value::Create(input.Shape(), std::vector<std::vector<float>>{ sequences[0], sequences[1] }, device);
+        VerifyException([&]() { evaluator->Evaluate({ { input, twoSequences } }); }, "Was able to evaluate a request with 2 sequences.");
+    }
+
+    // Each result must be the same as evaluating the request on its own.
+    for (size_t r = 0; r < sequences.size(); ++r)
+    {
+        std::unordered_map<Variable, ValuePtr> outputs = { { model->Output(), nullptr } };
+        model->Evaluate({ { input, Value::CreateSequence(input.Shape(), sequences[r], device) } }, outputs, device);
+        std::vector<std::vector<float>> expected;
+        outputs[model->Output()]->CopyVariableValueTo(model->Output(), expected);
+        BOOST_TEST(results[r].size() == 1);
+        FloatingPointVectorCompare(results[r][0], expected[0], "TestBatchingEvaluator: batched output does not match the output of the request evaluated on its own.");
+    }
+}
+
 BOOST_AUTO_TEST_SUITE(FunctionSuite)
 
 BOOST_AUTO_TEST_CASE(FindNameInCPU)
@@ -1222,6 +1281,12 @@ BOOST_AUTO_TEST_CASE(TestSettingRandomSeed)
         SetRandomSeed(DeviceDescriptor::GPUDevice(0));
 }
 
+BOOST_AUTO_TEST_CASE(BatchingEvaluatorInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestBatchingEvaluator(DeviceDescriptor::CPUDevice());
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
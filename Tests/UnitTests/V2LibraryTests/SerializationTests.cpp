@@ -13,6 +13,8 @@
 #include <vector>
 #include <functional>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
 using namespace CNTK;
 using namespace std;
@@ -410,6 +412,58 @@ void TestFunctionSaveAndLoad(const FunctionPtr& function, const DeviceDescriptor
     }
 }
 
+#ifndef _WIN32
+// Returns true if the address lies within a mapping of a file with the given name (according to /proc/self/maps).
+static bool IsInMappingOf(const void* address, const std::string& filename)
+{
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        if (line.size() < filename.size() || line.compare(line.size() - filename.size(), filename.size(), filename) != 0)
+            continue;
+        uintptr_t begin, end;
+        char dash;
+        std::istringstream(line) >> std::hex >> begin >> dash >> end;
+        if ((uintptr_t)address >= begin && (uintptr_t)address < end)
+            return true;
+    }
+    return false;
+}
+#endif
+
+void TestMappableFunctionSaveAndLoad(const DeviceDescriptor& device)
+{
+    auto file = L"TestMappableFunctionSaveAndLoad.out";
+    auto inputVar = InputVariable({ 20 }, false, DataType::Float, L"features");
+    auto function = BuildFFClassifierNet(inputVar, 5, device);
+
+    function->Save(file, ModelFormat::CNTKv2Mappable);
+    auto reloadedFunction = Function::Load(file, device);
+    if (!AreEqual(function, reloadedFunction))
+        BOOST_ERROR("TestMappableFunctionSaveAndLoad: original and reloaded functions are not identical.");
+
+#ifndef _WIN32
+    // On the CPU, the parameter values are used in place (zero-copy).
+    if (device.Type() == DeviceKind::CPU)
+    {
+        for (auto& parameter : reloadedFunction->Parameters())
+            BOOST_CHECK(IsInMappingOf(parameter.Value()->DataBuffer<float>(), "TestMappableFunctionSaveAndLoad.out"));
+    }
+#endif
+
+    // Updates of the (mapped) parameters must not change the model file.
+    for (auto& parameter : reloadedFunction->Parameters())
+        parameter.Value()->SetValue(1.0f);
+    if (!AreEqual(function, Function::Load(file, device)))
+        BOOST_ERROR("TestMappableFunctionSaveAndLoad: updating the parameters of a loaded function changed the model file.");
+
+    // Restoring from a memory-mappable model file.
+    reloadedFunction->Restore(file);
+    if (!AreEqual(function, reloadedFunction))
+        BOOST_ERROR("TestMappableFunctionSaveAndLoad: original and restored functions are not identical.");
+}
+
 void TestFunctionsForEquality(const DeviceDescriptor& device)
 {
     auto inputVar = InputVariable({ 2 }, false, DataType::Float, L"features");
@@ -1005,6 +1059,11 @@ BOOST_AUTO_TEST_CASE(FunctionSerializationInCPU)
     TestFunctionSerialization(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(MappableFunctionSerializationInCPU)
+{
+    TestMappableFunctionSaveAndLoad(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(ModelSerializationDuringTrainingInCPU)
 {
     TestModelSerializationDuringTraining(DeviceDescriptor::CPUDevice());
@@ -1058,6 +1117,14 @@ BOOST_AUTO_TEST_CASE(FunctionSerializationInGPU)
     }
 }
 
+BOOST_AUTO_TEST_CASE(MappableFunctionSerializationInGPU)
+{
+    if (ShouldRunOnGpu())
+    {
+        TestMappableFunctionSaveAndLoad(DeviceDescriptor::GPUDevice(0));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ModelSerializationDuringTrainingInGPU)
 {
     if (ShouldRunOnGpu())
@@ -383,6 +383,11 @@ IGNORE_CLASS CNTK::Internal::TensorBoardFileWriter;
 IGNORE_STRUCT CNTK::GPUProperties;
 IGNORE_FUNCTION CNTK::DeviceDescriptor::GetGPUProperties;
 
+// The batching evaluator takes std::chrono arguments and returns std::future results, which are not wrapped.
+IGNORE_CLASS CNTK::BatchingEvaluator;
+IGNORE_STRUCT CNTK::BatchingEvaluatorStatistics;
+IGNORE_FUNCTION CNTK::CreateBatchingEvaluator;
+
 #ifndef _MSC_VER
 IGNORE_FUNCTION _wcsdup;
 #endif
@@ -152,6 +152,11 @@
 %ignore CNTK::Function::RegisterUDFDeserializeCallback;
 %ignore CNTK::Function::GetUDFDeserializeCallback;
 
+// The batching evaluator takes std::chrono arguments and returns std::future results, which are not wrapped.
+%ignore CNTK::BatchingEvaluator;
+%ignore CNTK::BatchingEvaluatorStatistics;
+%ignore CNTK::CreateBatchingEvaluator;
+
 %{
 #define SWIG_FILE_WITH_INIT
 %}